@@ -0,0 +1,179 @@
+// Benchmark driver: converts one JSON file and reports how long each phase took.
+//
+//   json2relcsv_bench [--name NAME] [--commit ID] [--repeat N] [--threads N] FILE
+//
+// Phases are timed separately: parse (lex + parse + AST build, from a fresh mapping of
+// the file), schema (the analysis pass) and write (the data pass plus schema.json).
+// Output goes to a sink that only counts bytes, so the numbers measure the converter
+// rather than the disk. Each phase reports its fastest run out of N. The result is one
+// JSON object on stdout; peak RSS covers the whole process (all runs).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "ast.h"
+#include "input.h"
+#include "json_parser.h"
+#include "schema.h"
+
+// Bytes received by the counting sink, per run.
+static size_t output_bytes;
+
+// Every stream shares one (non-NULL) handle; NULL would fail the conversion.
+static void* count_open(void* ctx, const char* name) {
+    (void)ctx;
+    (void)name;
+    return &output_bytes;
+}
+
+static int count_write(void* ctx, void* stream, const char* data, size_t len) {
+    (void)ctx;
+    (void)stream;
+    (void)data;
+    output_bytes += len;
+    return 0;
+}
+
+static int count_close(void* ctx, void* stream) {
+    (void)ctx;
+    (void)stream;
+    return 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Peak resident set size of this process, in KiB.
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;        // KiB on Linux
+#endif
+}
+
+// Prints a string as a JSON string (names and commit IDs are plain, but be safe).
+static void print_json_string(const char* s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        if ((unsigned char)*s >= 0x20) {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: json2relcsv_bench [--name NAME] [--commit ID] [--repeat N] [--threads N] FILE\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* name = NULL;
+    const char* commit = "";
+    const char* path = NULL;
+    int repeat = 3;
+    int threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--commit") == 0 && i + 1 < argc) {
+            commit = argv[++i];
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!path || repeat < 1 || threads < 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (!name) {
+        name = path;
+    }
+
+    Json2RelCsvSink sink = { count_open, count_write, count_close, NULL };
+    double best_parse = 0, best_schema = 0, best_write = 0, best_total = 0;
+    size_t input_bytes = 0;
+    int table_count = 0;
+
+    for (int run = 0; run < repeat; run++) {
+        // The scanner edits the mapping in place, so every run maps the file afresh.
+        MappedInput mapped;
+        if (input_map_file(path, &mapped) != 0) {
+            fprintf(stderr, "Error: Could not map input file %s\n", path);
+            return EXIT_FAILURE;
+        }
+        input_bytes = mapped.size;
+
+        JsonParseInput input;
+        memset(&input, 0, sizeof(input));
+        input.in_place = mapped.data;
+        input.size = mapped.size;
+
+        double t0 = now_seconds();
+        Arena arena;
+        arena_init(&arena);
+        ASTBuilder builder;
+        ast_builder_init(&builder, &arena);
+        JsonEventHandler handler = ast_builder_handler(&builder);
+        JsonParseError error;
+        int result = json_parse(&input, &handler, &error);
+        ASTNode* root = builder.root;
+        ast_builder_free(&builder);
+        if (result != 0 || !root) {
+            fprintf(stderr, "Error: %s\n", result != 0 ? error.message : "empty document");
+            arena_free(&arena);
+            input_unmap(&mapped);
+            return EXIT_FAILURE;
+        }
+
+        double t1 = now_seconds();
+        SchemaContext context = schema_context_init();
+        build_schema(root, &context);
+
+        double t2 = now_seconds();
+        output_bytes = 0;
+        write_csv_files(&context, &sink, root, threads, NULL);
+        write_schema_json(&context, &sink, NULL);
+        double t3 = now_seconds();
+
+        table_count = context.table_count;
+        free_schema(&context);
+        arena_free(&arena);
+        input_unmap(&mapped);
+
+        if (run == 0 || t1 - t0 < best_parse) best_parse = t1 - t0;
+        if (run == 0 || t2 - t1 < best_schema) best_schema = t2 - t1;
+        if (run == 0 || t3 - t2 < best_write) best_write = t3 - t2;
+        if (run == 0 || t3 - t0 < best_total) best_total = t3 - t0;
+    }
+
+    double mb = (double)input_bytes / (1024.0 * 1024.0);
+    printf("{\"workload\": ");
+    print_json_string(name);
+    printf(", \"commit\": ");
+    print_json_string(commit);
+    printf(", \"input_bytes\": %zu, \"output_bytes\": %zu, \"tables\": %d, \"threads\": %d, \"repeat\": %d",
+           input_bytes, output_bytes, table_count, threads, repeat);
+    printf(", \"parse_s\": %.6f, \"schema_s\": %.6f, \"write_s\": %.6f, \"total_s\": %.6f",
+           best_parse, best_schema, best_write, best_total);
+    printf(", \"parse_mb_s\": %.2f, \"total_mb_s\": %.2f, \"peak_rss_kb\": %ld}\n",
+           best_parse > 0 ? mb / best_parse : 0.0, best_total > 0 ? mb / best_total : 0.0, peak_rss_kb());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,42 @@
+"""Prints json2relcsv benchmark results, or compares two runs.
+
+Usage: python3 bench/compare.py RESULTS.jsonl [BASELINE.jsonl]
+
+With a baseline, every phase time gets its ratio to the baseline's (below 1.00 is faster).
+"""
+import json
+import sys
+
+PHASES = ["parse_s", "schema_s", "write_s", "total_s"]
+
+
+def load(path):
+    with open(path) as f:
+        return {r["workload"]: r for r in (json.loads(line) for line in f if line.strip())}
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    results = load(argv[1])
+    baseline = load(argv[2]) if len(argv) == 3 else {}
+
+    header = "%-10s %8s %9s %9s %9s %9s %9s %10s" % (
+        "workload", "MB", "parse s", "schema s", "write s", "total s", "MB/s", "peak RSS")
+    print(header)
+    print("-" * len(header))
+    for name, r in results.items():
+        print("%-10s %8.1f %9.3f %9.3f %9.3f %9.3f %9.1f %7.0f MB" % (
+            name, r["input_bytes"] / 1048576.0, r["parse_s"], r["schema_s"], r["write_s"], r["total_s"],
+            r["total_mb_s"], r["peak_rss_kb"] / 1024.0))
+        base = baseline.get(name)
+        if base:
+            ratios = ["%9s" % ("%.2fx" % (r[p] / base[p]) if base[p] > 0 else "-") for p in PHASES]
+            rss = r["peak_rss_kb"] / base["peak_rss_kb"] if base["peak_rss_kb"] > 0 else 0
+            print("%-10s %8s %s %9s %7.2fx" % ("  vs " + base.get("commit", "base")[:5], "", " ".join(ratios), "", rss))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
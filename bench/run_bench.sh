@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+# Runs every benchmark workload (bench/workloads.py) through json2relcsv_bench and
+# collects the results.
+#
+#   bench/run_bench.sh BENCH_BINARY OUT_DIR
+#
+# Environment: BENCH_MB (workload size, default 16), BENCH_REPEAT (runs per workload,
+# default 3), BENCH_THREADS (writer threads, default 1), BENCH_ONLY (comma-separated
+# workload names).
+#
+# Workloads are generated once per size into OUT_DIR/workloads-<MB>mb. Results go to
+# OUT_DIR/results-<commit>.jsonl (one JSON object per workload) and are printed as a
+# table; compare two result files with bench/compare.py.
+set -euo pipefail
+
+BENCH="${1:?usage: run_bench.sh BENCH_BINARY OUT_DIR}"
+OUT_DIR="${2:?usage: run_bench.sh BENCH_BINARY OUT_DIR}"
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+MB="${BENCH_MB:-16}"
+REPEAT="${BENCH_REPEAT:-3}"
+THREADS="${BENCH_THREADS:-1}"
+ONLY="${BENCH_ONLY:-records,wide,deep,junction,escapes,tables}"
+
+COMMIT="$(git -C "$REPO_ROOT" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+if [ -n "$(git -C "$REPO_ROOT" status --porcelain --untracked-files=no 2>/dev/null)" ]; then
+    COMMIT="$COMMIT-dirty"
+fi
+
+WORKLOAD_DIR="$OUT_DIR/workloads-${MB}mb"
+mkdir -p "$WORKLOAD_DIR"
+MISSING=""
+for name in ${ONLY//,/ }; do
+    [ -f "$WORKLOAD_DIR/$name.json" ] || MISSING="$MISSING,$name"
+done
+if [ -n "$MISSING" ]; then
+    echo "[bench] Generating workloads (${MB} MB each)..."
+    python3 "$REPO_ROOT/bench/workloads.py" "$WORKLOAD_DIR" --mb "$MB" --only "${MISSING#,}"
+fi
+
+RESULTS="$OUT_DIR/results-$COMMIT.jsonl"
+: > "$RESULTS"
+for name in ${ONLY//,/ }; do
+    "$BENCH" --name "$name" --commit "$COMMIT" --repeat "$REPEAT" --threads "$THREADS" \
+        "$WORKLOAD_DIR/$name.json" >> "$RESULTS"
+done
+
+python3 "$REPO_ROOT/bench/compare.py" "$RESULTS"
+echo "[bench] Results: $RESULTS"
@@ -0,0 +1,172 @@
+"""Deterministic benchmark workloads for json2relcsv.
+
+Each workload stresses one part of the converter and is generated from a fixed seed,
+so the same size always yields byte-identical input across machines and commits.
+
+Usage: python3 bench/workloads.py OUT_DIR [--mb N] [--only name,name,...]
+Writes OUT_DIR/<workload>.json for every workload (about N MB each, default 16).
+"""
+import json
+import os
+import random
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from generate_large_json import generate_json_object, generate_random_string  # noqa: E402
+
+
+def records(rng, index):
+    """Mixed records, as written by generate_large_json.py."""
+    return generate_json_object(index, rng)
+
+
+WIDE_COLUMNS = 200
+
+
+def wide(rng, index):
+    """Flat records with many columns: one big table, long rows."""
+    row = {"record_index": index}
+    for c in range(WIDE_COLUMNS):
+        kind = c % 5
+        if kind == 0:
+            value = rng.randint(0, 10 ** 9)
+        elif kind == 1:
+            value = round(rng.uniform(-1e6, 1e6), 4)
+        elif kind == 2:
+            value = generate_random_string(rng.randint(4, 16), rng)
+        elif kind == 3:
+            value = rng.random() < 0.5
+        else:
+            value = None if rng.random() < 0.3 else rng.randint(0, 100)
+        row["c%03d" % c] = value
+    return row
+
+
+DEEP_LEVELS = 40
+
+
+def deep(rng, index):
+    """Objects nested many levels down: one table per level, long FK chains."""
+    node = {"level": DEEP_LEVELS, "leaf": generate_random_string(8, rng)}
+    for level in range(DEEP_LEVELS - 1, -1, -1):
+        node = {"level": level, "weight": rng.randint(0, 1000), "n%02d" % level: node}
+    node["record_index"] = index
+    return node
+
+
+def junction(rng, index):
+    """Few objects holding huge scalar arrays: junction tables with millions of rows."""
+    return {
+        "series_index": index,
+        "name": generate_random_string(12, rng),
+        "samples": [rng.randint(-10 ** 6, 10 ** 6) for _ in range(20000)],
+        "readings": [round(rng.gauss(0, 100), 3) for _ in range(10000)],
+        "labels": [generate_random_string(6, rng) for _ in range(5000)],
+    }
+
+
+ESCAPE_PIECES = ['"', "\\", "\n", "\t", "\r", "/", "\u00e9", "\u4e2d", "\U0001f600", "\b", "\f", "\u0001"]
+
+
+def escaped_string(rng, length):
+    parts = []
+    while len(parts) < length:
+        if rng.random() < 0.3:
+            parts.append(rng.choice(ESCAPE_PIECES))
+        else:
+            parts.append(generate_random_string(rng.randint(1, 6), rng))
+    return "".join(parts)
+
+
+def escapes(rng, index):
+    """String-heavy records where most strings contain escape sequences."""
+    return {
+        "record_index": index,
+        "title": escaped_string(rng, 20),
+        "body": escaped_string(rng, 120),
+        "path": "C:\\\\data\\\\" + generate_random_string(10, rng),
+        "quote": '"' + generate_random_string(30, rng) + '"',
+        "tags": [escaped_string(rng, 4) for _ in range(rng.randint(1, 4))],
+    }
+
+
+ENTITY_KINDS = 400
+
+
+def tables(rng, index):
+    """Heterogeneous records drawing from hundreds of nested shapes: many small tables."""
+    row = {"record_index": index, "kind": rng.randint(0, 9)}
+    for kind in rng.sample(range(ENTITY_KINDS), 6):
+        entity = {"code": generate_random_string(6, rng), "score": rng.randint(0, 100)}
+        if kind % 3 == 0:
+            row["entity_%03d" % kind] = entity
+        elif kind % 3 == 1:
+            row["list_%03d" % kind] = [dict(entity, seq=s) for s in range(rng.randint(1, 3))]
+        else:
+            row["tags_%03d" % kind] = [generate_random_string(5, rng) for _ in range(rng.randint(1, 4))]
+    return row
+
+
+WORKLOADS = {
+    "records": records,
+    "wide": wide,
+    "deep": deep,
+    "junction": junction,
+    "escapes": escapes,
+    "tables": tables,
+}
+
+
+def write_workload(name, path, target_bytes):
+    """Writes {"records": [...]} with records from the named generator until the file
+    reaches about target_bytes. The seed depends only on the workload name."""
+    rng = random.Random("json2relcsv-bench-" + name)
+    generate = WORKLOADS[name]
+    written = 0
+    index = 0
+    with open(path + ".tmp", "w") as f:
+        f.write('{"records": [')
+        while written < target_bytes or index == 0:
+            text = json.dumps(generate(rng, index))
+            if index > 0:
+                f.write(", ")
+            f.write(text)
+            written += len(text) + 2
+            index += 1
+        f.write("]}\n")
+    os.replace(path + ".tmp", path)
+    return index
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    out_dir = argv[1]
+    mb = 16.0
+    only = list(WORKLOADS)
+    args = argv[2:]
+    while args:
+        flag = args.pop(0)
+        if flag == "--mb" and args:
+            mb = float(args.pop(0))
+        elif flag == "--only" and args:
+            only = [name for name in args.pop(0).split(",") if name]
+        else:
+            print("unknown argument: " + flag, file=sys.stderr)
+            return 2
+    unknown = [name for name in only if name not in WORKLOADS]
+    if unknown:
+        print("unknown workload(s): " + ", ".join(unknown), file=sys.stderr)
+        return 2
+
+    os.makedirs(out_dir, exist_ok=True)
+    for name in only:
+        path = os.path.join(out_dir, name + ".json")
+        count = write_workload(name, path, int(mb * 1024 * 1024))
+        print("%-10s %8d records  %7.1f MB  %s" % (name, count, os.path.getsize(path) / (1024.0 * 1024.0), path))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
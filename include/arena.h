@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A chunked bump allocator. Everything allocated from an arena lives until the
+// whole arena is released with arena_free(), which costs one free() per chunk.
+// Used to own all AST nodes, list cells and strings for one parsed document.
+
+struct ArenaChunk;
+
+typedef struct Arena {
+    struct ArenaChunk* head; // chunk currently being filled
+    size_t next_chunk_size;  // size of the next regular chunk (grows geometrically)
+    size_t chunk_count;      // number of chunks allocated (i.e. malloc calls)
+    size_t bytes_used;       // total bytes handed out, including alignment padding
+} Arena;
+
+// Initializes an empty arena. No memory is allocated until the first request.
+void arena_init(Arena* arena);
+
+// Returns 'size' bytes aligned for any scalar or pointer type. Never returns NULL.
+void* arena_alloc(Arena* arena, size_t size);
+
+// Returns 'count' bytes with no alignment guarantee, for packing string storage.
+char* arena_alloc_chars(Arena* arena, size_t count);
+
+// Copies 'len' bytes of 'str' into the arena and NUL-terminates the copy.
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+
+// Releases every chunk owned by the arena and resets it to the empty state.
+void arena_free(Arena* arena);
+
+#endif /* ARENA_H */
@@ -1,6 +1,13 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stddef.h>
+#include "arena.h"
+#include "json_events.h"
+#include "json2relcsv.h"
+#include "schema.h"
+#include "symbols.h"
+
 // Represents the different types of nodes in a JSON Abstract Syntax Tree.
 typedef enum {
     NODE_OBJECT,
@@ -24,61 +31,105 @@ typedef struct ASTNode {
         struct KeyValueList* object; // For NODE_OBJECT
         struct ASTNodeList* array;   // For NODE_ARRAY
         char* string;                // For NODE_STRING
-        double number;               // For NODE_NUMBER
+        char* number;                // For NODE_NUMBER: the source lexeme (see json_number.h)
         int boolean;                 // For NODE_BOOLEAN
         // NULL doesn't need data
     } value;
 } ASTNode;
 
 // Represents a key-value pair within a JSON object.
-// 'key' is the JSON object key (string).
+// 'key' is the JSON object key, interned (see symbols.h).
 // 'value' is the ASTNode representing the JSON value.
 typedef struct KeyValuePair {
-    char* key;
+    const Symbol* key;
     ASTNode* value;
 } KeyValuePair;
 
-// Represents a linked list of KeyValuePairs, used for JSON objects.
+// Represents the members of a JSON object: a contiguous vector of KeyValuePairs
+// in source order. Never NULL for an object node; an empty object has count 0.
 typedef struct KeyValueList {
-    KeyValuePair* pair;
-    struct KeyValueList* next;
+    size_t count;
+    KeyValuePair pairs[];
 } KeyValueList;
 
-// Represents a linked list of ASTNodes, used for JSON arrays.
+// Represents the elements of a JSON array: a contiguous vector of ASTNodes
+// in source order. Never NULL for an array node; an empty array has count 0.
 typedef struct ASTNodeList {
-    ASTNode* node;
-    struct ASTNodeList* next;
+    size_t count;
+    ASTNode* items[];
 } ASTNodeList;
 
+// An array or object the builder has seen start but not yet end.
+typedef struct BuilderFrame {
+    NodeType type;         // NODE_OBJECT or NODE_ARRAY
+    size_t first;          // position of the container's first member on its stack
+    const Symbol* key;     // object member key awaiting its value
+} BuilderFrame;
+
+// Builds the AST from parser events (see json_events.h).
+// Members of open containers are pushed onto scratch stacks as they complete; when a
+// container closes, its members are copied into an exactly-sized arena vector and
+// popped. Containers close in LIFO order, so one stack per kind suffices and appends
+// are amortized O(1).
+typedef struct ASTBuilder {
+    Arena* arena;          // where nodes and finished vectors are allocated
+    KeyValuePair* pairs;   // pending object members
+    size_t pair_count;
+    size_t pair_capacity;
+    ASTNode** nodes;       // pending array elements
+    size_t node_count;
+    size_t node_capacity;
+    BuilderFrame* frames;  // open containers, innermost last
+    size_t depth;
+    size_t frame_capacity;
+    SymbolTable symbols;   // interned keys; the symbols live in the arena
+    ASTNode* root;         // the document, once its top-level value is complete
+} ASTBuilder;
+
 // --- AST Node Creation Functions ---
-ASTNode* create_object_node(KeyValueList* pairs);
-ASTNode* create_array_node(ASTNodeList* elements);
-ASTNode* create_string_node(char* value);
-ASTNode* create_number_node(double value);
-ASTNode* create_boolean_node(int value);
-ASTNode* create_null_node();
-
-// --- Key-Value Pair and List Functions ---
-KeyValuePair* create_key_value_pair(char* key, ASTNode* value);
-KeyValueList* create_key_value_list(KeyValuePair* pair);
-KeyValueList* add_key_value_pair(KeyValueList* list, KeyValuePair* pair);
-
-// --- AST Node List Functions ---
-ASTNodeList* create_node_list(ASTNode* node);
-ASTNodeList* add_node_to_list(ASTNodeList* list, ASTNode* node);
+// All AST structures are allocated from the caller's arena and are released
+// together by arena_free(); there is no per-node free.
+ASTNode* create_object_node(Arena* arena, KeyValueList* pairs);
+ASTNode* create_array_node(Arena* arena, ASTNodeList* elements);
+ASTNode* create_string_node(Arena* arena, char* value);
+ASTNode* create_number_node(Arena* arena, char* text);
+ASTNode* create_boolean_node(Arena* arena, int value);
+ASTNode* create_null_node(Arena* arena);
+
+// --- Builder Functions ---
+void ast_builder_init(ASTBuilder* builder, Arena* arena);
+// Releases the scratch stacks and the key index; the AST itself stays in the arena.
+void ast_builder_free(ASTBuilder* builder);
+// Returns an event handler that feeds the builder; pass it to the parser.
+JsonEventHandler ast_builder_handler(ASTBuilder* builder);
+
+// The ColumnType bit of a scalar node's value; 0 for objects and arrays.
+int ast_scalar_type(const ASTNode* node);
+
+// Counts the nodes of the AST (for --stats).
+size_t ast_node_count(const ASTNode* root);
 
 // Prints a human-readable representation of the AST to stdout.
 // Useful for debugging (e.g., with a --print-ast command-line option).
 void print_ast(ASTNode* root, int indent);
 
-// Frees all dynamically allocated memory associated with the AST.
-void free_ast(ASTNode* root);
-
 // --- CSV Generation ---
-// Analyzes the AST and generates relational CSV files in the specified output directory.
-void generate_csv_tables(ASTNode* root, const char* output_dir);
+// Analyzes the AST once and writes one relational CSV per table to 'sink' (see json2relcsv.h).
+// If emit_schema is set, also writes schema.json describing the same inferred schema.
+// With threads > 1, tables are written concurrently; the output is identical either way.
+// Returns 0, or -1 with 'error' (if not NULL) naming the output the sink failed.
+int generate_csv_tables(ASTNode* root, const Json2RelCsvSink* sink, int emit_schema, int threads,
+                        Json2RelCsvError* error);
+
+// The two passes of generate_csv_tables(), for callers that drive or time them separately
+// (e.g. the benchmark): infers every table into an empty 'context', then writes them.
+void build_schema(ASTNode* root, SchemaContext* context);
+int write_csv_files(SchemaContext* context, const Json2RelCsvSink* sink, ASTNode* root, int threads,
+                    Json2RelCsvError* error);
 
-// Analyzes the AST and writes schema.json describing the inferred relational schema.
-void emit_schema_json(ASTNode* root, const char* output_dir);
+// Adds to the column types of 'context' (as built by build_schema()) those of every value
+// write_csv_files() would write, including values the schema pass does not look at.
+// Only the types change; pgcopy uses this on a copy to type its columns up front.
+void type_csv_files(SchemaContext* context, ASTNode* root);
 
 #endif /* AST_H */
@@ -0,0 +1,101 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stddef.h>
+#include "json2relcsv.h"
+#include "schema.h"
+
+// Columnar output (--format=columnar): each table as "<table>.jrc", a self-describing
+// binary file that a loader can read without parsing or unescaping any text.
+//
+// All integers are little-endian. A file is:
+//
+//   "JRC1"                                  magic and format version
+//   u32 name length, name bytes             the table
+//   u32 column count, then per column:      its name, as in the CSV header
+//       u32 name length, name bytes
+//   chunks, each:
+//       u32 row count (> 0)
+//       per column, in order: a column chunk
+//   u32 0                                   end of file
+//
+// A column chunk holds one column's values for the chunk's rows:
+//
+//   u8  encoding                            ColumnarEncoding
+//   u8  flags                               COLUMNAR_HAS_NULLS: a null bitmap follows
+//   u32 length of the rest of the column chunk, so readers can skip columns
+//   [null bitmap]                           ceil(rows / 8) bytes; bit i (LSB first) is set
+//                                           if row i has a value
+//   payload                                 the values of the rows that have one
+//
+// Payloads, for n values:
+//
+//   COLUMNAR_NULL          nothing: every row is null (the bitmap is omitted)
+//   COLUMNAR_BOOL          ceil(n / 8) bytes, bit i (LSB first) set for true
+//   COLUMNAR_INT64         i64 base, u8 width w (1, 2, 4 or 8), then n x w-byte unsigned
+//                          offset: value = base + offset
+//   COLUMNAR_INT64_DELTA   i64 first value, i64 base, u8 width w, then (n - 1) x w-byte
+//                          unsigned offset: value = previous value + base + offset
+//   COLUMNAR_FLOAT64       n x IEEE 754 binary64
+//   COLUMNAR_NUMBER_TEXT   strings: the source lexemes of numbers no fixed type holds exactly
+//   COLUMNAR_STRING        strings
+//   COLUMNAR_STRING_DICT   u32 d, u8 index width w (1, 2 or 4), strings (the d distinct
+//                          values), then n x w-byte index into them
+//   COLUMNAR_MIXED         n x u8 ColumnarValueKind, then strings (the text of each
+//                          value; empty for booleans)
+//
+// Integer arithmetic wraps modulo 2^64. "strings" for k values is u32 offsets[k + 1]
+// (offsets[0] = 0) followed by offsets[k] bytes of UTF-8; value i is bytes
+// [offsets[i], offsets[i + 1]).
+//
+// Each chunk picks every column's encoding from the values it holds, so a column may
+// change encoding between chunks. Numbers are only given a fixed type when converting
+// them back (see columnar_format_double()) reproduces the CSV text exactly: dumping a
+// file as CSV gives the same bytes as --format=csv.
+
+#define COLUMNAR_MAGIC "JRC1"
+#define COLUMNAR_FILE_EXTENSION ".jrc"
+
+// Rows per chunk, unless the chunk's text reaches COLUMNAR_CHUNK_BYTES first.
+#define COLUMNAR_CHUNK_ROWS 65536
+#define COLUMNAR_CHUNK_BYTES (4 * 1024 * 1024)
+
+#define COLUMNAR_HAS_NULLS 1
+
+typedef enum {
+    COLUMNAR_NULL = 0,
+    COLUMNAR_BOOL = 1,
+    COLUMNAR_INT64 = 2,
+    COLUMNAR_FLOAT64 = 3,
+    COLUMNAR_NUMBER_TEXT = 4,
+    COLUMNAR_STRING = 5,
+    COLUMNAR_STRING_DICT = 6,
+    COLUMNAR_MIXED = 7,
+    COLUMNAR_INT64_DELTA = 8
+} ColumnarEncoding;
+
+// The type of one value of a COLUMNAR_MIXED column chunk.
+typedef enum {
+    COLUMNAR_VALUE_STRING = 1,
+    COLUMNAR_VALUE_NUMBER = 2,
+    COLUMNAR_VALUE_FALSE = 3,
+    COLUMNAR_VALUE_TRUE = 4
+} ColumnarValueKind;
+
+// Turns each "<table>.csv" written through it into "<table>.jrc" on 'inner'; other
+// streams (schema.json) pass through. The CSV text is decoded as it arrives and
+// re-encoded a chunk at a time, so memory stays bounded per open table.
+typedef struct ColumnarSink {
+    const Json2RelCsvSink* inner;
+    const SchemaContext* context;  // the tables' columns; must be complete before a CSV
+                                   // is opened, and not change while it is open
+} ColumnarSink;
+
+// Returns a sink that writes through 'columnar' (which must outlive it) to 'inner'.
+Json2RelCsvSink columnar_sink(ColumnarSink* columnar, const Json2RelCsvSink* inner, const SchemaContext* context);
+
+// Writes the canonical text of a finite double: "%.<p>g" with the smallest p (1 to 17)
+// that converts back to the same value. Returns the length.
+int columnar_format_double(double value, char* out, size_t size);
+
+#endif /* COLUMNAR_H */
@@ -0,0 +1,65 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "json2relcsv.h"
+
+// Compressed output (--compress): every stream written through a CompressSink reaches the
+// inner sink as "<name>.gz" (a gzip file) or "<name>.zst" (a zstd frame), compressed as it
+// is written, so no uncompressed copy of a table is ever held or stored.
+//
+// Streams are compressed by a pool of threads shared by the whole sink, one per
+// processor at most and started as blocks arrive: writes fill one block of a stream
+// while a thread compresses the block before with the stream's codec and hands the
+// result to the inner sink, so the CPU time of compressing the tables overlaps with
+// generating their rows. If no thread can be started (e.g. a build without thread
+// support), blocks are compressed inline as they fill. A codec or inner stream that
+// fails makes the stream's writes and close fail.
+//
+// A codec is only compiled in if its library was found at build time (zlib for gzip:
+// JSON2RELCSV_WITH_ZLIB, libzstd for zstd: JSON2RELCSV_WITH_ZSTD); see compress_supported().
+
+#define COMPRESS_GZIP_EXTENSION ".gz"
+#define COMPRESS_ZSTD_EXTENSION ".zst"
+
+// Uncompressed bytes per block handed to the compression threads.
+#define COMPRESS_BLOCK_SIZE (256 * 1024)
+
+// The most compression threads a sink starts, however many processors there are.
+#define COMPRESS_MAX_THREADS 64
+
+struct CompressStream;
+
+typedef struct CompressSink {
+    const Json2RelCsvSink* inner;
+    int compression;  // a Json2RelCsvCompression other than NONE
+    int level;        // 1 to compress_max_level(), or 0 for the codec's default
+    // The compression threads
+    pthread_t threads[COMPRESS_MAX_THREADS];
+    int thread_count;          // started so far
+    int max_threads;           // processors online
+    int idle;                  // threads waiting for a block
+    int stopping;              // compress_sink_destroy() was called
+    struct CompressStream* queue;      // streams with a block to compress, oldest first
+    struct CompressStream* queue_tail;
+    pthread_mutex_t lock;      // guards the above and every stream's pending block
+    pthread_cond_t queued;     // a block was queued, or 'stopping' set
+    pthread_cond_t done;       // a queued block was compressed
+} CompressSink;
+
+// Returns 1 if this build can compress with 'compression' (a Json2RelCsvCompression).
+int compress_supported(int compression);
+
+// The highest level 'compression' accepts: 9 for gzip, 22 for zstd.
+int compress_max_level(int compression);
+
+// Returns a sink that compresses through 'compress' (which must outlive it) to 'inner'.
+// 'compression' must be supported and 'level' in range.
+// Release 'compress' with compress_sink_destroy() once every stream is closed.
+Json2RelCsvSink compress_sink(CompressSink* compress, const Json2RelCsvSink* inner, int compression, int level);
+
+// Stops the sink's compression threads.
+void compress_sink_destroy(CompressSink* compress);
+
+#endif /* COMPRESS_H */
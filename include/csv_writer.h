@@ -0,0 +1,76 @@
+#ifndef CSV_WRITER_H
+#define CSV_WRITER_H
+
+#include <stdio.h>
+#include <string.h>
+#include "json2relcsv.h"
+
+struct ASTNode;
+
+// Output buffer for CSV text. Bound to a sink stream (see json2relcsv.h), it collects
+// output in one large block and hands it to the sink only when the block fills up, so
+// each cell costs a memcpy rather than a call per field. Unbound (sink == NULL, e.g.
+// zero-initialized), it grows instead and serves as an in-memory byte buffer.
+typedef struct {
+    const Json2RelCsvSink* sink;
+    void* stream;
+    char* data;
+    size_t len;
+    size_t cap;
+    size_t flushed;         // bytes handed to the sink (counted with JSON2RELCSV_STATS)
+    int failed;             // the sink failed a write; later output is dropped
+} CsvBuffer;
+
+// Binds a buffer to a stream of 'sink' (or to memory when 'sink' is NULL). Storage is
+// allocated on first use.
+void csv_buffer_init(CsvBuffer* buffer, const Json2RelCsvSink* sink, void* stream);
+
+// Makes room for 'extra' more bytes: flushes a sink-bound buffer, grows a memory one.
+// A sink-bound buffer may still have less room than asked for; see csv_buffer_append.
+void csv_buffer_reserve(CsvBuffer* buffer, size_t extra);
+
+// Writes out everything buffered so far (sink-bound buffers only).
+void csv_buffer_flush(CsvBuffer* buffer);
+
+// Flushes and releases the buffer's storage. The stream is left open.
+void csv_buffer_free(CsvBuffer* buffer);
+
+// Flushes and releases the buffer's storage, then closes its stream. Returns 0, or -1
+// if the sink failed a write to the stream or its close.
+int csv_buffer_close(CsvBuffer* buffer);
+
+// Fills 'error' (if not NULL) for the output 'name' that a sink failed to open, write
+// or close.
+void csv_output_error(Json2RelCsvError* error, const char* name);
+
+// Copies bytes into the buffer; blocks larger than a sink-bound buffer go straight to the sink.
+void csv_buffer_append_slow(CsvBuffer* buffer, const void* bytes, size_t len);
+
+static inline void csv_buffer_append(CsvBuffer* buffer, const void* bytes, size_t len) {
+    if (len < buffer->cap - buffer->len) {
+        memcpy(buffer->data + buffer->len, bytes, len);
+        buffer->len += len;
+    } else {
+        csv_buffer_append_slow(buffer, bytes, len);
+    }
+}
+
+static inline void csv_buffer_putc(CsvBuffer* buffer, char c) {
+    if (buffer->len == buffer->cap) {
+        csv_buffer_reserve(buffer, 1);
+    }
+    buffer->data[buffer->len++] = c;
+}
+
+// Appends a decimal integer (hand-formatted; used for id, FK, seq and index columns).
+void csv_buffer_append_int(CsvBuffer* buffer, int value);
+
+// Appends a string as a quoted CSV field, doubling embedded quotes.
+void csv_buffer_append_quoted(CsvBuffer* buffer, const char* str);
+
+// Appends a scalar ASTNode as a CSV cell: strings quoted and escaped, numbers verbatim,
+// booleans as true/false, null as an empty field. Objects and arrays cannot be cells;
+// they produce a warning and an empty field.
+void csv_buffer_append_value(CsvBuffer* buffer, const struct ASTNode* node);
+
+#endif /* CSV_WRITER_H */
@@ -0,0 +1,30 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// A file mapped into memory for the lexer to scan in place (--input).
+// The mapping is private and writable, so the lexer's in-place edits (string
+// terminators, Flex's held character) stay local to the process, and it is followed
+// by the two NUL bytes Flex expects at the end of a scan buffer. Pages are only
+// copied if they are written to.
+typedef struct MappedInput {
+    char* data;          // file contents, followed by two NUL bytes
+    size_t size;         // file size in bytes
+    size_t mapped_size;  // length of the whole mapping, for munmap()
+} MappedInput;
+
+// Maps the regular file at 'path'. Returns 0 on success, or -1 if the file cannot be
+// opened or mapped (e.g. it is a pipe or a terminal); then the caller should read it
+// as a stream instead.
+int input_map_file(const char* path, MappedInput* input);
+
+// Unmaps the file and resets 'input' to empty.
+void input_unmap(MappedInput* input);
+
+// Reads a whole stream (e.g. a pipe) into a new heap buffer, for inputs that must be in
+// memory but cannot be mapped. Stores the length in 'size'; the caller frees the buffer.
+char* input_read_stream(FILE* file, size_t* size);
+
+#endif /* INPUT_H */
@@ -0,0 +1,205 @@
+#ifndef JSON2RELCSV_H
+#define JSON2RELCSV_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// libjson2relcsv: converts a JSON document into relational CSV tables (one per inferred
+// table, plus an optional schema.json) and hands every output to a sink rather than to
+// the file system. The json2relcsv command is a thin wrapper that uses the directory sink.
+
+// Receives the converter's outputs as named byte streams: "<table>.csv" (or another
+// format's file, see Json2RelCsvFormat) for every table, then "schema.json" if requested.
+// Each stream is opened, written in order and closed. A stream the sink cannot open,
+// write or close fails the conversion (see Json2RelCsvError); an open one is still closed.
+// With threads > 1, several tables are written at the same time from different threads,
+// so open/write/close must be safe to call concurrently for different streams. With
+// compression, a stream's writes come from its compression thread, not the one that
+// opened it (but never two at once).
+typedef struct Json2RelCsvSink {
+    // Starts a stream. Returns a handle for write/close, or NULL if the output cannot be
+    // accepted.
+    void* (*open)(void* ctx, const char* name);
+    // Appends 'len' bytes to a stream. Returns 0, or -1 if they could not be written;
+    // later writes to the stream may then be skipped.
+    int (*write)(void* ctx, void* stream, const char* data, size_t len);
+    // Ends a stream and releases its handle. Returns 0, or -1 if the stream could not be
+    // completed (e.g. flushing it failed).
+    int (*close)(void* ctx, void* stream);
+    void* ctx;
+} Json2RelCsvSink;
+
+// Wall-clock and CPU time (all threads) spent in one phase of a conversion.
+typedef struct Json2RelCsvPhase {
+    double wall_seconds;
+    double cpu_seconds;
+} Json2RelCsvPhase;
+
+// One table's output.
+typedef struct Json2RelCsvTableStats {
+    char* name;
+    long rows;
+    size_t bytes;      // of its CSV, header included
+} Json2RelCsvTableStats;
+
+// What a conversion did (--stats). Token, row and byte counts are only gathered by
+// builds with JSON2RELCSV_STATS (counters_enabled); otherwise they are 0.
+typedef struct Json2RelCsvStats {
+    Json2RelCsvPhase parse;        // lexing, parsing and building the AST (with 'stream':
+                                   // also schema inference and spooling rows)
+    Json2RelCsvPhase schema;       // the schema pass over the AST (none with 'stream')
+    Json2RelCsvPhase write;        // writing the CSVs
+    Json2RelCsvPhase emit_schema;  // writing schema.json
+    long tokens;                   // tokens scanned, and by kind:
+    long punctuation_tokens;       //   { } [ ] : ,
+    long string_tokens;            //   strings, of which
+    long escaped_string_tokens;    //     strings with escapes
+    long number_tokens;
+    long literal_tokens;           //   true, false, null
+    size_t ast_nodes;              // nodes in the AST (0 with 'stream')
+    size_t arena_bytes;            // bytes allocated for the AST, and in how many blocks
+    size_t arena_blocks;
+    long peak_rss_kb;              // of the whole process, at the end of the conversion
+    long dropped_values;           // values the schema had no place for (schema + drop_unknown)
+    int table_count;
+    Json2RelCsvTableStats* tables; // in creation order; see json2relcsv_stats_free()
+    int counters_enabled;
+} Json2RelCsvStats;
+
+// A schema.json loaded for schema-first conversion; see json2relcsv_schema_load().
+typedef struct Json2RelCsvSchema Json2RelCsvSchema;
+
+// How the tables are written (--format).
+typedef enum Json2RelCsvFormat {
+    JSON2RELCSV_FORMAT_CSV = 0,      // "<table>.csv"
+    JSON2RELCSV_FORMAT_COLUMNAR = 1, // "<table>.jrc": typed binary columns, see columnar.h
+    JSON2RELCSV_FORMAT_PGCOPY = 2    // "<table>.pgcopy": PostgreSQL binary COPY files, and
+                                     // "schema.sql" after them; see pgcopy.h
+} Json2RelCsvFormat;
+
+// How every output is compressed (--compress). Each stream's name gets the codec's
+// extension ("root.csv.gz", "schema.json.zst"); see compress.h.
+typedef enum Json2RelCsvCompression {
+    JSON2RELCSV_COMPRESS_NONE = 0,
+    JSON2RELCSV_COMPRESS_GZIP = 1,   // ".gz", levels 1 to 9; needs a build with zlib
+    JSON2RELCSV_COMPRESS_ZSTD = 2    // ".zst", levels 1 to 22; needs a build with libzstd
+} Json2RelCsvCompression;
+
+// How to convert. Zero-initialize, then set what is needed.
+typedef struct Json2RelCsvOptions {
+    int emit_schema;   // also write "schema.json"
+    int stream;        // convert while parsing, without building the AST (--stream)
+    int ndjson;        // the input is JSON Lines, one value per line (--ndjson)
+    int threads;       // parsing (JSON Lines) and writer threads; 0 means 1
+    int print_ast;     // print the AST to stdout before converting (not with 'stream')
+    Json2RelCsvStats* stats; // if not NULL, filled in on success (--stats)
+    const Json2RelCsvSchema* schema; // if not NULL, write these tables instead of inferring
+                       // them, in one streaming pass (--schema; implies 'stream')
+    int drop_unknown;  // with 'schema': skip values it has no table or column for, rather
+                       // than failing (--drop-unknown)
+    int format;        // a Json2RelCsvFormat (--format); schema.json is written either way
+    int compression;   // a Json2RelCsvCompression (--compress)
+    int compression_level; // 0 for the codec's default
+} Json2RelCsvOptions;
+
+// Why a conversion failed. 'line' and 'column' are 0 unless the input is malformed.
+typedef struct Json2RelCsvError {
+    int line;
+    int column;
+    char message[160];
+} Json2RelCsvError;
+
+// Converts 'size' bytes of JSON in memory. Returns 0 on success; otherwise fills 'error'
+// (if not NULL) and returns -1, and the sink may have received nothing or only some
+// streams; if the sink failed a stream, the error names it. On success every table has
+// been opened, written and closed.
+int json2relcsv_convert(const char* data, size_t size, const Json2RelCsvOptions* options,
+                        const Json2RelCsvSink* sink, Json2RelCsvError* error);
+
+// Same, reading JSON from a stream until end of file.
+int json2relcsv_convert_stream(FILE* file, const Json2RelCsvOptions* options,
+                               const Json2RelCsvSink* sink, Json2RelCsvError* error);
+
+// Same, reading the file at 'path'. Regular files are memory-mapped and lexed in place.
+int json2relcsv_convert_file(const char* path, const Json2RelCsvOptions* options,
+                             const Json2RelCsvSink* sink, Json2RelCsvError* error);
+
+// Releases the table list of stats filled in by a conversion.
+void json2relcsv_stats_free(Json2RelCsvStats* stats);
+
+// --- Schema-first conversion ---
+
+// Loads a schema.json written by a conversion with emit_schema, to convert documents
+// of the same shape without inferring their schema again. Returns NULL and fills
+// 'error' (if not NULL) if the file cannot be read or does not describe a schema.
+// A loaded schema is read-only and may be shared by concurrent conversions.
+Json2RelCsvSchema* json2relcsv_schema_load(const char* path, Json2RelCsvError* error);
+
+// Same, from 'size' bytes of schema.json in memory.
+Json2RelCsvSchema* json2relcsv_schema_parse(const char* data, size_t size, Json2RelCsvError* error);
+
+void json2relcsv_schema_free(Json2RelCsvSchema* schema);
+
+// --- Appending ---
+
+// Converts the file at 'path' (or 'file') and adds its rows to the output of earlier
+// appends in 'dir', so that a new batch of records costs only its own conversion.
+// "<dir>/json2relcsv_state.json" holds the schema and the last row ID so far: the
+// schema is inferred on top of it and row IDs continue after it. Existing CSVs are
+// appended to; one is rewritten only when the batch adds columns to its table, to pad
+// its rows. Without a state file, 'dir' is written from scratch. The state file is
+// replaced last, and not at all if a conversion or write fails.
+// options->schema must not be set, options->format must be CSV and options->compression
+// NONE.
+int json2relcsv_append_file(const char* path, const Json2RelCsvOptions* options, const char* dir,
+                            Json2RelCsvError* error);
+
+int json2relcsv_append_stream(FILE* file, const Json2RelCsvOptions* options, const char* dir,
+                              Json2RelCsvError* error);
+
+// --- Sinks ---
+
+// Writes each stream to "<dir>/<name>" ("" and "." mean the current directory), creating
+// the directory if needed. 'dir' must outlive the sink.
+Json2RelCsvSink json2relcsv_directory_sink(const char* dir);
+
+// Collects every stream in a growable memory buffer, in the order they were opened.
+typedef struct Json2RelCsvMemory Json2RelCsvMemory;
+
+Json2RelCsvMemory* json2relcsv_memory_create(void);
+Json2RelCsvSink json2relcsv_memory_sink(Json2RelCsvMemory* memory);
+
+// Shorthand for json2relcsv_convert() into json2relcsv_memory_sink(memory).
+int json2relcsv_convert_to_memory(const char* data, size_t size, const Json2RelCsvOptions* options,
+                                  Json2RelCsvMemory* memory, Json2RelCsvError* error);
+
+// The collected outputs: their number, and each one's name, contents (NUL-terminated
+// for convenience) and size. Pointers stay valid until json2relcsv_memory_free().
+int json2relcsv_memory_count(const Json2RelCsvMemory* memory);
+const char* json2relcsv_memory_name(const Json2RelCsvMemory* memory, int index);
+const char* json2relcsv_memory_data(const Json2RelCsvMemory* memory, int index);
+size_t json2relcsv_memory_size(const Json2RelCsvMemory* memory, int index);
+
+// Releases the collected outputs.
+void json2relcsv_memory_free(Json2RelCsvMemory* memory);
+
+// Writes every stream as a member of one tar archive to 'file' (e.g. stdout), so that a
+// whole conversion is a single sequential write. The archive is POSIX ustar, with a pax
+// header for names over 100 bytes. A tar header holds its member's size, so each stream
+// is collected (in memory, or a temporary file once it is large) and written whole when
+// it is closed: members appear in the order they are closed, which with threads > 1 may
+// vary from run to run.
+typedef struct Json2RelCsvArchive Json2RelCsvArchive;
+
+Json2RelCsvArchive* json2relcsv_archive_create(FILE* file);
+Json2RelCsvSink json2relcsv_archive_sink(Json2RelCsvArchive* archive);
+
+// Ends the archive once every conversion into it is done, and flushes 'file' (which
+// stays open). Returns 0, or -1 if a write failed. A failed conversion still closes
+// its streams, so their members are already in 'file': leave the archive unended
+// then, and discard 'file' if it can be.
+int json2relcsv_archive_finish(Json2RelCsvArchive* archive);
+
+void json2relcsv_archive_free(Json2RelCsvArchive* archive);
+
+#endif /* JSON2RELCSV_H */
@@ -0,0 +1,22 @@
+#ifndef JSON_EVENTS_H
+#define JSON_EVENTS_H
+
+struct ASTNode;
+
+// SAX-style callbacks the parser drives as it recognizes the document.
+// Events arrive in document order: start_object, then key followed by that key's
+// value for every member, then end_object; arrays likewise, minus the keys.
+// Strings passed to key/scalar point into the lexer's buffers and are only valid for
+// the duration of the callback; handlers that keep a string must copy it.
+typedef struct JsonEventHandler {
+    void (*start_object)(void* ctx);
+    void (*end_object)(void* ctx);
+    void (*start_array)(void* ctx);
+    void (*end_array)(void* ctx);
+    void (*key)(void* ctx, char* key);
+    // 'value' is a transient NODE_STRING/NUMBER/BOOLEAN/NULL node describing the scalar.
+    void (*scalar)(void* ctx, const struct ASTNode* value);
+    void* ctx;
+} JsonEventHandler;
+
+#endif /* JSON_EVENTS_H */
@@ -0,0 +1,18 @@
+#ifndef JSON_NUMBER_H
+#define JSON_NUMBER_H
+
+#include <stddef.h>
+
+// Numbers are carried through the converter as their source lexeme (e.g. "12.50",
+// "1e400"), so CSV output copies the digits verbatim and loses nothing. Code that
+// needs the numeric value converts the lexeme on demand.
+
+// Converts a JSON number lexeme to the nearest double, correctly rounded.
+// 'text' must match the lexer's NUMBER pattern.
+double json_number_to_double(const char* text);
+
+// Converts the 'len'-byte lexeme of an integer (no fraction or exponent) to its value.
+// Returns 0 if the number has a fraction or exponent, or does not fit in 64 bits.
+int json_number_to_int64(const char* text, size_t len, long long* value);
+
+#endif /* JSON_NUMBER_H */
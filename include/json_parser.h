@@ -0,0 +1,70 @@
+#ifndef JSON_PARSER_H
+#define JSON_PARSER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "json_events.h"
+
+// Entry point to the Flex scanner and Bison parser. Each json_parse() call runs its
+// own scanner and parser instance with all state in a JsonParseState, so several
+// documents (or chunks of one, see ndjson.h) can be parsed concurrently. Malformed
+// input is reported back to the caller; nothing is printed and the process goes on.
+
+// Tokens scanned, by kind (--stats; see stats.h).
+typedef struct JsonTokenCounts {
+    long punctuation;        // { } [ ] : ,
+    long strings;            // including escaped_strings
+    long escaped_strings;    // strings that needed decoding
+    long numbers;
+    long literals;           // true, false, null
+} JsonTokenCounts;
+
+// What to parse. Zero-initialize, then set exactly one of file, data or in_place.
+typedef struct JsonParseInput {
+    FILE* file;              // a stream, read through the scanner's buffer
+    const char* data;        // 'size' bytes in memory, read through the scanner's buffer
+    char* in_place;          // 'size' bytes followed by two NULs, scanned where they lie
+                             // (writable; see input.h)
+    size_t size;
+    int records;             // JSON Lines: accept any number of values (one per line) and
+                             // report them as the elements of one top-level array; a
+                             // newline inside a value is an error
+    const char* line_origin; // for 'data' that is part of a larger text: that text's start,
+                             // so error messages give line numbers within the whole text
+    JsonTokenCounts* token_counts; // if not NULL, this parse's token counts are added here
+} JsonParseInput;
+
+// Why a parse failed.
+typedef struct JsonParseError {
+    int line;               // within the whole text (see JsonParseInput.line_origin)
+    int column;
+    char message[160];      // e.g. "syntax error at line 3, column 7"
+} JsonParseError;
+
+// Parses the input, reporting it to 'events'. Returns 0 on success. On malformed input,
+// stops at the first error, fills 'error' and returns -1; events already delivered
+// stay delivered, so the handler's partial result should be discarded.
+int json_parse(const JsonParseInput* input, JsonEventHandler* events, JsonParseError* error);
+
+// Per-parse state shared by the scanner (as its extra data) and the parser.
+typedef struct JsonParseState {
+    JsonEventHandler* events;
+    int line_num;              // position of the current token, for error messages
+    int column_num;
+    int pending_token;         // token to return before scanning any input (0 = none)
+    int records;               // see JsonParseInput
+    int depth;                 // objects and arrays open at the current token
+    char* decoded_buffer;      // scratch for strings with escapes; reused for every such token
+    size_t decoded_capacity;
+    const char* line_origin;   // see JsonParseInput
+    const char* text;
+    JsonParseError* error;     // the first error, once 'failed' is set
+    int failed;
+    JsonTokenCounts tokens;    // counted only in builds with JSON2RELCSV_STATS
+} JsonParseState;
+
+// Records an error at the current line and the given column, unless one was already
+// recorded (the parser's "syntax error" follows every lexical error).
+void json_parse_fail(JsonParseState* state, int column, const char* what);
+
+#endif /* JSON_PARSER_H */
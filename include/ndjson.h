@@ -0,0 +1,28 @@
+#ifndef NDJSON_H
+#define NDJSON_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "ast.h"
+#include "json_parser.h"
+
+// JSON Lines input (--ndjson): one JSON value per line. The document is converted
+// exactly as if the lines had been wrapped in one top-level array, so rows, IDs and
+// schema match that array's conversion. A value must end on the line it starts on; the
+// scanner rejects a newline inside one, whatever the thread count.
+//
+// The text is split at newlines into chunks that are parsed concurrently, each by its
+// own parser instance into its own arena; the chunks' records are then joined, in
+// order, into the top-level array. Schema inference and ID numbering run once over
+// the joined array, which keeps IDs globally consistent without coordination between
+// the parsing threads.
+
+// Parses 'size' bytes of JSON Lines with up to 'chunk_count' threads. Nodes are
+// allocated from arenas[0 .. chunk_count - 1], which the caller initializes and frees.
+// Returns 0 and stores the top-level array in 'root', or returns -1 and describes the
+// first error in the text (by position, whichever thread found it) in 'error'.
+// If 'token_counts' is not NULL, every chunk's token counts are added to it.
+int ndjson_parse(const char* text, size_t size, int chunk_count, Arena* arenas, ASTNode** root,
+                 JsonParseError* error, JsonTokenCounts* token_counts);
+
+#endif /* NDJSON_H */
@@ -0,0 +1,90 @@
+#ifndef PGCOPY_H
+#define PGCOPY_H
+
+#include <pthread.h>
+#include "json2relcsv.h"
+#include "schema.h"
+
+// PostgreSQL output (--format=pgcopy): each table as "<table>.pgcopy" in the binary
+// format of COPY, so the server loads it without parsing any text:
+//
+//   COPY "<table>" FROM '/path/<table>.pgcopy' WITH (FORMAT binary);
+//
+// plus "schema.sql", the CREATE TABLE statements for the tables to load into.
+//
+// A file is PostgreSQL's binary COPY format, with every integer big-endian:
+//
+//   "PGCOPY\n\377\r\n\0"                    signature
+//   int32 0                                 flags
+//   int32 length, header extension          skipped by PostgreSQL; see below
+//   rows, each:
+//       int16 field count                   the table's column count
+//       per field: int32 length (-1 for null), then the value in its type's binary
+//       send format
+//   int16 -1                                end of file
+//
+// The header extension describes the columns, so the files can be read without the
+// DDL (json2relcsv_pgcopy_dump does):
+//
+//   PGCOPY_EXTENSION_TAG                    12 bytes
+//   int32 column count, then per column:
+//       int32 type OID, int32 name length, name bytes
+//
+// Each column's type comes from the ColumnType bits of every value written to it (see
+// pgcopy_column_type()): the schema pass's, plus those of values it does not look at,
+// from type_csv_files() or stream_converter_type_rows() before the first row goes out.
+// With --schema, a loaded schema.json's types are used as they are, so a document can
+// put a value in a column that its type cannot hold (a string in a bigint column, say);
+// like a column the schema lacks, that fails the conversion, with the column named.
+
+#define PGCOPY_FILE_EXTENSION ".pgcopy"
+#define PGCOPY_DDL_FILE_NAME "schema.sql"
+
+#define PGCOPY_SIGNATURE "PGCOPY\n\377\r\n"  // and its terminating NUL: 11 bytes
+#define PGCOPY_SIGNATURE_SIZE 11
+#define PGCOPY_EXTENSION_TAG "json2relcsv"    // and its terminating NUL: 12 bytes
+#define PGCOPY_EXTENSION_TAG_SIZE 12
+
+// PostgreSQL allows no more columns in a table.
+#define PGCOPY_MAX_COLUMNS 1600
+
+// The column types used, by their PostgreSQL type OID.
+typedef enum {
+    PGCOPY_BOOLEAN = 16,
+    PGCOPY_BIGINT = 20,
+    PGCOPY_TEXT = 25,
+    PGCOPY_NUMERIC = 1700
+} PgCopyType;
+
+// The type of a column that holds values of 'types' (ColumnType bits): boolean or
+// bigint if every value is one, numeric if every value is a number, and otherwise
+// text (numbers and booleans as their CSV text).
+PgCopyType pgcopy_column_type(int types);
+
+// The SQL name of a type; NULL if it is not a PgCopyType.
+const char* pgcopy_type_name(int type);
+
+// Turns each "<table>.csv" written through it into "<table>.pgcopy" on 'inner'; other
+// streams (schema.json) pass through. Rows are re-encoded as they arrive.
+typedef struct PgCopySink {
+    const Json2RelCsvSink* inner;
+    const SchemaContext* context;  // the tables' columns and types; must be complete
+                                   // before a CSV is opened, and not change while it is open
+    pthread_mutex_t lock;          // guards 'error': tables may be written concurrently
+    char error[160];               // the first value that did not fit its column; "" if none
+} PgCopySink;
+
+// Returns a sink that writes through 'pgcopy' (which must outlive it) to 'inner'.
+// Release 'pgcopy' with pgcopy_sink_destroy() once every stream is closed.
+Json2RelCsvSink pgcopy_sink(PgCopySink* pgcopy, const Json2RelCsvSink* inner, const SchemaContext* context);
+
+void pgcopy_sink_destroy(PgCopySink* pgcopy);
+
+// Writes "schema.sql" to 'sink': a CREATE TABLE statement per table, parents first,
+// with the types of pgcopy_column_type() and "id" as the primary key, then each table's
+// foreign key to its parent as an ALTER TABLE statement, to run after loading. The keys
+// are NOT VALID: the data pass does not guarantee that every foreign key value is the ID
+// of a parent row. Returns 0, or -1 and fills 'error' if the sink fails the stream.
+int write_schema_sql(const SchemaContext* context, const Json2RelCsvSink* sink, Json2RelCsvError* error);
+
+#endif /* PGCOPY_H */
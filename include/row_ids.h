@@ -0,0 +1,57 @@
+#ifndef ROW_IDS_H
+#define ROW_IDS_H
+
+// Row ID numbering for the data pass.
+//
+// The output format numbers each table's rows as if the table had been written by
+// its own AST walk with its own counter (which is how the data pass first worked).
+// Those per-table counters only drift apart at arrays whose key names a table:
+// there, the table's own walk gave each element a single ID, while every other walk
+// gave object elements two and scalars none. So writers keep one shared base
+// counter plus a per-table offset that is adjusted at such arrays. Offsets are
+// checkpointed so a child row can recover its parent's ID as its own table saw it,
+// even if the offset moved in between.
+
+// Checkpoint of a table's ID offset, recorded whenever the offset changes.
+typedef struct {
+    unsigned long version;
+    int delta;
+} IdDeltaMark;
+
+// The shared base counter.
+typedef struct {
+    int next_id;            // next base ID (starts at 1)
+    unsigned long version;  // bumped on every offset change of any table
+} RowIdCounter;
+
+// One table's view of the numbering.
+typedef struct {
+    int delta;              // offset of this table's IDs from the shared base counter
+    int excluded;           // >0 while inside a subtree this table's numbering never visits
+    IdDeltaMark* marks;     // delta history, ordered by version
+    int mark_count;
+    int mark_capacity;
+} RowIds;
+
+// The logical parent row of the node being written.
+typedef struct {
+    const char* key;        // sanitized parent key, used to name FK columns; NULL at the root
+    int base_id;            // parent's ID on the shared base counter
+    unsigned long version;  // RowIdCounter.version when the parent was visited
+} ParentRef;
+
+// Changes a table's ID offset and checkpoints the new value.
+void row_ids_set_delta(RowIdCounter* counter, RowIds* ids, int delta);
+
+// Resolves the parent's row ID as seen by the table owning 'ids'.
+int row_ids_parent_id(const RowIds* ids, const ParentRef* parent);
+
+// Drops checkpoints no future lookup can reach. 'live_versions' (ascending) are the
+// versions of every ParentRef still in use; parents created later always see the
+// current offset. Keeps the history proportional to nesting depth when streaming.
+void row_ids_compact(RowIds* ids, const unsigned long* live_versions, int live_count);
+
+// Frees the checkpoint history.
+void row_ids_free(RowIds* ids);
+
+#endif /* ROW_IDS_H */
@@ -0,0 +1,144 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+// The inferred relational schema (tables, columns, parent links) shared by the
+// AST-based and streaming converters, plus the output helpers both use.
+
+#include <stddef.h>
+#include "json2relcsv.h"
+
+struct ASTNode;  // see ast.h, which includes this header
+
+// Table kind: mirrors the three structural forms from analyze_node
+typedef enum {
+    TABLE_OBJECT,    // standalone JSON object
+    TABLE_ARRAY,     // array-of-objects
+    TABLE_JUNCTION   // array-of-scalars
+} TableKind;
+
+// The kinds of value the schema pass has seen in a column, as a bit set.
+typedef enum {
+    COLUMN_TYPE_NULL = 1,    // JSON null, or loaded as nullable
+    COLUMN_TYPE_BOOL = 2,
+    COLUMN_TYPE_INT = 4,     // integers that fit in 64 bits, and generated IDs and positions
+    COLUMN_TYPE_NUMBER = 8,  // any other number
+    COLUMN_TYPE_STRING = 16,
+    COLUMN_TYPE_ANY = 32     // anything: a loaded schema's column with no recorded types
+} ColumnType;
+
+// What the schema pass has seen in a column.
+typedef struct ColumnStats {
+    int types;           // ColumnType bits
+    long rows;           // rows of the table with a value in the column, null included
+    long last_row;       // the table's row (row_estimate) last counted in 'rows'
+    size_t max_length;   // bytes of the longest string value
+} ColumnStats;
+
+// Structure to represent a table schema
+typedef struct TableSchema {
+    char* name;
+    char** columns;      // in first-seen order
+    ColumnStats* column_stats;   // per column, in the same order
+    int column_count;
+    int column_capacity; // grown geometrically
+    int* column_slots;   // hash index over columns: column index + 1, 0 = empty slot
+    int column_slot_capacity; // power of two, at least twice column_count
+    char* parent;        // FK target table name; NULL for root table
+    TableKind kind;      // structural kind of this table
+    int index;           // creation order (0-based); lets writers keep per-table state in arrays
+    long row_estimate;   // rows seen by the schema pass (a loaded table counts as one);
+                         // balances --threads writers
+    long rows_written;   // --stats: rows and bytes in the table's CSV (see stats.h)
+    size_t bytes_written;
+    int last_id;         // largest row ID written to the table's CSV (0 if none)
+    struct TableSchema* next;
+} TableSchema;
+
+// Structure to keep track of table data.
+// Tables are kept newest-first, which is the order schema.json lists them in.
+typedef struct {
+    TableSchema* tables;
+    int table_count;
+    int next_id;
+    int first_id;        // ID of the first row written: 1, or with --append one past the
+                         // last ID of earlier runs
+    TableSchema** table_slots; // hash index over tables by name; NULL = empty slot
+    int table_slot_capacity;   // power of two, at least twice table_count
+} SchemaContext;
+
+// Returns an empty context whose IDs (and row IDs) start at 1.
+SchemaContext schema_context_init(void);
+
+// Returns a new context with the same tables (in the same creation order), columns,
+// column stats and parent links, and first row ID as 'schema', and fresh output counters.
+SchemaContext schema_context_copy(const SchemaContext* schema);
+
+// Finds a TableSchema by name; NULL if no such table exists.
+TableSchema* find_table(const SchemaContext* context, const char* name);
+
+// Finds a TableSchema by name in the SchemaContext, or creates and adds a new one if not found.
+TableSchema* find_or_create_table(SchemaContext* context, const char* name);
+
+// Adds a column to a TableSchema if it doesn't already exist (first-seen order is kept),
+// and returns its position.
+int add_column(TableSchema* table, const char* column);
+
+// Records that the table's current row (the row_estimate-th) has a value of 'types'
+// (ColumnType bits) and, for strings, 'length' bytes in a column; 0 records nothing.
+void add_column_value(TableSchema* table, int column, int types, size_t length);
+
+// Same for a scalar node's value; objects and arrays are not values of a column.
+void add_scalar_value(TableSchema* table, int column, const struct ASTNode* value);
+
+// Adds a column and records a value of 'types' in it: add_column(), then add_column_value().
+void add_typed_column(TableSchema* table, const char* column, int types);
+
+// Returns 1 if a column may be empty: it held a null, or some row had no value for it.
+int column_nullable(const TableSchema* table, int column);
+
+// Returns the position of a column in a table, or -1 if the table has no such column.
+int find_column(const TableSchema* table, const char* column);
+
+// Frees all TableSchema entries in context (columns, parent, name, node).
+void free_schema(SchemaContext* context);
+
+// Converts a key into a table name: non-alphanumerics (except '_') become '_'.
+// Returns a new heap string; NULL or "" map to "unnamed".
+char* safe_filename(const char* name);
+
+// Returns a new heap string "<table_name>.csv": the name of the table's output stream.
+char* get_csv_file_name(const char* table_name);
+
+// The most table outputs a conversion keeps open at once. A sink may need a file (and a
+// compressor) per open stream, so documents with more tables than this write them in
+// groups rather than exhausting the process's file descriptors.
+#define MAX_OPEN_TABLES 512
+
+// Writes "schema.json" describing every table in the context to 'sink': per table its
+// name, kind, keys, columns and "columnTypes". Each column's entry there is null if its
+// types are unknown (COLUMN_TYPE_ANY), otherwise an object with
+//   "types"      the kinds of value seen: "boolean", "integer" (fits in 64 bits), "number"
+//                and "string"; empty if the column only ever held null
+//   "nullable"   column_nullable()
+//   "maxLength"  for columns with strings: bytes of the longest one
+// Returns 0, or -1 and fills 'error' if the sink fails the stream.
+int write_schema_json(const SchemaContext* context, const Json2RelCsvSink* sink, Json2RelCsvError* error);
+
+// The largest row ID written so far: the last of earlier runs (first_id - 1) or of any
+// table since.
+int schema_last_id(const SchemaContext* context);
+
+// Name of the state file --append keeps next to the CSVs.
+#define SCHEMA_STATE_FILE_NAME "json2relcsv_state.json"
+
+// Writes the --append state file: schema.json plus "lastId", schema_last_id(context).
+// Loading it with read_schema_json() sets first_id to continue after that ID.
+int write_state_json(const SchemaContext* context, const Json2RelCsvSink* sink, Json2RelCsvError* error);
+
+// Loads a schema.json written by write_schema_json() or write_state_json() into an empty
+// 'context' (--schema, --append).
+// Returns 0 on success; otherwise fills 'error' and returns -1, and the context holds
+// whatever was loaded so far (free it with free_schema()).
+int read_schema_json(const char* data, size_t size, SchemaContext* context, Json2RelCsvError* error);
+
+#endif /* SCHEMA_H */
@@ -0,0 +1,14 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Hot-path counters for --stats (tokens scanned, rows and bytes written). They are
+// bumped with STATS_ADD, which compiles to nothing unless JSON2RELCSV_STATS is defined
+// (see CMakeLists.txt); the counters then simply stay 0. Phase timings and totals that
+// are gathered once per conversion do not need the switch.
+#ifdef JSON2RELCSV_STATS
+#define STATS_ADD(counter, amount) ((counter) += (amount))
+#else
+#define STATS_ADD(counter, amount) ((void)0)
+#endif
+
+#endif /* STATS_H */
@@ -0,0 +1,72 @@
+#ifndef STREAM_GEN_H
+#define STREAM_GEN_H
+
+#include "json_events.h"
+#include "json2relcsv.h"
+#include "schema.h"
+
+// Streaming conversion (--stream): infers the schema and writes rows directly from
+// parser events, without building an AST. Each row is encoded as soon as the value
+// it describes is complete and spooled (in memory, then in one temporary file); the CSVs
+// are assembled at the end, once every table's final column list is known. Memory use
+// depends on nesting depth and schema size, not on document size.
+//
+// Output matches generate_csv_tables() except inside subtrees the schema pass never
+// inspects (elements of scalar arrays, arrays nested directly in arrays, non-object
+// elements of object arrays): there, the AST path also writes rows for tables that
+// first appear later in the document, which a single forward pass cannot know about yet.
+// A converter given the schema up front (--schema) knows every table from the start,
+// so it matches there too.
+
+typedef struct StreamConverter StreamConverter;
+
+// Creates an empty converter.
+StreamConverter* stream_converter_create(void);
+
+// Creates a converter that infers on top of the tables of 'base' (copied; --append):
+// their columns come first, new tables and columns follow, and row IDs start at
+// base->first_id.
+StreamConverter* stream_converter_create_from(const SchemaContext* base);
+
+// Creates a converter for documents whose schema is already known (--schema): it writes
+// the tables of 'schema' (copied) rather than inferring them, and sends each row to
+// 'output' as soon as it is complete, with no temporary files. Values the schema has
+// no table or column for are skipped; unless 'drop_unknown' is set, the first of them
+// is also reported by stream_converter_unknown(). 'output' must outlive the converter,
+// and stream_converter_finish() must be given the same sink.
+StreamConverter* stream_converter_create_with_schema(const SchemaContext* schema, int drop_unknown,
+                                                     const Json2RelCsvSink* output);
+
+// Returns an event handler that feeds the converter; pass it to the parser.
+JsonEventHandler stream_converter_handler(StreamConverter* converter);
+
+// The schema inferred so far (all of it, once the document has been parsed).
+const SchemaContext* stream_converter_schema(const StreamConverter* converter);
+
+// Describes the first value that did not fit the fixed schema, or returns NULL if all
+// did (or drop_unknown is set).
+const char* stream_converter_unknown(const StreamConverter* converter);
+
+// The number of values skipped because the fixed schema had no place for them
+// (only counted with drop_unknown).
+long stream_converter_dropped(const StreamConverter* converter);
+
+// Adds to the column types of 'typed', a copy of stream_converter_schema() taken once the
+// document is parsed, those of every value the spooled rows hold, including values
+// inference does not look at. Only the types change; pgcopy uses this to type its
+// columns before any row goes out. Not for a fixed-schema converter, whose rows are
+// already written. Returns -1 if the rows could not be read back; stream_converter_finish()
+// then reports it.
+int stream_converter_type_rows(StreamConverter* converter, SchemaContext* typed);
+
+// Writes every table's CSV (and schema.json if requested) to 'output' (see json2relcsv.h).
+// Returns 0, or -1 with 'error' (if not NULL) naming the first output the sink failed,
+// including one a fixed-schema converter could not open when it was created, or saying
+// that the rows could not be spooled (no spooled table is written then).
+int stream_converter_finish(StreamConverter* converter, const Json2RelCsvSink* output, int emit_schema,
+                            Json2RelCsvError* error);
+
+// Releases the converter, its schema and any temporary files.
+void stream_converter_free(StreamConverter* converter);
+
+#endif /* STREAM_GEN_H */
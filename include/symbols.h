@@ -0,0 +1,47 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stddef.h>
+#include <string.h>
+#include "arena.h"
+
+// Interned object keys. A document with many records repeats the same few keys over
+// and over, so the AST builder stores each distinct key once, together with the table
+// name derived from it, and every member with that key points at the same Symbol.
+// Within one symbol table, equal keys have equal pointers; keys from different tables
+// (e.g. different --ndjson chunks) are still compared by contents, see symbol_equal().
+
+typedef struct Symbol {
+    const char* text;        // the key, decoded
+    const char* table_name;  // safe_filename(text): the table a nested value under this key fills
+    unsigned int hash;       // symbol_hash(text)
+} Symbol;
+
+// Maps key text to its Symbol. Symbols and their strings are allocated from the arena
+// and live as long as it; the index itself is released by symbol_table_free().
+typedef struct SymbolTable {
+    Arena* arena;
+    Symbol** slots;          // open addressing (linear probing); NULL = empty slot
+    size_t slot_capacity;    // power of two, at least twice count
+    size_t count;            // distinct keys interned
+} SymbolTable;
+
+// FNV-1a over 'length' bytes.
+unsigned int symbol_hash(const char* text, size_t length);
+
+// Prepares an empty table whose symbols are allocated from 'arena'.
+void symbol_table_init(SymbolTable* symbols, Arena* arena);
+
+// Returns the Symbol for the 'length' bytes of 'text', creating it on first sight.
+// 'text' is copied, so it may be a transient lexer buffer.
+const Symbol* symbol_intern(SymbolTable* symbols, const char* text, size_t length);
+
+// Releases the index. The symbols stay valid until their arena is freed.
+void symbol_table_free(SymbolTable* symbols);
+
+// Returns 1 if two symbols spell the same key.
+static inline int symbol_equal(const Symbol* a, const Symbol* b) {
+    return a == b || (a->hash == b->hash && strcmp(a->text, b->text) == 0);
+}
+
+#endif /* SYMBOLS_H */
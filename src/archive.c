@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "json2relcsv.h"
+#include "csv_writer.h"
+
+// The archive sink: every stream becomes a member of one tar archive (POSIX ustar, with
+// a pax extended header for what ustar cannot hold). A tar header records its member's
+// size, so each stream is collected until it is closed and then written out whole.
+
+#define TAR_BLOCK_SIZE 512
+
+// The largest size and longest name a ustar header holds.
+#define TAR_MAX_USTAR_SIZE 077777777777ULL
+#define TAR_MAX_USTAR_NAME 100
+
+// A stream collects in memory up to this size, then moves to a temporary file.
+#define ARCHIVE_MEMORY_LIMIT (8 * 1024 * 1024)
+
+// Bytes copied at a time from a temporary file into the archive.
+#define ARCHIVE_COPY_SIZE (64 * 1024)
+
+struct Json2RelCsvArchive {
+    FILE* file;
+    time_t mtime;           // of every member: when the archive was created
+    int failed;             // a write to 'file' failed
+    pthread_mutex_t lock;   // keeps members whole while writer threads close streams
+};
+
+// One stream opened through the sink.
+typedef struct ArchiveMember {
+    char* name;
+    CsvBuffer contents;     // an unbound (growable) buffer, until 'spill' is opened
+    FILE* spill;            // the contents once they outgrow ARCHIVE_MEMORY_LIMIT
+    unsigned long long size;
+    int failed;             // a write to 'spill' failed
+} ArchiveMember;
+
+Json2RelCsvArchive* json2relcsv_archive_create(FILE* file) {
+    Json2RelCsvArchive* archive = (Json2RelCsvArchive*)calloc(1, sizeof(Json2RelCsvArchive));
+    if (!archive) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    archive->file = file;
+    archive->mtime = time(NULL);
+    pthread_mutex_init(&archive->lock, NULL);
+    return archive;
+}
+
+// --- Writing the archive ---
+
+static void archive_put(Json2RelCsvArchive* archive, const void* data, size_t len) {
+    if (len > 0 && fwrite(data, 1, len, archive->file) != len) {
+        archive->failed = 1;
+    }
+}
+
+// Pads a member of 'size' bytes to a whole number of blocks.
+static void archive_pad(Json2RelCsvArchive* archive, unsigned long long size) {
+    static const char zeros[TAR_BLOCK_SIZE];
+    archive_put(archive, zeros, (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+}
+
+// Writes 'value' into a header field of 'width' bytes as zero-padded octal, NUL-terminated.
+static void put_octal(char* field, size_t width, unsigned long long value) {
+    field[width - 1] = '\0';
+    for (size_t i = width - 1; i-- > 0;) {
+        field[i] = (char)('0' + (value & 7));
+        value >>= 3;
+    }
+}
+
+// Writes a header block: 'type' '0' for a file, 'x' for the pax header of the next one.
+static void put_header(Json2RelCsvArchive* archive, const char* name, unsigned long long size, char type) {
+    char header[TAR_BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+    size_t name_len = strlen(name);
+    memcpy(header, name, name_len < TAR_MAX_USTAR_NAME ? name_len : TAR_MAX_USTAR_NAME);
+    put_octal(header + 100, 8, 0644);                                     // mode
+    put_octal(header + 108, 8, 0);                                        // uid
+    put_octal(header + 116, 8, 0);                                        // gid
+    put_octal(header + 124, 12, size <= TAR_MAX_USTAR_SIZE ? size : 0);   // size (else in the pax header)
+    put_octal(header + 136, 12, archive->mtime > 0 ? (unsigned long long)archive->mtime : 0);
+    header[156] = type;
+    memcpy(header + 257, "ustar", 6);                                     // magic, with its NUL
+    memcpy(header + 263, "00", 2);                                        // version
+
+    // The checksum is the sum of the header's bytes, counting its own field as spaces.
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+        checksum += (unsigned char)header[i];
+    }
+    put_octal(header + 148, 7, checksum);
+    archive_put(archive, header, sizeof(header));
+}
+
+// Appends a pax record, "<length> <key>=<value>\n", where the length counts itself.
+static void put_pax_record(CsvBuffer* records, const char* key, const char* value) {
+    size_t len = strlen(key) + strlen(value) + 3;  // " ", "=" and "\n"
+    size_t total = len + 1;
+    while (total != len + (size_t)snprintf(NULL, 0, "%zu", total)) {
+        total = len + (size_t)snprintf(NULL, 0, "%zu", total);
+    }
+    char digits[24];
+    snprintf(digits, sizeof(digits), "%zu ", total);
+    csv_buffer_append(records, digits, strlen(digits));
+    csv_buffer_append(records, key, strlen(key));
+    csv_buffer_putc(records, '=');
+    csv_buffer_append(records, value, strlen(value));
+    csv_buffer_putc(records, '\n');
+}
+
+// Writes a member's headers: a pax header first if ustar cannot hold its name or size.
+static void put_member_header(Json2RelCsvArchive* archive, const char* name, unsigned long long size) {
+    if (strlen(name) > TAR_MAX_USTAR_NAME || size > TAR_MAX_USTAR_SIZE) {
+        CsvBuffer records;
+        csv_buffer_init(&records, NULL, NULL);
+        if (strlen(name) > TAR_MAX_USTAR_NAME) {
+            put_pax_record(&records, "path", name);
+        }
+        if (size > TAR_MAX_USTAR_SIZE) {
+            char digits[24];
+            snprintf(digits, sizeof(digits), "%llu", size);
+            put_pax_record(&records, "size", digits);
+        }
+        put_header(archive, "PaxHeader", records.len, 'x');
+        archive_put(archive, records.data, records.len);
+        archive_pad(archive, records.len);
+        csv_buffer_free(&records);
+    }
+    put_header(archive, name, size, '0');
+}
+
+// --- Sink ---
+
+static void* archive_open(void* ctx, const char* name) {
+    (void)ctx;
+    ArchiveMember* member = (ArchiveMember*)calloc(1, sizeof(ArchiveMember));
+    if (!member || !(member->name = strdup(name))) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    csv_buffer_init(&member->contents, NULL, NULL);
+    return member;
+}
+
+static int archive_write(void* ctx, void* stream, const char* data, size_t len) {
+    (void)ctx;
+    ArchiveMember* member = (ArchiveMember*)stream;
+    member->size += len;
+    if (!member->spill && member->contents.len + len > ARCHIVE_MEMORY_LIMIT) {
+        // Without a temporary file, the member stays in memory.
+        member->spill = tmpfile();
+        if (member->spill) {
+            if (fwrite(member->contents.data, 1, member->contents.len, member->spill) != member->contents.len) {
+                member->failed = 1;
+            }
+            csv_buffer_free(&member->contents);
+        }
+    }
+    if (member->spill) {
+        if (fwrite(data, 1, len, member->spill) != len) {
+            member->failed = 1;
+        }
+    } else {
+        csv_buffer_append(&member->contents, data, len);
+    }
+    return member->failed ? -1 : 0;
+}
+
+// Writes the member, whole, then releases it. Fails if the member or any write to the
+// archive so far did.
+static int archive_close(void* ctx, void* stream) {
+    Json2RelCsvArchive* archive = (Json2RelCsvArchive*)ctx;
+    ArchiveMember* member = (ArchiveMember*)stream;
+
+    pthread_mutex_lock(&archive->lock);
+    archive->failed |= member->failed;
+    put_member_header(archive, member->name, member->size);
+    if (member->spill) {
+        char* buffer = (char*)malloc(ARCHIVE_COPY_SIZE);
+        if (!buffer) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        rewind(member->spill);
+        unsigned long long left = member->size;
+        while (left > 0) {
+            size_t n = fread(buffer, 1, left < ARCHIVE_COPY_SIZE ? (size_t)left : ARCHIVE_COPY_SIZE, member->spill);
+            if (n == 0) {
+                archive->failed = 1;
+                break;
+            }
+            archive_put(archive, buffer, n);
+            left -= n;
+        }
+        free(buffer);
+        fclose(member->spill);
+    } else {
+        archive_put(archive, member->contents.data, member->contents.len);
+    }
+    archive_pad(archive, member->size);
+    int status = archive->failed ? -1 : 0;
+    pthread_mutex_unlock(&archive->lock);
+
+    csv_buffer_free(&member->contents);
+    free(member->name);
+    free(member);
+    return status;
+}
+
+Json2RelCsvSink json2relcsv_archive_sink(Json2RelCsvArchive* archive) {
+    Json2RelCsvSink sink;
+    sink.open = archive_open;
+    sink.write = archive_write;
+    sink.close = archive_close;
+    sink.ctx = archive;
+    return sink;
+}
+
+int json2relcsv_archive_finish(Json2RelCsvArchive* archive) {
+    static const char end[2 * TAR_BLOCK_SIZE];
+    archive_put(archive, end, sizeof(end));
+    if (fflush(archive->file) != 0 || ferror(archive->file)) {
+        archive->failed = 1;
+    }
+    return archive->failed ? -1 : 0;
+}
+
+void json2relcsv_archive_free(Json2RelCsvArchive* archive) {
+    if (!archive) {
+        return;
+    }
+    pthread_mutex_destroy(&archive->lock);
+    free(archive);
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// First chunk is small so tiny documents (e.g. the playground) stay cheap;
+// later chunks double up to the cap so large documents need few of them.
+#define ARENA_FIRST_CHUNK_SIZE (64 * 1024)
+#define ARENA_MAX_CHUNK_SIZE   (8 * 1024 * 1024)
+
+// Strictest alignment any AST structure needs.
+typedef union {
+    void* p;
+    double d;
+    long long ll;
+} ArenaMaxAlign;
+
+#define ARENA_ALIGNMENT sizeof(ArenaMaxAlign)
+
+// One contiguous block of arena memory. Chunks are linked newest-first.
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;            // usable bytes in data[]
+    size_t used;            // bytes handed out so far
+    ArenaMaxAlign data[];   // typed only to force alignment; addressed as bytes
+} ArenaChunk;
+
+void arena_init(Arena* arena) {
+    arena->head = NULL;
+    arena->next_chunk_size = ARENA_FIRST_CHUNK_SIZE;
+    arena->chunk_count = 0;
+    arena->bytes_used = 0;
+}
+
+// Allocates a fresh chunk able to hold at least 'min_size' bytes and makes it current.
+static void arena_add_chunk(Arena* arena, size_t min_size) {
+    size_t size = arena->next_chunk_size;
+    if (size < min_size) {
+        size = min_size; // Oversized request gets a chunk of its own size
+    }
+
+    ArenaChunk* chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + size);
+    if (!chunk) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = arena->head;
+    arena->head = chunk;
+    arena->chunk_count++;
+
+    if (arena->next_chunk_size < ARENA_MAX_CHUNK_SIZE) {
+        arena->next_chunk_size *= 2;
+    }
+}
+
+// Bump-allocates 'size' bytes at the given alignment (a power of two).
+static void* arena_alloc_aligned(Arena* arena, size_t size, size_t align) {
+    ArenaChunk* chunk = arena->head;
+    size_t offset = 0;
+
+    if (chunk) {
+        offset = (chunk->used + align - 1) & ~(align - 1);
+    }
+    if (!chunk || offset + size > chunk->size) {
+        arena_add_chunk(arena, size);
+        chunk = arena->head;
+        offset = 0; // data[] starts maximally aligned
+    }
+
+    arena->bytes_used += (offset - chunk->used) + size;
+    chunk->used = offset + size;
+    return (char*)chunk->data + offset;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_ALIGNMENT);
+}
+
+char* arena_alloc_chars(Arena* arena, size_t count) {
+    // Strings need no alignment, so they pack tightly between nodes.
+    return (char*)arena_alloc_aligned(arena, count, 1);
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* copy = arena_alloc_chars(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_free(Arena* arena) {
+    ArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(arena);
+}
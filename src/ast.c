@@ -2,177 +2,278 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "json_number.h"
 
-// Allocates and initializes an ASTNode for a JSON object.
-ASTNode* create_object_node(KeyValueList* pairs) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Allocates (from the document arena) and initializes an ASTNode for a JSON object.
+ASTNode* create_object_node(Arena* arena, KeyValueList* pairs) {
+    ASTNode* node = (ASTNode*)arena_alloc(arena, sizeof(ASTNode));
 
     node->type = NODE_OBJECT;
     node->value.object = pairs;
     return node;
 }
 
-// Allocates and initializes an ASTNode for a JSON array.
-ASTNode* create_array_node(ASTNodeList* elements) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Allocates (from the document arena) and initializes an ASTNode for a JSON array.
+ASTNode* create_array_node(Arena* arena, ASTNodeList* elements) {
+    ASTNode* node = (ASTNode*)arena_alloc(arena, sizeof(ASTNode));
 
     node->type = NODE_ARRAY;
     node->value.array = elements;
     return node;
 }
 
-// Allocates and initializes an ASTNode for a JSON string.
-// Note: The 'value' string is expected to be allocated by the lexer (e.g., strdup)
-// and will be freed by free_ast.
-ASTNode* create_string_node(char* value) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Allocates (from the document arena) and initializes an ASTNode for a JSON string.
+// Note: The 'value' string is not copied; it must live as long as the AST (e.g. in the same arena).
+ASTNode* create_string_node(Arena* arena, char* value) {
+    ASTNode* node = (ASTNode*)arena_alloc(arena, sizeof(ASTNode));
 
     node->type = NODE_STRING;
-    node->value.string = value; // value already allocated by lexer
+    node->value.string = value;
     return node;
 }
 
-// Allocates and initializes an ASTNode for a JSON number.
-ASTNode* create_number_node(double value) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Allocates (from the document arena) and initializes an ASTNode for a JSON number.
+// Note: The 'text' lexeme is not copied, like the value of a string node.
+ASTNode* create_number_node(Arena* arena, char* text) {
+    ASTNode* node = (ASTNode*)arena_alloc(arena, sizeof(ASTNode));
 
     node->type = NODE_NUMBER;
-    node->value.number = value;
+    node->value.number = text;
     return node;
 }
 
-// Allocates and initializes an ASTNode for a JSON boolean.
-ASTNode* create_boolean_node(int value) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Allocates (from the document arena) and initializes an ASTNode for a JSON boolean.
+ASTNode* create_boolean_node(Arena* arena, int value) {
+    ASTNode* node = (ASTNode*)arena_alloc(arena, sizeof(ASTNode));
 
     node->type = NODE_BOOLEAN;
     node->value.boolean = value;
     return node;
 }
 
-// Allocates and initializes an ASTNode for a JSON null.
-ASTNode* create_null_node() {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Allocates (from the document arena) and initializes an ASTNode for a JSON null.
+ASTNode* create_null_node(Arena* arena) {
+    ASTNode* node = (ASTNode*)arena_alloc(arena, sizeof(ASTNode));
 
     node->type = NODE_NULL;
     return node;
 }
 
-// Allocates and initializes a KeyValuePair.
-// Note: The 'key' string is expected to be allocated by the lexer (e.g., strdup)
-// and will be freed by free_ast.
-KeyValuePair* create_key_value_pair(char* key, ASTNode* value) {
-    KeyValuePair* pair = (KeyValuePair*)malloc(sizeof(KeyValuePair));
-    if (!pair) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+// Prepares an empty builder whose nodes and vectors are allocated from 'arena'.
+void ast_builder_init(ASTBuilder* builder, Arena* arena) {
+    builder->arena = arena;
+    builder->pairs = NULL;
+    builder->pair_count = 0;
+    builder->pair_capacity = 0;
+    builder->nodes = NULL;
+    builder->node_count = 0;
+    builder->node_capacity = 0;
+    builder->frames = NULL;
+    builder->depth = 0;
+    builder->frame_capacity = 0;
+    symbol_table_init(&builder->symbols, arena);
+    builder->root = NULL;
+}
 
-    pair->key = key; // key already allocated by lexer
-    pair->value = value;
-    return pair;
+// Frees the builder's scratch stacks.
+void ast_builder_free(ASTBuilder* builder) {
+    free(builder->pairs);
+    free(builder->nodes);
+    free(builder->frames);
+    builder->pairs = NULL;
+    builder->nodes = NULL;
+    builder->frames = NULL;
+    builder->pair_count = builder->pair_capacity = 0;
+    builder->node_count = builder->node_capacity = 0;
+    builder->depth = builder->frame_capacity = 0;
+    symbol_table_free(&builder->symbols);
 }
 
-// Creates a new KeyValueList, initializing it with a single KeyValuePair.
-// This is typically used for the first pair in an object.
-KeyValueList* create_key_value_list(KeyValuePair* pair) {
-    KeyValueList* list = (KeyValueList*)malloc(sizeof(KeyValueList));
-    if (!list) {
+// Grows a scratch stack to hold at least one more element, doubling its capacity.
+static void* grow_stack(void* items, size_t* capacity, size_t element_size) {
+    *capacity = *capacity ? *capacity * 2 : 64;
+    items = realloc(items, *capacity * element_size);
+    if (!items) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
+    return items;
+}
+
+// Pushes a KeyValuePair onto the pending stack.
+static void add_key_value_pair(ASTBuilder* builder, const Symbol* key, ASTNode* value) {
+    if (builder->pair_count == builder->pair_capacity) {
+        builder->pairs = (KeyValuePair*)grow_stack(builder->pairs, &builder->pair_capacity, sizeof(KeyValuePair));
+    }
+
+    builder->pairs[builder->pair_count].key = key;
+    builder->pairs[builder->pair_count].value = value;
+    builder->pair_count++;
+}
+
+// Moves the pending pairs [first, top) into an exactly-sized vector in the arena.
+// Called when an object closes; first == top yields an empty list.
+static KeyValueList* create_key_value_list(ASTBuilder* builder, size_t first) {
+    size_t count = builder->pair_count - first;
+    KeyValueList* list = (KeyValueList*)arena_alloc(builder->arena,
+                                                    sizeof(KeyValueList) + count * sizeof(KeyValuePair));
 
-    list->pair = pair;
-    list->next = NULL;
+    list->count = count;
+    if (count > 0) {
+        memcpy(list->pairs, builder->pairs + first, count * sizeof(KeyValuePair));
+    }
+    builder->pair_count = first;
     return list;
 }
 
-// Appends a KeyValuePair to an existing KeyValueList.
-// The new pair is added to the end of the list.
-KeyValueList* add_key_value_pair(KeyValueList* list, KeyValuePair* pair) {
-    // Add the pair to the end of the list
-    KeyValueList* new_item = (KeyValueList*)malloc(sizeof(KeyValueList));
-    if (!new_item) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+// Pushes an ASTNode onto the pending stack.
+static void add_node_to_list(ASTBuilder* builder, ASTNode* node) {
+    if (builder->node_count == builder->node_capacity) {
+        builder->nodes = (ASTNode**)grow_stack(builder->nodes, &builder->node_capacity, sizeof(ASTNode*));
     }
 
-    new_item->pair = pair;
-    new_item->next = NULL;
+    builder->nodes[builder->node_count++] = node;
+}
+
+// Moves the pending elements [first, top) into an exactly-sized vector in the arena.
+// Called when an array closes; first == top yields an empty list.
+static ASTNodeList* create_node_list(ASTBuilder* builder, size_t first) {
+    size_t count = builder->node_count - first;
+    ASTNodeList* list = (ASTNodeList*)arena_alloc(builder->arena,
+                                                  sizeof(ASTNodeList) + count * sizeof(ASTNode*));
 
-    // Find the end of the list
-    KeyValueList* current = list;
-    while (current->next != NULL) {
-        current = current->next;
+    list->count = count;
+    if (count > 0) {
+        memcpy(list->items, builder->nodes + first, count * sizeof(ASTNode*));
     }
+    builder->node_count = first;
+    return list;
+}
 
-    // Add the new item
-    current->next = new_item;
+// Hands a completed value to the innermost open container, or makes it the root.
+static void attach_value(ASTBuilder* builder, ASTNode* node) {
+    if (builder->depth == 0) {
+        builder->root = node;
+        return;
+    }
 
-    return list; // Return the head of the list
+    BuilderFrame* frame = &builder->frames[builder->depth - 1];
+    if (frame->type == NODE_OBJECT) {
+        add_key_value_pair(builder, frame->key, node);
+        frame->key = NULL;
+    } else {
+        add_node_to_list(builder, node);
+    }
 }
 
-// Creates a new ASTNodeList, initializing it with a single ASTNode.
-// This is typically used for the first element in an array.
-ASTNodeList* create_node_list(ASTNode* node) {
-    ASTNodeList* list = (ASTNodeList*)malloc(sizeof(ASTNodeList));
-    if (!list) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+// Opens a container whose members start at the current top of their stack.
+static void push_frame(ASTBuilder* builder, NodeType type) {
+    if (builder->depth == builder->frame_capacity) {
+        builder->frames = (BuilderFrame*)grow_stack(builder->frames, &builder->frame_capacity, sizeof(BuilderFrame));
     }
 
-    list->node = node;
-    list->next = NULL;
-    return list;
+    BuilderFrame* frame = &builder->frames[builder->depth++];
+    frame->type = type;
+    frame->first = (type == NODE_OBJECT) ? builder->pair_count : builder->node_count;
+    frame->key = NULL;
 }
 
-// Appends an ASTNode to an existing ASTNodeList.
-// The new node is added to the end of the list.
-ASTNodeList* add_node_to_list(ASTNodeList* list, ASTNode* node) {
-    // Add the node to the end of the list
-    ASTNodeList* new_item = (ASTNodeList*)malloc(sizeof(ASTNodeList));
-    if (!new_item) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+static void on_start_object(void* ctx) {
+    push_frame((ASTBuilder*)ctx, NODE_OBJECT);
+}
+
+static void on_end_object(void* ctx) {
+    ASTBuilder* builder = (ASTBuilder*)ctx;
+    BuilderFrame* frame = &builder->frames[--builder->depth];
+    KeyValueList* pairs = create_key_value_list(builder, frame->first);
+    attach_value(builder, create_object_node(builder->arena, pairs));
+}
+
+static void on_start_array(void* ctx) {
+    push_frame((ASTBuilder*)ctx, NODE_ARRAY);
+}
+
+static void on_end_array(void* ctx) {
+    ASTBuilder* builder = (ASTBuilder*)ctx;
+    BuilderFrame* frame = &builder->frames[--builder->depth];
+    ASTNodeList* elements = create_node_list(builder, frame->first);
+    attach_value(builder, create_array_node(builder->arena, elements));
+}
+
+static void on_key(void* ctx, char* key) {
+    ASTBuilder* builder = (ASTBuilder*)ctx;
+    // The lexer's copy only lives until the next token; repeated keys share one copy.
+    builder->frames[builder->depth - 1].key = symbol_intern(&builder->symbols, key, strlen(key));
+}
+
+static void on_scalar(void* ctx, const ASTNode* value) {
+    ASTBuilder* builder = (ASTBuilder*)ctx;
+    ASTNode* node;
+
+    switch (value->type) {
+        case NODE_STRING: {
+            const char* str = value->value.string;
+            node = create_string_node(builder->arena, arena_strndup(builder->arena, str, strlen(str)));
+            break;
+        }
+        case NODE_NUMBER: {
+            const char* text = value->value.number;
+            node = create_number_node(builder->arena, arena_strndup(builder->arena, text, strlen(text)));
+            break;
+        }
+        case NODE_BOOLEAN: node = create_boolean_node(builder->arena, value->value.boolean); break;
+        default:           node = create_null_node(builder->arena); break;
     }
+    attach_value(builder, node);
+}
 
-    new_item->node = node;
-    new_item->next = NULL;
+JsonEventHandler ast_builder_handler(ASTBuilder* builder) {
+    JsonEventHandler handler;
+    handler.start_object = on_start_object;
+    handler.end_object = on_end_object;
+    handler.start_array = on_start_array;
+    handler.end_array = on_end_array;
+    handler.key = on_key;
+    handler.scalar = on_scalar;
+    handler.ctx = builder;
+    return handler;
+}
 
-    // Find the end of the list
-    ASTNodeList* current = list;
-    while (current->next != NULL) {
-        current = current->next;
+int ast_scalar_type(const ASTNode* node) {
+    long long value;
+    switch (node->type) {
+        case NODE_STRING:
+            return COLUMN_TYPE_STRING;
+        case NODE_NUMBER:
+            return json_number_to_int64(node->value.number, strlen(node->value.number), &value)
+                       ? COLUMN_TYPE_INT
+                       : COLUMN_TYPE_NUMBER;
+        case NODE_BOOLEAN:
+            return COLUMN_TYPE_BOOL;
+        case NODE_NULL:
+            return COLUMN_TYPE_NULL;
+        default:
+            return 0;
     }
+}
 
-    // Add the new item
-    current->next = new_item;
+// Counts the nodes of the AST, the root included.
+size_t ast_node_count(const ASTNode* root) {
+    if (!root) return 0;
 
-    return list; // Return the head of the list
+    size_t count = 1;
+    if (root->type == NODE_OBJECT) {
+        const KeyValueList* list = root->value.object;
+        for (size_t i = 0; i < list->count; i++) {
+            count += ast_node_count(list->pairs[i].value);
+        }
+    } else if (root->type == NODE_ARRAY) {
+        const ASTNodeList* list = root->value.array;
+        for (size_t i = 0; i < list->count; i++) {
+            count += ast_node_count(list->items[i]);
+        }
+    }
+    return count;
 }
 
 // Helper function to print leading spaces for visual indentation of the AST.
@@ -209,14 +310,13 @@ void print_ast(ASTNode* root, int indent) {
         case NODE_OBJECT: {
             printf("{\n");
             KeyValueList* list = root->value.object;
-            while (list) {
+            for (size_t i = 0; i < list->count; i++) {
                 print_indent(indent + 1);
-                print_string_value(list->pair->key);
+                print_string_value(list->pairs[i].key->text);
                 printf(": ");
-                print_ast(list->pair->value, indent + 1);
-                if (list->next) printf(",");
+                print_ast(list->pairs[i].value, indent + 1);
+                if (i + 1 < list->count) printf(",");
                 printf("\n");
-                list = list->next;
             }
             print_indent(indent);
             printf("}");
@@ -225,12 +325,11 @@ void print_ast(ASTNode* root, int indent) {
         case NODE_ARRAY: {
             printf("[\n");
             ASTNodeList* list = root->value.array;
-            while (list) {
+            for (size_t i = 0; i < list->count; i++) {
                 print_indent(indent + 1);
-                print_ast(list->node, indent + 1);
-                if (list->next) printf(",");
+                print_ast(list->items[i], indent + 1);
+                if (i + 1 < list->count) printf(",");
                 printf("\n");
-                list = list->next;
             }
             print_indent(indent);
             printf("]");
@@ -240,7 +339,7 @@ void print_ast(ASTNode* root, int indent) {
             print_string_value(root->value.string);
             break;
         case NODE_NUMBER:
-            printf("%g", root->value.number);
+            printf("%g", json_number_to_double(root->value.number));
             break;
         case NODE_BOOLEAN:
             printf("%s", root->value.boolean ? "true" : "false");
@@ -250,44 +349,3 @@ void print_ast(ASTNode* root, int indent) {
             break;
     }
 }
-
-// Recursively frees all memory allocated for the AST.
-// This includes ASTNodes, KeyValuePairs, KeyValueLists, ASTNodeLists,
-// and the strings for keys and string values.
-void free_ast(ASTNode* root) {
-    if (!root) return;
-
-    switch (root->type) {
-        case NODE_OBJECT: {
-            KeyValueList* list = root->value.object;
-            while (list) {
-                KeyValueList* temp = list;
-                free(list->pair->key);
-                free_ast(list->pair->value);
-                free(list->pair);
-                list = list->next;
-                free(temp);
-            }
-            break;
-        }
-        case NODE_ARRAY: {
-            ASTNodeList* list = root->value.array;
-            while (list) {
-                ASTNodeList* temp = list;
-                free_ast(list->node);
-                list = list->next;
-                free(temp);
-            }
-            break;
-        }
-        case NODE_STRING:
-            free(root->value.string); // Strings are dynamically allocated
-            break;
-        default:
-            // NODE_NUMBER, NODE_BOOLEAN, NODE_NULL do not have dynamically allocated data
-            // within the union that needs separate freeing here. Their ASTNode struct itself is freed.
-            break;
-    }
-
-    free(root);
-}
\ No newline at end of file
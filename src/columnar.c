@@ -0,0 +1,676 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "columnar.h"
+#include "csv_writer.h"
+#include "json_number.h"
+#include "symbols.h"
+
+// The type of a cell while a chunk is collected: null, or a ColumnarValueKind.
+#define CELL_NULL 0
+
+// Where the CSV decoder is within a row.
+typedef enum {
+    FIELD_START,   // before the first byte of a field
+    FIELD_BARE,    // in an unquoted field (a number, true or false)
+    FIELD_QUOTED,  // in a quoted field (a string)
+    FIELD_QUOTE    // just after a quote inside a quoted field: "" or the end of the field
+} FieldState;
+
+// One column's cells of the current chunk.
+typedef struct ColumnBuilder {
+    unsigned char* kinds;  // per row: CELL_NULL or a ColumnarValueKind
+    size_t* ends;          // per row: end of its text in 'text' (strings and numbers only)
+    size_t capacity;       // rows allocated
+    CsvBuffer text;        // the text of the column's values, back to back
+} ColumnBuilder;
+
+// One stream opened through the columnar sink. Streams that are not a table's CSV only
+// have 'stream' set and are passed through.
+typedef struct ColumnarStream {
+    void* stream;           // on the inner sink
+    const TableSchema* table;
+    CsvBuffer out;          // the encoded file, bound to 'stream'
+    CsvBuffer scratch;      // the payload of the column chunk being encoded
+    ColumnBuilder* columns; // column_count + 1: the last one absorbs fields past the
+                            // last column, which a well-formed row never has
+    int column_count;
+    size_t rows;            // complete rows in the chunk
+    size_t text_bytes;      // text in the chunk, across columns
+    size_t header_left;     // bytes of the CSV header row still to skip
+    int column;             // column of the field being decoded
+    FieldState state;
+} ColumnarStream;
+
+// --- Encoding helpers ---
+
+static void put_u8(CsvBuffer* out, unsigned int value) {
+    csv_buffer_putc(out, (char)(unsigned char)value);
+}
+
+static void put_u32(CsvBuffer* out, size_t value) {
+    unsigned char bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    csv_buffer_append(out, bytes, 4);
+}
+
+static void put_u64(CsvBuffer* out, unsigned long long value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    csv_buffer_append(out, bytes, 8);
+}
+
+static void put_name(CsvBuffer* out, const char* name) {
+    size_t len = strlen(name);
+    put_u32(out, len);
+    csv_buffer_append(out, name, len);
+}
+
+int columnar_format_double(double value, char* out, size_t size) {
+    // Converting back is exact from some precision on, so search for the first one
+    // that is; 17 digits always are.
+    int low = 1;
+    int high = 17;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        snprintf(out, size, "%.*g", mid, value);
+        if (json_number_to_double(out) == value) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return snprintf(out, size, "%.*g", low, value);
+}
+
+// Parses a number lexeme that an int64 holds and prints back identically ("-0" and
+// leading zeros do not).
+static int parse_canonical_int64(const char* text, size_t len, long long* value) {
+    size_t i = 0;
+    int negative = 0;
+    if (i < len && text[i] == '-') {
+        negative = 1;
+        i++;
+    }
+    size_t digits = len - i;
+    if (digits == 0 || digits > 19 || (text[i] == '0' && (digits > 1 || negative))) {
+        return 0;
+    }
+    unsigned long long magnitude = 0;
+    for (; i < len; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return 0;
+        }
+        magnitude = magnitude * 10 + (unsigned long long)(text[i] - '0');
+    }
+    unsigned long long limit = negative ? 9223372036854775808ull : 9223372036854775807ull;
+    if (magnitude > limit) {
+        return 0;
+    }
+    *value = negative ? (long long)(0 - magnitude) : (long long)magnitude;
+    return 1;
+}
+
+// Parses a number lexeme that columnar_format_double() prints back identically. Since
+// a value that converts back from p digits also does from more, the shortest such p
+// is the one columnar_format_double() finds.
+static int parse_canonical_double(const char* text, size_t len, double* value) {
+    char lexeme[32];
+    char canonical[32];
+    if (len >= sizeof(lexeme)) {
+        return 0;
+    }
+    memcpy(lexeme, text, len);
+    lexeme[len] = '\0';
+
+    *value = json_number_to_double(lexeme);
+    if (!isfinite(*value)) {
+        return 0;
+    }
+
+    // The canonical text has as many significant digits as the lexeme, if it is the
+    // lexeme: print with that many, and check that one fewer does not convert back.
+    int digits = 0;
+    int leading = 1;
+    for (size_t i = 0; i < len && lexeme[i] != 'e' && lexeme[i] != 'E'; i++) {
+        if (lexeme[i] >= '1' && lexeme[i] <= '9') {
+            leading = 0;
+        }
+        if (!leading && lexeme[i] >= '0' && lexeme[i] <= '9') {
+            digits++;
+        }
+    }
+    int precision = digits > 0 ? digits : 1;
+    if (precision > 17) {
+        return 0;
+    }
+    int canonical_len = snprintf(canonical, sizeof(canonical), "%.*g", precision, *value);
+    if ((size_t)canonical_len != len || memcmp(canonical, lexeme, len) != 0) {
+        return 0;
+    }
+    if (precision > 1) {
+        snprintf(canonical, sizeof(canonical), "%.*g", precision - 1, *value);
+        if (json_number_to_double(canonical) == *value) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Appends the low 'width' bytes of 'value'.
+static void put_uint(CsvBuffer* out, unsigned long long value, size_t width) {
+    unsigned char bytes[8];
+    for (size_t i = 0; i < width; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    csv_buffer_append(out, bytes, width);
+}
+
+// The fewest bytes (1, 2, 4 or 8) that hold 'range'.
+static size_t byte_width(unsigned long long range) {
+    return range <= 0xffull ? 1 : range <= 0xffffull ? 2 : range <= 0xffffffffull ? 4 : 8;
+}
+
+// Appends integers (two's complement in 'values') as offsets from their minimum, or,
+// if smaller (IDs, which mostly grow in small steps), as offsets of their differences.
+// Arithmetic wraps modulo 2^64, so any values round-trip.
+static ColumnarEncoding put_int_values(CsvBuffer* out, const unsigned long long* values, size_t count) {
+    long long min = (long long)values[0];
+    long long max = min;
+    long long delta_min = 0;
+    long long delta_max = 0;
+    for (size_t i = 0; i < count; i++) {
+        long long value = (long long)values[i];
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+        if (i > 0) {
+            long long delta = (long long)(values[i] - values[i - 1]);
+            delta_min = i == 1 || delta < delta_min ? delta : delta_min;
+            delta_max = i == 1 || delta > delta_max ? delta : delta_max;
+        }
+    }
+    size_t width = byte_width((unsigned long long)max - (unsigned long long)min);
+    size_t delta_width = byte_width((unsigned long long)delta_max - (unsigned long long)delta_min);
+
+    if (count > 1 && 17 + delta_width * (count - 1) < 9 + width * count) {
+        put_u64(out, values[0]);
+        put_u64(out, (unsigned long long)delta_min);
+        put_u8(out, (unsigned int)delta_width);
+        for (size_t i = 1; i < count; i++) {
+            put_uint(out, values[i] - values[i - 1] - (unsigned long long)delta_min, delta_width);
+        }
+        return COLUMNAR_INT64_DELTA;
+    }
+
+    put_u64(out, (unsigned long long)min);
+    put_u8(out, (unsigned int)width);
+    for (size_t i = 0; i < count; i++) {
+        put_uint(out, values[i] - (unsigned long long)min, width);
+    }
+    return COLUMNAR_INT64;
+}
+
+// Appends the "strings" layout (see columnar.h) of the given cells of 'column'.
+static void put_strings(CsvBuffer* out, const ColumnBuilder* column, const size_t* rows, size_t count) {
+    size_t offset = 0;
+    put_u32(out, 0);
+    for (size_t i = 0; i < count; i++) {
+        size_t row = rows[i];
+        offset += column->ends[row] - (row > 0 ? column->ends[row - 1] : 0);
+        put_u32(out, offset);
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t row = rows[i];
+        size_t start = row > 0 ? column->ends[row - 1] : 0;
+        csv_buffer_append(out, column->text.data + start, column->ends[row] - start);
+    }
+}
+
+// Appends a string column chunk as a dictionary if that is smaller than the plain
+// strings. 'rows' lists the rows with a value.
+static ColumnarEncoding put_string_values(CsvBuffer* out, const ColumnBuilder* column, const size_t* rows,
+                                          size_t count) {
+    // Find the distinct values, in first-seen order.
+    size_t slot_count = 16;
+    while (slot_count < 2 * count) {
+        slot_count *= 2;
+    }
+    size_t* slots = (size_t*)calloc(slot_count, sizeof(size_t));          // entry + 1, 0 = empty
+    size_t* entries = (size_t*)malloc((count ? count : 1) * sizeof(size_t)); // distinct values' rows
+    size_t* indexes = (size_t*)malloc((count ? count : 1) * sizeof(size_t));
+    if (!slots || !entries || !indexes) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t entry_count = 0;
+    size_t entry_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t row = rows[i];
+        size_t start = row > 0 ? column->ends[row - 1] : 0;
+        size_t len = column->ends[row] - start;
+        const char* text = column->text.data + start;
+
+        size_t slot = symbol_hash(text, len) & (slot_count - 1);
+        for (;;) {
+            if (slots[slot] == 0) {
+                entries[entry_count] = row;
+                slots[slot] = ++entry_count;
+                entry_bytes += len;
+                break;
+            }
+            size_t other = entries[slots[slot] - 1];
+            size_t other_start = other > 0 ? column->ends[other - 1] : 0;
+            if (column->ends[other] - other_start == len && memcmp(column->text.data + other_start, text, len) == 0) {
+                break;
+            }
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        indexes[i] = slots[slot] - 1;
+    }
+
+    size_t width = entry_count <= 0x100 ? 1 : entry_count <= 0x10000 ? 2 : 4;
+    size_t plain_size = 4 * (count + 1) + column->text.len;
+    size_t dict_size = 5 + 4 * (entry_count + 1) + entry_bytes + width * count;
+
+    ColumnarEncoding encoding;
+    if (dict_size < plain_size) {
+        encoding = COLUMNAR_STRING_DICT;
+        put_u32(out, entry_count);
+        put_u8(out, (unsigned int)width);
+        put_strings(out, column, entries, entry_count);
+        for (size_t i = 0; i < count; i++) {
+            for (size_t b = 0; b < width; b++) {
+                put_u8(out, (unsigned int)(indexes[i] >> (8 * b)) & 0xff);
+            }
+        }
+    } else {
+        encoding = COLUMNAR_STRING;
+        put_strings(out, column, rows, count);
+    }
+
+    free(slots);
+    free(entries);
+    free(indexes);
+    return encoding;
+}
+
+// Picks the encoding of one column chunk and appends its payload to 'out'.
+static ColumnarEncoding put_column_values(CsvBuffer* out, const ColumnBuilder* column, const size_t* rows,
+                                          size_t count) {
+    int seen = 0;  // bit per ColumnarValueKind
+    for (size_t i = 0; i < count; i++) {
+        seen |= 1 << column->kinds[rows[i]];
+    }
+
+    if (seen == 0) {
+        return COLUMNAR_NULL;
+    }
+
+    int bools = (1 << COLUMNAR_VALUE_FALSE) | (1 << COLUMNAR_VALUE_TRUE);
+    if ((seen & ~bools) == 0) {
+        unsigned int byte = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (column->kinds[rows[i]] == COLUMNAR_VALUE_TRUE) {
+                byte |= 1u << (i % 8);
+            }
+            if (i % 8 == 7 || i == count - 1) {
+                put_u8(out, byte);
+                byte = 0;
+            }
+        }
+        return COLUMNAR_BOOL;
+    }
+
+    if (seen == (1 << COLUMNAR_VALUE_NUMBER)) {
+        // The narrowest type that reproduces every lexeme: int64, then double.
+        unsigned long long* values = (unsigned long long*)malloc(count * sizeof(unsigned long long));
+        if (!values) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        int ints = 1;
+        for (size_t i = 0; i < count && ints; i++) {
+            size_t row = rows[i];
+            size_t start = row > 0 ? column->ends[row - 1] : 0;
+            long long value = 0;
+            ints = parse_canonical_int64(column->text.data + start, column->ends[row] - start, &value);
+            values[i] = (unsigned long long)value;
+        }
+        int doubles = !ints;
+        for (size_t i = 0; i < count && doubles; i++) {
+            size_t row = rows[i];
+            size_t start = row > 0 ? column->ends[row - 1] : 0;
+            double value = 0;
+            doubles = parse_canonical_double(column->text.data + start, column->ends[row] - start, &value);
+            memcpy(&values[i], &value, sizeof(value));
+        }
+
+        ColumnarEncoding encoding = COLUMNAR_NUMBER_TEXT;
+        if (ints) {
+            encoding = put_int_values(out, values, count);
+        } else if (doubles) {
+            encoding = COLUMNAR_FLOAT64;
+            for (size_t i = 0; i < count; i++) {
+                put_u64(out, values[i]);
+            }
+        } else {
+            put_strings(out, column, rows, count);
+        }
+        free(values);
+        return encoding;
+    }
+
+    if (seen == (1 << COLUMNAR_VALUE_STRING)) {
+        return put_string_values(out, column, rows, count);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        put_u8(out, column->kinds[rows[i]]);
+    }
+    put_strings(out, column, rows, count);
+    return COLUMNAR_MIXED;
+}
+
+// Encodes the collected rows as one chunk and starts the next.
+static void flush_chunk(ColumnarStream* cs) {
+    if (cs->rows == 0) {
+        return;
+    }
+    size_t* rows = (size_t*)malloc(cs->rows * sizeof(size_t));
+    if (!rows) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    put_u32(&cs->out, cs->rows);
+    for (int c = 0; c < cs->column_count; c++) {
+        ColumnBuilder* column = &cs->columns[c];
+        size_t count = 0;
+        for (size_t row = 0; row < cs->rows; row++) {
+            if (column->kinds[row] != CELL_NULL) {
+                rows[count++] = row;
+            }
+        }
+
+        cs->scratch.len = 0;
+        ColumnarEncoding encoding = put_column_values(&cs->scratch, column, rows, count);
+        int has_nulls = count < cs->rows && encoding != COLUMNAR_NULL;
+        size_t bitmap_size = has_nulls ? (cs->rows + 7) / 8 : 0;
+
+        put_u8(&cs->out, encoding);
+        put_u8(&cs->out, has_nulls ? COLUMNAR_HAS_NULLS : 0);
+        put_u32(&cs->out, bitmap_size + cs->scratch.len);
+        if (has_nulls) {
+            unsigned int byte = 0;
+            for (size_t row = 0; row < cs->rows; row++) {
+                if (column->kinds[row] != CELL_NULL) {
+                    byte |= 1u << (row % 8);
+                }
+                if (row % 8 == 7 || row == cs->rows - 1) {
+                    put_u8(&cs->out, byte);
+                    byte = 0;
+                }
+            }
+        }
+        csv_buffer_append(&cs->out, cs->scratch.data, cs->scratch.len);
+        column->text.len = 0;
+    }
+    free(rows);
+    cs->rows = 0;
+    cs->text_bytes = 0;
+}
+
+// --- CSV decoding ---
+
+static ColumnBuilder* current_column(ColumnarStream* cs) {
+    return &cs->columns[cs->column < cs->column_count ? cs->column : cs->column_count];
+}
+
+// Starts a cell of the current column in the current row.
+static void begin_cell(ColumnarStream* cs, unsigned char kind) {
+    ColumnBuilder* column = current_column(cs);
+    if (cs->rows >= column->capacity) {
+        while (cs->rows >= column->capacity) {
+            column->capacity = column->capacity ? column->capacity * 2 : 256;
+        }
+        column->kinds = (unsigned char*)realloc(column->kinds, column->capacity);
+        column->ends = (size_t*)realloc(column->ends, column->capacity * sizeof(size_t));
+        if (!column->kinds || !column->ends) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    column->kinds[cs->rows] = kind;
+}
+
+// Ends the current cell; an unquoted one is a number unless it is a boolean.
+static void end_cell(ColumnarStream* cs) {
+    ColumnBuilder* column = current_column(cs);
+    size_t start = cs->rows > 0 ? column->ends[cs->rows - 1] : 0;
+    if (column == &cs->columns[cs->column_count]) {
+        start = 0;  // the overflow column keeps no rows
+    }
+    if (column->kinds[cs->rows] == COLUMNAR_VALUE_NUMBER) {
+        size_t len = column->text.len - start;
+        const char* text = column->text.data + start;
+        if (len == 4 && memcmp(text, "true", 4) == 0) {
+            column->kinds[cs->rows] = COLUMNAR_VALUE_TRUE;
+            column->text.len = start;
+        } else if (len == 5 && memcmp(text, "false", 5) == 0) {
+            column->kinds[cs->rows] = COLUMNAR_VALUE_FALSE;
+            column->text.len = start;
+        }
+    }
+    cs->text_bytes += column->text.len - start;
+    column->ends[cs->rows] = column->text.len;
+    cs->column++;
+}
+
+static void end_row(ColumnarStream* cs) {
+    while (cs->column < cs->column_count) {
+        begin_cell(cs, CELL_NULL);
+        end_cell(cs);
+    }
+    cs->columns[cs->column_count].text.len = 0;
+    cs->column = 0;
+    cs->rows++;
+    if (cs->rows == COLUMNAR_CHUNK_ROWS || cs->text_bytes >= COLUMNAR_CHUNK_BYTES) {
+        flush_chunk(cs);
+    }
+}
+
+// Decodes CSV as the writers produce it (csv_writer.h): strings quoted, numbers and
+// booleans bare, null empty, rows ending in '\n'.
+static void decode_csv(ColumnarStream* cs, const char* p, const char* end) {
+    while (p < end) {
+        switch (cs->state) {
+            case FIELD_START:
+                if (*p == '"') {
+                    begin_cell(cs, COLUMNAR_VALUE_STRING);
+                    cs->state = FIELD_QUOTED;
+                    p++;
+                } else if (*p == ',' || *p == '\n') {
+                    begin_cell(cs, CELL_NULL);
+                    end_cell(cs);
+                    if (*p == '\n') {
+                        end_row(cs);
+                    }
+                    p++;
+                } else {
+                    begin_cell(cs, COLUMNAR_VALUE_NUMBER);
+                    cs->state = FIELD_BARE;
+                }
+                break;
+            case FIELD_BARE: {
+                const char* stop = p;
+                while (stop < end && *stop != ',' && *stop != '\n') {
+                    stop++;
+                }
+                csv_buffer_append(&current_column(cs)->text, p, (size_t)(stop - p));
+                p = stop;
+                if (p < end) {
+                    end_cell(cs);
+                    if (*p == '\n') {
+                        end_row(cs);
+                    }
+                    cs->state = FIELD_START;
+                    p++;
+                }
+                break;
+            }
+            case FIELD_QUOTED: {
+                const char* quote = (const char*)memchr(p, '"', (size_t)(end - p));
+                const char* stop = quote ? quote : end;
+                csv_buffer_append(&current_column(cs)->text, p, (size_t)(stop - p));
+                p = stop;
+                if (quote) {
+                    cs->state = FIELD_QUOTE;
+                    p++;
+                }
+                break;
+            }
+            case FIELD_QUOTE:
+                if (*p == '"') {
+                    csv_buffer_putc(&current_column(cs)->text, '"');
+                    cs->state = FIELD_QUOTED;
+                } else {
+                    end_cell(cs);
+                    if (*p == '\n') {
+                        end_row(cs);
+                    }
+                    cs->state = FIELD_START;
+                }
+                p++;
+                break;
+        }
+    }
+}
+
+// --- Sink ---
+
+static void* columnar_open(void* ctx, const char* name) {
+    ColumnarSink* columnar = (ColumnarSink*)ctx;
+    ColumnarStream* cs = (ColumnarStream*)calloc(1, sizeof(ColumnarStream));
+    if (!cs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t len = strlen(name);
+    char* table_name = (char*)malloc(len + sizeof(COLUMNAR_FILE_EXTENSION));
+    if (!table_name) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(table_name, name, len + 1);
+    if (len > 4 && strcmp(name + len - 4, ".csv") == 0) {
+        table_name[len - 4] = '\0';
+        cs->table = find_table(columnar->context, table_name);
+    }
+
+    if (!cs->table) {
+        free(table_name);
+        cs->stream = columnar->inner->open(columnar->inner->ctx, name);
+        if (!cs->stream) {
+            free(cs);
+            return NULL;
+        }
+        return cs;
+    }
+
+    strcat(table_name, COLUMNAR_FILE_EXTENSION);
+    cs->stream = columnar->inner->open(columnar->inner->ctx, table_name);
+    free(table_name);
+    if (!cs->stream) {
+        free(cs);
+        return NULL;
+    }
+
+    cs->column_count = cs->table->column_count;
+    cs->columns = (ColumnBuilder*)calloc((size_t)cs->column_count + 1, sizeof(ColumnBuilder));
+    if (!cs->columns) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c <= cs->column_count; c++) {
+        csv_buffer_reserve(&cs->columns[c].text, 256);  // never NULL, even if all values are ""
+    }
+    csv_buffer_reserve(&cs->scratch, 256);
+    cs->state = FIELD_START;
+
+    // The header row is the column names joined with commas (see write_csv_files()).
+    cs->header_left = 1;
+    for (int c = 0; c < cs->column_count; c++) {
+        cs->header_left += strlen(cs->table->columns[c]) + (c > 0 ? 1 : 0);
+    }
+
+    csv_buffer_init(&cs->out, columnar->inner, cs->stream);
+    csv_buffer_append(&cs->out, COLUMNAR_MAGIC, 4);
+    put_name(&cs->out, cs->table->name);
+    put_u32(&cs->out, (size_t)cs->column_count);
+    for (int c = 0; c < cs->column_count; c++) {
+        put_name(&cs->out, cs->table->columns[c]);
+    }
+    return cs;
+}
+
+static int columnar_write(void* ctx, void* handle, const char* data, size_t len) {
+    ColumnarSink* columnar = (ColumnarSink*)ctx;
+    ColumnarStream* cs = (ColumnarStream*)handle;
+    if (!cs->table) {
+        return columnar->inner->write(columnar->inner->ctx, cs->stream, data, len);
+    }
+
+    size_t skip = cs->header_left < len ? cs->header_left : len;
+    cs->header_left -= skip;
+    decode_csv(cs, data + skip, data + len);
+    return cs->out.failed ? -1 : 0;
+}
+
+static int columnar_close(void* ctx, void* handle) {
+    ColumnarSink* columnar = (ColumnarSink*)ctx;
+    ColumnarStream* cs = (ColumnarStream*)handle;
+    int status;
+    if (cs->table) {
+        // A last row without its '\n'.
+        if (cs->state != FIELD_START) {
+            end_cell(cs);
+            cs->state = FIELD_START;
+        }
+        if (cs->column > 0) {
+            end_row(cs);
+        }
+        flush_chunk(cs);
+        put_u32(&cs->out, 0);
+        status = csv_buffer_close(&cs->out);
+        csv_buffer_free(&cs->scratch);
+        for (int c = 0; c <= cs->column_count; c++) {
+            free(cs->columns[c].kinds);
+            free(cs->columns[c].ends);
+            csv_buffer_free(&cs->columns[c].text);
+        }
+        free(cs->columns);
+    } else {
+        status = columnar->inner->close(columnar->inner->ctx, cs->stream);
+    }
+    free(cs);
+    return status;
+}
+
+Json2RelCsvSink columnar_sink(ColumnarSink* columnar, const Json2RelCsvSink* inner, const SchemaContext* context) {
+    columnar->inner = inner;
+    columnar->context = context;
+
+    Json2RelCsvSink sink;
+    sink.open = columnar_open;
+    sink.write = columnar_write;
+    sink.close = columnar_close;
+    sink.ctx = columnar;
+    return sink;
+}
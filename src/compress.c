@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "compress.h"
+
+#ifdef JSON2RELCSV_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef JSON2RELCSV_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Compressed bytes a compression thread collects before each write to an inner stream.
+#define COMPRESS_OUTPUT_SIZE (64 * 1024)
+
+// A stream's block starts this small and doubles up to COMPRESS_BLOCK_SIZE, so the many
+// small tables of a document do not each hold a full block.
+#define COMPRESS_INITIAL_BLOCK_SIZE (4 * 1024)
+
+// One stream opened through the sink.
+//
+// The writer fills blocks[filling]. A full block is queued for the sink's compression
+// threads as 'pending' (waiting first for the block before it to be done), and the
+// writer carries on in the other block. While a block is pending, only the thread
+// compressing it touches the codec and the inner stream, so a stream's blocks are
+// compressed one at a time and in order.
+typedef struct CompressStream {
+    CompressSink* compress;
+    void* stream;              // on the inner sink
+#ifdef JSON2RELCSV_WITH_ZLIB
+    z_stream gzip;
+#endif
+#ifdef JSON2RELCSV_WITH_ZSTD
+    ZSTD_CCtx* zstd;
+#endif
+    char* blocks[2];           // allocated as needed
+    size_t sizes[2];           // bytes allocated, up to COMPRESS_BLOCK_SIZE
+    size_t lengths[2];
+    int filling;               // the block being written to
+    int pending;               // the other block waits to be compressed
+    int last;                  // ... and ends the stream
+    int failed;                // the codec or a write to the inner stream failed
+    struct CompressStream* next_queued;
+} CompressStream;
+
+int compress_supported(int compression) {
+    switch (compression) {
+#ifdef JSON2RELCSV_WITH_ZLIB
+        case JSON2RELCSV_COMPRESS_GZIP: return 1;
+#endif
+#ifdef JSON2RELCSV_WITH_ZSTD
+        case JSON2RELCSV_COMPRESS_ZSTD: return 1;
+#endif
+        default: return 0;
+    }
+}
+
+int compress_max_level(int compression) {
+    return compression == JSON2RELCSV_COMPRESS_ZSTD ? 22 : 9;
+}
+
+static void* allocate(size_t size) {
+    void* memory = malloc(size);
+    if (!memory) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+// --- Codecs ---
+
+// Writes 'len' compressed bytes from 'output' to the inner stream. Returns -1 if it fails.
+static int put_output(CompressStream* cs, const char* output, size_t len) {
+    const Json2RelCsvSink* inner = cs->compress->inner;
+    return inner->write(inner->ctx, cs->stream, output, len) != 0 ? -1 : 0;
+}
+
+// Compresses 'len' bytes into the inner stream, through 'output' (COMPRESS_OUTPUT_SIZE
+// bytes); with 'last', also ends the file. Returns -1 if the codec or the inner stream
+// fails, and stops there.
+static int compress_block(CompressStream* cs, char* output, const char* data, size_t len, int last) {
+#ifdef JSON2RELCSV_WITH_ZLIB
+    if (cs->compress->compression == JSON2RELCSV_COMPRESS_GZIP) {
+        // Blocks are far below zlib's 4 GiB avail_in limit.
+        cs->gzip.next_in = (Bytef*)data;
+        cs->gzip.avail_in = (uInt)len;
+        int status;
+        do {
+            cs->gzip.next_out = (Bytef*)output;
+            cs->gzip.avail_out = COMPRESS_OUTPUT_SIZE;
+            status = deflate(&cs->gzip, last ? Z_FINISH : Z_NO_FLUSH);
+            // Z_BUF_ERROR only says that no progress was possible this time round.
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                return -1;
+            }
+            size_t produced = COMPRESS_OUTPUT_SIZE - cs->gzip.avail_out;
+            if (produced > 0 && put_output(cs, output, produced) != 0) {
+                return -1;
+            }
+        } while (cs->gzip.avail_out == 0 || (last && status != Z_STREAM_END));
+        return 0;
+    }
+#endif
+#ifdef JSON2RELCSV_WITH_ZSTD
+    if (cs->compress->compression == JSON2RELCSV_COMPRESS_ZSTD) {
+        ZSTD_inBuffer in = {data, len, 0};
+        size_t left;
+        do {
+            ZSTD_outBuffer out = {output, COMPRESS_OUTPUT_SIZE, 0};
+            left = ZSTD_compressStream2(cs->zstd, &out, &in, last ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(left)) {
+                return -1;
+            }
+            if (out.pos > 0 && put_output(cs, output, out.pos) != 0) {
+                return -1;
+            }
+        } while (in.pos < in.size || (last && left != 0));
+        return 0;
+    }
+#endif
+    (void)cs;
+    (void)output;
+    (void)data;
+    (void)len;
+    (void)last;
+    return 0;
+}
+
+// Sets up the codec for a new stream. Only fails if memory runs out.
+static void codec_init(CompressStream* cs) {
+    int level = cs->compress->level;
+#ifdef JSON2RELCSV_WITH_ZLIB
+    if (cs->compress->compression == JSON2RELCSV_COMPRESS_GZIP) {
+        memset(&cs->gzip, 0, sizeof(cs->gzip));
+        // 16 + window bits: a gzip header and trailer rather than a zlib one.
+        if (deflateInit2(&cs->gzip, level ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+#endif
+#ifdef JSON2RELCSV_WITH_ZSTD
+    if (cs->compress->compression == JSON2RELCSV_COMPRESS_ZSTD) {
+        cs->zstd = ZSTD_createCCtx();
+        if (!cs->zstd) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        ZSTD_CCtx_setParameter(cs->zstd, ZSTD_c_compressionLevel, level ? level : ZSTD_CLEVEL_DEFAULT);
+    }
+#endif
+    (void)level;
+}
+
+static void codec_free(CompressStream* cs) {
+#ifdef JSON2RELCSV_WITH_ZLIB
+    if (cs->compress->compression == JSON2RELCSV_COMPRESS_GZIP) {
+        deflateEnd(&cs->gzip);
+    }
+#endif
+#ifdef JSON2RELCSV_WITH_ZSTD
+    if (cs->compress->compression == JSON2RELCSV_COMPRESS_ZSTD) {
+        ZSTD_freeCCtx(cs->zstd);
+    }
+#endif
+    (void)cs;
+}
+
+// --- Compression threads ---
+
+// Compresses the pending blocks of queued streams, oldest first, until the sink stops.
+static void* compress_thread(void* arg) {
+    CompressSink* compress = (CompressSink*)arg;
+    char* output = (char*)allocate(COMPRESS_OUTPUT_SIZE);
+    pthread_mutex_lock(&compress->lock);
+    for (;;) {
+        while (!compress->queue && !compress->stopping) {
+            compress->idle++;
+            pthread_cond_wait(&compress->queued, &compress->lock);
+            compress->idle--;
+        }
+        CompressStream* cs = compress->queue;
+        if (!cs) {
+            break;
+        }
+        compress->queue = cs->next_queued;
+        if (!compress->queue) {
+            compress->queue_tail = NULL;
+        }
+        int block = 1 - cs->filling;
+        int last = cs->last;
+        int failed = cs->failed;
+        pthread_mutex_unlock(&compress->lock);
+
+        if (!failed && compress_block(cs, output, cs->blocks[block], cs->lengths[block], last) != 0) {
+            failed = 1;
+        }
+
+        pthread_mutex_lock(&compress->lock);
+        cs->failed = failed;
+        cs->pending = 0;
+        pthread_cond_broadcast(&compress->done);
+    }
+    pthread_mutex_unlock(&compress->lock);
+    free(output);
+    return NULL;
+}
+
+// Hands the block being filled to the compression threads and starts filling the other,
+// starting another thread if none is idle and the sink has room for one. Without any
+// thread, compresses the block here. Returns -1 once the stream has failed (for a
+// handed-over block, possibly only at a later call).
+static int hand_off(CompressStream* cs, int last) {
+    CompressSink* compress = cs->compress;
+    pthread_mutex_lock(&compress->lock);
+    if (compress->idle == 0 && compress->thread_count < compress->max_threads &&
+        pthread_create(&compress->threads[compress->thread_count], NULL, compress_thread, compress) == 0) {
+        compress->thread_count++;
+    }
+    if (compress->thread_count == 0) {
+        pthread_mutex_unlock(&compress->lock);
+        char* output = (char*)allocate(COMPRESS_OUTPUT_SIZE);
+        if (!cs->failed &&
+            compress_block(cs, output, cs->blocks[cs->filling], cs->lengths[cs->filling], last) != 0) {
+            cs->failed = 1;
+        }
+        free(output);
+        cs->lengths[cs->filling] = 0;
+        return cs->failed ? -1 : 0;
+    }
+
+    while (cs->pending) {
+        pthread_cond_wait(&compress->done, &compress->lock);
+    }
+    int failed = cs->failed;
+    cs->filling = 1 - cs->filling;
+    cs->lengths[cs->filling] = 0;
+    cs->pending = 1;
+    cs->last = last;
+    cs->next_queued = NULL;
+    if (compress->queue_tail) {
+        compress->queue_tail->next_queued = cs;
+    } else {
+        compress->queue = cs;
+    }
+    compress->queue_tail = cs;
+    pthread_cond_signal(&compress->queued);
+    pthread_mutex_unlock(&compress->lock);
+    return failed ? -1 : 0;
+}
+
+// --- Sink ---
+
+static void* compress_open(void* ctx, const char* name) {
+    CompressSink* compress = (CompressSink*)ctx;
+    const char* extension = compress->compression == JSON2RELCSV_COMPRESS_ZSTD ? COMPRESS_ZSTD_EXTENSION
+                                                                              : COMPRESS_GZIP_EXTENSION;
+    size_t len = strlen(name);
+    char* compressed_name = (char*)allocate(len + strlen(extension) + 1);
+    memcpy(compressed_name, name, len);
+    strcpy(compressed_name + len, extension);
+    void* stream = compress->inner->open(compress->inner->ctx, compressed_name);
+    free(compressed_name);
+    if (!stream) {
+        return NULL;
+    }
+
+    CompressStream* cs = (CompressStream*)calloc(1, sizeof(CompressStream));
+    if (!cs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    cs->compress = compress;
+    cs->stream = stream;
+    codec_init(cs);
+    return cs;
+}
+
+static int compress_write(void* ctx, void* handle, const char* data, size_t len) {
+    (void)ctx;
+    CompressStream* cs = (CompressStream*)handle;
+    int status = 0;
+    while (len > 0) {
+        int b = cs->filling;
+        if (cs->lengths[b] == cs->sizes[b] && cs->sizes[b] < COMPRESS_BLOCK_SIZE) {
+            // Grow the block being filled; the compression threads never touch it.
+            size_t size = cs->sizes[b] ? cs->sizes[b] * 2 : COMPRESS_INITIAL_BLOCK_SIZE;
+            cs->blocks[b] = (char*)realloc(cs->blocks[b], size < COMPRESS_BLOCK_SIZE ? size : COMPRESS_BLOCK_SIZE);
+            if (!cs->blocks[b]) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            cs->sizes[b] = size < COMPRESS_BLOCK_SIZE ? size : COMPRESS_BLOCK_SIZE;
+        }
+        size_t room = cs->sizes[b] - cs->lengths[b];
+        size_t n = len < room ? len : room;
+        memcpy(cs->blocks[b] + cs->lengths[b], data, n);
+        cs->lengths[b] += n;
+        data += n;
+        len -= n;
+        if (cs->lengths[b] == COMPRESS_BLOCK_SIZE && hand_off(cs, 0) != 0) {
+            status = -1;
+        }
+    }
+    return status;
+}
+
+// Compresses what is left and ends the file, waits for it to be written, then closes
+// the inner stream.
+static int compress_close(void* ctx, void* handle) {
+    CompressSink* compress = (CompressSink*)ctx;
+    CompressStream* cs = (CompressStream*)handle;
+    hand_off(cs, 1);
+    pthread_mutex_lock(&compress->lock);
+    while (cs->pending) {
+        pthread_cond_wait(&compress->done, &compress->lock);
+    }
+    pthread_mutex_unlock(&compress->lock);
+    int status = compress->inner->close(compress->inner->ctx, cs->stream) != 0 || cs->failed ? -1 : 0;
+
+    codec_free(cs);
+    free(cs->blocks[0]);
+    free(cs->blocks[1]);
+    free(cs);
+    return status;
+}
+
+// The number of processors online; at least 1.
+static int processor_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (count < COMPRESS_MAX_THREADS ? (int)count : COMPRESS_MAX_THREADS) : 1;
+}
+
+Json2RelCsvSink compress_sink(CompressSink* compress, const Json2RelCsvSink* inner, int compression, int level) {
+    memset(compress, 0, sizeof(*compress));
+    compress->inner = inner;
+    compress->compression = compression;
+    compress->level = level;
+    compress->max_threads = processor_count();
+    pthread_mutex_init(&compress->lock, NULL);
+    pthread_cond_init(&compress->queued, NULL);
+    pthread_cond_init(&compress->done, NULL);
+
+    Json2RelCsvSink sink;
+    sink.open = compress_open;
+    sink.write = compress_write;
+    sink.close = compress_close;
+    sink.ctx = compress;
+    return sink;
+}
+
+void compress_sink_destroy(CompressSink* compress) {
+    pthread_mutex_lock(&compress->lock);
+    compress->stopping = 1;
+    pthread_cond_broadcast(&compress->queued);
+    pthread_mutex_unlock(&compress->lock);
+    for (int i = 0; i < compress->thread_count; i++) {
+        pthread_join(compress->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&compress->lock);
+    pthread_cond_destroy(&compress->queued);
+    pthread_cond_destroy(&compress->done);
+}
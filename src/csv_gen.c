@@ -4,120 +4,222 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <ctype.h>
+#include <pthread.h>
 #include "ast.h"
-
-// Table kind: mirrors the three structural forms from analyze_node
+#include "schema.h"
+#include "row_ids.h"
+#include "csv_writer.h"
+#include "stats.h"
+
+// Where the members of objects with one particular key sequence land in one table.
+// Objects of the same shape (the common case for arrays of records) reuse it, so a row
+// is a direct scatter of members into column slots rather than a search per column.
+typedef struct ObjectShape {
+    size_t key_count;
+    const Symbol** keys;    // keys of the first object seen with this shape (AST-owned)
+    int* columns;           // per member: its column, or -1 (no such column, or a repeated key)
+    unsigned int hash;
+    struct ObjectShape* next; // next shape in the same bucket
+} ObjectShape;
+
+// How a column is filled, decided once per table.
 typedef enum {
-    TABLE_OBJECT,    // standalone JSON object
-    TABLE_ARRAY,     // array-of-objects
-    TABLE_JUNCTION   // array-of-scalars
-} TableKind;
-
-// Structure to represent a table schema
-typedef struct TableSchema {
-    char* name;
-    char** columns;
-    int column_count;
-    char* parent;        // FK target table name; NULL for root table
-    TableKind kind;      // structural kind of this table
-    struct TableSchema* next;
-} TableSchema;
-
-// Structure to keep track of table data
+    COLUMN_DATA,            // an object member
+    COLUMN_ID,              // "id"
+    COLUMN_POSITION,        // "seq" / "index": the position within the array, for array items
+    COLUMN_VALUE            // "value": the element itself, for scalar array items
+} ColumnRole;
+
+#define SHAPE_BUCKETS 64
+
+// Per-table output state for the single data pass.
+typedef struct {
+    TableSchema* schema;
+    void* stream;           // NULL if the table is not written by this job
+    int active;             // rows are written to 'stream', or typed (see type_csv_files())
+    CsvBuffer out;          // buffered output to 'stream'
+    RowIds ids;             // this table's view of the row numbering (see row_ids.h)
+    ColumnRole* roles;      // per column
+    ASTNode** cells;        // per column: the member value for the row being written
+    ObjectShape* shapes[SHAPE_BUCKETS];
+    ObjectShape* last_shape; // checked first; consecutive rows usually share a shape
+    const char* fk_parent_key; // parent key that fk_column was resolved for (AST-owned)
+    int fk_column;          // column of "<fk_parent_key>_id", or -1
+} TableSink;
+
+// A table lookup remembered by the data pass: where rows under 'key' go (NULL if the
+// key names no table).
 typedef struct {
-    TableSchema* tables;
-    int next_id;
-} SchemaContext;
+    const Symbol* key;
+    TableSink* sink;
+} SinkSlot;
+
+// State shared by the data pass across all tables.
+typedef struct {
+    SchemaContext* context;
+    TableSink* sinks;       // indexed by TableSchema.index
+    RowIdCounter counter;   // shared base ID counter
+    SinkSlot* sink_slots;   // find_sink() results by key pointer; key NULL = empty slot
+    size_t sink_slot_capacity; // power of two, at least twice sink_slot_count
+    size_t sink_slot_count;
+    int typing;             // rows are typed rather than written (see type_csv_files())
+} WriteContext;
+
+// One writer's share of the data pass (--threads). Each worker walks the whole AST
+// with its own copy of the ID bookkeeping, so IDs come out exactly as in a single
+// pass, but only opens and fills the tables assigned to it: at most open_limit of them
+// per walk, walking again for the rest.
+typedef struct {
+    SchemaContext* context;
+    const Json2RelCsvSink* sink;
+    ASTNode* root;
+    const int* table_workers; // per table index: the worker that writes it
+    int worker;
+    int open_limit;           // tables open at once (a share of MAX_OPEN_TABLES)
+    int typing;               // type_csv_files(): every table's rows are typed, none written
+    int failed;               // a table could not be written; 'error' says which
+    Json2RelCsvError error;
+} WriteJob;
 
 // Forward declarations for helper functions
 static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
-                        const char* key, SchemaContext* context);
-static void write_csv_files(SchemaContext* context, const char* output_dir, ASTNode* ast_root); // Added ast_root
-static void recursively_write_table_data(FILE* csv_f, TableSchema* target_schema,
-                                       ASTNode* current_ast_node, const char* current_node_key,
-                                       const char* logical_parent_key_for_fk_col, int actual_parent_row_id_for_fk_val,
-                                       int* master_id_counter); // New function
-static TableSchema* find_or_create_table(SchemaContext* context, const char* name);
-static void add_column(TableSchema* table, const char* column);
-static void ensure_directory_exists(const char* dir);
-static char* get_csv_file_path(const char* dir, const char* table_name);
-static void write_csv_value(FILE* file, ASTNode* node);
+                        const Symbol* key, SchemaContext* context);
+static void recursively_write_table_data(WriteContext* wc, ASTNode* current_ast_node,
+                                         const Symbol* current_node_key, const ParentRef* parent,
+                                         int is_array_item_row);
 static int has_same_keys(KeyValueList* list1, KeyValueList* list2);
-static char* safe_filename(const char* name);
 
-// Shared: run the analysis pass to populate context from root.
-static void build_schema(ASTNode* root, SchemaContext* context) {
-    analyze_node(root, NULL, 0, "root", context);
+// The key the top-level value is filed under.
+static Symbol root_key(void) {
+    Symbol key = {"root", "root", 0};
+    key.hash = symbol_hash(key.text, strlen(key.text));
+    return key;
 }
 
-// Shared: free all TableSchema entries in context (columns, parent, name, node).
-static void free_schema(SchemaContext* context) {
-    TableSchema* table = context->tables;
-    while (table) {
-        TableSchema* next = table->next;
-        for (int i = 0; i < table->column_count; i++) {
-            free(table->columns[i]);
-        }
-        free(table->columns);
-        free(table->name);
-        if (table->parent) {
-            free(table->parent);
-        }
-        free(table);
-        table = next;
-    }
-    context->tables = NULL;
+// Run the analysis pass to populate context from root.
+void build_schema(ASTNode* root, SchemaContext* context) {
+    Symbol key = root_key();
+    analyze_node(root, NULL, 0, &key, context);
 }
 
-// Main function to analyze AST and generate CSV files
-void generate_csv_tables(ASTNode* root, const char* output_dir) {
-    SchemaContext context = {NULL, 1}; // Start IDs from 1
+// Main function to analyze AST and generate CSV tables (and schema.json if requested)
+int generate_csv_tables(ASTNode* root, const Json2RelCsvSink* sink, int emit_schema, int threads,
+                        Json2RelCsvError* error) {
+    SchemaContext context = schema_context_init();
 
     // Step 1: Analyze the AST to identify tables and their schemas
     build_schema(root, &context);
 
-    // Step 2: Write CSV files based on the identified schemas
-    write_csv_files(&context, output_dir, root); // Pass root to write_csv_files
+    // Step 2: Write CSV tables based on the identified schemas
+    int result = write_csv_files(&context, sink, root, threads, error); // Pass root to write_csv_files
+
+    // Step 3: Describe the same schema in schema.json
+    if (result == 0 && emit_schema) {
+        result = write_schema_json(&context, sink, error);
+    }
 
     // Free allocated memory for schemas
     free_schema(&context);
+    return result;
+}
+
+// The keys of one object's object and array members so far, hashed by Symbol.hash.
+// A few fit in 'inline_slots'; more move the index to the heap.
+#define KEY_SET_INLINE 16
+
+typedef struct {
+    const Symbol* inline_slots[KEY_SET_INLINE];
+    const Symbol** slots;   // inline_slots or a heap array; NULL = empty slot
+    size_t capacity;        // power of two, at least twice count
+    size_t count;
+} KeySet;
+
+static void key_set_init(KeySet* set) {
+    memset(set->inline_slots, 0, sizeof(set->inline_slots));
+    set->slots = set->inline_slots;
+    set->capacity = KEY_SET_INLINE;
+    set->count = 0;
+}
+
+// Returns the slot holding 'key', or the empty slot where it would go.
+static const Symbol** key_set_slot(const KeySet* set, const Symbol* key) {
+    size_t mask = set->capacity - 1;
+    size_t i = key->hash & mask;
+    while (set->slots[i] && !symbol_equal(set->slots[i], key)) {
+        i = (i + 1) & mask;
+    }
+    return &set->slots[i];
+}
+
+static void key_set_add(KeySet* set, const Symbol* key) {
+    if (2 * (set->count + 1) > set->capacity) {
+        const Symbol** old_slots = set->slots;
+        size_t old_capacity = set->capacity;
+        set->capacity *= 2;
+        set->slots = (const Symbol**)calloc(set->capacity, sizeof(const Symbol*));
+        if (!set->slots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i]) {
+                *key_set_slot(set, old_slots[i]) = old_slots[i];
+            }
+        }
+        if (old_slots != set->inline_slots) {
+            free((void*)old_slots);
+        }
+    }
+    const Symbol** slot = key_set_slot(set, key);
+    if (!*slot) {
+        *slot = key;
+        set->count++;
+    }
+}
+
+// Returns 1 if an object or array member before this one had 'key'. The data pass writes
+// the first member with a key, so a scalar member then has no value in the row.
+static int follows_container_member(const KeySet* containers, const Symbol* key) {
+    return containers->count > 0 && *key_set_slot(containers, key) != NULL;
+}
+
+static void key_set_free(KeySet* set) {
+    if (set->slots != set->inline_slots) {
+        free((void*)set->slots);
+    }
 }
 
 // Recursively analyzes the AST to discover table schemas (names and columns).
 // - node: The current ASTNode being analyzed.
 // - parent_table: The name of the parent table (if any, for foreign key generation).
 // - parent_id: The ID of the parent row in the parent_table.
-// - key: The JSON key that led to this node (used for naming tables/columns).
+// - key: The JSON key that led to this node (its table_name names the node's table).
 // - context: The SchemaContext for storing discovered schemas and managing IDs.
 static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
-                       const char* key, SchemaContext* context) {
+                       const Symbol* key, SchemaContext* context) {
     if (!node) return;
 
     switch (node->type) {
         case NODE_OBJECT: {
             // Create or find a table schema for this JSON object.
-            char* table_name = safe_filename(key);
-            TableSchema* table = find_or_create_table(context, table_name);
-            free(table_name);
+            TableSchema* table = find_or_create_table(context, key->table_name);
 
             // Record parent on first encounter; kind set each visit (same value)
             table->kind = TABLE_OBJECT;
+            table->row_estimate++;
             if (parent_table && table->parent == NULL) {
                 table->parent = strdup(parent_table);
             }
 
             // Add an 'id' column to serve as the primary key for this table.
-            add_column(table, "id");
+            add_typed_column(table, "id", COLUMN_TYPE_INT);
 
             // If this object is nested within another object/array, add a foreign key column
             // linking back to the parent table (e.g., 'parent_table_name_id').
             if (parent_table) {
                 char fk_name[256];
                 snprintf(fk_name, sizeof(fk_name), "%s_id", parent_table);
-                add_column(table, fk_name);
+                add_typed_column(table, fk_name, COLUMN_TYPE_INT);
             }
 
             // Assign a unique ID to this specific object instance.
@@ -126,8 +228,10 @@ static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
 
             // Iterate through the key-value pairs of the JSON object.
             KeyValueList* list = node->value.object;
-            while (list) {
-                KeyValuePair* pair = list->pair;
+            KeySet containers;  // keys of the object and array members so far
+            key_set_init(&containers);
+            for (size_t i = 0; i < list->count; i++) {
+                KeyValuePair* pair = &list->pairs[i];
 
                 // Handle different value types within the object.
                 switch (pair->value->type) {
@@ -135,33 +239,36 @@ static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
                         // Nested object: recursively call analyze_node to define its schema.
                         // The current table becomes the parent for the nested object's table.
                         analyze_node(pair->value, table->name, object_id, pair->key, context);
+                        key_set_add(&containers, pair->key);
                         break;
 
                     case NODE_ARRAY:
                         // Nested array: recursively call analyze_node.
                         // The current table becomes the parent for the array's table (or junction table).
                         analyze_node(pair->value, table->name, object_id, pair->key, context);
+                        key_set_add(&containers, pair->key);
                         break;
 
                     default:
                         // Scalar value (string, number, boolean, null): add as a column to the current table.
-                        add_column(table, pair->key);
+                        if (follows_container_member(&containers, pair->key)) {
+                            add_column(table, pair->key->text);
+                        } else {
+                            add_scalar_value(table, add_column(table, pair->key->text), pair->value);
+                        }
                         break;
                 }
-
-                list = list->next;
             }
+            key_set_free(&containers);
             break;
         }
 
         case NODE_ARRAY: {
             ASTNodeList* list = node->value.array;
-            if (list && list->node->type == NODE_OBJECT) {
+            if (list->count > 0 && list->items[0]->type == NODE_OBJECT) {
                 // Array of objects: A new table is created for these objects.
                 // The table is named after the JSON key of the array.
-                char* array_table = safe_filename(key);
-                TableSchema* table = find_or_create_table(context, array_table);
-                free(array_table);
+                TableSchema* table = find_or_create_table(context, key->table_name);
 
                 // Record parent on first encounter; kind set each visit (same value)
                 table->kind = TABLE_ARRAY;
@@ -170,61 +277,73 @@ static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
                 }
 
                 // Add 'id' (primary key) and parent foreign key to the array's table.
-                add_column(table, "id");
+                int id_column = add_column(table, "id");
 
                 // Add foreign key to parent
+                int fk_column = -1;
                 if (parent_table) {
                     char fk_name[256];
                     snprintf(fk_name, sizeof(fk_name), "%s_id", parent_table);
-                    add_column(table, fk_name);
+                    fk_column = add_column(table, fk_name);
                 }
 
                 // Add a 'seq' (sequence) column to preserve the order of objects within the array.
-                add_column(table, "seq");
+                int seq_column = add_column(table, "seq");
 
                 // Process each object within the array to define its columns and handle further nesting.
-                int index = 0;
-                while (list) {
+                for (size_t index = 0; index < list->count; index++) {
+                    ASTNode* item = list->items[index];
+
+                    // Every element is a row, with values in the columns above.
+                    table->row_estimate++;
+                    add_column_value(table, id_column, COLUMN_TYPE_INT, 0);
+                    if (fk_column >= 0) {
+                        add_column_value(table, fk_column, COLUMN_TYPE_INT, 0);
+                    }
+                    add_column_value(table, seq_column, COLUMN_TYPE_INT, 0);
+
                     // Only process if it's an object
-                    if (list->node->type == NODE_OBJECT) {
+                    if (item->type == NODE_OBJECT) {
                         // Assign a unique ID for each object within the array.
                         int object_id = context->next_id++;
 
                         // Analyze the structure of the object in the array.
-                        KeyValueList* kv_list = list->node->value.object;
-                        while (kv_list) {
-                            KeyValuePair* pair = kv_list->pair;
+                        KeyValueList* kv_list = item->value.object;
+                        KeySet containers;
+                        key_set_init(&containers);
+                        for (size_t i = 0; i < kv_list->count; i++) {
+                            KeyValuePair* pair = &kv_list->pairs[i];
 
                             switch (pair->value->type) {
                                 case NODE_OBJECT:
                                     // Recursively process nested object
                                     analyze_node(pair->value, table->name, object_id, pair->key, context);
+                                    key_set_add(&containers, pair->key);
                                     break;
 
                                 case NODE_ARRAY:
                                     // Recursively process nested array
                                     analyze_node(pair->value, table->name, object_id, pair->key, context);
+                                    key_set_add(&containers, pair->key);
                                     break;
 
                                 default:
                                     // Add scalar value as a column
-                                    add_column(table, pair->key);
+                                    if (follows_container_member(&containers, pair->key)) {
+                                        add_column(table, pair->key->text);
+                                    } else {
+                                        add_scalar_value(table, add_column(table, pair->key->text), pair->value);
+                                    }
                                     break;
                             }
-
-                            kv_list = kv_list->next;
                         }
+                        key_set_free(&containers);
                     }
-
-                    index++;
-                    list = list->next;
                 }
-            } else if (list) {
+            } else if (list->count > 0) {
                 // Array of scalars (strings, numbers, etc.): A junction table is created.
                 // The table is named after the JSON key of the array.
-                char* junction_table = safe_filename(key);
-                TableSchema* table = find_or_create_table(context, junction_table);
-                free(junction_table);
+                TableSchema* table = find_or_create_table(context, key->table_name);
 
                 // Record parent on first encounter; kind set each visit (same value)
                 table->kind = TABLE_JUNCTION;
@@ -234,17 +353,29 @@ static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
 
                 // Junction table columns: 'id' (primary key), parent foreign key,
                 // 'index' (for order), and 'value' (for the scalar value itself).
-                add_column(table, "id");
+                int id_column = add_column(table, "id");
 
                 // Add foreign key to parent
+                int fk_column = -1;
                 if (parent_table) {
                     char fk_name[256];
                     snprintf(fk_name, sizeof(fk_name), "%s_id", parent_table);
-                    add_column(table, fk_name);
+                    fk_column = add_column(table, fk_name);
                 }
 
-                add_column(table, "index");
-                add_column(table, "value");
+                int index_column = add_column(table, "index");
+                int value_column = add_column(table, "value");
+
+                // Every element is a row; those that are not scalars leave 'value' empty.
+                for (size_t index = 0; index < list->count; index++) {
+                    table->row_estimate++;
+                    add_column_value(table, id_column, COLUMN_TYPE_INT, 0);
+                    if (fk_column >= 0) {
+                        add_column_value(table, fk_column, COLUMN_TYPE_INT, 0);
+                    }
+                    add_column_value(table, index_column, COLUMN_TYPE_INT, 0);
+                    add_scalar_value(table, value_column, list->items[index]);
+                }
             }
             break;
         }
@@ -256,546 +387,606 @@ static void analyze_node(ASTNode* node, const char* parent_table, int parent_id,
     }
 }
 
-// Iterates through the discovered table schemas and writes data to corresponding CSV files.
-// - context: The SchemaContext containing all discovered table schemas.
-// - output_dir: The directory where CSV files will be created.
-// - ast_root: The root of the AST, needed for the second pass (data population).
-static void write_csv_files(SchemaContext* context, const char* output_dir, ASTNode* ast_root) {
-    // Ensure output directory exists
-    ensure_directory_exists(output_dir);
-
-    // Write a CSV file for each table
-    TableSchema* current_table_schema = context->tables;
-    while (current_table_schema) {
-        // Get file path
-        char* file_path = get_csv_file_path(output_dir, current_table_schema->name);
-
-        // Open file for writing
-        FILE* file = fopen(file_path, "w");
-        if (!file) {
-            fprintf(stderr, "Error: Could not open file %s for writing\n", file_path);
-            free(file_path);
-            current_table_schema = current_table_schema->next; // Continue to next table
-            continue;
-        }
+// Returns the slot for 'key' in the lookup cache, or the empty slot where it would go.
+static SinkSlot* sink_slot(const WriteContext* wc, const Symbol* key) {
+    size_t mask = wc->sink_slot_capacity - 1;
+    size_t i = key->hash & mask;
+    while (wc->sink_slots[i].key && wc->sink_slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return &wc->sink_slots[i];
+}
 
-        // Write the header row for the current CSV file.
-        for (int i = 0; i < current_table_schema->column_count; i++) {
-            fprintf(file, "%s", current_table_schema->columns[i]);
-            if (i < current_table_schema->column_count - 1) {
-                fprintf(file, ",");
-            }
+// Doubles the lookup cache (or creates it) and reinserts every entry.
+static void grow_sink_slots(WriteContext* wc) {
+    SinkSlot* old_slots = wc->sink_slots;
+    size_t old_capacity = wc->sink_slot_capacity;
+    wc->sink_slot_capacity = old_capacity ? old_capacity * 2 : 64;
+    wc->sink_slots = (SinkSlot*)calloc(wc->sink_slot_capacity, sizeof(SinkSlot));
+    if (!wc->sink_slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].key) {
+            *sink_slot(wc, old_slots[i].key) = old_slots[i];
         }
-        fprintf(file, "\n");
-
-        // Populate data rows by performing a second traversal of the AST, targeting the current table.
-        // A new master_id_counter is used for this pass to ensure ID consistency with the schema analysis pass.
-        int master_id_counter_for_pass = 1; // Reset for each table, to mirror analyze_node's ID generation
-        recursively_write_table_data(file, current_table_schema, ast_root, "root", NULL, 0, &master_id_counter_for_pass);
-
-        fclose(file);
-        free(file_path);
-
-        current_table_schema = current_table_schema->next;
     }
+    free(old_slots);
 }
 
-// Recursively traverses the AST to populate rows in a specific target CSV table.
-// This function is called for each table schema discovered by analyze_node.
-// - csv_f: File pointer to the open CSV file for the target_schema.
-// - target_schema: The schema of the table currently being populated.
-// - current_ast_node: The AST node currently being visited in this traversal.
-// - current_node_key: The JSON key that led to current_ast_node.
-// - logical_parent_key_for_fk_col: The key of the logical parent object/array (used for naming FK columns).
-// - actual_parent_row_id_for_fk_val: The actual ID of the parent row (used for FK column values).
-// - master_id_counter: Pointer to a counter that mimics ID generation from analyze_node, ensuring consistency.
-static void recursively_write_table_data(FILE* csv_f, TableSchema* target_schema,
-                                       ASTNode* current_ast_node, const char* current_node_key,
-                                       const char* logical_parent_key_for_fk_col, int actual_parent_row_id_for_fk_val,
-                                       int* master_id_counter) {
-    if (!current_ast_node) {
-        return;
+// Looks up the sink for the table a key names; NULL if no such table was inferred.
+// Keys are interned, so each distinct key is resolved by name only once per writer.
+static TableSink* find_sink(WriteContext* wc, const Symbol* key) {
+    if (2 * (wc->sink_slot_count + 1) > wc->sink_slot_capacity) {
+        grow_sink_slots(wc);
     }
 
-    char* safe_current_key = safe_filename(current_node_key);
-
-    if (current_ast_node->type == NODE_OBJECT) {
-        // Increment ID counter for every object encountered, same as in analyze_node.
-        int current_object_generated_id = (*master_id_counter)++;
-
-        // Check if this object instance corresponds to a row in the target_schema.
-        if (strcmp(safe_current_key, target_schema->name) == 0) {
-            // This object is a row for the target_schema. Write its values.
-            for (int i = 0; i < target_schema->column_count; i++) {
-                const char* col_name = target_schema->columns[i];
-                int value_written = 0;
-
-                // Populate the 'id' column.
-                if (strcmp(col_name, "id") == 0) {
-                    fprintf(csv_f, "%d", current_object_generated_id);
-                    value_written = 1;
-                // Populate foreign key columns (e.g., 'parent_key_id').
-                } else if (logical_parent_key_for_fk_col) {
-                    char expected_fk_col_name[256];
-                    snprintf(expected_fk_col_name, sizeof(expected_fk_col_name), "%s_id", logical_parent_key_for_fk_col);
-                    if (strcmp(col_name, expected_fk_col_name) == 0) {
-                        fprintf(csv_f, "%d", actual_parent_row_id_for_fk_val);
-                        value_written = 1;
-                    }
-                }
+    SinkSlot* slot = sink_slot(wc, key);
+    if (!slot->key) {
+        TableSchema* table = find_table(wc->context, key->table_name);
+        slot->key = key;
+        slot->sink = table ? &wc->sinks[table->index] : NULL;
+        wc->sink_slot_count++;
+    }
+    return slot->sink;
+}
 
-                // Populate data columns from the object's properties.
-                if (!value_written) {
-                    // Find data in object's properties
-                    KeyValueList* kv_list = current_ast_node->value.object;
-                    while (kv_list) {
-                        if (strcmp(kv_list->pair->key, col_name) == 0) {
-                            // Only write direct scalar values. Nested objects/arrays form other tables.
-                            if (kv_list->pair->value->type != NODE_OBJECT && kv_list->pair->value->type != NODE_ARRAY) {
-                                write_csv_value(csv_f, kv_list->pair->value);
-                                value_written = 1;
-                            }
-                            break;
-                        }
-                        kv_list = kv_list->next;
-                    }
-                }
+// Hashes an object's key sequence (FNV-1a over the keys' own hashes).
+static unsigned int hash_keys(KeyValueList* kv_list) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < kv_list->count; i++) {
+        hash ^= kv_list->pairs[i].key->hash;
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-                if (!value_written) {
-                    // If a column in the schema doesn't have a corresponding value in this object
-                    // (e.g., an optional field, or an FK to a different parent), write an empty field.
-                }
+// Returns 1 if the object has exactly the shape's key sequence.
+static int shape_matches(const ObjectShape* shape, KeyValueList* kv_list) {
+    if (shape->key_count != kv_list->count) return 0;
+    for (size_t i = 0; i < kv_list->count; i++) {
+        if (!symbol_equal(shape->keys[i], kv_list->pairs[i].key)) return 0;
+    }
+    return 1;
+}
 
-                if (i < target_schema->column_count - 1) {
-                    fprintf(csv_f, ",");
-                }
-            }
-            fprintf(csv_f, "\n");
-        }
+// Returns the cached shape for an object's key sequence, creating it on first sight.
+// A member maps to a column only if it is the first member with that key, matching
+// what a search of the object by column name would find.
+static ObjectShape* get_object_shape(TableSink* sink, KeyValueList* kv_list) {
+    if (sink->last_shape && shape_matches(sink->last_shape, kv_list)) {
+        return sink->last_shape;
+    }
 
-        // Recursively call for child elements of this object.
-        // The current object's key and generated ID become parent info for its children.
-        KeyValueList* kv_list_children = current_ast_node->value.object;
-        while (kv_list_children) {
-            recursively_write_table_data(csv_f, target_schema, kv_list_children->pair->value,
-                                       kv_list_children->pair->key, safe_current_key, current_object_generated_id,
-                                       master_id_counter);
-            kv_list_children = kv_list_children->next;
+    unsigned int hash = hash_keys(kv_list);
+    ObjectShape** bucket = &sink->shapes[hash % SHAPE_BUCKETS];
+    for (ObjectShape* shape = *bucket; shape; shape = shape->next) {
+        if (shape->hash == hash && shape_matches(shape, kv_list)) {
+            sink->last_shape = shape;
+            return shape;
         }
+    }
 
-    } else if (current_ast_node->type == NODE_ARRAY) {
-        ASTNodeList* el_list = current_ast_node->value.array;
-        int seq = 0; // Sequence counter for array elements.
-
-        // Check if this array's items are rows for the target_schema.
-        if (strcmp(safe_current_key, target_schema->name) == 0) {
-            // This array's items are rows for the target_schema
-            while (el_list) {
-                ASTNode* array_item = el_list->node;
-                // Increment ID for each item in an array that forms rows for a table.
-                int item_generated_id = (*master_id_counter)++; // ID for the item (either object in array or junction row)
-
-                for (int i = 0; i < target_schema->column_count; i++) {
-                    const char* col_name = target_schema->columns[i];
-                    int value_written = 0;
-
-                    // Populate 'id', parent foreign key, 'seq' (for arrays of objects),
-                    // or 'index' (for arrays of scalars forming junction tables).
-                    if (strcmp(col_name, "id") == 0) {
-                        fprintf(csv_f, "%d", item_generated_id);
-                        value_written = 1;
-                    } else if (logical_parent_key_for_fk_col) { // FK to the object *containing* this array.
-                        char expected_fk_col_name[256];
-                        snprintf(expected_fk_col_name, sizeof(expected_fk_col_name), "%s_id", logical_parent_key_for_fk_col);
-                        if (strcmp(col_name, expected_fk_col_name) == 0) {
-                            fprintf(csv_f, "%d", actual_parent_row_id_for_fk_val);
-                            value_written = 1;
-                        }
-                    }
-                    
-                    if (!value_written && strcmp(col_name, "seq") == 0) { // For arrays of objects
-                         fprintf(csv_f, "%d", seq);
-                         value_written = 1;
-                    } else if (!value_written && strcmp(col_name, "index") == 0) { // For arrays of scalars (junction table)
-                         fprintf(csv_f, "%d", seq);
-                         value_written = 1;
-                    }
-
-
-                    if (!value_written) {
-                        if (array_item->type == NODE_OBJECT) {
-                            KeyValueList* kv_item_list = array_item->value.object;
-                            while (kv_item_list) {
-                                if (strcmp(kv_item_list->pair->key, col_name) == 0) {
-                                    if (kv_item_list->pair->value->type != NODE_OBJECT && kv_item_list->pair->value->type != NODE_ARRAY) {
-                                        write_csv_value(csv_f, kv_item_list->pair->value);
-                                        value_written = 1;
-                                    }
-                                    break;
-                                }
-                                kv_item_list = kv_item_list->next;
-                            }
-                        } else { // Array of scalars, for "value" column in junction table
-                            if (strcmp(col_name, "value") == 0) {
-                                write_csv_value(csv_f, array_item);
-                                value_written = 1;
-                            }
-                        }
-                    }
-                     if (!value_written) {
-                        // No value found or applicable
-                    }
-                    if (i < target_schema->column_count - 1) {
-                        fprintf(csv_f, ",");
-                    }
-                }
-                fprintf(csv_f, "\n");
-
-                // If array items are objects, recurse for their children.
-                // The array's key (safe_current_key) and the item's ID become parent info.
-                if (array_item->type == NODE_OBJECT) {
-                    KeyValueList* kv_list_children = array_item->value.object;
-                    while (kv_list_children) {
-                        recursively_write_table_data(csv_f, target_schema, kv_list_children->pair->value,
-                                                   kv_list_children->pair->key, safe_current_key, item_generated_id,
-                                                   master_id_counter);
-                        kv_list_children = kv_list_children->next;
-                    }
-                }
-                seq++;
-                el_list = el_list->next;
-            }
-        } else {
-            // This array is not the target_schema itself, but its elements might contain relevant data
-            // or be parents to data relevant to the target_schema. Traverse its elements.
-            el_list = current_ast_node->value.array; // Reset pointer
-            while (el_list) {
-                ASTNode* array_item = el_list->node;
-                // Consume an ID if the item is an object, as analyze_node would have.
-                // Scalar items in non-target arrays don't consume IDs here unless they form a table
-                // (which would be caught if safe_current_key matched target_schema->name).
-                if (array_item->type == NODE_OBJECT) {
-                    (*master_id_counter)++;
-                } else { 
-                    // For arrays of scalars, an ID is consumed if it forms a junction table.
-                    // This check is complex here. analyze_node decides this.
-                    // To be safe and keep master_id_counter in sync, we might need to check
-                    // if a table exists for this safe_current_key.
-                    // For now, let's assume analyze_node's ID consumption for scalar arrays
-                    // is tied to when it *creates* the junction table.
-                    // The current logic for ID consumption in array handling is when safe_current_key == target_schema->name.
-                    // If not, we just recurse.
-                }
-
-                // Recurse into the array item.
-                // The parent context (logical_parent_key_for_fk_col, actual_parent_row_id_for_fk_val)
-                // remains that of the object/array that *contains* this current (non-target) array.
-                recursively_write_table_data(csv_f, target_schema, array_item, safe_current_key,
-                                           logical_parent_key_for_fk_col, actual_parent_row_id_for_fk_val,
-                                           master_id_counter);
-                el_list = el_list->next;
+    ObjectShape* shape = (ObjectShape*)malloc(sizeof(ObjectShape));
+    size_t count = kv_list->count;
+    shape->keys = (const Symbol**)malloc((count > 0 ? count : 1) * sizeof(const Symbol*));
+    shape->columns = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    if (!shape || !shape->keys || !shape->columns) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    shape->key_count = count;
+    shape->hash = hash;
+    for (size_t i = 0; i < count; i++) {
+        const Symbol* key = kv_list->pairs[i].key;
+        shape->keys[i] = key;
+        shape->columns[i] = find_column(sink->schema, key->text);
+        for (size_t j = 0; j < i && shape->columns[i] >= 0; j++) {
+            if (symbol_equal(shape->keys[j], key)) {
+                shape->columns[i] = -1; // a repeated key; the first one wins
             }
         }
     }
-    // Scalar nodes (strings, numbers, etc.) do not directly form rows; their values are extracted
-    // when processing their parent object or array. No direct action for them here.
+    shape->next = *bucket;
+    *bucket = shape;
+    sink->last_shape = shape;
+    return shape;
+}
 
-    free(safe_current_key);
+// Returns the FK column for rows whose parent has the given key, or -1.
+// Resolved once per run of rows with the same parent key. Parent keys are interned
+// table names, so the check is usually a pointer comparison.
+static int get_fk_column(TableSink* sink, const char* parent_key) {
+    if (sink->fk_parent_key != parent_key &&
+        (!sink->fk_parent_key || strcmp(sink->fk_parent_key, parent_key) != 0)) {
+        char expected_fk_col_name[256];
+        snprintf(expected_fk_col_name, sizeof(expected_fk_col_name), "%s_id", parent_key);
+        sink->fk_parent_key = parent_key;
+        sink->fk_column = find_column(sink->schema, expected_fk_col_name);
+    }
+    return sink->fk_column;
 }
 
-// Finds a TableSchema by name in the SchemaContext, or creates and adds a new one if not found.
-static TableSchema* find_or_create_table(SchemaContext* context, const char* name) {
-    // Check if table already exists
-    TableSchema* table = context->tables;
-    while (table) {
-        if (strcmp(table->name, name) == 0) {
-            return table;
+// Frees a sink's shape cache and per-column arrays.
+static void free_sink(TableSink* sink) {
+    for (int b = 0; b < SHAPE_BUCKETS; b++) {
+        ObjectShape* shape = sink->shapes[b];
+        while (shape) {
+            ObjectShape* next = shape->next;
+            free(shape->keys);
+            free(shape->columns);
+            free(shape);
+            shape = next;
         }
-        table = table->next;
     }
+    free(sink->roles);
+    free(sink->cells);
+    row_ids_free(&sink->ids);
+}
 
-    // Create new table if not found
-    table = (TableSchema*)malloc(sizeof(TableSchema));
-    if (!table) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+// Sets the job's error, unless an earlier failure already did.
+static void write_failed(WriteJob* job, const char* file_name) {
+    if (!job->failed) {
+        job->failed = 1;
+        csv_output_error(&job->error, file_name);
     }
+}
 
-    table->name = strdup(name);
-    table->columns = NULL;
-    table->column_count = 0;
-    table->parent = NULL;
-    table->kind = TABLE_OBJECT;  // default; overwritten in analyze_node
-    table->next = context->tables;
-    context->tables = table;
-
-    return table;
+// Returns 1 if the job writes the table.
+static int job_writes(const WriteJob* job, const TableSchema* table) {
+    return !job->table_workers || job->table_workers[table->index] == job->worker;
 }
 
-// Adds a column to a TableSchema if it doesn't already exist.
-// Column names are duplicated to ensure they have their own memory.
-static void add_column(TableSchema* table, const char* column) {
-    // Check if column already exists
-    for (int i = 0; i < table->column_count; i++) {
-        if (strcmp(table->columns[i], column) == 0) {
-            return;  // Column already exists
+// Resolves how each of a sink's columns is filled, before its first row.
+static void init_sink_columns(TableSink* sink) {
+    TableSchema* t = sink->schema;
+    sink->active = 1;
+    sink->roles = (ColumnRole*)malloc((t->column_count + 1) * sizeof(ColumnRole));
+    sink->cells = (ASTNode**)calloc(t->column_count + 1, sizeof(ASTNode*));
+    if (!sink->roles || !sink->cells) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < t->column_count; i++) {
+        const char* col_name = t->columns[i];
+        if (strcmp(col_name, "id") == 0) {
+            sink->roles[i] = COLUMN_ID;
+        } else if (strcmp(col_name, "seq") == 0 || strcmp(col_name, "index") == 0) {
+            sink->roles[i] = COLUMN_POSITION;
+        } else if (strcmp(col_name, "value") == 0) {
+            sink->roles[i] = COLUMN_VALUE;
+        } else {
+            sink->roles[i] = COLUMN_DATA;
         }
     }
+}
 
-    // Add new column
-    table->column_count++;
-    table->columns = (char**)realloc(table->columns, table->column_count * sizeof(char*));
-    if (!table->columns) {
+// One walk of the data pass, writing the job's tables from the first-th (in creation
+// order) to the one before first + open_limit, all in a single traversal of the AST.
+// Tables owned by other workers or groups get no stream, so their rows are skipped, but
+// their ID bookkeeping still runs. A typing job opens nothing and types every table.
+static void write_table_group(WriteJob* job, int first) {
+    SchemaContext* context = job->context;
+    const Json2RelCsvSink* output = job->sink;
+
+    WriteContext wc;
+    wc.context = context;
+    wc.counter.next_id = context->first_id; // 1, as in analyze_node, unless appending
+    wc.counter.version = 0;
+    wc.sink_slots = NULL;
+    wc.sink_slot_capacity = 0;
+    wc.sink_slot_count = 0;
+    wc.typing = job->typing;
+    wc.sinks = (TableSink*)calloc(context->table_count > 0 ? context->table_count : 1, sizeof(TableSink));
+    if (!wc.sinks) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
-    table->columns[table->column_count - 1] = strdup(column);
-}
+    // Open every table's stream (of this group) up front and write its header row.
+    int rank = 0;
+    for (TableSchema* t = context->tables; t; t = t->next) {
+        TableSink* sink = &wc.sinks[t->index];
+        sink->schema = t;
+        if (job->typing) {
+            init_sink_columns(sink);
+            continue;
+        }
+        if (!job_writes(job, t)) {
+            continue;
+        }
+        rank++;
+        if (rank <= first || rank > first + job->open_limit) {
+            continue;
+        }
+
+        char* file_name = get_csv_file_name(t->name);
+        sink->stream = output->open(output->ctx, file_name);
+        if (!sink->stream) {
+            // Fails the conversion; rows for this table are dropped, but its ID
+            // bookkeeping still runs.
+            write_failed(job, file_name);
+            free(file_name);
+            continue;
+        }
+        free(file_name);
+        csv_buffer_init(&sink->out, output, sink->stream);
+        init_sink_columns(sink);
 
-// Ensures that the specified directory exists. If not, it attempts to create it.
-// Handles basic cases like empty or "." for current directory.
-static void ensure_directory_exists(const char* dir) {
-    if (!dir || strcmp(dir, "") == 0 || strcmp(dir, ".") == 0) {
-        return;  // Current directory
+        for (int i = 0; i < t->column_count; i++) {
+            csv_buffer_append(&sink->out, t->columns[i], strlen(t->columns[i]));
+            if (i < t->column_count - 1) {
+                csv_buffer_putc(&sink->out, ',');
+            }
+        }
+        csv_buffer_putc(&sink->out, '\n');
     }
 
-    // Use system-dependent directory creation
-    #ifdef _WIN32
-    _mkdir(dir);
-    #else
-    mkdir(dir, 0755);
-    #endif
+    // Populate data rows for all tables with one traversal of the AST.
+    ParentRef no_parent = {NULL, 0, 0};
+    Symbol key = root_key();
+    recursively_write_table_data(&wc, job->root, &key, &no_parent, 0);
+
+    for (int i = 0; i < context->table_count; i++) {
+        if (wc.sinks[i].stream) {
+            if (csv_buffer_close(&wc.sinks[i].out) != 0) {
+                char* file_name = get_csv_file_name(wc.sinks[i].schema->name);
+                write_failed(job, file_name);
+                free(file_name);
+            }
+            wc.sinks[i].schema->bytes_written = wc.sinks[i].out.flushed;
+        }
+        free_sink(&wc.sinks[i]);
+    }
+    free(wc.sinks);
+    free(wc.sink_slots);
 }
 
-// Constructs the full file path for a CSV file (e.g., "output_dir/table_name.csv").
-// Handles cases where output_dir is empty or ".".
-static char* get_csv_file_path(const char* dir, const char* table_name) {
-    size_t len = strlen(dir) + strlen(table_name) + 6;  // +6 for "/" + ".csv" + null terminator
-    char* path = (char*)malloc(len);
-    if (!path) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+// Writes the job's tables, open_limit at a time.
+static void write_tables(WriteJob* job) {
+    int count = 0;
+    for (TableSchema* t = job->context->tables; t; t = t->next) {
+        count += job_writes(job, t);
     }
-
-    if (strcmp(dir, "") == 0 || strcmp(dir, ".") == 0) {
-        snprintf(path, len, "%s.csv", table_name);
-    } else {
-        snprintf(path, len, "%s/%s.csv", dir, table_name);
+    for (int first = 0; first < count; first += job->open_limit) {
+        write_table_group(job, first);
     }
+}
 
-    return path;
+static void* write_tables_thread(void* arg) {
+    write_tables((WriteJob*)arg);
+    return NULL;
 }
 
-// Writes an ASTNode's scalar value to the CSV file, applying appropriate formatting.
-// Strings are quoted and internal quotes are escaped.
-// Null values result in an empty field.
-static void write_csv_value(FILE* file, ASTNode* node) {
-    if (!node) {
-        // Empty field for NULL
-        return;
+// Writes one CSV per discovered table to the sink. With threads > 1, the tables are split between
+// that many workers that run concurrently over the read-only AST; every table is still
+// written by exactly one of them, with the same contents as a single-threaded run.
+// At most MAX_OPEN_TABLES tables are open at once; a document with more takes another
+// walk of the AST per group.
+// - context: The SchemaContext containing all discovered table schemas.
+// - sink: Where the CSV tables go.
+// - ast_root: The root of the AST, needed for the data pass.
+// - threads: The number of writers to use.
+// - error: Receives the first table the sink failed, if any (may be NULL).
+// Returns 0, or -1 if the sink failed a table (every table is still attempted).
+int write_csv_files(SchemaContext* context, const Json2RelCsvSink* sink, ASTNode* ast_root, int threads,
+                    Json2RelCsvError* error) {
+    if (threads > context->table_count) {
+        threads = context->table_count;
     }
-
-    switch (node->type) {
-        case NODE_STRING: {
-            // Quote and escape strings
-            fprintf(file, "\"");
-            char* str = node->value.string;
-            while (*str) {
-                if (*str == '"') {
-                    fprintf(file, "\"\"");  // Double quotes for escaping
-                } else {
-                    fputc(*str, file);
-                }
-                str++;
-            }
-            fprintf(file, "\"");
-            break;
+    if (threads <= 1) {
+        WriteJob job;
+        memset(&job, 0, sizeof(job));
+        job.context = context;
+        job.sink = sink;
+        job.root = ast_root;
+        job.open_limit = MAX_OPEN_TABLES;
+        write_tables(&job);
+        if (job.failed && error) {
+            *error = job.error;
         }
-        case NODE_NUMBER:
-            fprintf(file, "%g", node->value.number);
-            break;
-        case NODE_BOOLEAN:
-            fprintf(file, "%s", node->value.boolean ? "true" : "false");
-            break;
-        case NODE_NULL:
-            // Empty field for NULL
-            break;
-        default:
-            // Complex types (objects/arrays) should not be written directly as CSV cell values.
-            // They are expanded into separate tables or their scalar contents are extracted.
-            fprintf(stderr, "Warning: Complex type encountered in CSV cell\n");
-            break;
+        return job.failed ? -1 : 0;
     }
-}
 
-// (Potentially unused) Helper function to check if two JSON objects (represented by KeyValueLists)
-// have the same set of keys. Order of keys does not matter.
-static int has_same_keys(KeyValueList* list1, KeyValueList* list2) {
-    // Count keys in first list
-    int count1 = 0;
-    KeyValueList* temp1 = list1;
-    while (temp1) {
-        count1++;
-        temp1 = temp1->next;
+    // Balance the estimated output (rows x columns) across workers: largest tables
+    // first, each to the least loaded worker so far.
+    int table_count = context->table_count;
+    int* table_workers = (int*)malloc(table_count * sizeof(int));
+    TableSchema** by_size = (TableSchema**)malloc(table_count * sizeof(TableSchema*));
+    long* loads = (long*)calloc(threads, sizeof(long));
+    WriteJob* jobs = (WriteJob*)malloc(threads * sizeof(WriteJob));
+    pthread_t* workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    int* started = (int*)calloc(threads, sizeof(int));
+    if (!table_workers || !by_size || !loads || !jobs || !workers || !started) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
     }
 
-    // Count keys in second list
-    int count2 = 0;
-    KeyValueList* temp2 = list2;
-    while (temp2) {
-        count2++;
-        temp2 = temp2->next;
+    for (TableSchema* t = context->tables; t; t = t->next) {
+        by_size[t->index] = t;
+    }
+    for (int i = 1; i < table_count; i++) {
+        // Insertion sort by decreasing cost; ties keep creation order.
+        TableSchema* t = by_size[i];
+        long cost = (t->row_estimate + 1) * t->column_count;
+        int j = i - 1;
+        while (j >= 0 && (by_size[j]->row_estimate + 1) * by_size[j]->column_count < cost) {
+            by_size[j + 1] = by_size[j];
+            j--;
+        }
+        by_size[j + 1] = t;
+    }
+    for (int i = 0; i < table_count; i++) {
+        int lightest = 0;
+        for (int w = 1; w < threads; w++) {
+            if (loads[w] < loads[lightest]) lightest = w;
+        }
+        table_workers[by_size[i]->index] = lightest;
+        loads[lightest] += (by_size[i]->row_estimate + 1) * by_size[i]->column_count;
     }
 
-    // If counts differ, keys are different
-    if (count1 != count2) return 0;
+    for (int w = 0; w < threads; w++) {
+        memset(&jobs[w], 0, sizeof(WriteJob));
+        jobs[w].context = context;
+        jobs[w].sink = sink;
+        jobs[w].root = ast_root;
+        jobs[w].table_workers = table_workers;
+        jobs[w].worker = w;
+        jobs[w].open_limit = MAX_OPEN_TABLES / threads > 0 ? MAX_OPEN_TABLES / threads : 1;
+    }
+    // Worker 0 runs on this thread. If a thread cannot be started (e.g. a build
+    // without thread support), its share is written here afterwards.
+    for (int w = 1; w < threads; w++) {
+        started[w] = pthread_create(&workers[w], NULL, write_tables_thread, &jobs[w]) == 0;
+    }
+    write_tables(&jobs[0]);
+    for (int w = 1; w < threads; w++) {
+        if (started[w]) {
+            pthread_join(workers[w], NULL);
+        } else {
+            write_tables(&jobs[w]);
+        }
+    }
 
-    // Check each key in list1 exists in list2
-    temp1 = list1;
-    while (temp1) {
-        int found = 0;
-        temp2 = list2;
-        while (temp2) {
-            if (strcmp(temp1->pair->key, temp2->pair->key) == 0) {
-                found = 1;
-                break;
+    // Report the first worker's failure, so the error does not depend on timing.
+    int result = 0;
+    for (int w = 0; w < threads && result == 0; w++) {
+        if (jobs[w].failed) {
+            if (error) {
+                *error = jobs[w].error;
             }
-            temp2 = temp2->next;
+            result = -1;
         }
-
-        if (!found) return 0;
-        temp1 = temp1->next;
     }
 
-    return 1;
+    free(started);
+    free(workers);
+    free(jobs);
+    free(loads);
+    free(by_size);
+    free(table_workers);
+    return result;
+}
+
+// Adds to each column's types in 'context' those of the values write_csv_files() writes
+// there: one more walk of the data pass that records rows instead of writing them. It
+// reaches what the schema pass does not (arrays nested directly in arrays, for one), so
+// a format that fixes its column types before the first row (pgcopy) can rely on them.
+void type_csv_files(SchemaContext* context, ASTNode* ast_root) {
+    WriteJob job;
+    memset(&job, 0, sizeof(job));
+    job.context = context;
+    job.root = ast_root;
+    job.typing = 1;
+    write_table_group(&job, 0);
 }
 
-// Converts a string into a "safe" filename by replacing non-alphanumeric characters (except '_') with '_'.
-// If the input name is NULL or empty, defaults to "unnamed".
-static char* safe_filename(const char* name) {
-    if (!name || strcmp(name, "") == 0) {
-        return strdup("unnamed");
+// Writes one row of a table. 'item' is the object forming the row, or for an array item
+// row (an element of an array whose key names a table) the element itself. Columns are
+// filled, in order of precedence: 'id', the parent FK, 'seq'/'index' for array items,
+// the object's scalar members, and 'value' for scalar array items. Anything else
+// (an optional field, or an FK to a different parent) is left empty.
+static void write_row(TableSink* sink, ASTNode* item, int is_array_item, int row_id, int seq,
+                      const ParentRef* parent) {
+    TableSchema* schema = sink->schema;
+    CsvBuffer* out = &sink->out;
+    int fk_column = parent->key ? get_fk_column(sink, parent->key) : -1;
+
+    // Scatter the object's scalar members into their column slots.
+    ObjectShape* shape = NULL;
+    if (item->type == NODE_OBJECT) {
+        KeyValueList* kv_list = item->value.object;
+        shape = get_object_shape(sink, kv_list);
+        for (size_t i = 0; i < kv_list->count; i++) {
+            ASTNode* value = kv_list->pairs[i].value;
+            if (shape->columns[i] >= 0 && value->type != NODE_OBJECT && value->type != NODE_ARRAY) {
+                sink->cells[shape->columns[i]] = value;
+            }
+        }
     }
 
-    // Make a copy we can modify
-    char* result = strdup(name);
+    for (int i = 0; i < schema->column_count; i++) {
+        ColumnRole role = sink->roles[i];
+
+        if (role == COLUMN_ID) {
+            csv_buffer_append_int(out, row_id);
+        } else if (i == fk_column) {
+            csv_buffer_append_int(out, row_ids_parent_id(&sink->ids, parent));
+        } else if (is_array_item && role == COLUMN_POSITION) {
+            csv_buffer_append_int(out, seq);
+        } else if (shape) {
+            if (sink->cells[i]) {
+                csv_buffer_append_value(out, sink->cells[i]);
+            }
+        } else if (is_array_item && role == COLUMN_VALUE) {
+            // Array of scalars, for "value" column in junction table
+            csv_buffer_append_value(out, item);
+        }
 
-    // Replace special characters
-    for (char* p = result; *p; p++) {
-        if (!isalnum(*p) && *p != '_') {
-            *p = '_';
+        if (i < schema->column_count - 1) {
+            csv_buffer_putc(out, ',');
         }
     }
+    csv_buffer_putc(out, '\n');
+    STATS_ADD(schema->rows_written, 1);
+    if (row_id > schema->last_id) {
+        schema->last_id = row_id;
+    }
 
-    return result;
+    if (shape) {
+        KeyValueList* kv_list = item->value.object;
+        for (size_t i = 0; i < kv_list->count; i++) {
+            if (shape->columns[i] >= 0) {
+                sink->cells[shape->columns[i]] = NULL;
+            }
+        }
+    }
 }
 
-// Writes a JSON-escaped string (handles ", \, and control chars) to file.
-static void write_json_escaped_string(FILE* f, const char* s) {
-    fputc('"', f);
-    for (; *s; s++) {
-        if (*s == '"') {
-            fputs("\\\"", f);
-        } else if (*s == '\\') {
-            fputs("\\\\", f);
-        } else if ((unsigned char)*s < 0x20) {
-            // Control characters must be \u-escaped for valid JSON (RFC 8259).
-            fprintf(f, "\\u%04x", (unsigned char)*s);
-        } else {
-            fputc(*s, f);
+// Records the types of what write_row() writes for a row, with the same precedence:
+// IDs and positions are integers, then each member (or scalar item) has its own type.
+static void type_row(TableSink* sink, ASTNode* item, int is_array_item, const ParentRef* parent) {
+    ColumnStats* stats = sink->schema->column_stats;
+    int fk_column = parent->key ? get_fk_column(sink, parent->key) : -1;
+    for (int i = 0; i < sink->schema->column_count; i++) {
+        ColumnRole role = sink->roles[i];
+        if (role == COLUMN_ID || i == fk_column || (is_array_item && role == COLUMN_POSITION)) {
+            stats[i].types |= COLUMN_TYPE_INT;
+        } else if (is_array_item && role == COLUMN_VALUE && item->type != NODE_OBJECT) {
+            stats[i].types |= ast_scalar_type(item);
         }
     }
-    fputc('"', f);
-}
 
-// Analyzes root and writes schema.json describing the inferred relational schema.
-void emit_schema_json(ASTNode* root, const char* output_dir) {
-    SchemaContext context = {NULL, 1};
-    build_schema(root, &context);
+    if (item->type == NODE_OBJECT) {
+        KeyValueList* kv_list = item->value.object;
+        ObjectShape* shape = get_object_shape(sink, kv_list);
+        for (size_t i = 0; i < kv_list->count; i++) {
+            int column = shape->columns[i];
+            if (column >= 0 && sink->roles[column] != COLUMN_ID && column != fk_column &&
+                !(is_array_item && sink->roles[column] == COLUMN_POSITION)) {
+                stats[column].types |= ast_scalar_type(kv_list->pairs[i].value);
+            }
+        }
+    }
+}
 
-    // Build output path: "<output_dir>/schema.json", or just "schema.json" for "" / "."
-    char schema_path[4096];
-    if (!output_dir || strcmp(output_dir, "") == 0 || strcmp(output_dir, ".") == 0) {
-        snprintf(schema_path, sizeof(schema_path), "schema.json");
+// Writes a row to its table's CSV, or in a typing walk records its types.
+static void emit_row(const WriteContext* wc, TableSink* sink, ASTNode* item, int is_array_item, int row_id,
+                     int seq, const ParentRef* parent) {
+    if (wc->typing) {
+        type_row(sink, item, is_array_item, parent);
     } else {
-        snprintf(schema_path, sizeof(schema_path), "%s/schema.json", output_dir);
+        write_row(sink, item, is_array_item, row_id, seq, parent);
     }
+}
 
-    ensure_directory_exists(output_dir);
-
-    FILE* f = fopen(schema_path, "w");
-    if (!f) {
-        fprintf(stderr, "Error: Could not open %s for writing\n", schema_path);
-        free_schema(&context);
+// Recursively traverses the AST once, routing each row to the sink of the table it belongs to.
+// Row IDs follow the per-table numbering described in row_ids.h.
+//
+// - wc: Shared write state (sinks, base ID counter).
+// - current_ast_node: The AST node currently being visited.
+// - current_node_key: The JSON key that led to current_ast_node.
+// - parent: The logical parent row (used for naming FK columns and for FK values).
+// - is_array_item_row: Set for objects already written as an element row of their array's table.
+static void recursively_write_table_data(WriteContext* wc, ASTNode* current_ast_node,
+                                         const Symbol* current_node_key, const ParentRef* parent,
+                                         int is_array_item_row) {
+    if (!current_ast_node) {
         return;
     }
 
-    // Count tables for pretty printing
-    int table_count = 0;
-    for (TableSchema* t = context.tables; t; t = t->next) {
-        table_count++;
-    }
+    if (current_ast_node->type == NODE_OBJECT) {
+        // Every object consumes an ID, same as in analyze_node.
+        int base_id = wc->counter.next_id++;
+
+        // Write the object as a row if its key names a table.
+        if (!is_array_item_row) {
+            TableSink* sink = find_sink(wc, current_node_key);
+            if (sink && !sink->ids.excluded && sink->active) {
+                emit_row(wc, sink, current_ast_node, 0, base_id + sink->ids.delta, 0, parent);
+            }
+        }
 
-    fprintf(f, "{\n  \"tables\": [\n");
+        // The current object's key and ID become parent info for its children.
+        ParentRef self = {current_node_key->table_name, base_id, wc->counter.version};
+        KeyValueList* kv_list_children = current_ast_node->value.object;
+        for (size_t i = 0; i < kv_list_children->count; i++) {
+            recursively_write_table_data(wc, kv_list_children->pairs[i].value, kv_list_children->pairs[i].key,
+                                         &self, 0);
+        }
 
-    int table_idx = 0;
-    TableSchema* t = context.tables;
-    while (t) {
-        fprintf(f, "    {");
+    } else if (current_ast_node->type == NODE_ARRAY) {
+        ASTNodeList* el_list = current_ast_node->value.array;
 
-        // name
-        fprintf(f, " \"name\": ");
-        write_json_escaped_string(f, t->name);
+        // Check if this array's items are rows of a table.
+        TableSink* sink = find_sink(wc, current_node_key);
+        if (sink && sink->ids.excluded) {
+            sink = NULL;
+        }
 
-        // kind
-        const char* kind_str = (t->kind == TABLE_ARRAY) ? "array"
-                             : (t->kind == TABLE_JUNCTION) ? "junction"
-                             : "object";
-        fprintf(f, ", \"kind\": \"%s\"", kind_str);
+        // seq: position of the element within the array.
+        for (int seq = 0; seq < (int)el_list->count; seq++) {
+            ASTNode* array_item = el_list->items[seq];
 
-        // primaryKey (always "id")
-        fprintf(f, ", \"primaryKey\": \"id\"");
+            if (sink) {
+                int item_id = wc->counter.next_id + sink->ids.delta;
+                if (sink->active) {
+                    emit_row(wc, sink, array_item, 1, item_id, seq, parent);
+                }
 
-        // parent
-        fprintf(f, ", \"parent\": ");
-        if (t->parent) {
-            write_json_escaped_string(f, t->parent);
-        } else {
-            fprintf(f, "null");
+                if (array_item->type == NODE_OBJECT) {
+                    // The object itself takes the next base ID; shift this table's offset so
+                    // that ID maps back to item_id, then recurse for the object's children.
+                    row_ids_set_delta(&wc->counter, &sink->ids, sink->ids.delta - 1);
+                    wc->counter.next_id++;
+                    recursively_write_table_data(wc, array_item, current_node_key, parent, 1);
+                } else if (array_item->type == NODE_ARRAY) {
+                    // This table's own walk never descended into nested arrays, but other
+                    // tables' walks did. Hide the subtree from this table, then discount
+                    // the IDs it consumed.
+                    int base_before = wc->counter.next_id;
+                    sink->ids.excluded++;
+                    recursively_write_table_data(wc, array_item, current_node_key, parent, 0);
+                    sink->ids.excluded--;
+                    row_ids_set_delta(&wc->counter, &sink->ids,
+                                      sink->ids.delta + 1 - (wc->counter.next_id - base_before));
+                } else {
+                    row_ids_set_delta(&wc->counter, &sink->ids, sink->ids.delta + 1);
+                }
+            } else {
+                // Not a table's rows, but the elements may contain rows of other tables.
+                // Object elements consume an extra ID, as the per-table walk always did.
+                // The parent context remains that of the object that contains this array.
+                if (array_item->type == NODE_OBJECT) {
+                    wc->counter.next_id++;
+                }
+                recursively_write_table_data(wc, array_item, current_node_key, parent, 0);
+            }
         }
+    }
+    // Scalar nodes (strings, numbers, etc.) do not directly form rows; their values are extracted
+    // when processing their parent object or array. No direct action for them here.
+}
 
-        // foreignKey
-        fprintf(f, ", \"foreignKey\": ");
-        if (t->parent) {
-            char fk_buf[512];
-            snprintf(fk_buf, sizeof(fk_buf), "%s_id", t->parent);
-            write_json_escaped_string(f, fk_buf);
-        } else {
-            fprintf(f, "null");
-        }
+// (Potentially unused) Helper function to check if two JSON objects (represented by KeyValueLists)
+// have the same set of keys. Order of keys does not matter.
+static int has_same_keys(KeyValueList* list1, KeyValueList* list2) {
+    // If counts differ, keys are different
+    if (list1->count != list2->count) return 0;
 
-        // columns array (preserving insertion order)
-        fprintf(f, ", \"columns\": [");
-        for (int i = 0; i < t->column_count; i++) {
-            write_json_escaped_string(f, t->columns[i]);
-            if (i < t->column_count - 1) {
-                fprintf(f, ", ");
+    // Check each key in list1 exists in list2
+    for (size_t i = 0; i < list1->count; i++) {
+        int found = 0;
+        for (size_t j = 0; j < list2->count; j++) {
+            if (symbol_equal(list1->pairs[i].key, list2->pairs[j].key)) {
+                found = 1;
+                break;
             }
         }
-        fprintf(f, "] }");
 
-        table_idx++;
-        if (table_idx < table_count) {
-            fprintf(f, ",");
-        }
-        fprintf(f, "\n");
-
-        t = t->next;
+        if (!found) return 0;
     }
 
-    fprintf(f, "  ]\n}\n");
-    fclose(f);
-
-    free_schema(&context);
-}
\ No newline at end of file
+    return 1;
+}
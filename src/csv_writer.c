@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "csv_writer.h"
+#include "stats.h"
+
+// Size of a sink-bound buffer. Large enough that the sink sees a few big writes per table.
+#define CSV_SINK_BUFFER_SIZE (64 * 1024)
+
+void csv_buffer_init(CsvBuffer* buffer, const Json2RelCsvSink* sink, void* stream) {
+    buffer->sink = sink;
+    buffer->stream = stream;
+    buffer->flushed = 0;
+    buffer->failed = 0;
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->cap = 0;
+}
+
+// Allocates or resizes the storage to 'cap' bytes.
+static void csv_buffer_resize(CsvBuffer* buffer, size_t cap) {
+    buffer->data = (char*)realloc(buffer->data, cap);
+    if (!buffer->data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer->cap = cap;
+}
+
+void csv_buffer_reserve(CsvBuffer* buffer, size_t extra) {
+    if (buffer->cap - buffer->len >= extra) {
+        return;
+    }
+
+    if (buffer->sink) {
+        if (!buffer->data) {
+            csv_buffer_resize(buffer, CSV_SINK_BUFFER_SIZE);
+        }
+        csv_buffer_flush(buffer);
+        return;
+    }
+
+    size_t cap = buffer->cap ? buffer->cap * 2 : 256;
+    while (cap - buffer->len < extra) {
+        cap *= 2;
+    }
+    csv_buffer_resize(buffer, cap);
+}
+
+// Hands bytes to the sink, unless an earlier write failed.
+static void sink_write(CsvBuffer* buffer, const char* bytes, size_t len) {
+    if (buffer->failed) {
+        return;
+    }
+    if (buffer->sink->write(buffer->sink->ctx, buffer->stream, bytes, len) != 0) {
+        buffer->failed = 1;
+        return;
+    }
+    STATS_ADD(buffer->flushed, len);
+}
+
+void csv_buffer_flush(CsvBuffer* buffer) {
+    if (buffer->sink && buffer->len > 0) {
+        sink_write(buffer, buffer->data, buffer->len);
+    }
+    if (buffer->sink) {
+        buffer->len = 0;
+    }
+}
+
+void csv_buffer_free(CsvBuffer* buffer) {
+    csv_buffer_flush(buffer);
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->len = buffer->cap = 0;
+}
+
+int csv_buffer_close(CsvBuffer* buffer) {
+    csv_buffer_free(buffer);
+    if (buffer->sink->close(buffer->sink->ctx, buffer->stream) != 0) {
+        buffer->failed = 1;
+    }
+    return buffer->failed ? -1 : 0;
+}
+
+void csv_output_error(Json2RelCsvError* error, const char* name) {
+    if (error) {
+        error->line = 0;
+        error->column = 0;
+        snprintf(error->message, sizeof(error->message), "Could not write the output %.120s.", name);
+    }
+}
+
+void csv_buffer_append_slow(CsvBuffer* buffer, const void* bytes, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    csv_buffer_reserve(buffer, len);
+    if (buffer->cap - buffer->len < len) {
+        // Bigger than the whole buffer: bypass it (it was just flushed).
+        sink_write(buffer, (const char*)bytes, len);
+        return;
+    }
+    memcpy(buffer->data + buffer->len, bytes, len);
+    buffer->len += len;
+}
+
+void csv_buffer_append_int(CsvBuffer* buffer, int value) {
+    char digits[12];
+    int count = 0;
+    // Negate in unsigned arithmetic so INT_MIN is safe.
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    csv_buffer_reserve(buffer, (size_t)count + 1);
+    char* out = buffer->data + buffer->len;
+    if (value < 0) {
+        *out++ = '-';
+    }
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    buffer->len = (size_t)(out - buffer->data);
+}
+
+void csv_buffer_append_quoted(CsvBuffer* buffer, const char* str) {
+    const char* end = str + strlen(str);
+
+    csv_buffer_putc(buffer, '"');
+    // Copy quote-free runs in bulk; each embedded quote is copied and then doubled.
+    const char* quote;
+    while ((quote = (const char*)memchr(str, '"', (size_t)(end - str))) != NULL) {
+        csv_buffer_append(buffer, str, (size_t)(quote - str) + 1);
+        csv_buffer_putc(buffer, '"');
+        str = quote + 1;
+    }
+    csv_buffer_append(buffer, str, (size_t)(end - str));
+    csv_buffer_putc(buffer, '"');
+}
+
+void csv_buffer_append_value(CsvBuffer* buffer, const ASTNode* node) {
+    if (!node) {
+        // Empty field for NULL
+        return;
+    }
+
+    switch (node->type) {
+        case NODE_STRING:
+            csv_buffer_append_quoted(buffer, node->value.string);
+            break;
+        case NODE_NUMBER:
+            // The source lexeme, so no digits are lost to formatting.
+            csv_buffer_append(buffer, node->value.number, strlen(node->value.number));
+            break;
+        case NODE_BOOLEAN:
+            if (node->value.boolean) {
+                csv_buffer_append(buffer, "true", 4);
+            } else {
+                csv_buffer_append(buffer, "false", 5);
+            }
+            break;
+        case NODE_NULL:
+            // Empty field for NULL
+            break;
+        default:
+            // Complex types (objects/arrays) should not be written directly as CSV cell values.
+            // They are expanded into separate tables or their scalar contents are extracted.
+            fprintf(stderr, "Warning: Complex type encountered in CSV cell\n");
+            break;
+    }
+}
@@ -0,0 +1,87 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include "input.h"
+
+int input_map_file(const char* path, MappedInput* input) {
+    input->data = NULL;
+    input->size = 0;
+    input->mapped_size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    // Room for the two trailing NULs, rounded up to whole pages.
+    size_t mapped_size = (size + 2 + page_size - 1) / page_size * page_size;
+
+    // Reserve zeroed anonymous memory for the whole range first, then map the file
+    // over its start. The tail of the file's last page is zero-filled by the kernel
+    // and any page past it stays anonymous, so the terminators are always readable,
+    // even when the file size is an exact multiple of the page size.
+    char* base = (char*)mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (size > 0 &&
+        mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, mapped_size);
+        close(fd);
+        return -1;
+    }
+    close(fd); // The mapping keeps the file referenced.
+
+#ifdef MADV_SEQUENTIAL
+    madvise(base, mapped_size, MADV_SEQUENTIAL); // The lexer reads front to back once.
+#endif
+
+    input->data = base;
+    input->size = size;
+    input->mapped_size = mapped_size;
+    return 0;
+}
+
+void input_unmap(MappedInput* input) {
+    if (input->data) {
+        munmap(input->data, input->mapped_size);
+    }
+    input->data = NULL;
+    input->size = 0;
+    input->mapped_size = 0;
+}
+
+char* input_read_stream(FILE* file, size_t* size) {
+    size_t capacity = 1 << 20;
+    size_t length = 0;
+    char* data = (char*)malloc(capacity);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t n;
+    while ((n = fread(data + length, 1, capacity - length, file)) > 0) {
+        length += n;
+        if (length == capacity) {
+            capacity *= 2;
+            data = (char*)realloc(data, capacity);
+            if (!data) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    *size = length;
+    return data;
+}
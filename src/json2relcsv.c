@@ -0,0 +1,1240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "json2relcsv.h"
+#include "ast.h"
+#include "columnar.h"
+#include "compress.h"
+#include "csv_writer.h"
+#include "input.h"
+#include "json_parser.h"
+#include "ndjson.h"
+#include "pgcopy.h"
+#include "stream_gen.h"
+
+// Fills in 'error' (if the caller asked for it).
+static void set_error(Json2RelCsvError* error, int line, int column, const char* message) {
+    if (!error) {
+        return;
+    }
+    error->line = line;
+    error->column = column;
+    snprintf(error->message, sizeof(error->message), "%s", message);
+}
+
+// --- Stats ---
+
+// Wall-clock and CPU readings at the start of a phase.
+typedef struct PhaseClock {
+    double wall;
+    double cpu;
+} PhaseClock;
+
+static double read_clock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static PhaseClock phase_start(void) {
+    PhaseClock start;
+    start.wall = read_clock(CLOCK_MONOTONIC);
+    start.cpu = read_clock(CLOCK_PROCESS_CPUTIME_ID);
+    return start;
+}
+
+// Records the time since 'start' in 'phase' (if stats were requested).
+static void phase_end(PhaseClock start, Json2RelCsvPhase* phase) {
+    if (!phase) {
+        return;
+    }
+    phase->wall_seconds = read_clock(CLOCK_MONOTONIC) - start.wall;
+    phase->cpu_seconds = read_clock(CLOCK_PROCESS_CPUTIME_ID) - start.cpu;
+}
+
+// Copies the token counts and every table's output totals into 'stats'.
+static void collect_stats(Json2RelCsvStats* stats, const JsonTokenCounts* tokens, const SchemaContext* context) {
+    stats->punctuation_tokens = tokens->punctuation;
+    stats->string_tokens = tokens->strings;
+    stats->escaped_string_tokens = tokens->escaped_strings;
+    stats->number_tokens = tokens->numbers;
+    stats->literal_tokens = tokens->literals;
+    stats->tokens = tokens->punctuation + tokens->strings + tokens->numbers + tokens->literals;
+
+    stats->table_count = context->table_count;
+    stats->tables = (Json2RelCsvTableStats*)calloc(context->table_count > 0 ? context->table_count : 1,
+                                                   sizeof(Json2RelCsvTableStats));
+    if (!stats->tables) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (TableSchema* t = context->tables; t; t = t->next) {
+        Json2RelCsvTableStats* table = &stats->tables[t->index];
+        table->name = strdup(t->name);
+        table->rows = t->rows_written;
+        table->bytes = t->bytes_written;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    stats->peak_rss_kb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    stats->peak_rss_kb = usage.ru_maxrss;        // KiB on Linux
+#endif
+#ifdef JSON2RELCSV_STATS
+    stats->counters_enabled = 1;
+#endif
+}
+
+void json2relcsv_stats_free(Json2RelCsvStats* stats) {
+    for (int i = 0; i < stats->table_count; i++) {
+        free(stats->tables[i].name);
+    }
+    free(stats->tables);
+    stats->tables = NULL;
+    stats->table_count = 0;
+}
+
+// --- Schema-first conversion ---
+
+struct Json2RelCsvSchema {
+    SchemaContext context;
+};
+
+Json2RelCsvSchema* json2relcsv_schema_parse(const char* data, size_t size, Json2RelCsvError* error) {
+    Json2RelCsvSchema* schema = (Json2RelCsvSchema*)malloc(sizeof(Json2RelCsvSchema));
+    if (!schema) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    schema->context = schema_context_init();
+
+    Json2RelCsvError load_error;
+    if (read_schema_json(data ? data : "", data ? size : 0, &schema->context, &load_error) != 0) {
+        set_error(error, load_error.line, load_error.column, load_error.message);
+        json2relcsv_schema_free(schema);
+        return NULL;
+    }
+    return schema;
+}
+
+Json2RelCsvSchema* json2relcsv_schema_load(const char* path, Json2RelCsvError* error) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        char message[160];
+        snprintf(message, sizeof(message), "Could not open schema file %s", path);
+        set_error(error, 0, 0, message);
+        return NULL;
+    }
+    size_t size = 0;
+    char* text = input_read_stream(file, &size);
+    fclose(file);
+
+    Json2RelCsvSchema* schema = json2relcsv_schema_parse(text, size, error);
+    free(text);
+    return schema;
+}
+
+void json2relcsv_schema_free(Json2RelCsvSchema* schema) {
+    if (!schema) {
+        return;
+    }
+    free_schema(&schema->context);
+    free(schema);
+}
+
+// --- Conversion ---
+
+// Where the tables go: straight to the sink as CSV, or through the encoder of another
+// format (see Json2RelCsvFormat) in front of it.
+typedef struct TableOutput {
+    int format;
+    ColumnarSink columnar;
+    PgCopySink pgcopy;
+    Json2RelCsvSink encoder;
+    const Json2RelCsvSink* sink;  // what the tables are written to
+} TableOutput;
+
+// Sets up the output of the tables to 'sink' in 'format'. The encoders need the tables'
+// columns: those of 'context', which may be set later with table_output_set_context(),
+// but must be complete before the first table is written.
+static void table_output_init(TableOutput* output, int format, const Json2RelCsvSink* sink,
+                              const SchemaContext* context) {
+    output->format = format;
+    output->sink = sink;
+    if (format == JSON2RELCSV_FORMAT_COLUMNAR) {
+        output->encoder = columnar_sink(&output->columnar, sink, context);
+        output->sink = &output->encoder;
+    } else if (format == JSON2RELCSV_FORMAT_PGCOPY) {
+        output->encoder = pgcopy_sink(&output->pgcopy, sink, context);
+        output->sink = &output->encoder;
+    }
+}
+
+static void table_output_set_context(TableOutput* output, const SchemaContext* context) {
+    output->columnar.context = context;
+    output->pgcopy.context = context;
+}
+
+// Finishes the output once the tables are written ('written' is what writing them
+// returned): writes what the format adds after them (schema.sql for pgcopy) to 'sink'.
+// Returns -1 and fills 'error' if a table could not be encoded or written.
+static int table_output_finish(TableOutput* output, const SchemaContext* context, const Json2RelCsvSink* sink,
+                               int written, Json2RelCsvError* error) {
+    if (output->format == JSON2RELCSV_FORMAT_PGCOPY && output->pgcopy.error[0]) {
+        set_error(error, 0, 0, output->pgcopy.error);
+        return -1;
+    }
+    if (written != 0) {
+        return -1;
+    }
+    if (output->format != JSON2RELCSV_FORMAT_PGCOPY) {
+        return 0;
+    }
+    return write_schema_sql(context, sink, error);
+}
+
+static void table_output_free(TableOutput* output) {
+    if (output->format == JSON2RELCSV_FORMAT_PGCOPY) {
+        pgcopy_sink_destroy(&output->pgcopy);
+    }
+}
+
+// Converts the document with the streaming converter; the AST is never built. With a
+// schema, rows are written during the parse and nothing is inferred. With a base (see
+// convert_input()), inference extends it.
+static int run_stream(const JsonParseInput* input, const Json2RelCsvSink* sink, int emit_schema, int format,
+                      const Json2RelCsvSchema* schema, int drop_unknown, const SchemaContext* base,
+                      Json2RelCsvStats* stats, Json2RelCsvError* error) {
+    // The encoders of other formats need the tables' columns: those of the schema, or
+    // without one, known once the document is parsed.
+    TableOutput output;
+    table_output_init(&output, format, sink, schema ? &schema->context : NULL);
+
+    StreamConverter* converter = schema ? stream_converter_create_with_schema(&schema->context, drop_unknown,
+                                                                              output.sink)
+                               : base   ? stream_converter_create_from(base)
+                                        : stream_converter_create();
+    JsonEventHandler handler = stream_converter_handler(converter);
+
+    JsonTokenCounts tokens;
+    memset(&tokens, 0, sizeof(tokens));
+    JsonParseInput counted_input = *input;
+    counted_input.token_counts = &tokens;
+
+    PhaseClock clock = phase_start();
+    JsonParseError parse_error;
+    if (json_parse(&counted_input, &handler, &parse_error) != 0) {
+        set_error(error, parse_error.line, parse_error.column, parse_error.message);
+        stream_converter_free(converter);
+        table_output_free(&output);
+        return -1;
+    }
+    phase_end(clock, stats ? &stats->parse : NULL);
+
+    const char* unknown = stream_converter_unknown(converter);
+    if (unknown) {
+        set_error(error, 0, 0, unknown);
+        stream_converter_free(converter);
+        table_output_free(&output);
+        return -1;
+    }
+
+    clock = phase_start();
+    // pgcopy fixes each column's type before the first row, so without a schema its
+    // tables are typed by every value the rows hold, not only those inference saw.
+    const SchemaContext* output_context = schema ? &schema->context : stream_converter_schema(converter);
+    SchemaContext typed = schema_context_init();
+    if (!schema && format == JSON2RELCSV_FORMAT_PGCOPY) {
+        typed = schema_context_copy(output_context);
+        stream_converter_type_rows(converter, &typed);
+        output_context = &typed;
+    }
+    if (!schema) {
+        table_output_set_context(&output, output_context);
+    }
+    int written = stream_converter_finish(converter, output.sink, 0, error);
+    int result = table_output_finish(&output, output_context, sink, written, error);
+    table_output_free(&output);
+    free_schema(&typed);
+    phase_end(clock, stats ? &stats->write : NULL);
+
+    if (result == 0 && emit_schema) {
+        clock = phase_start();
+        result = write_schema_json(stream_converter_schema(converter), sink, error);
+        phase_end(clock, stats ? &stats->emit_schema : NULL);
+    }
+    if (result == 0 && base) {
+        result = write_state_json(stream_converter_schema(converter), sink, error);
+    }
+    if (result != 0) {
+        stream_converter_free(converter);
+        return -1;
+    }
+
+    if (stats) {
+        collect_stats(stats, &tokens, stream_converter_schema(converter));
+        stats->dropped_values = stream_converter_dropped(converter);
+    }
+
+    stream_converter_free(converter);
+
+    return 0;
+}
+
+// Builds the AST, then generates the CSVs (and schema.json) from it.
+// JSON Lines text in memory is parsed in 'threads' chunks concurrently (see ndjson.h).
+static int run_ast(const JsonParseInput* input, int print_ast_flag, const Json2RelCsvSink* sink, int emit_schema,
+                   int format, int threads, const SchemaContext* base, Json2RelCsvStats* stats,
+                   Json2RelCsvError* error) {
+    const char* text = input->in_place ? input->in_place : input->data;
+    int chunk_count = (input->records && text && threads > 1) ? threads : 1;
+
+    // Every node, list cell and string of the document is allocated from these arenas
+    // (one per parsing thread).
+    Arena* document_arenas = (Arena*)malloc(chunk_count * sizeof(Arena));
+    if (!document_arenas) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < chunk_count; i++) {
+        arena_init(&document_arenas[i]);
+    }
+
+    JsonTokenCounts tokens;
+    memset(&tokens, 0, sizeof(tokens));
+
+    PhaseClock clock = phase_start();
+    ASTNode* ast_root = NULL;
+    JsonParseError parse_error;
+    int parse_result;
+    if (chunk_count > 1) {
+        parse_result = ndjson_parse(text, input->size, chunk_count, document_arenas, &ast_root, &parse_error,
+                                    &tokens);
+    } else {
+        ASTBuilder builder;
+        ast_builder_init(&builder, &document_arenas[0]);
+        JsonEventHandler handler = ast_builder_handler(&builder);
+
+        // Run the Bison-generated parser, which feeds its events to the builder.
+        JsonParseInput counted_input = *input;
+        counted_input.token_counts = &tokens;
+        parse_result = json_parse(&counted_input, &handler, &parse_error);
+
+        // Only the scratch stacks go; the finished vectors live in the arena.
+        ast_root = builder.root;
+        ast_builder_free(&builder);
+    }
+    phase_end(clock, stats ? &stats->parse : NULL);
+
+    if (parse_result != 0 || !ast_root) {
+        if (parse_result != 0) {
+            set_error(error, parse_error.line, parse_error.column, parse_error.message);
+        } else {
+            set_error(error, 0, 0, "AST root is null after parsing, even though yyparse reported success.");
+        }
+        for (int i = 0; i < chunk_count; i++) {
+            arena_free(&document_arenas[i]);
+        }
+        free(document_arenas);
+        return -1;
+    }
+
+    if (print_ast_flag) {
+        print_ast(ast_root, 0);
+        printf("\n"); // Add a newline for cleaner output after AST print.
+    }
+
+    // The steps of generate_csv_tables(), timed one by one.
+    SchemaContext context = base ? schema_context_copy(base) : schema_context_init();
+    clock = phase_start();
+    build_schema(ast_root, &context);
+    phase_end(clock, stats ? &stats->schema : NULL);
+
+    clock = phase_start();
+    // pgcopy fixes each column's type before the first row, so its tables are typed by
+    // every value written, not only those the schema pass saw.
+    const SchemaContext* output_context = &context;
+    SchemaContext typed = schema_context_init();
+    if (format == JSON2RELCSV_FORMAT_PGCOPY) {
+        typed = schema_context_copy(&context);
+        type_csv_files(&typed, ast_root);
+        output_context = &typed;
+    }
+
+    TableOutput output;
+    table_output_init(&output, format, sink, output_context);
+
+    int written = write_csv_files(&context, output.sink, ast_root, threads, error);
+    int result = table_output_finish(&output, output_context, sink, written, error);
+    table_output_free(&output);
+    free_schema(&typed);
+    phase_end(clock, stats ? &stats->write : NULL);
+
+    if (result == 0 && emit_schema) {
+        clock = phase_start();
+        result = write_schema_json(&context, sink, error);
+        phase_end(clock, stats ? &stats->emit_schema : NULL);
+    }
+    if (result == 0 && base) {
+        result = write_state_json(&context, sink, error);
+    }
+    if (result != 0) {
+        free_schema(&context);
+        for (int i = 0; i < chunk_count; i++) {
+            arena_free(&document_arenas[i]);
+        }
+        free(document_arenas);
+        return -1;
+    }
+
+    if (stats) {
+        collect_stats(stats, &tokens, &context);
+        stats->ast_nodes = ast_node_count(ast_root);
+        for (int i = 0; i < chunk_count; i++) {
+            stats->arena_bytes += document_arenas[i].bytes_used;
+            stats->arena_blocks += document_arenas[i].chunk_count;
+        }
+    }
+    free_schema(&context);
+
+    // Release the whole AST in one go.
+    for (int i = 0; i < chunk_count; i++) {
+        arena_free(&document_arenas[i]);
+    }
+    free(document_arenas);
+
+    return 0;
+}
+
+// Runs one conversion of an already prepared input. 'base' is NULL, or for --append the
+// tables and last row ID of earlier runs: inference extends them, IDs continue after
+// them, and the state file for the next run is written last.
+static int convert_input(const JsonParseInput* input, const Json2RelCsvOptions* options,
+                         const SchemaContext* base, const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    int threads = options->threads > 1 ? options->threads : 1;
+
+    if (options->stream && options->print_ast) {
+        set_error(error, 0, 0, "print_ast cannot be combined with stream (no AST is built).");
+        return -1;
+    }
+    if (options->schema && options->print_ast) {
+        set_error(error, 0, 0, "print_ast cannot be combined with schema (no AST is built).");
+        return -1;
+    }
+
+    if (options->format != JSON2RELCSV_FORMAT_CSV && options->format != JSON2RELCSV_FORMAT_COLUMNAR &&
+        options->format != JSON2RELCSV_FORMAT_PGCOPY) {
+        set_error(error, 0, 0, "Unknown output format.");
+        return -1;
+    }
+    if (base && options->format != JSON2RELCSV_FORMAT_CSV) {
+        set_error(error, 0, 0, "An append can only add to CSV files.");
+        return -1;
+    }
+
+    // Everything, schema.json included, goes through the compressor.
+    CompressSink compress;
+    Json2RelCsvSink compressed;
+    if (options->compression != JSON2RELCSV_COMPRESS_NONE) {
+        if (options->compression != JSON2RELCSV_COMPRESS_GZIP && options->compression != JSON2RELCSV_COMPRESS_ZSTD) {
+            set_error(error, 0, 0, "Unknown compression.");
+            return -1;
+        }
+        if (!compress_supported(options->compression)) {
+            set_error(error, 0, 0, options->compression == JSON2RELCSV_COMPRESS_GZIP
+                                       ? "This build cannot compress with gzip (it was built without zlib)."
+                                       : "This build cannot compress with zstd (it was built without libzstd).");
+            return -1;
+        }
+        if (options->compression_level < 0 ||
+            options->compression_level > compress_max_level(options->compression)) {
+            set_error(error, 0, 0, "Compression level out of range (gzip: 1 to 9, zstd: 1 to 22).");
+            return -1;
+        }
+        if (base) {
+            set_error(error, 0, 0, "An append cannot compress its output.");
+            return -1;
+        }
+        compressed = compress_sink(&compress, sink, options->compression, options->compression_level);
+        sink = &compressed;
+    }
+
+    if (options->stats) {
+        memset(options->stats, 0, sizeof(*options->stats));
+    }
+    int result = options->stream || options->schema
+                     ? run_stream(input, sink, options->emit_schema, options->format, options->schema,
+                                  options->drop_unknown, base, options->stats, error)
+                     : run_ast(input, options->print_ast, sink, options->emit_schema, options->format, threads,
+                               base, options->stats, error);
+    if (options->compression != JSON2RELCSV_COMPRESS_NONE) {
+        compress_sink_destroy(&compress);
+    }
+    return result;
+}
+
+// The public entry points, with convert_input()'s 'base'.
+static int convert_memory(const char* data, size_t size, const Json2RelCsvOptions* options,
+                          const SchemaContext* base, const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    Json2RelCsvOptions defaults;
+    memset(&defaults, 0, sizeof(defaults));
+
+    JsonParseInput input;
+    memset(&input, 0, sizeof(input));
+    input.data = data ? data : "";
+    input.size = data ? size : 0;
+    input.records = options ? options->ndjson : 0;
+
+    return convert_input(&input, options ? options : &defaults, base, sink, error);
+}
+
+static int convert_stream(FILE* file, const Json2RelCsvOptions* options, const SchemaContext* base,
+                          const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    Json2RelCsvOptions defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (!options) {
+        options = &defaults;
+    }
+
+    if (options->ndjson && !options->stream && !options->schema && options->threads > 1) {
+        // Splitting JSON Lines into chunks needs the whole text in memory.
+        size_t size = 0;
+        char* text = input_read_stream(file, &size);
+        int status = convert_memory(text, size, options, base, sink, error);
+        free(text);
+        return status;
+    }
+
+    JsonParseInput input;
+    memset(&input, 0, sizeof(input));
+    input.file = file;
+    input.records = options->ndjson;
+
+    return convert_input(&input, options, base, sink, error);
+}
+
+static int convert_path(const char* path, const Json2RelCsvOptions* options, const SchemaContext* base,
+                        const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    Json2RelCsvOptions defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (!options) {
+        options = &defaults;
+    }
+
+    // Regular files are mapped and lexed in place, with no read() calls or copies into
+    // Flex's buffers. Anything else (pipes, devices) is read as a stream.
+    MappedInput mapped_input = { NULL, 0, 0 };
+    if (input_map_file(path, &mapped_input) == 0) {
+        JsonParseInput input;
+        memset(&input, 0, sizeof(input));
+        input.in_place = mapped_input.data;
+        input.size = mapped_input.size;
+        input.records = options->ndjson;
+
+        int status = convert_input(&input, options, base, sink, error);
+        input_unmap(&mapped_input);
+        return status;
+    }
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        char message[160];
+        snprintf(message, sizeof(message), "Could not open input file %s", path);
+        set_error(error, 0, 0, message);
+        return -1;
+    }
+    int status = convert_stream(file, options, base, sink, error);
+    fclose(file);
+    return status;
+}
+
+int json2relcsv_convert(const char* data, size_t size, const Json2RelCsvOptions* options,
+                        const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    return convert_memory(data, size, options, NULL, sink, error);
+}
+
+int json2relcsv_convert_stream(FILE* file, const Json2RelCsvOptions* options,
+                               const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    return convert_stream(file, options, NULL, sink, error);
+}
+
+int json2relcsv_convert_file(const char* path, const Json2RelCsvOptions* options,
+                             const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    return convert_path(path, options, NULL, sink, error);
+}
+
+// --- Directory sink ---
+
+// Creates the output directory if needed ("" and "." mean the current directory).
+static void ensure_directory_exists(const char* dir) {
+    if (!dir || strcmp(dir, "") == 0 || strcmp(dir, ".") == 0) {
+        return;  // Current directory
+    }
+
+    // Use system-dependent directory creation
+    #ifdef _WIN32
+    _mkdir(dir);
+    #else
+    mkdir(dir, 0755);
+    #endif
+}
+
+// Returns "<dir>/<name>" (or just "<name>" for "" / "."); the caller frees it.
+static char* directory_path(const char* dir, const char* name) {
+    size_t len = strlen(dir) + strlen(name) + 2;  // +2 for "/" + null terminator
+    char* path = (char*)malloc(len);
+    if (!path) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (strcmp(dir, "") == 0 || strcmp(dir, ".") == 0) {
+        snprintf(path, len, "%s", name);
+    } else {
+        snprintf(path, len, "%s/%s", dir, name);
+    }
+    return path;
+}
+
+// Opens "<dir>/<name>" (or just "<name>" for "" / ".") for writing.
+static void* directory_open(void* ctx, const char* name) {
+    const char* dir = (const char*)ctx;
+    ensure_directory_exists(dir);
+
+    char* path = directory_path(dir, name);
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s for writing\n", path);
+    }
+    free(path);
+    return file;
+}
+
+static int directory_write(void* ctx, void* stream, const char* data, size_t len) {
+    (void)ctx;
+    return fwrite(data, 1, len, (FILE*)stream) == len ? 0 : -1;
+}
+
+static int directory_close(void* ctx, void* stream) {
+    (void)ctx;
+    return fclose((FILE*)stream) == 0 ? 0 : -1;
+}
+
+Json2RelCsvSink json2relcsv_directory_sink(const char* dir) {
+    Json2RelCsvSink sink;
+    sink.open = directory_open;
+    sink.write = directory_write;
+    sink.close = directory_close;
+    sink.ctx = (void*)(dir ? dir : ".");
+    return sink;
+}
+
+// --- Append ---
+
+// The sink of an append: like the directory sink, except that the CSV of a table the
+// earlier runs wrote is appended to instead of replaced. Nothing the earlier runs wrote
+// changes unless the whole append succeeds: every other output is written beside its
+// old version ("<path>.tmp") and renamed over it when the state file, written last, is;
+// a failed append removes those and truncates the appended CSVs back to their old size.
+
+// A file the append changes.
+typedef struct AppendChange {
+    char* path;
+    int staged;              // written to "<path>.tmp", to be renamed over 'path'
+    int committed;           // ... and renamed
+    off_t size;              // not staged: appended to in place, from this size
+} AppendChange;
+
+typedef struct AppendOutput {
+    const char* dir;
+    SchemaContext* base;     // the earlier runs' tables (read-only)
+    pthread_mutex_t lock;    // tables may be written concurrently (--threads)
+    int failed;              // an output could not be written; keeps the old state file
+    AppendChange* changes;   // guarded by 'lock'
+    int change_count;
+    int change_capacity;
+} AppendOutput;
+
+// One output. An appended CSV's header row is held back until it is complete, checked
+// against the file's own header, and dropped.
+typedef struct AppendStream {
+    char* path;
+    FILE* file;              // NULL while the header is held back, or after a failure
+    int held;                // still collecting the header row
+    int in_quotes;           // ... and inside a quoted column name
+    char* header;
+    size_t header_len;
+    size_t header_cap;
+    int is_state;            // the state file: commits the append on close
+    int failed;              // could not be started or written
+} AppendStream;
+
+static void append_failed(AppendOutput* output, const char* message, const char* path) {
+    fprintf(stderr, "Error: %s %s\n", message, path);
+    pthread_mutex_lock(&output->lock);
+    output->failed = 1;
+    pthread_mutex_unlock(&output->lock);
+}
+
+// Returns "<path>.tmp"; the caller frees it.
+static char* temp_path(const char* path) {
+    size_t len = strlen(path) + 5;  // +5 for ".tmp" + null terminator
+    char* temp = (char*)malloc(len);
+    if (!temp) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(temp, len, "%s.tmp", path);
+    return temp;
+}
+
+// Records a file the append changes, so that it can be committed or rolled back.
+static void append_change(AppendOutput* output, const char* path, int staged, off_t size) {
+    pthread_mutex_lock(&output->lock);
+    if (output->change_count == output->change_capacity) {
+        output->change_capacity = output->change_capacity ? output->change_capacity * 2 : 16;
+        output->changes = (AppendChange*)realloc(output->changes, output->change_capacity * sizeof(AppendChange));
+        if (!output->changes) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    AppendChange* change = &output->changes[output->change_count++];
+    change->path = strdup(path);
+    if (!change->path) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    change->staged = staged;
+    change->committed = 0;
+    change->size = size;
+    pthread_mutex_unlock(&output->lock);
+}
+
+// Opens "<path>.tmp" for writing (or with 'append', for appending) and records it as
+// staged. Returns NULL if it cannot be opened.
+static FILE* append_stage(AppendOutput* output, const char* path, int append) {
+    char* temp = temp_path(path);
+    FILE* file = fopen(temp, append ? "a" : "w");
+    free(temp);
+    if (file) {
+        append_change(output, path, 1, 0);
+    }
+    return file;
+}
+
+// Renames every staged file over its old version. Called once every output but the
+// state file is closed. Returns -1 if one could not be renamed.
+static int append_commit(AppendOutput* output) {
+    int status = 0;
+    for (int i = 0; i < output->change_count; i++) {
+        AppendChange* change = &output->changes[i];
+        if (!change->staged) {
+            continue;
+        }
+        char* temp = temp_path(change->path);
+        if (rename(temp, change->path) == 0) {
+            change->committed = 1;
+        } else {
+            fprintf(stderr, "Error: Could not replace %s\n", change->path);
+            status = -1;
+        }
+        free(temp);
+    }
+    return status;
+}
+
+// Undoes what a failed append has not committed: removes staged files and truncates
+// appended ones to their old size.
+static void append_rollback(AppendOutput* output) {
+    for (int i = 0; i < output->change_count; i++) {
+        AppendChange* change = &output->changes[i];
+        if (change->committed) {
+            continue;
+        }
+        if (change->staged) {
+            char* temp = temp_path(change->path);
+            remove(temp);
+            free(temp);
+        } else if (truncate(change->path, change->size) != 0) {
+            fprintf(stderr, "Error: Could not restore %s\n", change->path);
+        }
+    }
+}
+
+// Returns 1 if 'name' is the CSV of a table of the earlier runs and that CSV exists.
+static int is_appended_csv(const AppendOutput* output, const char* name, const char* path) {
+    size_t len = strlen(name);
+    if (len <= 4 || strcmp(name + len - 4, ".csv") != 0) {
+        return 0;
+    }
+    char table_name[256];
+    if (len - 4 >= sizeof(table_name)) {
+        return 0;
+    }
+    memcpy(table_name, name, len - 4);
+    table_name[len - 4] = '\0';
+
+    struct stat info;
+    return find_table(output->base, table_name) && stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// Reads the first row of 'file', with its '\n'; sets *len to 0 for an empty file.
+static char* read_header_row(FILE* file, size_t* len) {
+    size_t cap = 256;
+    char* row = (char*)malloc(cap);
+    if (!row) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    *len = 0;
+    int in_quotes = 0;
+    int c;
+    while ((c = getc(file)) != EOF) {
+        if (*len == cap) {
+            cap *= 2;
+            row = (char*)realloc(row, cap);
+            if (!row) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        row[(*len)++] = (char)c;
+        if (c == '"') {
+            in_quotes = !in_quotes;
+        } else if (c == '\n' && !in_quotes) {
+            break;
+        }
+    }
+    return row;
+}
+
+// Rewrites the CSV at 'path' into "<path>.tmp" with 'header' (a complete row) in place of
+// its first row, which 'in' has just been read past, and every other row padded with
+// 'extra' empty cells: new columns always come after the existing ones (see add_column()).
+static int widen_csv(const char* path, FILE* in, const char* header, size_t header_len, int extra) {
+    char* temp = temp_path(path);
+    FILE* out = fopen(temp, "w");
+    if (!out) {
+        free(temp);
+        return -1;
+    }
+    fwrite(header, 1, header_len, out);
+
+    char buffer[65536];
+    size_t n;
+    int in_quotes = 0;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        size_t start = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (buffer[i] == '"') {
+                in_quotes = !in_quotes;
+            } else if (buffer[i] == '\n' && !in_quotes) {
+                fwrite(buffer + start, 1, i - start, out);
+                for (int k = 0; k < extra; k++) {
+                    putc(',', out);
+                }
+                start = i;  // the '\n' goes out with the next piece
+            }
+        }
+        fwrite(buffer + start, 1, n - start, out);
+    }
+
+    int status = ferror(in) || ferror(out) ? -1 : 0;
+    if (fclose(out) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        remove(temp);
+    }
+    free(temp);
+    return status;
+}
+
+// Called once the held-back header row is complete: opens the CSV for appending, or if
+// this run added columns to the table, stages a widened copy to append to instead.
+static void append_start(AppendOutput* output, AppendStream* stream) {
+    stream->held = 0;
+
+    FILE* existing = fopen(stream->path, "r");
+    size_t old_len = 0;
+    char* old = existing ? read_header_row(existing, &old_len) : NULL;
+    if (old_len == 0) {
+        // Removed or emptied since it was opened; start it over.
+        if (existing) {
+            fclose(existing);
+        }
+        free(old);
+        stream->file = append_stage(output, stream->path, 0);
+        if (!stream->file) {
+            append_failed(output, "Could not open file for writing:", stream->path);
+            return;
+        }
+        if (fwrite(stream->header, 1, stream->header_len, stream->file) != stream->header_len) {
+            append_failed(output, "Could not write", stream->path);
+            stream->failed = 1;
+        }
+        return;
+    }
+
+    // Compare the rows without their line ends.
+    size_t old_cells = old[old_len - 1] == '\n' ? old_len - 1 : old_len;
+    size_t new_cells = stream->header_len > 0 && stream->header[stream->header_len - 1] == '\n'
+                     ? stream->header_len - 1 : stream->header_len;
+    int matches = new_cells >= old_cells && memcmp(stream->header, old, old_cells) == 0 &&
+                  (new_cells == old_cells || stream->header[old_cells] == ',');
+    free(old);
+    if (!matches) {
+        fclose(existing);
+        append_failed(output, "The columns no longer extend the header row of", stream->path);
+        return;
+    }
+
+    int extra = 0;
+    int in_quotes = 0;
+    for (size_t i = old_cells; i < new_cells; i++) {
+        if (stream->header[i] == '"') {
+            in_quotes = !in_quotes;
+        } else if (stream->header[i] == ',' && !in_quotes) {
+            extra++;
+        }
+    }
+    if (extra > 0) {
+        int widened = widen_csv(stream->path, existing, stream->header, stream->header_len, extra);
+        fclose(existing);
+        if (widened != 0) {
+            append_failed(output, "Could not add the new columns to", stream->path);
+            return;
+        }
+        stream->file = append_stage(output, stream->path, 1);
+    } else {
+        fclose(existing);
+        stream->file = fopen(stream->path, "a");
+        if (stream->file) {
+            // Where a rollback truncates it back to.
+            if (fseeko(stream->file, 0, SEEK_END) == 0) {
+                append_change(output, stream->path, 0, ftello(stream->file));
+            } else {
+                fclose(stream->file);
+                stream->file = NULL;
+            }
+        }
+    }
+    if (!stream->file) {
+        append_failed(output, "Could not open file for appending:", stream->path);
+    }
+}
+
+static void* append_open(void* ctx, const char* name) {
+    AppendOutput* output = (AppendOutput*)ctx;
+    ensure_directory_exists(output->dir);
+
+    AppendStream* stream = (AppendStream*)calloc(1, sizeof(AppendStream));
+    if (!stream) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    stream->path = directory_path(output->dir, name);
+
+    if (strcmp(name, SCHEMA_STATE_FILE_NAME) == 0) {
+        // Written last; if any output failed, the old state (and IDs) must stay.
+        pthread_mutex_lock(&output->lock);
+        int failed = output->failed;
+        pthread_mutex_unlock(&output->lock);
+        if (failed) {
+            free(stream->path);
+            free(stream);
+            return NULL;
+        }
+        char* temp = temp_path(stream->path);
+        stream->file = fopen(temp, "w");
+        stream->is_state = 1;
+        free(temp);
+    } else if (is_appended_csv(output, name, stream->path)) {
+        stream->held = 1;
+        return stream;
+    } else {
+        stream->file = append_stage(output, stream->path, 0);
+    }
+
+    if (!stream->file) {
+        append_failed(output, "Could not open file for writing:", stream->path);
+        free(stream->path);
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+static int append_write(void* ctx, void* handle, const char* data, size_t len) {
+    AppendOutput* output = (AppendOutput*)ctx;
+    AppendStream* stream = (AppendStream*)handle;
+    if (stream->failed) {
+        return -1;
+    }
+    if (stream->held) {
+        size_t i = 0;
+        while (i < len && (data[i] != '\n' || stream->in_quotes)) {
+            if (data[i] == '"') {
+                stream->in_quotes = !stream->in_quotes;
+            }
+            i++;
+        }
+        int complete = i < len;
+        size_t take = complete ? i + 1 : len;
+        if (stream->header_len + take > stream->header_cap) {
+            stream->header_cap = (stream->header_len + take) * 2;
+            stream->header = (char*)realloc(stream->header, stream->header_cap);
+            if (!stream->header) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        memcpy(stream->header + stream->header_len, data, take);
+        stream->header_len += take;
+        data += take;
+        len -= take;
+        if (!complete) {
+            return 0;  // the header row continues in the next write
+        }
+        append_start(output, stream);
+    }
+    if (!stream->file) {
+        stream->failed = 1;  // append_start() reported why
+        return -1;
+    }
+    if (len > 0 && fwrite(data, 1, len, stream->file) != len) {
+        append_failed(output, "Could not write", stream->path);
+        stream->failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+static int append_close(void* ctx, void* handle) {
+    AppendOutput* output = (AppendOutput*)ctx;
+    AppendStream* stream = (AppendStream*)handle;
+    if (stream->held) {
+        append_start(output, stream);
+    }
+    int status = stream->failed || !stream->file ? -1 : 0;
+    if (stream->file) {
+        int write_failed = ferror(stream->file);
+        if (fclose(stream->file) != 0 || write_failed) {
+            if (!stream->failed) {
+                append_failed(output, "Could not write", stream->path);
+            }
+            status = -1;
+        }
+    }
+    if (stream->is_state) {
+        // Every other output is closed: commit them, then the state file.
+        char* temp = temp_path(stream->path);
+        if (status == 0 && append_commit(output) != 0) {
+            status = -1;  // append_commit() said which
+        }
+        if (status == 0 && rename(temp, stream->path) != 0) {
+            append_failed(output, "Could not replace", stream->path);
+            status = -1;
+        }
+        if (status != 0) {
+            remove(temp);
+        }
+        free(temp);
+    }
+    free(stream->header);
+    free(stream->path);
+    free(stream);
+    return status;
+}
+
+// Appends the conversion of 'path' or, if it is NULL, of 'file' to 'dir'.
+static int append_to(const char* path, FILE* file, const Json2RelCsvOptions* options, const char* dir,
+                     Json2RelCsvError* error) {
+    if (options && options->schema) {
+        set_error(error, 0, 0, "An append extends the schema in its state file; it cannot use another schema");
+        return -1;
+    }
+    dir = dir ? dir : ".";
+
+    // No state file yet means no earlier runs: everything starts over, from ID 1.
+    SchemaContext base = schema_context_init();
+    char* state_path = directory_path(dir, SCHEMA_STATE_FILE_NAME);
+    FILE* state = fopen(state_path, "r");
+    if (state) {
+        size_t size = 0;
+        char* text = input_read_stream(state, &size);
+        fclose(state);
+
+        Json2RelCsvError load_error;
+        int loaded = read_schema_json(text, size, &base, &load_error);
+        free(text);
+        if (loaded != 0) {
+            char message[sizeof(error->message)];
+            snprintf(message, sizeof(message), "%.110s (in %.40s)", load_error.message, state_path);
+            set_error(error, load_error.line, load_error.column, message);
+            free(state_path);
+            free_schema(&base);
+            return -1;
+        }
+    }
+    free(state_path);
+
+    AppendOutput output;
+    memset(&output, 0, sizeof(output));
+    output.dir = dir;
+    output.base = &base;
+    pthread_mutex_init(&output.lock, NULL);
+
+    Json2RelCsvSink sink;
+    sink.open = append_open;
+    sink.write = append_write;
+    sink.close = append_close;
+    sink.ctx = &output;
+
+    int status = path ? convert_path(path, options, &base, &sink, error)
+                      : convert_stream(file, options, &base, &sink, error);
+    if (status == 0 && output.failed) {
+        char message[160];
+        snprintf(message, sizeof(message), "Could not append to the output in %.120s", dir);
+        set_error(error, 0, 0, message);
+        status = -1;
+    }
+    if (status != 0) {
+        append_rollback(&output);
+    }
+    for (int i = 0; i < output.change_count; i++) {
+        free(output.changes[i].path);
+    }
+    free(output.changes);
+
+    pthread_mutex_destroy(&output.lock);
+    free_schema(&base);
+    return status;
+}
+
+int json2relcsv_append_file(const char* path, const Json2RelCsvOptions* options, const char* dir,
+                            Json2RelCsvError* error) {
+    return append_to(path, NULL, options, dir, error);
+}
+
+int json2relcsv_append_stream(FILE* file, const Json2RelCsvOptions* options, const char* dir,
+                              Json2RelCsvError* error) {
+    return append_to(NULL, file, options, dir, error);
+}
+
+// --- Memory sink ---
+
+// One collected stream.
+typedef struct MemoryOutput {
+    char* name;
+    CsvBuffer contents;     // an unbound (growable) buffer
+} MemoryOutput;
+
+struct Json2RelCsvMemory {
+    MemoryOutput** outputs; // in opening order; each output stays where it was allocated
+    int count;
+    int capacity;
+    pthread_mutex_t lock;   // guards 'outputs' while writer threads open streams
+};
+
+Json2RelCsvMemory* json2relcsv_memory_create(void) {
+    Json2RelCsvMemory* memory = (Json2RelCsvMemory*)calloc(1, sizeof(Json2RelCsvMemory));
+    if (!memory) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&memory->lock, NULL);
+    return memory;
+}
+
+static void* memory_open(void* ctx, const char* name) {
+    Json2RelCsvMemory* memory = (Json2RelCsvMemory*)ctx;
+    MemoryOutput* output = (MemoryOutput*)calloc(1, sizeof(MemoryOutput));
+    if (!output || !(output->name = strdup(name))) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    csv_buffer_init(&output->contents, NULL, NULL);
+
+    pthread_mutex_lock(&memory->lock);
+    if (memory->count == memory->capacity) {
+        memory->capacity = memory->capacity ? memory->capacity * 2 : 16;
+        memory->outputs = (MemoryOutput**)realloc(memory->outputs, memory->capacity * sizeof(MemoryOutput*));
+        if (!memory->outputs) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memory->outputs[memory->count++] = output;
+    pthread_mutex_unlock(&memory->lock);
+    return output;
+}
+
+static int memory_write(void* ctx, void* stream, const char* data, size_t len) {
+    (void)ctx;
+    csv_buffer_append(&((MemoryOutput*)stream)->contents, data, len);
+    return 0;
+}
+
+// Terminates the contents, without counting the NUL in their size.
+static int memory_close(void* ctx, void* stream) {
+    (void)ctx;
+    CsvBuffer* contents = &((MemoryOutput*)stream)->contents;
+    csv_buffer_reserve(contents, 1);
+    contents->data[contents->len] = '\0';
+    return 0;
+}
+
+Json2RelCsvSink json2relcsv_memory_sink(Json2RelCsvMemory* memory) {
+    Json2RelCsvSink sink;
+    sink.open = memory_open;
+    sink.write = memory_write;
+    sink.close = memory_close;
+    sink.ctx = memory;
+    return sink;
+}
+
+int json2relcsv_convert_to_memory(const char* data, size_t size, const Json2RelCsvOptions* options,
+                                  Json2RelCsvMemory* memory, Json2RelCsvError* error) {
+    Json2RelCsvSink sink = json2relcsv_memory_sink(memory);
+    return json2relcsv_convert(data, size, options, &sink, error);
+}
+
+int json2relcsv_memory_count(const Json2RelCsvMemory* memory) {
+    return memory->count;
+}
+
+const char* json2relcsv_memory_name(const Json2RelCsvMemory* memory, int index) {
+    return memory->outputs[index]->name;
+}
+
+const char* json2relcsv_memory_data(const Json2RelCsvMemory* memory, int index) {
+    const CsvBuffer* contents = &memory->outputs[index]->contents;
+    return contents->data ? contents->data : "";
+}
+
+size_t json2relcsv_memory_size(const Json2RelCsvMemory* memory, int index) {
+    return memory->outputs[index]->contents.len;
+}
+
+void json2relcsv_memory_free(Json2RelCsvMemory* memory) {
+    if (!memory) {
+        return;
+    }
+    for (int i = 0; i < memory->count; i++) {
+        free(memory->outputs[i]->name);
+        csv_buffer_free(&memory->outputs[i]->contents);
+        free(memory->outputs[i]);
+    }
+    free(memory->outputs);
+    pthread_mutex_destroy(&memory->lock);
+    free(memory);
+}
@@ -0,0 +1,96 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "json_number.h"
+
+// Powers of ten that are exactly representable as doubles.
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+double json_number_to_double(const char* text) {
+    const char* p = text;
+    int negative = (*p == '-');
+    if (negative) p++;
+
+    // Accumulate up to 19 significant digits; anything longer takes the slow path.
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa) digits++;
+        } else {
+            return strtod(text, NULL);
+        }
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            } else {
+                return strtod(text, NULL);
+            }
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        int exponent_negative = (*p == '-');
+        if (*p == '-' || *p == '+') p++;
+        int value = 0;
+        for (; *p >= '0' && *p <= '9'; p++) {
+            if (value < 100000) value = value * 10 + (*p - '0');
+        }
+        exponent += exponent_negative ? -value : value;
+    }
+
+    if (mantissa == 0) {
+        return negative ? -0.0 : 0.0;
+    }
+
+    // Clinger's fast path: when both the mantissa and the power of ten are exact
+    // doubles, a single multiplication or division is correctly rounded.
+    if (mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / exact_powers_of_ten[-exponent] : value * exact_powers_of_ten[exponent];
+        return negative ? -value : value;
+    }
+
+    // strtod() rounds correctly too; the C locale is never changed, so '.' is the
+    // decimal point it expects.
+    return strtod(text, NULL);
+}
+
+int json_number_to_int64(const char* text, size_t len, long long* value) {
+    const char* p = text;
+    const char* end = text + len;
+    int negative = (p < end && *p == '-');
+    if (negative) p++;
+    if (p == end) {
+        return 0;
+    }
+
+    // Accumulate the magnitude negatively: INT64_MIN has no positive counterpart.
+    int64_t result = 0;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') {
+            return 0;
+        }
+        int digit = *p - '0';
+        if (result < (INT64_MIN + digit) / 10) {
+            return 0;
+        }
+        result = result * 10 - digit;
+    }
+    if (!negative) {
+        if (result == INT64_MIN) {
+            return 0;
+        }
+        result = -result;
+    }
+    *value = (long long)result;
+    return 1;
+}
@@ -1,14 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "ast.h"
-
-// External variables from the lexer (Flex) and parser (Bison).
-extern FILE* yyin;      // Input file stream for the lexer.
-extern int yyparse();   // Main parsing function generated by Bison.
-extern ASTNode* ast_root; // Root of the Abstract Syntax Tree, populated by the parser.
-// extern int line_num; // Line number tracking from lexer (currently unused in main).
-// extern int column_num; // Column number tracking from lexer (currently unused in main).
+#include <sys/stat.h>
+#include "json2relcsv.h"
+
 // extern int yydebug; // Bison debug flag (set to 1 to enable parser tracing).
 
 // Checks if a string 'str' starts with the given 'prefix'.
@@ -21,17 +16,48 @@ int starts_with(const char* str, const char* prefix) {
 // - argc, argv: Standard main function arguments.
 // - print_ast_flag: (Output) Set to 1 if --print-ast is present.
 // - emit_schema_flag: (Output) Set to 1 if --emit-schema is present.
+// - stream_flag: (Output) Set to 1 if --stream is present.
+// - ndjson_flag: (Output) Set to 1 if --ndjson is present.
 // - out_dir: (Output) Set to the specified output directory string (defaults to ".").
-void parse_args(int argc, char* argv[], int* print_ast_flag, int* emit_schema_flag, char** out_dir) {
+// - input_path: (Output) Set to the --input file, or NULL to read standard input.
+// - threads: (Output) Set to the --threads count (defaults to 1), or 0 if it is not a positive number.
+// - stats_format: (Output) 0 without --stats, 1 for --stats (text), 2 for --stats=json, -1 if unknown.
+// - schema_path: (Output) Set to the --schema file, or NULL to infer the schema.
+// - drop_unknown_flag: (Output) Set to 1 if --drop-unknown is present.
+// - append_flag: (Output) Set to 1 if --append is present.
+// - format: (Output) A Json2RelCsvFormat for --format=csv, columnar or pgcopy (defaults to CSV), -1 if unknown.
+// - compression: (Output) A Json2RelCsvCompression for --compress=gzip or zstd (defaults to none), -1 if unknown.
+// - compression_level: (Output) The level after "gzip:" or "zstd:" (defaults to 0), -1 if it is not a number.
+// - archive_path: (Output) Set to the --out-archive file ("-" for standard output), or NULL to write to out_dir.
+void parse_args(int argc, char* argv[], int* print_ast_flag, int* emit_schema_flag, int* stream_flag,
+                int* ndjson_flag, char** out_dir, char** input_path, int* threads, int* stats_format,
+                char** schema_path, int* drop_unknown_flag, int* append_flag, int* format,
+                int* compression, int* compression_level, char** archive_path) {
     *print_ast_flag = 0;
     *emit_schema_flag = 0;
+    *stream_flag = 0;
+    *ndjson_flag = 0;
     *out_dir = ".";  // Default to current directory
+    *input_path = NULL;
+    *threads = 1;
+    *stats_format = 0;
+    *schema_path = NULL;
+    *drop_unknown_flag = 0;
+    *append_flag = 0;
+    *format = JSON2RELCSV_FORMAT_CSV;
+    *compression = JSON2RELCSV_COMPRESS_NONE;
+    *compression_level = 0;
+    *archive_path = NULL;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--print-ast") == 0) {
             *print_ast_flag = 1;
         } else if (strcmp(argv[i], "--emit-schema") == 0) {
             *emit_schema_flag = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            *stream_flag = 1;
+        } else if (strcmp(argv[i], "--ndjson") == 0) {
+            *ndjson_flag = 1;
         } else if (strcmp(argv[i], "--out-dir") == 0 || strcmp(argv[i], "--output-dir") == 0) {
             // Handles "--out-dir DIR" or "--output-dir DIR" (space separated)
             if (i + 1 < argc && argv[i+1][0] != '-') {
@@ -53,48 +79,332 @@ void parse_args(int argc, char* argv[], int* print_ast_flag, int* emit_schema_fl
                 // Use default directory. A warning could be printed here if desired.
                 // fprintf(stderr, "Warning: %s received an empty value. Using default directory '%s'.\n", argv[i], *out_dir);
             }
+        } else if (strcmp(argv[i], "--out-archive") == 0) {
+            // "--out-archive FILE"; "-" means standard output.
+            if (i + 1 < argc) {
+                *archive_path = argv[i + 1];
+                i++;
+            }
+        } else if (starts_with(argv[i], "--out-archive=")) {
+            char* value = strchr(argv[i], '=') + 1;
+            if (*value != '\0') {
+                *archive_path = value;
+            }
+        } else if (strcmp(argv[i], "--input") == 0) {
+            // "--input FILE"; "-" (or no --input at all) means standard input.
+            if (i + 1 < argc) {
+                *input_path = argv[i + 1];
+                i++;
+            }
+        } else if (starts_with(argv[i], "--input=")) {
+            char* value = strchr(argv[i], '=') + 1;
+            if (*value != '\0') {
+                *input_path = value;
+            }
+        } else if (strcmp(argv[i], "--schema") == 0) {
+            // "--schema FILE": a schema.json from an earlier --emit-schema run.
+            if (i + 1 < argc) {
+                *schema_path = argv[i + 1];
+                i++;
+            }
+        } else if (starts_with(argv[i], "--schema=")) {
+            char* value = strchr(argv[i], '=') + 1;
+            if (*value != '\0') {
+                *schema_path = value;
+            }
+        } else if (strcmp(argv[i], "--drop-unknown") == 0) {
+            *drop_unknown_flag = 1;
+        } else if (strcmp(argv[i], "--append") == 0) {
+            *append_flag = 1;
+        } else if (strcmp(argv[i], "--format") == 0 || starts_with(argv[i], "--format=")) {
+            // "--format NAME" or "--format=NAME"
+            const char* value = NULL;
+            if (argv[i][8] == '=') {
+                value = argv[i] + 9;
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            }
+            if (value && strcmp(value, "csv") == 0) {
+                *format = JSON2RELCSV_FORMAT_CSV;
+            } else if (value && strcmp(value, "columnar") == 0) {
+                *format = JSON2RELCSV_FORMAT_COLUMNAR;
+            } else if (value && strcmp(value, "pgcopy") == 0) {
+                *format = JSON2RELCSV_FORMAT_PGCOPY;
+            } else {
+                *format = -1;
+            }
+        } else if (strcmp(argv[i], "--compress") == 0 || starts_with(argv[i], "--compress=")) {
+            // "--compress NAME[:LEVEL]" or "--compress=NAME[:LEVEL]"
+            const char* value = NULL;
+            if (argv[i][10] == '=') {
+                value = argv[i] + 11;
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            }
+            const char* level = value ? strchr(value, ':') : NULL;
+            size_t name_len = level ? (size_t)(level - value) : (value ? strlen(value) : 0);
+            if (value && name_len == 4 && strncmp(value, "gzip", 4) == 0) {
+                *compression = JSON2RELCSV_COMPRESS_GZIP;
+            } else if (value && name_len == 4 && strncmp(value, "zstd", 4) == 0) {
+                *compression = JSON2RELCSV_COMPRESS_ZSTD;
+            } else {
+                *compression = -1;
+            }
+            if (level) {
+                char* end = NULL;
+                long number = strtol(level + 1, &end, 10);
+                *compression_level = (level[1] != '\0' && *end == '\0' && number > 0 && number <= 99)
+                                         ? (int)number : -1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+            *stats_format = 1;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            *stats_format = 2;
+        } else if (starts_with(argv[i], "--stats=")) {
+            *stats_format = -1;
+        } else if (strcmp(argv[i], "--threads") == 0 || starts_with(argv[i], "--threads=")) {
+            // "--threads N" or "--threads=N"
+            const char* value = NULL;
+            if (argv[i][9] == '=') {
+                value = argv[i] + 10;
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            }
+            char* end = NULL;
+            long count = value ? strtol(value, &end, 10) : 0;
+            *threads = (value && *value != '\0' && *end == '\0' && count > 0 && count <= 1024) ? (int)count : 0;
         }
     }
 }
 
+// Prints --stats as a readable report.
+static void print_stats_text(FILE* out, const Json2RelCsvStats* stats) {
+    const char* names[] = {"parse", "schema", "write", "emit_schema"};
+    const Json2RelCsvPhase* phases[] = {&stats->parse, &stats->schema, &stats->write, &stats->emit_schema};
+
+    fprintf(out, "Stats:\n");
+    fprintf(out, "  %-12s %10s %10s\n", "phase", "wall s", "cpu s");
+    for (int i = 0; i < 4; i++) {
+        fprintf(out, "  %-12s %10.6f %10.6f\n", names[i], phases[i]->wall_seconds, phases[i]->cpu_seconds);
+    }
+    fprintf(out, "  tokens: %ld (punctuation %ld, strings %ld of which escaped %ld, numbers %ld, literals %ld)\n",
+            stats->tokens, stats->punctuation_tokens, stats->string_tokens, stats->escaped_string_tokens,
+            stats->number_tokens, stats->literal_tokens);
+    fprintf(out, "  AST: %zu nodes, %zu bytes in %zu arena blocks\n",
+            stats->ast_nodes, stats->arena_bytes, stats->arena_blocks);
+    fprintf(out, "  peak RSS: %ld KiB\n", stats->peak_rss_kb);
+    if (stats->dropped_values) {
+        fprintf(out, "  dropped: %ld values not in the schema\n", stats->dropped_values);
+    }
+    fprintf(out, "  %-24s %12s %14s\n", "table", "rows", "bytes");
+    for (int i = 0; i < stats->table_count; i++) {
+        fprintf(out, "  %-24s %12ld %14zu\n", stats->tables[i].name, stats->tables[i].rows, stats->tables[i].bytes);
+    }
+    if (!stats->counters_enabled) {
+        fprintf(out, "  (token, row and byte counts are not compiled in; build with JSON2RELCSV_STATS)\n");
+    }
+}
+
+// Prints --stats=json as one JSON object. Table names are safe_filename()s, so they
+// need no escaping.
+static void print_stats_json(FILE* out, const Json2RelCsvStats* stats) {
+    const char* names[] = {"parse", "schema", "write", "emit_schema"};
+    const Json2RelCsvPhase* phases[] = {&stats->parse, &stats->schema, &stats->write, &stats->emit_schema};
+
+    fprintf(out, "{\"phases\": {");
+    for (int i = 0; i < 4; i++) {
+        fprintf(out, "%s\"%s\": {\"wall_s\": %.6f, \"cpu_s\": %.6f}", i ? ", " : "", names[i],
+                phases[i]->wall_seconds, phases[i]->cpu_seconds);
+    }
+    fprintf(out, "}, \"counters_enabled\": %s", stats->counters_enabled ? "true" : "false");
+    fprintf(out, ", \"tokens\": {\"total\": %ld, \"punctuation\": %ld, \"strings\": %ld, \"escaped_strings\": %ld"
+                 ", \"numbers\": %ld, \"literals\": %ld}",
+            stats->tokens, stats->punctuation_tokens, stats->string_tokens, stats->escaped_string_tokens,
+            stats->number_tokens, stats->literal_tokens);
+    fprintf(out, ", \"ast_nodes\": %zu, \"arena_bytes\": %zu, \"arena_blocks\": %zu, \"peak_rss_kb\": %ld",
+            stats->ast_nodes, stats->arena_bytes, stats->arena_blocks, stats->peak_rss_kb);
+    fprintf(out, ", \"dropped_values\": %ld", stats->dropped_values);
+    fprintf(out, ", \"tables\": [");
+    for (int i = 0; i < stats->table_count; i++) {
+        fprintf(out, "%s{\"name\": \"%s\", \"rows\": %ld, \"bytes\": %zu}", i ? ", " : "",
+                stats->tables[i].name, stats->tables[i].rows, stats->tables[i].bytes);
+    }
+    fprintf(out, "]}\n");
+}
+
 int main(int argc, char* argv[]) {
     int print_ast_flag = 0;    // Flag to indicate if the AST should be printed.
     int emit_schema_flag = 0;  // Flag to indicate if schema.json should be written.
+    int stream_flag = 0;       // Flag to convert while parsing, without building the AST.
+    int ndjson_flag = 0;       // Flag to read JSON Lines (one value per line).
     char* out_dir = NULL;      // Directory for outputting CSV files.
+    char* input_path = NULL;   // File to convert; NULL means standard input.
+    int threads = 1;           // Number of parsing (--ndjson) and CSV writer threads.
+    int stats_format = 0;      // --stats: 0 = off, 1 = text, 2 = JSON.
+    char* schema_path = NULL;  // schema.json to convert with instead of inferring one.
+    int drop_unknown_flag = 0; // Flag to skip values the schema has no place for.
+    int append_flag = 0;       // Flag to add to the output of earlier --append runs.
+    int format = JSON2RELCSV_FORMAT_CSV; // How tables are written.
+    int compression = JSON2RELCSV_COMPRESS_NONE; // How every output is compressed.
+    int compression_level = 0; // 0 for the codec's default.
+    char* archive_path = NULL; // tar archive to write instead of files in out_dir.
 
-    parse_args(argc, argv, &print_ast_flag, &emit_schema_flag, &out_dir);
+    parse_args(argc, argv, &print_ast_flag, &emit_schema_flag, &stream_flag, &ndjson_flag, &out_dir,
+               &input_path, &threads, &stats_format, &schema_path, &drop_unknown_flag,
+               &append_flag, &format, &compression, &compression_level, &archive_path);
 
-    // To enable Bison's internal parsing trace, uncomment the following line:
-    // yydebug = 1;
+    if (threads == 0) {
+        fprintf(stderr, "Error: --threads expects a number between 1 and 1024.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (stats_format < 0) {
+        fprintf(stderr, "Error: --stats accepts no value, =text or =json.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (stream_flag && print_ast_flag) {
+        fprintf(stderr, "Error: --print-ast cannot be combined with --stream (no AST is built).\n");
+        return EXIT_FAILURE;
+    }
+
+    if (schema_path && print_ast_flag) {
+        fprintf(stderr, "Error: --print-ast cannot be combined with --schema (no AST is built).\n");
+        return EXIT_FAILURE;
+    }
+
+    if (drop_unknown_flag && !schema_path) {
+        fprintf(stderr, "Error: --drop-unknown needs --schema.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (format < 0) {
+        fprintf(stderr, "Error: --format accepts csv, columnar or pgcopy.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (append_flag && format != JSON2RELCSV_FORMAT_CSV) {
+        fprintf(stderr, "Error: --append only adds to CSV files.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (compression < 0 || compression_level < 0) {
+        fprintf(stderr, "Error: --compress accepts gzip or zstd, optionally followed by :LEVEL.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (append_flag && compression != JSON2RELCSV_COMPRESS_NONE) {
+        fprintf(stderr, "Error: --append cannot be combined with --compress (it adds to plain CSV files).\n");
+        return EXIT_FAILURE;
+    }
 
-    yyin = stdin; // Set lexer input to standard input.
+    if (append_flag && archive_path) {
+        fprintf(stderr, "Error: --append cannot be combined with --out-archive (it adds to files in --out-dir).\n");
+        return EXIT_FAILURE;
+    }
 
-    // Call the Bison-generated parser.
-    // yyparse() will read from yyin, build the AST, and store its root in ast_root.
-    if (yyparse() != 0) {
-        // An error message is typically printed by yyerror() within the parser.
-        fprintf(stderr, "Parsing failed.\n");
+    int archive_to_stdout = archive_path && strcmp(archive_path, "-") == 0;
+    if (archive_to_stdout && print_ast_flag) {
+        fprintf(stderr, "Error: --print-ast cannot be combined with --out-archive - (both write to standard output).\n");
         return EXIT_FAILURE;
     }
 
-    if (!ast_root) {
-        fprintf(stderr, "Error: AST root is null after parsing, even though yyparse reported success.\n");
+    if (append_flag && schema_path) {
+        fprintf(stderr, "Error: --append cannot be combined with --schema (the state file holds the schema).\n");
         return EXIT_FAILURE;
     }
 
-    if (print_ast_flag) {
-        print_ast(ast_root, 0);
-        printf("\n"); // Add a newline for cleaner output after AST print.
+    // To enable Bison's internal parsing trace, uncomment the following line:
+    // yydebug = 1;
+
+    Json2RelCsvOptions options;
+    memset(&options, 0, sizeof(options));
+    options.emit_schema = emit_schema_flag;
+    options.stream = stream_flag;
+    options.ndjson = ndjson_flag;
+    options.threads = threads;
+    options.print_ast = print_ast_flag;
+    Json2RelCsvStats stats;
+    memset(&stats, 0, sizeof(stats));
+    options.stats = stats_format ? &stats : NULL;
+    options.drop_unknown = drop_unknown_flag;
+    options.format = format;
+    options.compression = compression;
+    options.compression_level = compression_level;
+
+    Json2RelCsvError error;
+    Json2RelCsvSchema* schema = NULL;
+    if (schema_path) {
+        schema = json2relcsv_schema_load(schema_path, &error);
+        if (!schema) {
+            fprintf(stderr, "Error: %s\n", error.message);
+            return EXIT_FAILURE;
+        }
+        options.schema = schema;
     }
 
-    generate_csv_tables(ast_root, out_dir);
+    // The library does the work; the CLI only points it at the input and the output directory
+    // (or archive).
+    Json2RelCsvSink sink = json2relcsv_directory_sink(out_dir);
+    FILE* archive_file = NULL;
+    Json2RelCsvArchive* archive = NULL;
+    if (archive_path) {
+        archive_file = archive_to_stdout ? stdout : fopen(archive_path, "wb");
+        if (!archive_file) {
+            fprintf(stderr, "Error: Could not open file %s for writing\n", archive_path);
+            json2relcsv_schema_free(schema);
+            return EXIT_FAILURE;
+        }
+        archive = json2relcsv_archive_create(archive_file);
+        sink = json2relcsv_archive_sink(archive);
+    }
+    int from_file = input_path && strcmp(input_path, "-") != 0;
+    int result;
+    if (append_flag) {
+        result = from_file ? json2relcsv_append_file(input_path, &options, out_dir, &error)
+                           : json2relcsv_append_stream(stdin, &options, out_dir, &error);
+    } else if (from_file) {
+        result = json2relcsv_convert_file(input_path, &options, &sink, &error);
+    } else {
+        result = json2relcsv_convert_stream(stdin, &options, &sink, &error);
+    }
+    json2relcsv_schema_free(schema);
 
-    if (emit_schema_flag) {
-        emit_schema_json(ast_root, out_dir);
+    // The archive is only ended if the conversion succeeded, so a failed one is not
+    // mistaken for a complete archive. Members are written as their outputs close, which
+    // a failed conversion still does, so an archive file is removed then; standard
+    // output is left without the end-of-archive blocks.
+    if (archive) {
+        if (result == 0 && json2relcsv_archive_finish(archive) != 0) {
+            snprintf(error.message, sizeof(error.message), "Could not write the archive to %s.",
+                     archive_to_stdout ? "standard output" : archive_path);
+            result = -1;
+        }
+        json2relcsv_archive_free(archive);
+        if (!archive_to_stdout && fclose(archive_file) != 0 && result == 0) {
+            snprintf(error.message, sizeof(error.message), "Could not write the archive to %s.", archive_path);
+            result = -1;
+        }
+        // Only a regular file: the path may name a device (/dev/stdout, say).
+        struct stat archive_stat;
+        if (result != 0 && !archive_to_stdout && stat(archive_path, &archive_stat) == 0 &&
+            S_ISREG(archive_stat.st_mode)) {
+            remove(archive_path);
+        }
     }
 
-    free_ast(ast_root); // Release all memory allocated for the AST.
-    ast_root = NULL;    // Defensive: prevent dangling pointer use.
+    if (result != 0) {
+        fprintf(stderr, "Error: %s\n", error.message);
+        return EXIT_FAILURE;
+    }
+
+    // Statistics go to stderr, leaving stdout to --print-ast.
+    if (stats_format == 1) {
+        print_stats_text(stderr, &stats);
+    } else if (stats_format == 2) {
+        print_stats_json(stderr, &stats);
+    }
+    json2relcsv_stats_free(&stats);
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
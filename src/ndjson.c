@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ndjson.h"
+#include "json_parser.h"
+
+// One chunk of whole lines and the parser state that turns it into records.
+typedef struct {
+    const char* text;       // the whole input, for line numbers in error messages
+    const char* start;
+    size_t size;
+    Arena* arena;
+    ASTNode* records;       // the chunk's lines, as one array node
+    int result;             // json_parse()'s result
+    JsonParseError error;
+    JsonTokenCounts tokens; // this chunk's token counts
+} NdjsonChunk;
+
+static void parse_chunk(NdjsonChunk* chunk) {
+    ASTBuilder builder;
+    ast_builder_init(&builder, chunk->arena);
+    JsonEventHandler handler = ast_builder_handler(&builder);
+
+    JsonParseInput input;
+    memset(&input, 0, sizeof(input));
+    input.data = chunk->start;
+    input.size = chunk->size;
+    input.records = 1;
+    input.line_origin = chunk->text;
+    input.token_counts = &chunk->tokens;
+    chunk->result = json_parse(&input, &handler, &chunk->error);
+
+    chunk->records = builder.root;
+    ast_builder_free(&builder);
+}
+
+static void* parse_chunk_thread(void* arg) {
+    parse_chunk((NdjsonChunk*)arg);
+    return NULL;
+}
+
+int ndjson_parse(const char* text, size_t size, int chunk_count, Arena* arenas, ASTNode** root,
+                 JsonParseError* error, JsonTokenCounts* token_counts) {
+    if (chunk_count < 1) {
+        chunk_count = 1;
+    }
+
+    NdjsonChunk* chunks = (NdjsonChunk*)calloc(chunk_count, sizeof(NdjsonChunk));
+    pthread_t* workers = (pthread_t*)malloc(chunk_count * sizeof(pthread_t));
+    int* started = (int*)calloc(chunk_count, sizeof(int));
+    if (!chunks || !workers || !started) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Cut the text into roughly equal chunks, moving each cut past the next newline so
+    // that every chunk holds whole lines. Chunks may end up empty.
+    const char* end = text + size;
+    const char* start = text;
+    for (int c = 0; c < chunk_count; c++) {
+        const char* cut = end;
+        if (c < chunk_count - 1) {
+            cut = text + size / chunk_count * (c + 1);
+            if (cut < start) {
+                cut = start;
+            }
+            const char* newline = (const char*)memchr(cut, '\n', (size_t)(end - cut));
+            cut = newline ? newline + 1 : end;
+        }
+        chunks[c].text = text;
+        chunks[c].start = start;
+        chunks[c].size = (size_t)(cut - start);
+        chunks[c].arena = &arenas[c];
+        start = cut;
+    }
+
+    // Chunk 0 is parsed on this thread. If a thread cannot be started (e.g. a build
+    // without thread support), its chunk is parsed here afterwards.
+    for (int c = 1; c < chunk_count; c++) {
+        started[c] = pthread_create(&workers[c], NULL, parse_chunk_thread, &chunks[c]) == 0;
+    }
+    parse_chunk(&chunks[0]);
+    for (int c = 1; c < chunk_count; c++) {
+        if (started[c]) {
+            pthread_join(workers[c], NULL);
+        } else {
+            parse_chunk(&chunks[c]);
+        }
+    }
+
+    // Every chunk is parsed to completion (or to its own first error), so the error
+    // reported is always the first one in the text.
+    *root = NULL;
+    for (int c = 0; c < chunk_count; c++) {
+        if (chunks[c].result != 0) {
+            *error = chunks[c].error;
+            free(started);
+            free(workers);
+            free(chunks);
+            return -1;
+        }
+    }
+
+    if (token_counts) {
+        for (int c = 0; c < chunk_count; c++) {
+            token_counts->punctuation += chunks[c].tokens.punctuation;
+            token_counts->strings += chunks[c].tokens.strings;
+            token_counts->escaped_strings += chunks[c].tokens.escaped_strings;
+            token_counts->numbers += chunks[c].tokens.numbers;
+            token_counts->literals += chunks[c].tokens.literals;
+        }
+    }
+
+    // Join the chunks' records into the top-level array, in input order.
+    size_t total = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        total += chunks[c].records->value.array->count;
+    }
+    ASTNodeList* records = (ASTNodeList*)arena_alloc(&arenas[0], sizeof(ASTNodeList) + total * sizeof(ASTNode*));
+    records->count = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        ASTNodeList* part = chunks[c].records->value.array;
+        if (part->count > 0) {
+            memcpy(records->items + records->count, part->items, part->count * sizeof(ASTNode*));
+            records->count += part->count;
+        }
+    }
+
+    free(started);
+    free(workers);
+    free(chunks);
+    *root = create_array_node(&arenas[0], records);
+    return 0;
+}
@@ -1,48 +1,64 @@
+%code requires {
+#include "json_parser.h"
+// The scanner handle, as declared by Flex for a reentrant scanner.
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+}
+
 %{
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h" // Will contain AST node definitions
+#include "json_events.h"
+%}
 
-// Extern declarations for flex
-extern int yylex();
-extern int line_num;
-extern int column_num;
-extern FILE* yyin;
-extern int yydebug; // Declare yydebug for Bison trace
-
-// Root of the AST
-ASTNode* ast_root = NULL;
+%code {
+// Extern declaration for flex
+extern int yylex(YYSTYPE* yylval_param, yyscan_t yyscanner);
+
+// Forwards a scalar token to the event handler as a transient ASTNode.
+// 'text' is the decoded string for strings and the source lexeme for numbers.
+static void emit_scalar(JsonParseState* state, NodeType type, char* text, int boolean) {
+    ASTNode value;
+    value.type = type;
+    if (type == NODE_STRING) {
+        value.value.string = text;
+    } else if (type == NODE_NUMBER) {
+        value.value.number = text;
+    } else {
+        value.value.boolean = boolean;
+    }
+    state->events->scalar(state->events->ctx, &value);
+}
 
-// Error handling function
-void yyerror(const char* s) {
-    fprintf(stderr, "Error: %s at line %d, column %d\n", s, line_num, column_num);
-    exit(EXIT_FAILURE);
+// Error handling function: records the error; yyparse() then returns 1.
+static void yyerror(yyscan_t scanner, JsonParseState* state, const char* s) {
+    (void)scanner;
+    json_parse_fail(state, state->column_num, s);
+}
 }
 
-%}
+// A pure (reentrant) parser: the scanner handle and the parse state are passed in,
+// and events go to the state's handler, so parses can run concurrently.
+%define api.pure full
+%parse-param {yyscan_t scanner} {JsonParseState* state}
+%lex-param {yyscan_t scanner}
 
 %union {
-    double number;
     char* string;
     int boolean;
-    struct ASTNode* node;
-    struct KeyValuePair* pair;
-    struct KeyValueList* pairlist;
-    struct ASTNodeList* nodelist;
 }
 
 // Token definitions
 %token <string> STRING
-%token <number> NUMBER
+%token <string> NUMBER  // the lexeme, converted only where a value is needed
 %token <boolean> TRUE FALSE
 %token NUL
-
-// Non-terminal types
-%type <node> json_value object array
-%type <pair> pair
-%type <pairlist> pairs
-%type <nodelist> elements
+%token RECORDS  // sent first by the scanner when parsing JSON Lines
+%token LEX_ERROR  // malformed input; no rule accepts it, so the parse stops
 
 // Start symbol
 %start json
@@ -50,43 +66,58 @@ void yyerror(const char* s) {
 %%
 
 json: json_value
-    {
-        ast_root = $1;
-    }
+    | RECORDS           { state->events->start_array(state->events->ctx); }
+      records           { state->events->end_array(state->events->ctx); }
+    ;
+
+records:
+    %empty
+    | records json_value
     ;
 
 json_value:
-    object          { $$ = $1; }
-    | array         { $$ = $1; }
-    | STRING        { $$ = create_string_node($1); }
-    | NUMBER        { $$ = create_number_node($1); }
-    | TRUE          { $$ = create_boolean_node(1); }
-    | FALSE         { $$ = create_boolean_node(0); }
-    | NUL           { $$ = create_null_node(); }
+    object
+    | array
+    | STRING        { emit_scalar(state, NODE_STRING, $1, 0); }
+    | NUMBER        { emit_scalar(state, NODE_NUMBER, $1, 0); }
+    | TRUE          { emit_scalar(state, NODE_BOOLEAN, NULL, 1); }
+    | FALSE         { emit_scalar(state, NODE_BOOLEAN, NULL, 0); }
+    | NUL           { emit_scalar(state, NODE_NULL, NULL, 0); }
     ;
 
 object:
-    '{' '}'         { $$ = create_object_node(NULL); }
-    | '{' pairs '}' { $$ = create_object_node($2); }
+    '{'                 { state->events->start_object(state->events->ctx); }
+    pairs_opt '}'       { state->events->end_object(state->events->ctx); }
+    ;
+
+pairs_opt:
+    %empty
+    | pairs
     ;
 
 pairs:
-    pair                { $$ = create_key_value_list($1); }
-    | pairs ',' pair    { $$ = add_key_value_pair($1, $3); }
+    pair
+    | pairs ',' pair
     ;
 
 pair:
-    STRING ':' json_value { $$ = create_key_value_pair($1, $3); }
+    STRING              { state->events->key(state->events->ctx, $1); }
+    ':' json_value
     ;
 
 array:
-    '[' ']'             { $$ = create_array_node(NULL); }
-    | '[' elements ']'  { $$ = create_array_node($2); }
+    '['                 { state->events->start_array(state->events->ctx); }
+    elements_opt ']'    { state->events->end_array(state->events->ctx); }
+    ;
+
+elements_opt:
+    %empty
+    | elements
     ;
 
 elements:
-    json_value              { $$ = create_node_list($1); }
-    | elements ',' json_value { $$ = add_node_to_list($1, $3); }
+    json_value
+    | elements ',' json_value
     ;
 
-%%
\ No newline at end of file
+%%
@@ -0,0 +1,558 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgcopy.h"
+#include "csv_writer.h"
+#include "json_number.h"
+
+// The numeric limits of PostgreSQL's binary numeric format (numeric_recv()).
+#define NUMERIC_MAX_DIGITS 3000      // base-10000 digits
+#define NUMERIC_MAX_WEIGHT 32767
+#define NUMERIC_MAX_DSCALE 0x3FFF
+#define NUMERIC_NEGATIVE 0x4000
+
+// What the field being decoded is.
+typedef enum {
+    CELL_NULL,
+    CELL_STRING,   // quoted: a string
+    CELL_BARE      // unquoted: a number, true or false
+} CellKind;
+
+// Where the CSV decoder is within a row.
+typedef enum {
+    FIELD_START,   // before the first byte of a field
+    FIELD_BARE,    // in an unquoted field
+    FIELD_QUOTED,  // in a quoted field
+    FIELD_QUOTE    // just after a quote inside a quoted field: "" or the end of the field
+} FieldState;
+
+// One stream opened through the sink. Streams that are not a table's CSV only have
+// 'stream' set and are passed through.
+typedef struct PgCopyStream {
+    void* stream;           // on the inner sink
+    const TableSchema* table;
+    PgCopyType* types;      // per column
+    CsvBuffer out;          // the encoded file, bound to 'stream'
+    CsvBuffer cell;         // the text of the field being decoded
+    CellKind cell_kind;
+    size_t header_left;     // bytes of the CSV header row still to skip
+    int column;             // column of the field being decoded
+    FieldState state;
+    int failed;             // a value did not fit; the rest of the table is dropped
+} PgCopyStream;
+
+PgCopyType pgcopy_column_type(int types) {
+    types &= ~COLUMN_TYPE_NULL;
+    if (types == COLUMN_TYPE_BOOL) {
+        return PGCOPY_BOOLEAN;
+    }
+    if (types == COLUMN_TYPE_INT) {
+        return PGCOPY_BIGINT;
+    }
+    if (types && (types & ~(COLUMN_TYPE_INT | COLUMN_TYPE_NUMBER)) == 0) {
+        return PGCOPY_NUMERIC;
+    }
+    return PGCOPY_TEXT;
+}
+
+const char* pgcopy_type_name(int type) {
+    switch (type) {
+        case PGCOPY_BOOLEAN: return "boolean";
+        case PGCOPY_BIGINT: return "bigint";
+        case PGCOPY_TEXT: return "text";
+        case PGCOPY_NUMERIC: return "numeric";
+        default: return NULL;
+    }
+}
+
+// --- Encoding helpers ---
+
+static void put_int16(CsvBuffer* out, int value) {
+    csv_buffer_putc(out, (char)(value >> 8));
+    csv_buffer_putc(out, (char)value);
+}
+
+static void put_int32(CsvBuffer* out, long value) {
+    unsigned char bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (unsigned char)((unsigned long)value >> (24 - 8 * i));
+    }
+    csv_buffer_append(out, bytes, 4);
+}
+
+static void put_int64(CsvBuffer* out, long long value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (unsigned char)((unsigned long long)value >> (56 - 8 * i));
+    }
+    csv_buffer_append(out, bytes, 8);
+}
+
+static long floor_div4(long value) {
+    return value >= 0 ? value / 4 : -((-value + 3) / 4);
+}
+
+// Appends a number lexeme as a numeric field: base-10000 digits around the decimal
+// point, with the display scale of the lexeme, so "1.50" stays 1.50. Returns 0 if the
+// value is beyond what numeric can hold.
+static int put_numeric(CsvBuffer* out, const char* text, size_t len) {
+    const char* p = text;
+    const char* end = text + len;
+    int negative = (p < end && *p == '-');
+    if (negative) p++;
+
+    const char* int_digits = p;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    long int_len = (long)(p - int_digits);
+    const char* frac_digits = p;
+    long frac_len = 0;
+    if (p < end && *p == '.') {
+        frac_digits = ++p;
+        while (p < end && *p >= '0' && *p <= '9') p++;
+        frac_len = (long)(p - frac_digits);
+    }
+    long exponent = 0;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int exponent_negative = (p < end && *p == '-');
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (exponent < 1000000) {
+                exponent = exponent * 10 + (*p - '0');
+            }
+        }
+        if (exponent_negative) {
+            exponent = -exponent;
+        }
+    }
+
+    long dscale = frac_len - exponent > 0 ? frac_len - exponent : 0;
+    if (dscale > NUMERIC_MAX_DSCALE) {
+        return 0;
+    }
+
+    // Digit i of the int and fraction digits together is worth 10^(int_len - 1 - i + exponent).
+    long count = int_len + frac_len;
+    long first = 0;
+    long last = count - 1;
+#define DIGIT(i) ((i) < int_len ? int_digits[i] : frac_digits[(i) - int_len])
+    while (first < count && DIGIT(first) == '0') first++;
+    while (last >= first && DIGIT(last) == '0') last--;
+
+    if (first > last) {
+        put_int32(out, 8);
+        put_int16(out, 0);        // no digits: zero
+        put_int16(out, 0);
+        put_int16(out, 0);
+        put_int16(out, (int)dscale);
+        return 1;
+    }
+
+    long weight = floor_div4(int_len - 1 - first + exponent);
+    long lowest = floor_div4(int_len - 1 - last + exponent);
+    long ndigits = weight - lowest + 1;
+    if (weight > NUMERIC_MAX_WEIGHT || ndigits > NUMERIC_MAX_DIGITS) {
+        return 0;
+    }
+
+    static const int powers[] = {1, 10, 100, 1000};
+    int digits[NUMERIC_MAX_DIGITS];
+    memset(digits, 0, (size_t)ndigits * sizeof(int));
+    for (long i = first; i <= last; i++) {
+        long power = int_len - 1 - i + exponent;
+        long group = floor_div4(power);
+        digits[weight - group] += (DIGIT(i) - '0') * powers[power - 4 * group];
+    }
+#undef DIGIT
+
+    put_int32(out, 8 + 2 * ndigits);
+    put_int16(out, (int)ndigits);
+    put_int16(out, (int)weight);
+    put_int16(out, negative ? NUMERIC_NEGATIVE : 0);
+    put_int16(out, (int)dscale);
+    for (long i = 0; i < ndigits; i++) {
+        put_int16(out, digits[i]);
+    }
+    return 1;
+}
+
+// --- CSV decoding ---
+
+// Records why the table cannot be written, unless another one failed first.
+static void stream_failed(PgCopySink* pgcopy, PgCopyStream* ps, const char* what) {
+    ps->failed = 1;
+    pthread_mutex_lock(&pgcopy->lock);
+    if (!pgcopy->error[0]) {
+        snprintf(pgcopy->error, sizeof(pgcopy->error), "Column \"%.40s\" of table \"%.40s\" %s",
+                 ps->table->columns[ps->column], ps->table->name, what);
+    }
+    pthread_mutex_unlock(&pgcopy->lock);
+}
+
+// Appends the field just decoded in its column's type.
+static void put_field(PgCopySink* pgcopy, PgCopyStream* ps) {
+    const char* text = ps->cell.data;
+    size_t len = ps->cell.len;
+    if (ps->cell_kind == CELL_NULL) {
+        put_int32(&ps->out, -1);
+        return;
+    }
+
+    int is_true = ps->cell_kind == CELL_BARE && len == 4 && memcmp(text, "true", 4) == 0;
+    int is_false = ps->cell_kind == CELL_BARE && len == 5 && memcmp(text, "false", 5) == 0;
+    int is_number = ps->cell_kind == CELL_BARE && !is_true && !is_false;
+    long long value;
+    switch (ps->types[ps->column]) {
+        case PGCOPY_BOOLEAN:
+            if (!is_true && !is_false) {
+                stream_failed(pgcopy, ps, "has a value that is not a boolean");
+                return;
+            }
+            put_int32(&ps->out, 1);
+            csv_buffer_putc(&ps->out, (char)is_true);
+            return;
+        case PGCOPY_BIGINT:
+            if (!is_number || !json_number_to_int64(text, len, &value)) {
+                stream_failed(pgcopy, ps, "has a value that is not a 64-bit integer");
+                return;
+            }
+            put_int32(&ps->out, 8);
+            put_int64(&ps->out, value);
+            return;
+        case PGCOPY_NUMERIC:
+            if (!is_number) {
+                stream_failed(pgcopy, ps, "has a value that is not a number");
+            } else if (!put_numeric(&ps->out, text, len)) {
+                stream_failed(pgcopy, ps, "has a number beyond the range of numeric");
+            }
+            return;
+        default:
+            put_int32(&ps->out, (long)len);
+            csv_buffer_append(&ps->out, text, len);
+            return;
+    }
+}
+
+static void begin_cell(PgCopyStream* ps, CellKind kind) {
+    ps->cell_kind = kind;
+    ps->cell.len = 0;
+}
+
+static void end_cell(PgCopySink* pgcopy, PgCopyStream* ps) {
+    if (ps->column == 0) {
+        put_int16(&ps->out, ps->table->column_count);
+    }
+    // Fields past the last column, which a well-formed row never has, are dropped.
+    if (ps->column < ps->table->column_count && !ps->failed) {
+        put_field(pgcopy, ps);
+    }
+    ps->column++;
+}
+
+static void end_row(PgCopySink* pgcopy, PgCopyStream* ps) {
+    while (ps->column < ps->table->column_count) {
+        begin_cell(ps, CELL_NULL);
+        end_cell(pgcopy, ps);
+    }
+    ps->column = 0;
+}
+
+// Decodes CSV as the writers produce it (csv_writer.h): strings quoted, numbers and
+// booleans bare, null empty, rows ending in '\n'.
+static void decode_csv(PgCopySink* pgcopy, PgCopyStream* ps, const char* p, const char* end) {
+    while (p < end) {
+        switch (ps->state) {
+            case FIELD_START:
+                if (*p == '"') {
+                    begin_cell(ps, CELL_STRING);
+                    ps->state = FIELD_QUOTED;
+                    p++;
+                } else if (*p == ',' || *p == '\n') {
+                    begin_cell(ps, CELL_NULL);
+                    end_cell(pgcopy, ps);
+                    if (*p == '\n') {
+                        end_row(pgcopy, ps);
+                    }
+                    p++;
+                } else {
+                    begin_cell(ps, CELL_BARE);
+                    ps->state = FIELD_BARE;
+                }
+                break;
+            case FIELD_BARE: {
+                const char* stop = p;
+                while (stop < end && *stop != ',' && *stop != '\n') {
+                    stop++;
+                }
+                csv_buffer_append(&ps->cell, p, (size_t)(stop - p));
+                p = stop;
+                if (p < end) {
+                    end_cell(pgcopy, ps);
+                    if (*p == '\n') {
+                        end_row(pgcopy, ps);
+                    }
+                    ps->state = FIELD_START;
+                    p++;
+                }
+                break;
+            }
+            case FIELD_QUOTED: {
+                const char* quote = (const char*)memchr(p, '"', (size_t)(end - p));
+                const char* stop = quote ? quote : end;
+                csv_buffer_append(&ps->cell, p, (size_t)(stop - p));
+                p = stop;
+                if (quote) {
+                    ps->state = FIELD_QUOTE;
+                    p++;
+                }
+                break;
+            }
+            case FIELD_QUOTE:
+                if (*p == '"') {
+                    csv_buffer_putc(&ps->cell, '"');
+                    ps->state = FIELD_QUOTED;
+                } else {
+                    end_cell(pgcopy, ps);
+                    if (*p == '\n') {
+                        end_row(pgcopy, ps);
+                    }
+                    ps->state = FIELD_START;
+                }
+                p++;
+                break;
+        }
+    }
+}
+
+// --- Sink ---
+
+static void* pgcopy_open(void* ctx, const char* name) {
+    PgCopySink* pgcopy = (PgCopySink*)ctx;
+    PgCopyStream* ps = (PgCopyStream*)calloc(1, sizeof(PgCopyStream));
+    if (!ps) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t len = strlen(name);
+    char* table_name = (char*)malloc(len + sizeof(PGCOPY_FILE_EXTENSION));
+    if (!table_name) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(table_name, name, len + 1);
+    if (len > 4 && strcmp(name + len - 4, ".csv") == 0) {
+        table_name[len - 4] = '\0';
+        ps->table = find_table(pgcopy->context, table_name);
+    }
+
+    if (!ps->table) {
+        free(table_name);
+        ps->stream = pgcopy->inner->open(pgcopy->inner->ctx, name);
+        if (!ps->stream) {
+            free(ps);
+            return NULL;
+        }
+        return ps;
+    }
+
+    strcat(table_name, PGCOPY_FILE_EXTENSION);
+    ps->stream = pgcopy->inner->open(pgcopy->inner->ctx, table_name);
+    free(table_name);
+    if (!ps->stream) {
+        free(ps);
+        return NULL;
+    }
+
+    const TableSchema* table = ps->table;
+    ps->types = (PgCopyType*)malloc(((size_t)table->column_count + 1) * sizeof(PgCopyType));
+    if (!ps->types) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < table->column_count; c++) {
+        ps->types[c] = pgcopy_column_type(table->column_stats[c].types);
+    }
+    csv_buffer_reserve(&ps->cell, 256);  // never NULL, even for ""
+    ps->state = FIELD_START;
+
+    // The header row is the column names joined with commas (see write_csv_files()).
+    ps->header_left = 1;
+    size_t extension_len = PGCOPY_EXTENSION_TAG_SIZE + 4;
+    for (int c = 0; c < table->column_count; c++) {
+        ps->header_left += strlen(table->columns[c]) + (c > 0 ? 1 : 0);
+        extension_len += 8 + strlen(table->columns[c]);
+    }
+
+    csv_buffer_init(&ps->out, pgcopy->inner, ps->stream);
+    csv_buffer_append(&ps->out, PGCOPY_SIGNATURE, PGCOPY_SIGNATURE_SIZE);
+    put_int32(&ps->out, 0);
+    put_int32(&ps->out, (long)extension_len);
+    csv_buffer_append(&ps->out, PGCOPY_EXTENSION_TAG, PGCOPY_EXTENSION_TAG_SIZE);
+    put_int32(&ps->out, table->column_count);
+    for (int c = 0; c < table->column_count; c++) {
+        size_t name_len = strlen(table->columns[c]);
+        put_int32(&ps->out, ps->types[c]);
+        put_int32(&ps->out, (long)name_len);
+        csv_buffer_append(&ps->out, table->columns[c], name_len);
+    }
+
+    if (table->column_count > PGCOPY_MAX_COLUMNS) {
+        ps->column = 0;
+        stream_failed(pgcopy, ps, "is past the 1600 columns PostgreSQL allows in a table");
+    }
+    return ps;
+}
+
+// A value that does not fit its column is reported through pgcopy->error, not here.
+static int pgcopy_write(void* ctx, void* handle, const char* data, size_t len) {
+    PgCopySink* pgcopy = (PgCopySink*)ctx;
+    PgCopyStream* ps = (PgCopyStream*)handle;
+    if (!ps->table) {
+        return pgcopy->inner->write(pgcopy->inner->ctx, ps->stream, data, len);
+    }
+    if (ps->failed) {
+        return 0;
+    }
+
+    size_t skip = ps->header_left < len ? ps->header_left : len;
+    ps->header_left -= skip;
+    decode_csv(pgcopy, ps, data + skip, data + len);
+    return ps->out.failed ? -1 : 0;
+}
+
+static int pgcopy_close(void* ctx, void* handle) {
+    PgCopySink* pgcopy = (PgCopySink*)ctx;
+    PgCopyStream* ps = (PgCopyStream*)handle;
+    int status;
+    if (ps->table) {
+        if (!ps->failed) {
+            // A last row without its '\n'.
+            if (ps->state != FIELD_START) {
+                end_cell(pgcopy, ps);
+            }
+            if (ps->column > 0) {
+                end_row(pgcopy, ps);
+            }
+            put_int16(&ps->out, -1);
+        }
+        status = csv_buffer_close(&ps->out);
+        csv_buffer_free(&ps->cell);
+        free(ps->types);
+    } else {
+        status = pgcopy->inner->close(pgcopy->inner->ctx, ps->stream);
+    }
+    free(ps);
+    return status;
+}
+
+Json2RelCsvSink pgcopy_sink(PgCopySink* pgcopy, const Json2RelCsvSink* inner, const SchemaContext* context) {
+    pgcopy->inner = inner;
+    pgcopy->context = context;
+    pthread_mutex_init(&pgcopy->lock, NULL);
+    pgcopy->error[0] = '\0';
+
+    Json2RelCsvSink sink;
+    sink.open = pgcopy_open;
+    sink.write = pgcopy_write;
+    sink.close = pgcopy_close;
+    sink.ctx = pgcopy;
+    return sink;
+}
+
+void pgcopy_sink_destroy(PgCopySink* pgcopy) {
+    pthread_mutex_destroy(&pgcopy->lock);
+}
+
+// --- DDL ---
+
+static void put(CsvBuffer* out, const char* text) {
+    csv_buffer_append(out, text, strlen(text));
+}
+
+// Appends a quoted SQL identifier, doubling embedded quotes.
+static void put_identifier(CsvBuffer* out, const char* name) {
+    csv_buffer_putc(out, '"');
+    for (const char* p = name; *p; p++) {
+        if (*p == '"') {
+            csv_buffer_putc(out, '"');
+        }
+        csv_buffer_putc(out, *p);
+    }
+    csv_buffer_putc(out, '"');
+}
+
+int write_schema_sql(const SchemaContext* context, const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    void* stream = sink->open(sink->ctx, PGCOPY_DDL_FILE_NAME);
+    if (!stream) {
+        csv_output_error(error, PGCOPY_DDL_FILE_NAME);
+        return -1;
+    }
+    CsvBuffer out;
+    csv_buffer_init(&out, sink, stream);
+
+    // The list is newest-first; tables are created after their parents.
+    TableSchema** by_index = (TableSchema**)malloc((context->table_count > 0 ? context->table_count : 1) *
+                                                   sizeof(TableSchema*));
+    if (!by_index) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (TableSchema* t = context->tables; t; t = t->next) {
+        by_index[t->index] = t;
+    }
+
+    put(&out, "-- The tables of json2relcsv --format=pgcopy, parents first. Create them, load each one with\n"
+              "--   COPY \"<table>\" FROM '/path/<table>.pgcopy' WITH (FORMAT binary);\n"
+              "-- then add the foreign keys at the end. They are NOT VALID, i.e. not checked against\n"
+              "-- the rows already loaded: a key is not guaranteed to match an ID of the parent table.\n");
+    for (int i = 0; i < context->table_count; i++) {
+        const TableSchema* t = by_index[i];
+        put(&out, "\nCREATE TABLE ");
+        put_identifier(&out, t->name);
+        put(&out, " (\n");
+        for (int c = 0; c < t->column_count; c++) {
+            put(&out, "    ");
+            put_identifier(&out, t->columns[c]);
+            csv_buffer_putc(&out, ' ');
+            put(&out, pgcopy_type_name(pgcopy_column_type(t->column_stats[c].types)));
+            if (strcmp(t->columns[c], "id") == 0) {
+                put(&out, " PRIMARY KEY");
+            }
+            put(&out, c < t->column_count - 1 ? ",\n" : "\n");
+        }
+        put(&out, ");\n");
+    }
+
+    int has_foreign_keys = 0;
+    for (int i = 0; i < context->table_count; i++) {
+        const TableSchema* t = by_index[i];
+        const TableSchema* parent = t->parent ? find_table(context, t->parent) : NULL;
+        char fk_name[256];
+        if (!parent || find_column(parent, "id") < 0) {
+            continue;
+        }
+        snprintf(fk_name, sizeof(fk_name), "%s_id", t->parent);
+        if (find_column(t, fk_name) < 0) {
+            continue;
+        }
+        if (!has_foreign_keys) {
+            csv_buffer_putc(&out, '\n');
+            has_foreign_keys = 1;
+        }
+        put(&out, "ALTER TABLE ");
+        put_identifier(&out, t->name);
+        put(&out, " ADD FOREIGN KEY (");
+        put_identifier(&out, fk_name);
+        put(&out, ") REFERENCES ");
+        put_identifier(&out, parent->name);
+        put(&out, " (\"id\") NOT VALID;\n");
+    }
+
+    free(by_index);
+    if (csv_buffer_close(&out) != 0) {
+        csv_output_error(error, PGCOPY_DDL_FILE_NAME);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "row_ids.h"
+
+void row_ids_set_delta(RowIdCounter* counter, RowIds* ids, int delta) {
+    if (ids->mark_count == ids->mark_capacity) {
+        ids->mark_capacity = ids->mark_capacity ? ids->mark_capacity * 2 : 16;
+        ids->marks = (IdDeltaMark*)realloc(ids->marks, ids->mark_capacity * sizeof(IdDeltaMark));
+        if (!ids->marks) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    counter->version++;
+    ids->marks[ids->mark_count].version = counter->version;
+    ids->marks[ids->mark_count].delta = delta;
+    ids->mark_count++;
+    ids->delta = delta;
+}
+
+// Returns the offset a table had at the given version (binary search over its checkpoints).
+static int delta_at(const RowIds* ids, unsigned long version) {
+    int lo = 0, hi = ids->mark_count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ids->marks[mid].version <= version) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found >= 0 ? ids->marks[found].delta : 0;
+}
+
+int row_ids_parent_id(const RowIds* ids, const ParentRef* parent) {
+    return parent->base_id + delta_at(ids, parent->version);
+}
+
+void row_ids_compact(RowIds* ids, const unsigned long* live_versions, int live_count) {
+    int kept = 0;
+    int live = 0;
+    for (int i = 0; i < ids->mark_count; i++) {
+        int is_last = (i == ids->mark_count - 1);
+        unsigned long next_version = is_last ? 0 : ids->marks[i + 1].version;
+
+        // Skip live versions that predate this mark; they resolve to an earlier one.
+        while (live < live_count && live_versions[live] < ids->marks[i].version) {
+            live++;
+        }
+        // Mark i answers lookups for versions in [its version, next mark's version).
+        int needed = is_last || (live < live_count && live_versions[live] < next_version);
+        if (needed) {
+            ids->marks[kept++] = ids->marks[i];
+        }
+    }
+    ids->mark_count = kept;
+}
+
+void row_ids_free(RowIds* ids) {
+    free(ids->marks);
+    ids->marks = NULL;
+    ids->mark_count = ids->mark_capacity = 0;
+}
@@ -0,0 +1,666 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "schema.h"
+#include "ast.h"
+#include "csv_writer.h"
+#include "json_parser.h"
+
+// Lookups go through open-addressing hash indexes (linear probing) kept next to the
+// ordered lists, so the lists keep their first-seen order for output.
+#define SCHEMA_INITIAL_SLOTS 16
+
+// FNV-1a: cheap, and spreads short identifier-like names well.
+static unsigned int hash_name(const char* name) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+SchemaContext schema_context_init(void) {
+    SchemaContext context = {NULL, 0, 1, 1, NULL, 0}; // Start IDs from 1
+    return context;
+}
+
+SchemaContext schema_context_copy(const SchemaContext* schema) {
+    SchemaContext copy = schema_context_init();
+    copy.first_id = schema->first_id;
+
+    // The list is newest-first; recreate the tables oldest-first so indexes match.
+    TableSchema** by_index = (TableSchema**)malloc((schema->table_count > 0 ? schema->table_count : 1) *
+                                                   sizeof(TableSchema*));
+    if (!by_index) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (TableSchema* t = schema->tables; t; t = t->next) {
+        by_index[t->index] = t;
+    }
+    for (int i = 0; i < schema->table_count; i++) {
+        TableSchema* table = find_or_create_table(&copy, by_index[i]->name);
+        table->kind = by_index[i]->kind;
+        table->row_estimate = by_index[i]->row_estimate;  // keeps the columns' row counts meaningful
+        if (by_index[i]->parent) {
+            table->parent = strdup(by_index[i]->parent);
+        }
+        for (int c = 0; c < by_index[i]->column_count; c++) {
+            int column = add_column(table, by_index[i]->columns[c]);  // may move column_stats
+            table->column_stats[column] = by_index[i]->column_stats[c];
+        }
+    }
+    free(by_index);
+    return copy;
+}
+
+// Returns the slot holding 'name', or the empty slot where it would go.
+static TableSchema** table_slot(const SchemaContext* context, const char* name) {
+    unsigned int mask = (unsigned int)context->table_slot_capacity - 1;
+    unsigned int i = hash_name(name) & mask;
+    while (context->table_slots[i] && strcmp(context->table_slots[i]->name, name) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &context->table_slots[i];
+}
+
+// Doubles the table index (or creates it) and reinserts every table.
+static void grow_table_slots(SchemaContext* context) {
+    int capacity = context->table_slot_capacity ? context->table_slot_capacity * 2 : SCHEMA_INITIAL_SLOTS;
+    free(context->table_slots);
+    context->table_slots = (TableSchema**)calloc(capacity, sizeof(TableSchema*));
+    if (!context->table_slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    context->table_slot_capacity = capacity;
+
+    for (TableSchema* table = context->tables; table; table = table->next) {
+        *table_slot(context, table->name) = table;
+    }
+}
+
+// Finds a TableSchema by name; NULL if no such table exists.
+TableSchema* find_table(const SchemaContext* context, const char* name) {
+    if (context->table_count == 0) {
+        return NULL;
+    }
+    return *table_slot(context, name);
+}
+
+// Finds a TableSchema by name in the SchemaContext, or creates and adds a new one if not found.
+TableSchema* find_or_create_table(SchemaContext* context, const char* name) {
+    // Keep the index at most half full so probe sequences stay short.
+    if (2 * (context->table_count + 1) > context->table_slot_capacity) {
+        grow_table_slots(context);
+    }
+
+    // Check if table already exists
+    TableSchema** slot = table_slot(context, name);
+    if (*slot) {
+        return *slot;
+    }
+
+    // Create new table if not found
+    TableSchema* table = (TableSchema*)malloc(sizeof(TableSchema));
+    if (!table) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    table->name = strdup(name);
+    table->columns = NULL;
+    table->column_stats = NULL;
+    table->column_count = 0;
+    table->column_capacity = 0;
+    table->column_slots = NULL;
+    table->column_slot_capacity = 0;
+    table->parent = NULL;
+    table->kind = TABLE_OBJECT;  // default; overwritten in analyze_node
+    table->index = context->table_count++;
+    table->row_estimate = 0;
+    table->rows_written = 0;
+    table->bytes_written = 0;
+    table->last_id = 0;
+    table->next = context->tables;
+    context->tables = table;
+    *slot = table;
+
+    return table;
+}
+
+// Returns the column-index slot holding 'column', or the empty slot where it would go.
+static int* column_slot(const TableSchema* table, const char* column) {
+    unsigned int mask = (unsigned int)table->column_slot_capacity - 1;
+    unsigned int i = hash_name(column) & mask;
+    while (table->column_slots[i] && strcmp(table->columns[table->column_slots[i] - 1], column) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &table->column_slots[i];
+}
+
+// Doubles a table's column index (or creates it) and reinserts every column.
+static void grow_column_slots(TableSchema* table) {
+    int capacity = table->column_slot_capacity ? table->column_slot_capacity * 2 : SCHEMA_INITIAL_SLOTS;
+    free(table->column_slots);
+    table->column_slots = (int*)calloc(capacity, sizeof(int));
+    if (!table->column_slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    table->column_slot_capacity = capacity;
+
+    for (int i = 0; i < table->column_count; i++) {
+        *column_slot(table, table->columns[i]) = i + 1;
+    }
+}
+
+int find_column(const TableSchema* table, const char* column) {
+    if (table->column_count == 0) {
+        return -1;
+    }
+    return *column_slot(table, column) - 1;
+}
+
+// Adds a column to a TableSchema if it doesn't already exist, and returns its position.
+// Column names are duplicated to ensure they have their own memory.
+int add_column(TableSchema* table, const char* column) {
+    if (2 * (table->column_count + 1) > table->column_slot_capacity) {
+        grow_column_slots(table);
+    }
+
+    // Check if column already exists
+    int* slot = column_slot(table, column);
+    if (*slot) {
+        return *slot - 1;  // Column already exists
+    }
+
+    // Add new column, growing the arrays geometrically
+    if (table->column_count == table->column_capacity) {
+        table->column_capacity = table->column_capacity ? table->column_capacity * 2 : 8;
+        table->columns = (char**)realloc(table->columns, table->column_capacity * sizeof(char*));
+        table->column_stats = (ColumnStats*)realloc(table->column_stats,
+                                                    table->column_capacity * sizeof(ColumnStats));
+        if (!table->columns || !table->column_stats) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memset(&table->column_stats[table->column_count], 0, sizeof(ColumnStats));
+    table->columns[table->column_count++] = strdup(column);
+    *slot = table->column_count;
+    return table->column_count - 1;
+}
+
+// A column counts one value per row of its table, however many it is given.
+void add_column_value(TableSchema* table, int column, int types, size_t length) {
+    if (!types) {
+        return;
+    }
+    ColumnStats* stats = &table->column_stats[column];
+    stats->types |= types;
+    if (stats->last_row != table->row_estimate) {
+        stats->last_row = table->row_estimate;
+        stats->rows++;
+    }
+    if (length > stats->max_length) {
+        stats->max_length = length;
+    }
+}
+
+void add_scalar_value(TableSchema* table, int column, const ASTNode* value) {
+    add_column_value(table, column, ast_scalar_type(value),
+                     value->type == NODE_STRING ? strlen(value->value.string) : 0);
+}
+
+void add_typed_column(TableSchema* table, const char* column, int types) {
+    int index = add_column(table, column);  // may move column_stats
+    add_column_value(table, index, types, 0);
+}
+
+int column_nullable(const TableSchema* table, int column) {
+    const ColumnStats* stats = &table->column_stats[column];
+    return (stats->types & COLUMN_TYPE_NULL) || stats->rows < table->row_estimate;
+}
+
+// Frees all TableSchema entries in context (columns, parent, name, node).
+void free_schema(SchemaContext* context) {
+    TableSchema* table = context->tables;
+    while (table) {
+        TableSchema* next = table->next;
+        for (int i = 0; i < table->column_count; i++) {
+            free(table->columns[i]);
+        }
+        free(table->columns);
+        free(table->column_stats);
+        free(table->column_slots);
+        free(table->name);
+        if (table->parent) {
+            free(table->parent);
+        }
+        free(table);
+        table = next;
+    }
+    context->tables = NULL;
+    context->table_count = 0;
+    free(context->table_slots);
+    context->table_slots = NULL;
+    context->table_slot_capacity = 0;
+}
+
+// Converts a string into a "safe" filename by replacing non-alphanumeric characters (except '_') with '_'.
+// If the input name is NULL or empty, defaults to "unnamed".
+char* safe_filename(const char* name) {
+    if (!name || strcmp(name, "") == 0) {
+        return strdup("unnamed");
+    }
+
+    // Make a copy we can modify
+    char* result = strdup(name);
+
+    // Replace special characters
+    for (char* p = result; *p; p++) {
+        if (!isalnum(*p) && *p != '_') {
+            *p = '_';
+        }
+    }
+
+    return result;
+}
+
+// Returns the output name of a table's CSV: a new heap string "<table_name>.csv".
+char* get_csv_file_name(const char* table_name) {
+    size_t len = strlen(table_name) + 5;  // +5 for ".csv" + null terminator
+    char* name = (char*)malloc(len);
+    if (!name) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(name, len, "%s.csv", table_name);
+    return name;
+}
+
+// Appends a NUL-terminated string to the output.
+static void put(CsvBuffer* out, const char* s) {
+    csv_buffer_append(out, s, strlen(s));
+}
+
+// Writes a JSON-escaped string (handles ", \, and control chars) to the output.
+static void write_json_escaped_string(CsvBuffer* out, const char* s) {
+    csv_buffer_putc(out, '"');
+    for (; *s; s++) {
+        if (*s == '"') {
+            put(out, "\\\"");
+        } else if (*s == '\\') {
+            put(out, "\\\\");
+        } else if ((unsigned char)*s < 0x20) {
+            // Control characters must be \u-escaped for valid JSON (RFC 8259).
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*s);
+            put(out, escape);
+        } else {
+            csv_buffer_putc(out, *s);
+        }
+    }
+    csv_buffer_putc(out, '"');
+}
+
+// The "types" names of ColumnType bits in schema.json, in the order they are listed.
+static const struct {
+    int type;
+    const char* name;
+} column_type_names[] = {
+    {COLUMN_TYPE_BOOL, "boolean"},
+    {COLUMN_TYPE_INT, "integer"},
+    {COLUMN_TYPE_NUMBER, "number"},
+    {COLUMN_TYPE_STRING, "string"}
+};
+#define COLUMN_TYPE_NAME_COUNT (int)(sizeof(column_type_names) / sizeof(column_type_names[0]))
+
+// Writes a column's "columnTypes" entry (see write_schema_json()).
+static void write_column_types(CsvBuffer* out, const TableSchema* table, int column) {
+    const ColumnStats* stats = &table->column_stats[column];
+    if (stats->types & COLUMN_TYPE_ANY) {
+        put(out, "null");
+        return;
+    }
+    put(out, "{\"types\": [");
+    int listed = 0;
+    for (int i = 0; i < COLUMN_TYPE_NAME_COUNT; i++) {
+        if (stats->types & column_type_names[i].type) {
+            put(out, listed++ ? ", \"" : "\"");
+            put(out, column_type_names[i].name);
+            put(out, "\"");
+        }
+    }
+    put(out, column_nullable(table, column) ? "], \"nullable\": true" : "], \"nullable\": false");
+    if (stats->types & COLUMN_TYPE_STRING) {
+        char max_length[48];
+        snprintf(max_length, sizeof(max_length), ", \"maxLength\": %zu", stats->max_length);
+        put(out, max_length);
+    }
+    put(out, "}");
+}
+
+int schema_last_id(const SchemaContext* context) {
+    int last_id = context->first_id - 1;
+    for (TableSchema* t = context->tables; t; t = t->next) {
+        if (t->last_id > last_id) {
+            last_id = t->last_id;
+        }
+    }
+    return last_id;
+}
+
+// Writes a schema document named 'name' to 'sink'; with_last_id adds the --append state.
+// Returns -1 and fills 'error' if the sink fails it.
+static int write_schema_document(const SchemaContext* context, const Json2RelCsvSink* sink, const char* name,
+                                 int with_last_id, Json2RelCsvError* error) {
+    void* stream = sink->open(sink->ctx, name);
+    if (!stream) {
+        csv_output_error(error, name);
+        return -1;
+    }
+
+    CsvBuffer out;
+    csv_buffer_init(&out, sink, stream);
+
+    // Count tables for pretty printing
+    int table_count = 0;
+    for (TableSchema* t = context->tables; t; t = t->next) {
+        table_count++;
+    }
+
+    put(&out, "{\n");
+    if (with_last_id) {
+        put(&out, "  \"lastId\": ");
+        csv_buffer_append_int(&out, schema_last_id(context));
+        put(&out, ",\n");
+    }
+    put(&out, "  \"tables\": [\n");
+
+    int table_idx = 0;
+    TableSchema* t = context->tables;
+    while (t) {
+        put(&out, "    {");
+
+        // name
+        put(&out, " \"name\": ");
+        write_json_escaped_string(&out, t->name);
+
+        // kind
+        const char* kind_str = (t->kind == TABLE_ARRAY) ? "array"
+                             : (t->kind == TABLE_JUNCTION) ? "junction"
+                             : "object";
+        put(&out, ", \"kind\": \"");
+        put(&out, kind_str);
+        put(&out, "\"");
+
+        // primaryKey (always "id")
+        put(&out, ", \"primaryKey\": \"id\"");
+
+        // parent
+        put(&out, ", \"parent\": ");
+        if (t->parent) {
+            write_json_escaped_string(&out, t->parent);
+        } else {
+            put(&out, "null");
+        }
+
+        // foreignKey
+        put(&out, ", \"foreignKey\": ");
+        if (t->parent) {
+            char fk_buf[512];
+            snprintf(fk_buf, sizeof(fk_buf), "%s_id", t->parent);
+            write_json_escaped_string(&out, fk_buf);
+        } else {
+            put(&out, "null");
+        }
+
+        // columns array (preserving insertion order)
+        put(&out, ", \"columns\": [");
+        for (int i = 0; i < t->column_count; i++) {
+            write_json_escaped_string(&out, t->columns[i]);
+            if (i < t->column_count - 1) {
+                put(&out, ", ");
+            }
+        }
+        put(&out, "]");
+
+        // columnTypes: what the schema pass saw in each column
+        put(&out, ", \"columnTypes\": [");
+        for (int i = 0; i < t->column_count; i++) {
+            write_column_types(&out, t, i);
+            if (i < t->column_count - 1) {
+                put(&out, ", ");
+            }
+        }
+        put(&out, "] }");
+
+        table_idx++;
+        if (table_idx < table_count) {
+            put(&out, ",");
+        }
+        put(&out, "\n");
+
+        t = t->next;
+    }
+
+    put(&out, "  ]\n}\n");
+    if (csv_buffer_close(&out) != 0) {
+        csv_output_error(error, name);
+        return -1;
+    }
+    return 0;
+}
+
+// Writes schema.json describing the tables in 'context' to 'sink'.
+int write_schema_json(const SchemaContext* context, const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    return write_schema_document(context, sink, "schema.json", 0, error);
+}
+
+int write_state_json(const SchemaContext* context, const Json2RelCsvSink* sink, Json2RelCsvError* error) {
+    return write_schema_document(context, sink, SCHEMA_STATE_FILE_NAME, 1, error);
+}
+
+// Fills in 'error' for a schema.json that is not one write_schema_json() could have written.
+static int schema_file_error(Json2RelCsvError* error, const char* what, const char* name) {
+    error->line = 0;
+    error->column = 0;
+    if (name) {
+        snprintf(error->message, sizeof(error->message), "Invalid schema: %s \"%s\"", what, name);
+    } else {
+        snprintf(error->message, sizeof(error->message), "Invalid schema: %s", what);
+    }
+    return -1;
+}
+
+// Returns the value of the first member named 'key' of an object node, or NULL.
+static const ASTNode* find_member(const ASTNode* object, const char* key) {
+    const KeyValueList* list = object->value.object;
+    for (size_t i = 0; i < list->count; i++) {
+        if (strcmp(list->pairs[i].key->text, key) == 0) {
+            return list->pairs[i].value;
+        }
+    }
+    return NULL;
+}
+
+// Returns 1 if 'name' could be a table name, i.e. safe_filename() leaves it unchanged.
+// Table names become output file names, so nothing else is accepted.
+static int is_table_name(const char* name) {
+    if (*name == '\0') {
+        return 0;
+    }
+    for (const char* p = name; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Loads a "columnTypes" entry (see write_schema_json()) into 'stats'; returns -1 if it is
+// not one.
+static int load_column_types(const ASTNode* entry, ColumnStats* stats) {
+    if (entry->type == NODE_NULL) {
+        stats->types = COLUMN_TYPE_ANY | COLUMN_TYPE_NULL;
+        return 0;
+    }
+    const ASTNode* types = entry->type == NODE_OBJECT ? find_member(entry, "types") : NULL;
+    const ASTNode* nullable = entry->type == NODE_OBJECT ? find_member(entry, "nullable") : NULL;
+    const ASTNode* max_length = entry->type == NODE_OBJECT ? find_member(entry, "maxLength") : NULL;
+    if (!types || types->type != NODE_ARRAY || !nullable || nullable->type != NODE_BOOLEAN) {
+        return -1;
+    }
+    for (size_t i = 0; i < types->value.array->count; i++) {
+        const ASTNode* name = types->value.array->items[i];
+        int type = 0;
+        for (int k = 0; k < COLUMN_TYPE_NAME_COUNT && name->type == NODE_STRING; k++) {
+            if (strcmp(name->value.string, column_type_names[k].name) == 0) {
+                type = column_type_names[k].type;
+            }
+        }
+        if (!type) {
+            return -1;
+        }
+        stats->types |= type;
+    }
+    if (nullable->value.boolean) {
+        stats->types |= COLUMN_TYPE_NULL;
+    }
+    if (max_length) {
+        char* end = NULL;
+        long long value = max_length->type == NODE_NUMBER ? strtoll(max_length->value.number, &end, 10) : -1;
+        if (value < 0 || *end != '\0') {
+            return -1;
+        }
+        stats->max_length = (size_t)value;
+    }
+    return 0;
+}
+
+// Adds the tables described by a parsed schema.json to 'context'.
+static int load_tables(const ASTNode* root, SchemaContext* context, Json2RelCsvError* error) {
+    const ASTNode* tables = root->type == NODE_OBJECT ? find_member(root, "tables") : NULL;
+    if (!tables || tables->type != NODE_ARRAY) {
+        return schema_file_error(error, "expected an object with a \"tables\" array", NULL);
+    }
+
+    // A state file (write_state_json()) also says where row IDs continue.
+    const ASTNode* last_id = find_member(root, "lastId");
+    if (last_id) {
+        char* end = NULL;
+        long value = last_id->type == NODE_NUMBER ? strtol(last_id->value.number, &end, 10) : -1;
+        if (value < 0 || value >= INT_MAX || *end != '\0') {
+            return schema_file_error(error, "\"lastId\" must be a non-negative integer", NULL);
+        }
+        context->first_id = (int)value + 1;
+    }
+
+    // Tables are listed newest-first; create them oldest-first to restore their order.
+    const ASTNodeList* list = tables->value.array;
+    for (size_t i = list->count; i-- > 0;) {
+        const ASTNode* entry = list->items[i];
+        const ASTNode* name = entry->type == NODE_OBJECT ? find_member(entry, "name") : NULL;
+        if (!name || name->type != NODE_STRING) {
+            return schema_file_error(error, "every table needs a \"name\" string", NULL);
+        }
+        if (!is_table_name(name->value.string)) {
+            return schema_file_error(error, "not a table name:", name->value.string);
+        }
+        if (find_table(context, name->value.string)) {
+            return schema_file_error(error, "table listed twice:", name->value.string);
+        }
+
+        const ASTNode* kind = find_member(entry, "kind");
+        const ASTNode* parent = find_member(entry, "parent");
+        const ASTNode* columns = find_member(entry, "columns");
+        TableKind table_kind;
+        if (kind && kind->type == NODE_STRING && strcmp(kind->value.string, "object") == 0) {
+            table_kind = TABLE_OBJECT;
+        } else if (kind && kind->type == NODE_STRING && strcmp(kind->value.string, "array") == 0) {
+            table_kind = TABLE_ARRAY;
+        } else if (kind && kind->type == NODE_STRING && strcmp(kind->value.string, "junction") == 0) {
+            table_kind = TABLE_JUNCTION;
+        } else {
+            return schema_file_error(error, "expected kind object, array or junction for table", name->value.string);
+        }
+        if (parent && parent->type != NODE_NULL &&
+            (parent->type != NODE_STRING || !is_table_name(parent->value.string))) {
+            return schema_file_error(error, "bad parent for table", name->value.string);
+        }
+        if (!columns || columns->type != NODE_ARRAY) {
+            return schema_file_error(error, "expected a \"columns\" array for table", name->value.string);
+        }
+
+        TableSchema* table = find_or_create_table(context, name->value.string);
+        table->kind = table_kind;
+        if (parent && parent->type == NODE_STRING) {
+            table->parent = strdup(parent->value.string);
+        }
+        const ASTNodeList* column_list = columns->value.array;
+        for (size_t c = 0; c < column_list->count; c++) {
+            if (column_list->items[c]->type != NODE_STRING) {
+                return schema_file_error(error, "column names must be strings in table", name->value.string);
+            }
+            add_column(table, column_list->items[c]->value.string);
+        }
+
+        // The tables of earlier runs count as one row, which had a value in every column
+        // not nullable; files without "columnTypes" say nothing about the values.
+        const ASTNode* column_types = find_member(entry, "columnTypes");
+        if (column_types && (column_types->type != NODE_ARRAY ||
+                             column_types->value.array->count != column_list->count)) {
+            return schema_file_error(error, "expected a \"columnTypes\" entry per column in table",
+                                     name->value.string);
+        }
+        table->row_estimate = 1;
+        for (size_t c = 0; c < column_list->count; c++) {
+            ColumnStats* stats = &table->column_stats[find_column(table, column_list->items[c]->value.string)];
+            stats->rows = 1;
+            stats->last_row = 1;
+            if (!column_types) {
+                stats->types = COLUMN_TYPE_ANY | COLUMN_TYPE_NULL;
+            } else if (load_column_types(column_types->value.array->items[c], stats) != 0) {
+                return schema_file_error(error, "bad \"columnTypes\" entry in table", name->value.string);
+            }
+        }
+    }
+    return 0;
+}
+
+// Loads a schema.json (see schema.h). The file is parsed with the document parser.
+int read_schema_json(const char* data, size_t size, SchemaContext* context, Json2RelCsvError* error) {
+    Arena arena;
+    arena_init(&arena);
+    ASTBuilder builder;
+    ast_builder_init(&builder, &arena);
+    JsonEventHandler handler = ast_builder_handler(&builder);
+
+    JsonParseInput input;
+    memset(&input, 0, sizeof(input));
+    input.data = data;
+    input.size = size;
+    JsonParseError parse_error;
+    int result = json_parse(&input, &handler, &parse_error);
+    ASTNode* root = builder.root;
+    ast_builder_free(&builder);
+
+    if (result != 0) {
+        error->line = parse_error.line;
+        error->column = parse_error.column;
+        snprintf(error->message, sizeof(error->message), "Invalid schema: %.140s", parse_error.message);
+    } else if (!root) {
+        result = schema_file_error(error, "empty file", NULL);
+    } else {
+        result = load_tables(root, context, error);
+    }
+    arena_free(&arena);
+    return result;
+}
@@ -0,0 +1,1252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "ast.h"
+#include "schema.h"
+#include "row_ids.h"
+#include "stream_gen.h"
+#include "csv_writer.h"
+#include "json_number.h"
+#include "stats.h"
+
+// How the streaming converter reproduces the AST path:
+// - Schema: the steps analyze_node takes on entering a value are taken when the value
+//   starts (tables and their id/FK columns) or when a member arrives (scalar columns).
+//   An array's table is created at its first element, once the element kind is known.
+// - IDs: the data pass visits values in the same order the parser reports them, so
+//   the shared counter and per-table offsets of row_ids.h advance exactly as there.
+// - Rows: a row's IDs are fixed when it starts and its fields are collected until it
+//   ends. Fields are stored by column name, so columns added later still line up.
+//   Rows are spooled in a compact record form and turned into CSV lines at the end.
+// - Order: rows open in document order, but an object row ends after any rows of the
+//   same table nested inside it. Those inner rows are held back until the enclosing
+//   row has been spooled.
+// - Fixed schema (--schema): inference only checks the steps above against the loaded
+//   tables, and rows are written to the CSVs as soon as they are complete, in the
+//   order they would have been spooled, instead of going through temporary files.
+//   Only the first MAX_OPEN_TABLES tables are written that way; the rest are spooled.
+// - Spool: encoded rows collect in memory per table. Past STREAM_SPOOL_MEMORY in all,
+//   every table's rows so far move to one shared temporary file as a segment, so the
+//   number of open files does not grow with the number of tables.
+
+// Row record layout (native ints, temporary files only):
+//   int length of the rest | int kind | int id | int seq | int fk | colref fk column
+//   | [ITEM_SCALAR: int len, bytes] | int field count | fields: colref, int len, bytes
+// A colref is a column index, or COLUMN_BY_NAME + int len + bytes for a column the
+// table did not have yet, or NO_COLUMN.
+#define COLUMN_BY_NAME (-1)
+#define NO_COLUMN (-2)
+
+// Encoded rows held in memory, across all tables, before they move to the spool file.
+#define STREAM_SPOOL_MEMORY (8 * 1024 * 1024)
+
+// A table's spool buffer larger than this is released after moving to the spool file.
+#define STREAM_SPOOL_KEEP (64 * 1024)
+
+typedef enum {
+    ROW_OBJECT,        // an object forming a row of its own table
+    ROW_ITEM_OBJECT,   // an object element of an array whose key names a table
+    ROW_ITEM_SCALAR,   // a scalar element of such an array
+    ROW_ITEM_ARRAY     // an array element of such an array
+} RowKind;
+
+// A closed row held back until the rows before it have been spooled.
+typedef struct {
+    long ordinal;
+    size_t offset;         // into StreamSink.pending
+    size_t len;
+} PendingRow;
+
+// A run of one table's encoded rows in the spool file.
+typedef struct {
+    off_t offset;
+    size_t len;
+} SpoolSegment;
+
+// Column roles, resolved once per table.
+typedef enum { COLUMN_DATA, COLUMN_ID, COLUMN_POSITION, COLUMN_VALUE } ColumnRole;
+
+// Per-table output state.
+typedef struct {
+    TableSchema* schema;
+    // Encoded rows in final order: 'segments' of the spool file, then 'spooled'
+    CsvBuffer spooled;
+    SpoolSegment* segments;
+    int segment_count;
+    int segment_capacity;
+    int deferred;          // fixed schema: spooled like an inferred table, written at the end
+    RowIds ids;            // this table's view of the row numbering (see row_ids.h)
+    int compact_at;        // checkpoint count that triggers row_ids_compact()
+    long next_ordinal;     // position of the next row to open within this table
+    int open_rows;         // object rows of this table still collecting fields
+    CsvBuffer pending;     // encoded rows waiting for an enclosing row to close
+    PendingRow* pending_rows;
+    int pending_count;
+    int pending_capacity;
+    // The table's CSV while it is being written (see open_table_output())
+    void* stream;          // NULL if not open
+    CsvBuffer out;
+    ColumnRole* roles;     // per column
+    const char** cells;    // per column: the field value for the row being written
+    int* cell_lens;
+} StreamSink;
+
+// A member seen while collecting an object row. Offsets point into StreamFrame.row_text.
+typedef struct {
+    size_t name;
+    size_t value;
+    size_t value_len;
+    int has_value;         // 0 if the first member with this name was an object/array
+} RowField;
+
+// A row whose IDs are fixed and whose fields are being collected.
+typedef struct {
+    StreamSink* sink;
+    RowKind kind;
+    int id;
+    int seq;
+    int fk;
+    const char* parent_key; // sanitized parent key naming the FK column; NULL at the root
+    long ordinal;
+} OpenRow;
+
+// An object or array that has started but not yet ended. Frame slots are reused,
+// so their buffers are only ever grown.
+typedef struct {
+    NodeType type;
+    const char* key;        // JSON key that led to this value
+    char* safe_key;         // safe_filename(key)
+    ParentRef parent;       // logical parent row, as in the data pass
+    // Objects
+    ParentRef self;         // this object as the parent of its members
+    CsvBuffer member_key;   // key of the member currently being parsed
+    CsvBuffer container_keys; // inferring: keys of the object and array members so far,
+                              // each NUL-terminated
+    size_t* container_slots;  // hash index over container_keys: offset + 1, 0 = empty slot
+    size_t container_slot_capacity; // power of two, at least twice container_key_count
+    size_t container_key_count;
+    int has_row;
+    OpenRow row;
+    CsvBuffer row_text;     // field names and CSV-formatted values
+    RowField* fields;
+    int field_count;
+    int field_capacity;
+    // Arrays
+    int element_count;
+    StreamSink* sink;       // table whose rows are this array's elements, if any
+    TableSchema* element_table; // table analyzing this array's object elements, if any
+    TableSchema* item_table; // inferring: table whose rows this array's elements are, if any
+    int item_columns[4];    // ...and its id, FK (-1 if none), seq or index, and value columns
+    StreamSink* excluded_sink;  // set for an array element of a table's array
+    int base_before;        // base counter when excluded_sink's exclusion began
+    // Analysis
+    int analyzed;           // analyze_node visits this array with...
+    const char* parent_table; // ...this parent_table
+    TableSchema* analysis_table; // objects: table receiving this object's scalar columns
+} StreamFrame;
+
+struct StreamConverter {
+    SchemaContext context;
+    StreamSink** sinks;     // indexed by TableSchema.index
+    int sink_count;
+    int sink_capacity;
+    RowIdCounter counter;
+    StreamFrame* frames;
+    int depth;
+    int frame_capacity;
+    CsvBuffer record;       // row being encoded or decoded
+    unsigned long* live_versions;
+    int live_capacity;
+    // Fixed schema (see stream_converter_create_with_schema())
+    const Json2RelCsvSink* output; // where rows go as they complete; NULL when inferring
+    // Spool (see the top of this file)
+    FILE* spool;            // NULL until rows first outgrow memory
+    off_t spool_size;
+    size_t spooled;         // bytes in every table's 'spooled' buffer
+    int drop_unknown;
+    long dropped;           // values the schema has no place for
+    char unknown[160];      // the first of them, unless drop_unknown; "" if none
+    int failed;             // the sink failed a table, or the spool failed; 'error' says which
+    int spool_failed;       // rows could not be spooled; later ones are dropped
+    Json2RelCsvError error;
+};
+
+static void* xrealloc(void* ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+// Appends an int in native byte order (record fields, not CSV text).
+static void append_raw_int(CsvBuffer* buffer, int value) {
+    csv_buffer_append(buffer, &value, sizeof(value));
+}
+
+// Returns the sink of a table, creating sinks for any tables added since the last call.
+static StreamSink* sink_for(StreamConverter* sc, TableSchema* table) {
+    if (sc->sink_capacity < sc->context.table_count) {
+        sc->sink_capacity = sc->context.table_count * 2;
+        sc->sinks = (StreamSink**)xrealloc(sc->sinks, sc->sink_capacity * sizeof(StreamSink*));
+    }
+    while (sc->sink_count < sc->context.table_count) {
+        StreamSink* sink = (StreamSink*)calloc(1, sizeof(StreamSink));
+        if (!sink) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        sink->compact_at = 64;
+        sc->sinks[sc->sink_count++] = sink;
+    }
+
+    StreamSink* sink = sc->sinks[table->index];
+    sink->schema = table;
+    return sink;
+}
+
+// Looks up the sink for a table by name; NULL if no such table has been inferred yet.
+static StreamSink* find_sink(StreamConverter* sc, const char* name) {
+    TableSchema* table = find_table(&sc->context, name);
+    return table ? sink_for(sc, table) : NULL;
+}
+
+// Changes a table's ID offset, pruning checkpoints that no open parent can still need.
+static void set_delta(StreamConverter* sc, StreamSink* sink, int delta) {
+    row_ids_set_delta(&sc->counter, &sink->ids, delta);
+    if (sink->ids.mark_count < sink->compact_at) {
+        return;
+    }
+
+    if (sc->live_capacity < sc->depth) {
+        sc->live_capacity = sc->depth * 2;
+        sc->live_versions = (unsigned long*)xrealloc(sc->live_versions,
+                                                     sc->live_capacity * sizeof(unsigned long));
+    }
+    int live_count = 0;
+    for (int i = 0; i < sc->depth; i++) {
+        if (sc->frames[i].type == NODE_OBJECT) {
+            sc->live_versions[live_count++] = sc->frames[i].self.version;
+        }
+    }
+    row_ids_compact(&sink->ids, sc->live_versions, live_count);
+    sink->compact_at = sink->ids.mark_count * 2 > 64 ? sink->ids.mark_count * 2 : 64;
+}
+
+// --- Schema inference (mirrors analyze_node) ---
+
+// Counts a value that does not fit a fixed schema and, unless such values are dropped,
+// remembers the first one as the conversion's error.
+static void report_unknown(StreamConverter* sc, const char* table, const char* column) {
+    sc->dropped++;
+    if (sc->drop_unknown || sc->unknown[0]) {
+        return;
+    }
+    if (column) {
+        snprintf(sc->unknown, sizeof(sc->unknown), "Column \"%.56s\" of table \"%.56s\" is not in the schema",
+                 column, table);
+    } else {
+        snprintf(sc->unknown, sizeof(sc->unknown), "Table \"%.100s\" is not in the schema", table);
+    }
+}
+
+// Finds or creates a table; with a fixed schema, only finds it (NULL if it has none).
+static TableSchema* schema_table(StreamConverter* sc, const char* name) {
+    if (!sc->output) {
+        return find_or_create_table(&sc->context, name);
+    }
+    TableSchema* table = find_table(&sc->context, name);
+    if (!table) {
+        report_unknown(sc, name, NULL);
+    }
+    return table;
+}
+
+// Adds a column to a table, recording a generated value of 'types' (ColumnType bits)
+// in its current row; with a fixed schema, only checks that it has the column.
+static void schema_column(StreamConverter* sc, TableSchema* table, const char* name, int types) {
+    if (!sc->output) {
+        add_typed_column(table, name, types);
+    } else if (find_column(table, name) < 0) {
+        report_unknown(sc, table->name, name);
+    }
+}
+
+// Same for a member's scalar value.
+static void schema_value_column(StreamConverter* sc, TableSchema* table, const char* name, const ASTNode* value) {
+    if (!sc->output) {
+        add_scalar_value(table, add_column(table, name), value);
+    } else if (find_column(table, name) < 0) {
+        report_unknown(sc, table->name, name);
+    }
+}
+
+// Returns the slot of 'key' in the index over an object's container member keys, or
+// the empty slot where it would go. The index must exist.
+static size_t* container_slot(const StreamFrame* object, const char* key) {
+    size_t mask = object->container_slot_capacity - 1;
+    size_t i = symbol_hash(key, strlen(key)) & mask;
+    while (object->container_slots[i] &&
+           strcmp(object->container_keys.data + object->container_slots[i] - 1, key) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &object->container_slots[i];
+}
+
+// Records that a member of 'object' with 'key' is an object or array.
+static void add_container_key(StreamFrame* object, const char* key) {
+    if (2 * (object->container_key_count + 1) > object->container_slot_capacity) {
+        size_t* old_slots = object->container_slots;
+        size_t old_capacity = object->container_slot_capacity;
+        object->container_slot_capacity = old_capacity ? old_capacity * 2 : 16;
+        object->container_slots = (size_t*)calloc(object->container_slot_capacity, sizeof(size_t));
+        if (!object->container_slots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i]) {
+                *container_slot(object, object->container_keys.data + old_slots[i] - 1) = old_slots[i];
+            }
+        }
+        free(old_slots);
+    }
+    size_t* slot = container_slot(object, key);
+    if (!*slot) {
+        *slot = object->container_keys.len + 1;
+        csv_buffer_append(&object->container_keys, key, strlen(key) + 1);
+        object->container_key_count++;
+    }
+}
+
+// Empties a reused frame's container member keys. An index much larger than the keys
+// it held is released rather than cleared, so clearing stays proportional to them.
+static void clear_container_keys(StreamFrame* frame) {
+    if (frame->container_key_count > 0) {
+        if (frame->container_slot_capacity > 4 * frame->container_key_count + 16) {
+            free(frame->container_slots);
+            frame->container_slots = NULL;
+            frame->container_slot_capacity = 0;
+        } else {
+            memset(frame->container_slots, 0, frame->container_slot_capacity * sizeof(size_t));
+        }
+    }
+    frame->container_keys.len = 0;
+    frame->container_key_count = 0;
+}
+
+// Returns 1 if an object or array member of 'object' before the current one had 'key'.
+// As in analyze_node, a scalar after one then has no value in the row.
+static int follows_container_member(const StreamFrame* object, const char* key) {
+    return object->container_key_count > 0 && *container_slot(object, key) != 0;
+}
+
+// Records the parent link and the id/FK columns every table kind starts with, and for
+// objects, starts the object's row (array elements count theirs in analyze_element()).
+static void start_table(StreamConverter* sc, TableSchema* table, TableKind kind, const char* parent_table) {
+    // Record parent on first encounter; kind set each visit (same value)
+    if (!sc->output) {
+        table->kind = kind;
+        if (parent_table && table->parent == NULL) {
+            table->parent = strdup(parent_table);
+        }
+        if (kind == TABLE_OBJECT) {
+            table->row_estimate++;
+        }
+    }
+
+    int types = kind == TABLE_OBJECT ? COLUMN_TYPE_INT : 0;
+    schema_column(sc, table, "id", types);
+    if (parent_table) {
+        char fk_name[256];
+        snprintf(fk_name, sizeof(fk_name), "%s_id", parent_table);
+        schema_column(sc, table, fk_name, types);
+    }
+}
+
+// Creates the table for an analyzed array once its first element shows its kind.
+static void analyze_array(StreamConverter* sc, StreamFrame* array, NodeType first_type) {
+    TableSchema* table = schema_table(sc, array->safe_key);
+    if (!table) {
+        return;
+    }
+    if (first_type == NODE_OBJECT) {
+        start_table(sc, table, TABLE_ARRAY, array->parent_table);
+        schema_column(sc, table, "seq", 0);
+        array->element_table = table;
+    } else {
+        start_table(sc, table, TABLE_JUNCTION, array->parent_table);
+        schema_column(sc, table, "index", 0);
+        schema_column(sc, table, "value", 0);
+    }
+    if (!sc->output) {
+        // A fixed schema's stats are not added to.
+        array->item_table = table;
+        array->item_columns[0] = find_column(table, "id");
+        array->item_columns[1] = -1;
+        if (array->parent_table) {
+            char fk_name[256];
+            snprintf(fk_name, sizeof(fk_name), "%s_id", array->parent_table);
+            array->item_columns[1] = find_column(table, fk_name);
+        }
+        array->item_columns[2] = find_column(table, first_type == NODE_OBJECT ? "seq" : "index");
+        array->item_columns[3] = find_column(table, "value");
+    }
+}
+
+// Counts an element of an analyzed array as a row of its table, with the values of its
+// generated columns and, for a junction table, of "value" (see analyze_node).
+static void analyze_element(StreamFrame* array, const ASTNode* scalar) {
+    TableSchema* table = array->item_table;
+    table->row_estimate++;
+    add_column_value(table, array->item_columns[0], COLUMN_TYPE_INT, 0);
+    if (array->item_columns[1] >= 0) {
+        add_column_value(table, array->item_columns[1], COLUMN_TYPE_INT, 0);
+    }
+    add_column_value(table, array->item_columns[2], COLUMN_TYPE_INT, 0);
+    if (scalar && !array->element_table) {
+        add_scalar_value(table, array->item_columns[3], scalar);
+    }
+}
+
+// --- Row spooling ---
+
+static long open_row(StreamSink* sink, int collects_fields) {
+    if (collects_fields) {
+        sink->open_rows++;
+    }
+    return sink->next_ordinal++;
+}
+
+static void append_colref(CsvBuffer* record, const TableSchema* table, const char* name) {
+    int column = find_column(table, name);
+    if (column >= 0) {
+        append_raw_int(record, column);
+    } else {
+        size_t len = strlen(name);
+        append_raw_int(record, COLUMN_BY_NAME);
+        append_raw_int(record, (int)len);
+        csv_buffer_append(record, name, len);
+    }
+}
+
+// Encodes a finished row into sc->record.
+static void encode_row(StreamConverter* sc, const OpenRow* row, const StreamFrame* frame,
+                       const ASTNode* scalar) {
+    CsvBuffer* record = &sc->record;
+    const TableSchema* table = row->sink->schema;
+
+    record->len = 0;
+    append_raw_int(record, 0); // length, patched below
+    append_raw_int(record, row->kind);
+    append_raw_int(record, row->id);
+    append_raw_int(record, row->seq);
+    append_raw_int(record, row->fk);
+    if (row->parent_key) {
+        char fk_name[256];
+        snprintf(fk_name, sizeof(fk_name), "%s_id", row->parent_key);
+        append_colref(record, table, fk_name);
+    } else {
+        append_raw_int(record, NO_COLUMN);
+    }
+
+    if (row->kind == ROW_ITEM_SCALAR) {
+        size_t start = record->len;
+        append_raw_int(record, 0);
+        csv_buffer_append_value(record, scalar);
+        int len = (int)(record->len - start - sizeof(int));
+        memcpy(record->data + start, &len, sizeof(len));
+    }
+
+    int value_count = 0;
+    for (int i = 0; frame && i < frame->field_count; i++) {
+        value_count += frame->fields[i].has_value;
+    }
+    append_raw_int(record, value_count);
+    for (int i = 0; frame && i < frame->field_count; i++) {
+        const RowField* field = &frame->fields[i];
+        if (field->has_value) {
+            append_colref(record, table, frame->row_text.data + field->name);
+            append_raw_int(record, (int)field->value_len);
+            csv_buffer_append(record, frame->row_text.data + field->value, field->value_len);
+        }
+    }
+
+    int len = (int)(record->len - sizeof(int));
+    memcpy(record->data, &len, sizeof(len));
+}
+
+static void write_record(StreamSink* sink, const char* cursor);
+
+// Fails the conversion with 'message', unless an earlier failure already did.
+static void converter_failed(StreamConverter* sc, const char* message) {
+    if (!sc->failed) {
+        sc->failed = 1;
+        sc->error.line = 0;
+        sc->error.column = 0;
+        snprintf(sc->error.message, sizeof(sc->error.message), "%s", message);
+    }
+}
+
+// Fails the conversion because the spool file could not be created, written or read.
+static void spool_failed(StreamConverter* sc, const char* message) {
+    converter_failed(sc, message);
+    sc->spool_failed = 1;
+}
+
+// Moves every table's spooled rows to the spool file, a segment per table. Once the
+// spool has failed, drops them instead.
+static void spool_flush(StreamConverter* sc) {
+    if (!sc->spool && !sc->spool_failed) {
+        sc->spool = tmpfile();
+        if (!sc->spool) {
+            spool_failed(sc, "Could not create a temporary file for the spooled rows.");
+        }
+    }
+    for (int i = 0; i < sc->sink_count; i++) {
+        StreamSink* sink = sc->sinks[i];
+        if (sink->spooled.len == 0) {
+            continue;
+        }
+        if (sc->spool_failed) {
+            sink->spooled.len = 0;
+            continue;
+        }
+        if (sink->segment_count == sink->segment_capacity) {
+            sink->segment_capacity = sink->segment_capacity ? sink->segment_capacity * 2 : 8;
+            sink->segments = (SpoolSegment*)xrealloc(sink->segments, sink->segment_capacity * sizeof(SpoolSegment));
+        }
+        SpoolSegment* segment = &sink->segments[sink->segment_count++];
+        segment->offset = sc->spool_size;
+        segment->len = sink->spooled.len;
+        if (fwrite(sink->spooled.data, 1, sink->spooled.len, sc->spool) != sink->spooled.len) {
+            spool_failed(sc, "Could not write the spooled rows to a temporary file.");
+        }
+        sc->spool_size += (off_t)sink->spooled.len;
+        if (sink->spooled.cap > STREAM_SPOOL_KEEP) {
+            csv_buffer_free(&sink->spooled);
+        }
+        sink->spooled.len = 0;
+    }
+    sc->spooled = 0;
+}
+
+// Passes on an encoded row, in final order: to the table's CSV with a fixed schema,
+// otherwise (or if the table is deferred) to the spool.
+static void spool_write(StreamConverter* sc, StreamSink* sink, const char* bytes, size_t len) {
+    if (sc->output && !sink->deferred) {
+        if (sink->stream) {
+            write_record(sink, bytes + sizeof(int));
+        }
+        return;
+    }
+    csv_buffer_append(&sink->spooled, bytes, len);
+    sc->spooled += len;
+    if (sc->spooled > STREAM_SPOOL_MEMORY) {
+        spool_flush(sc);
+    }
+}
+
+static int compare_pending(const void* a, const void* b) {
+    long x = ((const PendingRow*)a)->ordinal;
+    long y = ((const PendingRow*)b)->ordinal;
+    return (x > y) - (x < y);
+}
+
+// Spools the row in sc->record, or holds it back while an earlier row of the same
+// table (necessarily one enclosing it) is still collecting fields.
+static void submit_row(StreamConverter* sc, StreamSink* sink, long ordinal, int closes_open_row) {
+    if (closes_open_row) {
+        sink->open_rows--;
+    }
+
+    if (sink->open_rows == 0 && sink->pending_count == 0) {
+        spool_write(sc, sink, sc->record.data, sc->record.len);
+        return;
+    }
+
+    if (sink->pending_count == sink->pending_capacity) {
+        sink->pending_capacity = sink->pending_capacity ? sink->pending_capacity * 2 : 16;
+        sink->pending_rows = (PendingRow*)xrealloc(sink->pending_rows,
+                                                   sink->pending_capacity * sizeof(PendingRow));
+    }
+    PendingRow* pending = &sink->pending_rows[sink->pending_count++];
+    pending->ordinal = ordinal;
+    pending->offset = sink->pending.len;
+    pending->len = sc->record.len;
+    csv_buffer_append(&sink->pending, sc->record.data, sc->record.len);
+
+    if (sink->open_rows == 0) {
+        // Everything held back is complete now; spool it in document order.
+        qsort(sink->pending_rows, sink->pending_count, sizeof(PendingRow), compare_pending);
+        for (int i = 0; i < sink->pending_count; i++) {
+            spool_write(sc, sink, sink->pending.data + sink->pending_rows[i].offset, sink->pending_rows[i].len);
+        }
+        sink->pending_count = 0;
+        sink->pending.len = 0;
+    }
+}
+
+// Writes a row for a scalar or array element of a table's array; it has no fields to wait for.
+static void write_item_row(StreamConverter* sc, OpenRow* row, const ASTNode* scalar) {
+    row->ordinal = open_row(row->sink, 0);
+    encode_row(sc, row, NULL, scalar);
+    submit_row(sc, row->sink, row->ordinal, 0);
+}
+
+// Records an object member for the row being collected. As in the data pass,
+// only the first member with a given key counts, and only if it is a scalar.
+static void add_row_field(StreamFrame* frame, const char* key, const ASTNode* scalar) {
+    for (int i = 0; i < frame->field_count; i++) {
+        if (strcmp(frame->row_text.data + frame->fields[i].name, key) == 0) {
+            return;
+        }
+    }
+
+    if (frame->field_count == frame->field_capacity) {
+        frame->field_capacity = frame->field_capacity ? frame->field_capacity * 2 : 16;
+        frame->fields = (RowField*)xrealloc(frame->fields, frame->field_capacity * sizeof(RowField));
+    }
+    RowField* field = &frame->fields[frame->field_count++];
+    field->name = frame->row_text.len;
+    csv_buffer_append(&frame->row_text, key, strlen(key) + 1);
+    field->has_value = (scalar != NULL);
+    field->value = frame->row_text.len;
+    if (scalar) {
+        csv_buffer_append_value(&frame->row_text, scalar);
+    }
+    field->value_len = frame->row_text.len - field->value;
+}
+
+// --- Event handling ---
+
+static StreamFrame* push_frame(StreamConverter* sc) {
+    if (sc->depth == sc->frame_capacity) {
+        int old_capacity = sc->frame_capacity;
+        sc->frame_capacity = old_capacity ? old_capacity * 2 : 16;
+        sc->frames = (StreamFrame*)xrealloc(sc->frames, sc->frame_capacity * sizeof(StreamFrame));
+        memset(sc->frames + old_capacity, 0, (sc->frame_capacity - old_capacity) * sizeof(StreamFrame));
+    }
+    return &sc->frames[sc->depth++];
+}
+
+// Handles the start of any value: its schema contribution, the element bookkeeping of
+// an enclosing array, and, for objects and arrays, a new frame.
+static void begin_value(StreamConverter* sc, NodeType type, const ASTNode* scalar) {
+    StreamFrame* up = sc->depth > 0 ? &sc->frames[sc->depth - 1] : NULL;
+    const char* key = "root";
+    ParentRef parent = {NULL, 0, 0};
+    int analyzed = 1;                   // analyze_node visits this value on its own
+    const char* parent_table = NULL;
+    TableSchema* element_table = NULL;  // table analyzing this value as an array element
+    int has_item_row = 0;
+    OpenRow item_row;
+    StreamSink* excluded_sink = NULL;
+    int base_before = 0;
+
+    if (up && up->type == NODE_OBJECT) {
+        key = up->member_key.data;
+        parent = up->self;
+        analyzed = (up->analysis_table != NULL);
+        if (analyzed) {
+            parent_table = up->analysis_table->name;
+            if (scalar && follows_container_member(up, key)) {
+                schema_column(sc, up->analysis_table, key, 0);
+            } else if (scalar) {
+                schema_value_column(sc, up->analysis_table, key, scalar);
+            } else if (!sc->output) {
+                add_container_key(up, key);
+            }
+        }
+        if (up->has_row) {
+            add_row_field(up, key, scalar);
+        }
+    } else if (up) {
+        key = up->key;
+        parent = up->parent;
+        analyzed = 0;
+        int seq = up->element_count++;
+        if (seq == 0) {
+            if (up->analyzed) {
+                analyze_array(sc, up, type);
+            }
+            StreamSink* sink = find_sink(sc, up->safe_key);
+            up->sink = (sink && !sink->ids.excluded) ? sink : NULL;
+        }
+        if (up->item_table) {
+            analyze_element(up, scalar);
+        }
+        if (type == NODE_OBJECT) {
+            element_table = up->element_table;
+        }
+
+        StreamSink* sink = up->sink;
+        if (sink) {
+            OpenRow row;
+            row.sink = sink;
+            row.id = sc->counter.next_id + sink->ids.delta;
+            row.seq = seq;
+            row.parent_key = parent.key;
+            row.fk = parent.key ? row_ids_parent_id(&sink->ids, &parent) : 0;
+
+            if (type == NODE_OBJECT) {
+                // The object itself takes the next base ID; shift this table's offset so
+                // that ID maps back to the row's ID.
+                row.kind = ROW_ITEM_OBJECT;
+                item_row = row;
+                has_item_row = 1;
+                set_delta(sc, sink, sink->ids.delta - 1);
+                sc->counter.next_id++;
+            } else if (type == NODE_ARRAY) {
+                // Hide the nested array from this table; its IDs are discounted at its end.
+                row.kind = ROW_ITEM_ARRAY;
+                write_item_row(sc, &row, NULL);
+                sink->ids.excluded++;
+                excluded_sink = sink;
+                base_before = sc->counter.next_id;
+            } else {
+                row.kind = ROW_ITEM_SCALAR;
+                write_item_row(sc, &row, scalar);
+                set_delta(sc, sink, sink->ids.delta + 1);
+            }
+        } else if (type == NODE_OBJECT) {
+            // Object elements of other arrays consume an extra ID, as in the data pass.
+            sc->counter.next_id++;
+        }
+    }
+
+    if (scalar) {
+        return;
+    }
+
+    StreamFrame* frame = push_frame(sc); // 'up' is invalid from here on
+    frame->type = type;
+    frame->key = key;
+    frame->safe_key = safe_filename(key);
+    frame->parent = parent;
+    frame->has_row = 0;
+    frame->field_count = 0;
+    frame->row_text.len = 0;
+    clear_container_keys(frame);
+    frame->element_count = 0;
+    frame->sink = NULL;
+    frame->element_table = NULL;
+    frame->item_table = NULL;
+    frame->excluded_sink = excluded_sink;
+    frame->base_before = base_before;
+    frame->analyzed = analyzed;
+    frame->parent_table = parent_table;
+    frame->analysis_table = element_table;
+
+    if (type != NODE_OBJECT) {
+        return;
+    }
+
+    if (analyzed) {
+        TableSchema* table = schema_table(sc, frame->safe_key);
+        if (table) {
+            start_table(sc, table, TABLE_OBJECT, parent_table);
+        }
+        frame->analysis_table = table;
+    }
+
+    // Every object consumes an ID, same as in the data pass.
+    int base_id = sc->counter.next_id++;
+
+    if (has_item_row) {
+        frame->row = item_row;
+        frame->has_row = 1;
+    } else {
+        // Write the object as a row if its key names a table.
+        StreamSink* sink = find_sink(sc, frame->safe_key);
+        if (sink && !sink->ids.excluded) {
+            frame->row.sink = sink;
+            frame->row.kind = ROW_OBJECT;
+            frame->row.id = base_id + sink->ids.delta;
+            frame->row.seq = 0;
+            frame->row.parent_key = parent.key;
+            frame->row.fk = parent.key ? row_ids_parent_id(&sink->ids, &parent) : 0;
+            frame->has_row = 1;
+        }
+    }
+    if (frame->has_row) {
+        frame->row.ordinal = open_row(frame->row.sink, 1);
+    }
+
+    ParentRef self = {frame->safe_key, base_id, sc->counter.version};
+    frame->self = self;
+}
+
+static void on_start_object(void* ctx) {
+    begin_value((StreamConverter*)ctx, NODE_OBJECT, NULL);
+}
+
+static void on_start_array(void* ctx) {
+    begin_value((StreamConverter*)ctx, NODE_ARRAY, NULL);
+}
+
+static void on_end_object(void* ctx) {
+    StreamConverter* sc = (StreamConverter*)ctx;
+    StreamFrame* frame = &sc->frames[sc->depth - 1];
+
+    if (frame->has_row) {
+        encode_row(sc, &frame->row, frame, NULL);
+        submit_row(sc, frame->row.sink, frame->row.ordinal, 1);
+    }
+    free(frame->safe_key);
+    sc->depth--;
+}
+
+static void on_end_array(void* ctx) {
+    StreamConverter* sc = (StreamConverter*)ctx;
+    StreamFrame* frame = &sc->frames[sc->depth - 1];
+    StreamSink* sink = frame->excluded_sink;
+
+    free(frame->safe_key);
+    sc->depth--;
+
+    if (sink) {
+        // Discount the IDs the nested array consumed, as the data pass does.
+        sink->ids.excluded--;
+        set_delta(sc, sink, sink->ids.delta + 1 - (sc->counter.next_id - frame->base_before));
+    }
+}
+
+static void on_key(void* ctx, char* key) {
+    StreamConverter* sc = (StreamConverter*)ctx;
+    CsvBuffer* member_key = &sc->frames[sc->depth - 1].member_key;
+
+    member_key->len = 0;
+    csv_buffer_append(member_key, key, strlen(key) + 1);
+}
+
+static void on_scalar(void* ctx, const ASTNode* value) {
+    StreamConverter* sc = (StreamConverter*)ctx;
+    begin_value(sc, value->type, value);
+}
+
+// --- Output ---
+
+static int read_int(const char** cursor) {
+    int value;
+    memcpy(&value, *cursor, sizeof(value));
+    *cursor += sizeof(value);
+    return value;
+}
+
+// Decodes a colref into a column index (-1 if the table never got that column).
+static int read_colref(const char** cursor, const TableSchema* table) {
+    int column = read_int(cursor);
+    if (column == COLUMN_BY_NAME) {
+        int len = read_int(cursor);
+        char name[256];
+        char* heap_name = NULL;
+        char* copy = name;
+        if (len >= (int)sizeof(name)) {
+            copy = heap_name = (char*)xrealloc(NULL, len + 1);
+        }
+        memcpy(copy, *cursor, len);
+        copy[len] = '\0';
+        *cursor += len;
+        column = find_column(table, copy);
+        free(heap_name);
+    } else if (column == NO_COLUMN) {
+        column = -1;
+    }
+    return column;
+}
+
+// Records that the sink failed a table's CSV, unless an earlier table already did.
+static void output_failed(StreamConverter* sc, const TableSchema* schema) {
+    char* file_name = get_csv_file_name(schema->name);
+    Json2RelCsvError error;
+    csv_output_error(&error, file_name);
+    free(file_name);
+    converter_failed(sc, error.message);
+}
+
+// How a column named 'name' is filled.
+static ColumnRole column_role(const char* name) {
+    if (strcmp(name, "id") == 0) {
+        return COLUMN_ID;
+    } else if (strcmp(name, "seq") == 0 || strcmp(name, "index") == 0) {
+        return COLUMN_POSITION;
+    } else if (strcmp(name, "value") == 0) {
+        return COLUMN_VALUE;
+    }
+    return COLUMN_DATA;
+}
+
+// Opens a table's CSV and writes its header row. Leaves 'stream' NULL, and fails the
+// conversion, if the sink does not accept the table.
+static void open_table_output(StreamConverter* sc, StreamSink* sink, const Json2RelCsvSink* output) {
+    TableSchema* schema = sink->schema;
+    char* file_name = get_csv_file_name(schema->name);
+    sink->stream = output->open(output->ctx, file_name);
+    free(file_name);
+    if (!sink->stream) {
+        output_failed(sc, schema);
+        return;
+    }
+
+    csv_buffer_init(&sink->out, output, sink->stream);
+    for (int i = 0; i < schema->column_count; i++) {
+        csv_buffer_append(&sink->out, schema->columns[i], strlen(schema->columns[i]));
+        if (i < schema->column_count - 1) {
+            csv_buffer_putc(&sink->out, ',');
+        }
+    }
+    csv_buffer_putc(&sink->out, '\n');
+
+    int columns = schema->column_count;
+    sink->roles = (ColumnRole*)xrealloc(NULL, (columns + 1) * sizeof(ColumnRole));
+    sink->cells = (const char**)calloc(columns + 1, sizeof(char*));
+    sink->cell_lens = (int*)xrealloc(NULL, (columns + 1) * sizeof(int));
+    if (!sink->cells) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < columns; i++) {
+        sink->roles[i] = column_role(schema->columns[i]);
+    }
+}
+
+// Writes one encoded row (the record after its length) as a CSV line, padded to the
+// table's columns.
+static void write_record(StreamSink* sink, const char* cursor) {
+    TableSchema* schema = sink->schema;
+    CsvBuffer* out = &sink->out;
+    const char** cells = sink->cells;
+    int* cell_lens = sink->cell_lens;
+    int columns = schema->column_count;
+
+    RowKind kind = (RowKind)read_int(&cursor);
+    int id = read_int(&cursor);
+    int seq = read_int(&cursor);
+    int fk = read_int(&cursor);
+    int fk_column = read_colref(&cursor, schema);
+    const char* scalar = NULL;
+    int scalar_len = 0;
+    if (kind == ROW_ITEM_SCALAR) {
+        scalar_len = read_int(&cursor);
+        scalar = cursor;
+        cursor += scalar_len;
+    }
+    int field_count = read_int(&cursor);
+    for (int f = 0; f < field_count; f++) {
+        int column = read_colref(&cursor, schema);
+        int value_len = read_int(&cursor);
+        if (column >= 0) {
+            cells[column] = cursor;
+            cell_lens[column] = value_len;
+        }
+        cursor += value_len;
+    }
+
+    // Same precedence as write_row() in csv_gen.c.
+    int is_item = (kind != ROW_OBJECT);
+    for (int i = 0; i < columns; i++) {
+        if (sink->roles[i] == COLUMN_ID) {
+            csv_buffer_append_int(out, id);
+        } else if (i == fk_column) {
+            csv_buffer_append_int(out, fk);
+        } else if (is_item && sink->roles[i] == COLUMN_POSITION) {
+            csv_buffer_append_int(out, seq);
+        } else if (kind == ROW_OBJECT || kind == ROW_ITEM_OBJECT) {
+            if (cells[i]) {
+                csv_buffer_append(out, cells[i], (size_t)cell_lens[i]);
+            }
+        } else if (sink->roles[i] == COLUMN_VALUE) {
+            if (kind == ROW_ITEM_SCALAR) {
+                csv_buffer_append(out, scalar, (size_t)scalar_len);
+            } else {
+                fprintf(stderr, "Warning: Complex type encountered in CSV cell\n");
+            }
+        }
+        cells[i] = NULL;
+
+        if (i < columns - 1) {
+            csv_buffer_putc(out, ',');
+        }
+    }
+    csv_buffer_putc(out, '\n');
+    STATS_ADD(schema->rows_written, 1);
+    if (id > schema->last_id) {
+        schema->last_id = id;
+    }
+}
+
+// Flushes and closes a table's CSV, if it is open.
+static void close_table_output(StreamConverter* sc, StreamSink* sink) {
+    if (!sink->stream) {
+        return;
+    }
+    if (csv_buffer_close(&sink->out) != 0) {
+        output_failed(sc, sink->schema);
+    }
+    sink->schema->bytes_written = sink->out.flushed;
+    sink->stream = NULL;
+    free(sink->roles);
+    free(sink->cells);
+    free(sink->cell_lens);
+    sink->roles = NULL;
+    sink->cells = NULL;
+    sink->cell_lens = NULL;
+}
+
+// Writes every encoded row in 'len' bytes of whole records as CSV lines.
+static void write_records(StreamSink* sink, const char* data, size_t len) {
+    const char* end = data + len;
+    while (data < end) {
+        int record_len;
+        memcpy(&record_len, data, sizeof(record_len));
+        write_record(sink, data + sizeof(int));
+        data += sizeof(int) + (size_t)record_len;
+    }
+}
+
+// Reads a segment of the spool file into sc->record; NULL, failing the spool, if it cannot.
+static const char* read_segment(StreamConverter* sc, const SpoolSegment* segment) {
+    CsvBuffer* buffer = &sc->record;
+    buffer->len = 0;
+    csv_buffer_reserve(buffer, segment->len);
+    if (fseeko(sc->spool, segment->offset, SEEK_SET) != 0 ||
+        fread(buffer->data, 1, segment->len, sc->spool) != segment->len) {
+        spool_failed(sc, "Could not read the spooled rows back from their temporary file.");
+        return NULL;
+    }
+    return buffer->data;
+}
+
+// Writes one table's CSV: the header, then every spooled row.
+static void write_table(StreamConverter* sc, StreamSink* sink, const Json2RelCsvSink* output) {
+    open_table_output(sc, sink, output);
+    if (!sink->stream) {
+        return;
+    }
+
+    for (int i = 0; i < sink->segment_count; i++) {
+        const char* data = read_segment(sc, &sink->segments[i]);
+        if (!data) {
+            break;
+        }
+        write_records(sink, data, sink->segments[i].len);
+    }
+    write_records(sink, sink->spooled.data, sink->spooled.len);
+
+    close_table_output(sc, sink);
+}
+
+// The ColumnType bit of a field's CSV text (see csv_buffer_append_value()); 0 if empty.
+static int field_type(const char* text, int len) {
+    long long value;
+    if (len == 0) {
+        return 0;
+    } else if (text[0] == '"') {
+        return COLUMN_TYPE_STRING;
+    } else if (text[0] == 't' || text[0] == 'f') {
+        return COLUMN_TYPE_BOOL;
+    }
+    return json_number_to_int64(text, (size_t)len, &value) ? COLUMN_TYPE_INT : COLUMN_TYPE_NUMBER;
+}
+
+// Records in 'stats' (a column_stats array matching sink->schema) the types of what
+// write_record() writes for each encoded row in 'len' bytes of whole records, with
+// the same precedence: IDs and positions are integers, then each field has its own type.
+static void type_records(const StreamSink* sink, const ColumnRole* roles, ColumnStats* stats, const char* data,
+                         size_t len) {
+    const TableSchema* schema = sink->schema;
+    const char* end = data + len;
+    while (data < end) {
+        const char* cursor = data + sizeof(int);
+        int record_len;
+        memcpy(&record_len, data, sizeof(record_len));
+        data = cursor + record_len;
+
+        RowKind kind = (RowKind)read_int(&cursor);
+        cursor += 3 * sizeof(int);  // id, seq, fk
+        int fk_column = read_colref(&cursor, schema);
+        int is_item = (kind != ROW_OBJECT);
+        for (int i = 0; i < schema->column_count; i++) {
+            if (roles[i] == COLUMN_ID || i == fk_column || (is_item && roles[i] == COLUMN_POSITION)) {
+                stats[i].types |= COLUMN_TYPE_INT;
+            }
+        }
+        if (kind == ROW_ITEM_SCALAR) {
+            int scalar_len = read_int(&cursor);
+            for (int i = 0; i < schema->column_count; i++) {
+                if (roles[i] == COLUMN_VALUE && i != fk_column) {
+                    stats[i].types |= field_type(cursor, scalar_len);
+                }
+            }
+            cursor += scalar_len;
+        }
+        int field_count = read_int(&cursor);
+        for (int f = 0; f < field_count; f++) {
+            int column = read_colref(&cursor, schema);
+            int value_len = read_int(&cursor);
+            if (column >= 0 && (kind == ROW_OBJECT || kind == ROW_ITEM_OBJECT) && roles[column] != COLUMN_ID &&
+                column != fk_column && !(is_item && roles[column] == COLUMN_POSITION)) {
+                stats[column].types |= field_type(cursor, value_len);
+            }
+            cursor += value_len;
+        }
+    }
+}
+
+int stream_converter_type_rows(StreamConverter* converter, SchemaContext* typed) {
+    if (converter->spool && (fflush(converter->spool) != 0 || ferror(converter->spool))) {
+        spool_failed(converter, "Could not write the spooled rows to a temporary file.");
+    }
+    for (TableSchema* t = converter->context.tables; t && !converter->spool_failed; t = t->next) {
+        StreamSink* sink = sink_for(converter, t);
+        ColumnStats* stats = find_table(typed, t->name)->column_stats;
+        ColumnRole* roles = (ColumnRole*)xrealloc(NULL, (t->column_count + 1) * sizeof(ColumnRole));
+        for (int i = 0; i < t->column_count; i++) {
+            roles[i] = column_role(t->columns[i]);
+        }
+        for (int i = 0; i < sink->segment_count; i++) {
+            const char* data = read_segment(converter, &sink->segments[i]);
+            if (!data) {
+                break;
+            }
+            type_records(sink, roles, stats, data, sink->segments[i].len);
+        }
+        type_records(sink, roles, stats, sink->spooled.data, sink->spooled.len);
+        free(roles);
+    }
+    return converter->spool_failed ? -1 : 0;
+}
+
+StreamConverter* stream_converter_create(void) {
+    StreamConverter* sc = (StreamConverter*)calloc(1, sizeof(StreamConverter));
+    if (!sc) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    sc->context = schema_context_init();
+    sc->counter.next_id = 1; // Start IDs from 1, as the data pass does
+    sc->counter.version = 0;
+    return sc;
+}
+
+StreamConverter* stream_converter_create_from(const SchemaContext* base) {
+    StreamConverter* sc = stream_converter_create();
+    free_schema(&sc->context);
+    sc->context = schema_context_copy(base);
+    sc->counter.next_id = sc->context.first_id;
+    return sc;
+}
+
+StreamConverter* stream_converter_create_with_schema(const SchemaContext* schema, int drop_unknown,
+                                                     const Json2RelCsvSink* output) {
+    StreamConverter* sc = stream_converter_create_from(schema);
+    sc->output = output;
+    sc->drop_unknown = drop_unknown;
+
+    // Every table is known, so every CSV can be started now: up to MAX_OPEN_TABLES of
+    // them; the rest are spooled and written at the end.
+    for (TableSchema* t = sc->context.tables; t; t = t->next) {
+        StreamSink* sink = sink_for(sc, t);
+        if (t->index < MAX_OPEN_TABLES) {
+            open_table_output(sc, sink, output);
+        } else {
+            sink->deferred = 1;
+        }
+    }
+    return sc;
+}
+
+JsonEventHandler stream_converter_handler(StreamConverter* converter) {
+    JsonEventHandler handler;
+    handler.start_object = on_start_object;
+    handler.end_object = on_end_object;
+    handler.start_array = on_start_array;
+    handler.end_array = on_end_array;
+    handler.key = on_key;
+    handler.scalar = on_scalar;
+    handler.ctx = converter;
+    return handler;
+}
+
+const SchemaContext* stream_converter_schema(const StreamConverter* converter) {
+    return &converter->context;
+}
+
+const char* stream_converter_unknown(const StreamConverter* converter) {
+    return converter->unknown[0] ? converter->unknown : NULL;
+}
+
+long stream_converter_dropped(const StreamConverter* converter) {
+    return converter->drop_unknown ? converter->dropped : 0;
+}
+
+int stream_converter_finish(StreamConverter* converter, const Json2RelCsvSink* output, int emit_schema,
+                            Json2RelCsvError* error) {
+    // Every spooled row must have reached the spool file before any CSV is assembled.
+    if (converter->spool && (fflush(converter->spool) != 0 || ferror(converter->spool))) {
+        spool_failed(converter, "Could not write the spooled rows to a temporary file.");
+    }
+    for (TableSchema* t = converter->context.tables; t; t = t->next) {
+        StreamSink* sink = sink_for(converter, t);
+        if (converter->spool_failed) {
+            break;  // the open CSVs of a fixed schema are closed by stream_converter_free()
+        }
+        if (converter->output && !sink->deferred) {
+            close_table_output(converter, sink);
+        } else {
+            write_table(converter, sink, output);
+        }
+    }
+    if (converter->failed) {
+        if (error) {
+            *error = converter->error;
+        }
+        return -1;
+    }
+
+    if (emit_schema) {
+        return write_schema_json(&converter->context, output, error);
+    }
+    return 0;
+}
+
+void stream_converter_free(StreamConverter* converter) {
+    for (int i = 0; i < converter->sink_count; i++) {
+        StreamSink* sink = converter->sinks[i];
+        csv_buffer_free(&sink->spooled);
+        free(sink->segments);
+        if (converter->output) {
+            close_table_output(converter, sink); // after a failed parse
+        }
+        row_ids_free(&sink->ids);
+        csv_buffer_free(&sink->pending);
+        free(sink->pending_rows);
+        free(sink);
+    }
+    free(converter->sinks);
+    if (converter->spool) {
+        fclose(converter->spool);
+    }
+
+    // Frames above the depth are spare slots that still own their buffers.
+    for (int i = 0; i < converter->frame_capacity; i++) {
+        StreamFrame* frame = &converter->frames[i];
+        if (i < converter->depth) {
+            free(frame->safe_key);
+        }
+        csv_buffer_free(&frame->member_key);
+        csv_buffer_free(&frame->container_keys);
+        free(frame->container_slots);
+        csv_buffer_free(&frame->row_text);
+        free(frame->fields);
+    }
+    free(converter->frames);
+
+    csv_buffer_free(&converter->record);
+    free(converter->live_versions);
+    free_schema(&converter->context);
+    free(converter);
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "symbols.h"
+#include "schema.h"
+
+#define SYMBOL_INITIAL_SLOTS 64
+
+unsigned int symbol_hash(const char* text, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void symbol_table_init(SymbolTable* symbols, Arena* arena) {
+    symbols->arena = arena;
+    symbols->slots = NULL;
+    symbols->slot_capacity = 0;
+    symbols->count = 0;
+}
+
+// Doubles the index (or creates it) and reinserts every symbol.
+static void grow_symbol_slots(SymbolTable* symbols) {
+    size_t capacity = symbols->slot_capacity ? symbols->slot_capacity * 2 : SYMBOL_INITIAL_SLOTS;
+    Symbol** slots = (Symbol**)calloc(capacity, sizeof(Symbol*));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < symbols->slot_capacity; i++) {
+        Symbol* symbol = symbols->slots[i];
+        if (symbol) {
+            size_t j = symbol->hash & mask;
+            while (slots[j]) {
+                j = (j + 1) & mask;
+            }
+            slots[j] = symbol;
+        }
+    }
+    free(symbols->slots);
+    symbols->slots = slots;
+    symbols->slot_capacity = capacity;
+}
+
+const Symbol* symbol_intern(SymbolTable* symbols, const char* text, size_t length) {
+    // Keep the index at most half full so probe sequences stay short.
+    if (2 * (symbols->count + 1) > symbols->slot_capacity) {
+        grow_symbol_slots(symbols);
+    }
+
+    unsigned int hash = symbol_hash(text, length);
+    size_t mask = symbols->slot_capacity - 1;
+    size_t i = hash & mask;
+    for (Symbol* symbol = symbols->slots[i]; symbol; symbol = symbols->slots[i]) {
+        if (symbol->hash == hash && strncmp(symbol->text, text, length) == 0 && symbol->text[length] == '\0') {
+            return symbol;
+        }
+        i = (i + 1) & mask;
+    }
+
+    Symbol* symbol = (Symbol*)arena_alloc(symbols->arena, sizeof(Symbol));
+    char* copy = arena_strndup(symbols->arena, text, length);
+    symbol->text = copy;
+    symbol->hash = hash;
+
+    // Most keys are already valid table names; share their text in that case.
+    char* table_name = safe_filename(copy);
+    symbol->table_name = strcmp(table_name, copy) == 0
+                       ? copy
+                       : arena_strndup(symbols->arena, table_name, strlen(table_name));
+    free(table_name);
+
+    symbols->slots[i] = symbol;
+    symbols->count++;
+    return symbol;
+}
+
+void symbol_table_free(SymbolTable* symbols) {
+    free(symbols->slots);
+    symbols->slots = NULL;
+    symbols->slot_capacity = 0;
+    symbols->count = 0;
+}
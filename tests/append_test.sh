@@ -0,0 +1,183 @@
+#!/usr/bin/env bash
+# Append test: converts one batch with --append, then a second batch that brings new
+# columns and a new table, and verifies that the second batch's rows were added exactly
+# as a conversion of that batch alone writes them, with row IDs continuing after the
+# first batch's, and that the first batch's rows were padded for the new columns.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+BATCH_OBJECTS="${BATCH_OBJECTS:-2000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[append_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[append_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[append_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Two batches of the large benchmark shape; every third record of the second one has
+# a field and a nested object the first batch never had.
+python3 "$REPO_ROOT/generate_large_json.py" "$TMPDIR_OUT/first.json" "$BATCH_OBJECTS" >/dev/null
+python3 "$REPO_ROOT/generate_large_json.py" "$TMPDIR_OUT/second.json" "$BATCH_OBJECTS" >/dev/null
+python3 - "$TMPDIR_OUT/second.json" <<'PY'
+import json, sys
+doc = json.load(open(sys.argv[1]))
+for i, record in enumerate(doc["records"]):
+    if i % 3 == 0:
+        record["note"] = "late, \"quoted\"\nmultiline" if i % 2 else i
+        record["audit"] = {"by": "batch2", "tags": ["a", "b"]}
+json.dump(doc, open(sys.argv[1], "w"))
+PY
+
+# Converts both batches with --append into one directory, and each batch on its own,
+# then checks the appended output against the separate ones. Extra arguments go to
+# every run.
+check_append() {
+    local name="$1"
+    shift
+    local dir="$TMPDIR_OUT/$name"
+
+    echo "[append_test] Appending two batches ($name)..."
+    mkdir -p "$dir"
+    "$BINARY" --append --out-dir "$dir/appended" "$@" < "$TMPDIR_OUT/first.json"
+    cp "$dir/appended/json2relcsv_state.json" "$dir/first_state.json"
+    "$BINARY" --append --out-dir "$dir/appended" "$@" --input "$TMPDIR_OUT/second.json"
+    "$BINARY" --emit-schema --out-dir "$dir/first" "$@" < "$TMPDIR_OUT/first.json"
+    "$BINARY" --emit-schema --out-dir "$dir/second" "$@" < "$TMPDIR_OUT/second.json"
+
+    python3 - "$dir" "$name" <<'PY' || FAIL=1
+import csv, json, os, sys
+
+dir, name = sys.argv[1:]
+appended = os.path.join(dir, "appended")
+first_last = json.load(open(os.path.join(dir, "first_state.json")))["lastId"]
+state = json.load(open(os.path.join(appended, "json2relcsv_state.json")))
+foreign_keys = {t["name"]: t["foreignKey"] for t in json.load(open(os.path.join(dir, "second", "schema.json")))["tables"]}
+
+def read(path):
+    return list(csv.reader(open(path, newline=""))) if os.path.exists(path) else []
+
+errors = []
+second_last = 0
+for table in sorted(t["name"] for t in state["tables"]):
+    rows = read(os.path.join(appended, table + ".csv"))
+    first = read(os.path.join(dir, "first", table + ".csv"))
+    second = read(os.path.join(dir, "second", table + ".csv"))
+    header = rows[0]
+    if [t["columns"] for t in state["tables"] if t["name"] == table][0] != header:
+        errors.append(f"{table}: header does not match the state file")
+
+    # The first batch's rows, padded for columns the second batch added.
+    expected = [row + [""] * (len(header) - len(row)) for row in first[1:]]
+
+    # The second batch's rows, in the appended column order, with IDs shifted.
+    if second:
+        shifted = {"id", foreign_keys.get(table)}
+        for row in second[1:]:
+            values = dict(zip(second[0], row))
+            for column in shifted:
+                if values.get(column):
+                    second_last = max(second_last, int(values[column]))
+                    values[column] = str(int(values[column]) + first_last)
+            expected.append([values.get(column, "") for column in header])
+
+    if rows[1:] != expected:
+        errors.append(f"{table}: appended rows differ from the batches converted separately")
+    ids = [row[0] for row in rows[1:]]
+    if len(set(ids)) != len(ids):
+        errors.append(f"{table}: duplicate IDs")
+
+# The state's column types describe both batches: the kinds of value either had, and
+# nullable if either had nulls or lacked the column (the first batch's rows are padded).
+batches = [{t["name"]: t for t in json.load(open(os.path.join(dir, batch, "schema.json")))["tables"]}
+           for batch in ("first", "second")]
+for table in state["tables"]:
+    for column, entry in zip(table["columns"], table["columnTypes"]):
+        seen = [dict(zip(b[table["name"]]["columns"], b[table["name"]]["columnTypes"])).get(column)
+                if table["name"] in b else None for b in batches]
+        present = [e for e in seen if e]
+        kinds = {kind for e in present for kind in e["types"]}
+        expected = {"types": [kind for kind in ("boolean", "integer", "number", "string") if kind in kinds],
+                    "nullable": len(present) < sum(table["name"] in b for b in batches)
+                                or any(e["nullable"] for e in present)}
+        if "string" in expected["types"]:
+            expected["maxLength"] = max(e.get("maxLength", 0) for e in present)
+        if entry != expected:
+            errors.append(f"{table['name']}.{column}: column types {entry}, expected {expected}")
+            break
+
+if state["lastId"] != first_last + second_last:
+    errors.append(f"lastId is {state['lastId']}, expected {first_last + second_last}")
+
+for error in errors:
+    print(f"[append_test] FAIL ({name}): {error}")
+if errors:
+    sys.exit(1)
+print(f"[append_test] PASS ({name}): {len(state['tables'])} tables, IDs continue after {first_last}")
+PY
+}
+
+check_append tree
+check_append stream --stream
+check_append threads --threads 4
+
+echo "[append_test] Sanity check: --append cannot be combined with --schema..."
+if "$BINARY" --append --schema "$TMPDIR_OUT/tree/second/schema.json" --out-dir "$TMPDIR_OUT/rejected" \
+        < "$TMPDIR_OUT/first.json" >/dev/null 2>&1; then
+    echo "[append_test] FAIL: --append with --schema was accepted"
+    FAIL=1
+else
+    echo "[append_test] PASS: rejected"
+fi
+
+echo "[append_test] Sanity check: a damaged state file is rejected and left alone..."
+BROKEN_DIR="$TMPDIR_OUT/broken"
+mkdir -p "$BROKEN_DIR"
+echo '{"lastId": -1, "tables": []}' > "$BROKEN_DIR/json2relcsv_state.json"
+if "$BINARY" --append --out-dir "$BROKEN_DIR" < "$TMPDIR_OUT/first.json" >/dev/null 2>&1; then
+    echo "[append_test] FAIL: a damaged state file was accepted"
+    FAIL=1
+elif [ "$(ls "$BROKEN_DIR")" != "json2relcsv_state.json" ]; then
+    echo "[append_test] FAIL: output was written despite the damaged state file"
+    FAIL=1
+else
+    echo "[append_test] PASS: damaged state file rejected"
+fi
+
+# The second batch widens the first batch's tables, appends to others and adds new
+# ones; with one of its new tables unwritable, the append must fail and leave every
+# file of the first batch as it was.
+for mode in tree --stream --threads; do
+    echo "[append_test] Sanity check: a failed append changes nothing ($mode)..."
+    ROLLBACK_DIR="$TMPDIR_OUT/rollback$mode"
+    flags=()
+    [ "$mode" = --stream ] && flags=(--stream)
+    [ "$mode" = --threads ] && flags=(--threads 4)
+    "$BINARY" --append --out-dir "$ROLLBACK_DIR" ${flags[@]+"${flags[@]}"} < "$TMPDIR_OUT/first.json"
+    cp -r "$ROLLBACK_DIR" "$ROLLBACK_DIR.before"
+    mkdir "$ROLLBACK_DIR/audit.csv.tmp"
+    if "$BINARY" --append --out-dir "$ROLLBACK_DIR" ${flags[@]+"${flags[@]}"} < "$TMPDIR_OUT/second.json" 2>/dev/null; then
+        echo "[append_test] FAIL: the append succeeded"
+        FAIL=1
+    elif ! diff -r --exclude=audit.csv.tmp "$ROLLBACK_DIR.before" "$ROLLBACK_DIR" >/dev/null; then
+        diff -r --exclude=audit.csv.tmp -q "$ROLLBACK_DIR.before" "$ROLLBACK_DIR" | head -10
+        echo "[append_test] FAIL: the failed append changed the output"
+        FAIL=1
+    else
+        echo "[append_test] PASS: output unchanged"
+    fi
+done
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[append_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[append_test] RESULT: ALL PASSED"
+exit 0
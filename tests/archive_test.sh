@@ -0,0 +1,147 @@
+#!/usr/bin/env bash
+# Archive test: converts inputs with --out-archive (to standard output and to a file) and
+# with --out-dir in each mode, and verifies that the tar archive holds exactly the files
+# --out-dir writes, byte for byte, and that malformed input writes no archive.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+INPUT_FILE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[archive_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[archive_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[archive_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Large enough that its biggest table moves to a temporary file before it is archived.
+python3 "$REPO_ROOT/generate_large_json.py" "$TMPDIR_OUT/large.json" "$LARGE_OBJECTS" >/dev/null
+# A table name over ustar's 100 bytes, which needs a pax header.
+python3 -c 'import json; print(json.dumps({"k" * 150: [{"a": 1}], "x": 2}))' > "$TMPDIR_OUT/long.json"
+
+# Converts $2 with --out-dir and with --out-archive - , and checks that the archive's
+# members are the directory's files. Extra arguments go to both runs.
+check_archive() {
+    local name="$1" input="$2"
+    shift 2
+    local dir="$TMPDIR_OUT/$name"
+
+    echo "[archive_test] Converting ($name)..."
+    mkdir -p "$dir"
+    "$BINARY" --out-dir "$dir/files" "$@" < "$input"
+    "$BINARY" --out-archive - "$@" < "$input" > "$dir/out.tar"
+
+    python3 - "$dir" "$name" <<'PY' || FAIL=1
+import os, sys, tarfile
+
+dir, name = sys.argv[1:]
+files = sorted(os.listdir(os.path.join(dir, "files")))
+with tarfile.open(os.path.join(dir, "out.tar")) as archive:
+    members = archive.getmembers()
+    names = sorted(m.name for m in members)
+    if names != files or not all(m.isfile() for m in members):
+        print(f"[archive_test] FAIL ({name}): archived {names}, wrote {files}")
+        sys.exit(1)
+    for member in members:
+        if archive.extractfile(member).read() != open(os.path.join(dir, "files", member.name), "rb").read():
+            print(f"[archive_test] FAIL ({name}): {member.name} differs")
+            sys.exit(1)
+print(f"[archive_test] PASS ({name}): {len(files)} members")
+PY
+}
+
+check_archive sample "$INPUT_FILE" --emit-schema
+check_archive large "$TMPDIR_OUT/large.json" --emit-schema
+check_archive large-stream "$TMPDIR_OUT/large.json" --stream --emit-schema
+check_archive large-threads "$TMPDIR_OUT/large.json" --threads 4 --emit-schema
+check_archive large-pgcopy "$TMPDIR_OUT/large.json" --format=pgcopy
+check_archive long-name "$TMPDIR_OUT/long.json" --emit-schema
+if "$BINARY" --compress=gzip --out-dir "$TMPDIR_OUT/probe" < "$INPUT_FILE" >/dev/null 2>&1; then
+    check_archive large-gzip "$TMPDIR_OUT/large.json" --compress=gzip:1
+fi
+
+echo "[archive_test] Writing the archive to a file..."
+"$BINARY" --emit-schema --out-archive "$TMPDIR_OUT/file.tar" < "$INPUT_FILE"
+if cmp -s <(tar -xOf "$TMPDIR_OUT/file.tar" root.csv) "$TMPDIR_OUT/sample/files/root.csv"; then
+    echo "[archive_test] PASS: tar extracts it"
+else
+    echo "[archive_test] FAIL: tar could not extract root.csv"
+    FAIL=1
+fi
+
+# Converts $2 with --out-archive to a file, expecting the conversion to fail after some
+# members were written; the file must be removed. Extra arguments go to the run.
+check_removed() {
+    local name="$1" input="$2"
+    shift 2
+    local file="$TMPDIR_OUT/$name.tar"
+
+    echo "[archive_test] Sanity check: a failed conversion leaves no archive ($name)..."
+    if (trap '' XFSZ; "$BINARY" --out-archive "$file" "$@" < "$input") 2>"$TMPDIR_OUT/$name.err"; then
+        echo "[archive_test] FAIL ($name): the conversion succeeded"
+        FAIL=1
+    elif [ -e "$file" ]; then
+        echo "[archive_test] FAIL ($name): $(wc -c < "$file") bytes left in the archive"
+        FAIL=1
+    else
+        echo "[archive_test] PASS ($name): $(cat "$TMPDIR_OUT/$name.err")"
+    fi
+}
+
+# With --schema, rows go out during the parse, so every table's member is written when
+# a malformed document fails it.
+python3 -c 'import sys; text = open(sys.argv[1]).read(); print(text[:len(text) // 2])' \
+    "$INPUT_FILE" > "$TMPDIR_OUT/truncated.json"
+check_removed schema "$TMPDIR_OUT/truncated.json" --schema "$TMPDIR_OUT/sample/files/schema.json"
+# A value the loaded types cannot hold fails pgcopy once its table is closed.
+echo '{"t": [{"a": 1}]}' | "$BINARY" --emit-schema --out-dir "$TMPDIR_OUT/typed" >/dev/null
+echo '{"t": [{"a": "x"}], "u": [{"b": 1}]}' > "$TMPDIR_OUT/mistyped.json"
+check_removed pgcopy "$TMPDIR_OUT/mistyped.json" --format=pgcopy --schema "$TMPDIR_OUT/typed/schema.json" \
+    --drop-unknown
+# A write to the archive fails once it outgrows the file size limit.
+(ulimit -f 64; check_removed write-failure "$TMPDIR_OUT/large.json" --emit-schema; exit "$FAIL") || FAIL=1
+
+echo "[archive_test] Sanity check: a failed archive on a device is left alone..."
+if [ -c /dev/full ]; then
+    if "$BINARY" --out-archive /dev/full < "$INPUT_FILE" 2>/dev/null; then
+        echo "[archive_test] FAIL: writing to /dev/full succeeded"
+        FAIL=1
+    elif [ ! -c /dev/full ]; then
+        echo "[archive_test] FAIL: /dev/full was removed"
+        FAIL=1
+    else
+        echo "[archive_test] PASS: failed, and /dev/full is still there"
+    fi
+fi
+
+echo "[archive_test] Sanity check: malformed input writes no archive..."
+if echo '{"a": [1, 2' | "$BINARY" --out-archive - > "$TMPDIR_OUT/failed.tar" 2>/dev/null; then
+    echo "[archive_test] FAIL: malformed input was accepted"
+    FAIL=1
+elif [ -s "$TMPDIR_OUT/failed.tar" ]; then
+    echo "[archive_test] FAIL: $(wc -c < "$TMPDIR_OUT/failed.tar") bytes written"
+    FAIL=1
+else
+    echo "[archive_test] PASS: nothing written"
+fi
+if "$BINARY" --print-ast --out-archive - < "$INPUT_FILE" >/dev/null 2>&1; then
+    echo "[archive_test] FAIL: --print-ast was accepted with --out-archive -"
+    FAIL=1
+else
+    echo "[archive_test] PASS: --print-ast rejected with --out-archive -"
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[archive_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[archive_test] RESULT: ALL PASSED"
+exit 0
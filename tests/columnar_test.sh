@@ -0,0 +1,134 @@
+#!/usr/bin/env bash
+# Columnar test: converts inputs with --format=columnar and with the default CSV in each
+# mode, and verifies that json2relcsv_dump turns every .jrc back into exactly the CSV,
+# that the same tables are written, and that the columnar files of the large input are
+# smaller than its CSVs.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+DUMP="$REPO_ROOT/build/json2relcsv_dump"
+INPUT_FILE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binaries not present
+if [ ! -f "$BINARY" ] || [ ! -f "$DUMP" ]; then
+    echo "[columnar_test] Binaries not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[columnar_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[columnar_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+python3 "$REPO_ROOT/generate_large_json.py" "$TMPDIR_OUT/large.json" "$LARGE_OBJECTS" >/dev/null
+python3 - "$TMPDIR_OUT/large.json" "$TMPDIR_OUT/large.jsonl" <<'PY'
+import json, sys
+with open(sys.argv[2], "w") as out:
+    for record in json.load(open(sys.argv[1]))["records"]:
+        out.write(json.dumps(record) + "\n")
+PY
+
+# Values every encoding has to reproduce: numbers with no exact fixed type, integers at
+# the int64 limits, mixed columns, escapes, and columns that change type between chunks.
+python3 - "$TMPDIR_OUT/edge.json" <<'PY'
+import json, sys
+numbers = ["0", "-0", "0.0", "1.50", "1e400", "1E5", "5e-324", "0.1", "-12.5e-3",
+           "9223372036854775807", "-9223372036854775808", "18446744073709551616"]
+rows = []
+for i in range(70000):
+    row = '{"n": %s, "i": %d, "s": %s, "b": %s, "m": %s}' % (
+        numbers[i % len(numbers)],
+        (i * 7919) % 1000003 - 500000,
+        json.dumps(["plain", "with \"quotes\"", "comma, here", "line\nbreak", ""][i % 5]
+                   if i < 40000 else "unique %d" % i),
+        ["true", "false", "null"][i % 3],
+        ["1", '"1"', "true", "null", "2.5"][i % 5] if i < 65536 else "3")
+    rows.append(row)
+open(sys.argv[1], "w").write("[" + ",\n".join(rows) + "]")
+PY
+
+# Converts with and without --format=columnar into "<dir>/columnar" and "<dir>/csv",
+# then checks the dumped .jrc files against the CSVs. Extra arguments go to both runs.
+check_columnar() {
+    local name="$1" input="$2"
+    shift 2
+    local dir="$TMPDIR_OUT/$name"
+
+    echo "[columnar_test] Converting ($name)..."
+    mkdir -p "$dir"
+    "$BINARY" --out-dir "$dir/csv" "$@" < "$input"
+    "$BINARY" --format=columnar --out-dir "$dir/columnar" "$@" < "$input"
+
+    local csv_names jrc_names
+    csv_names="$(cd "$dir/csv" && ls | grep '\.csv$' | sed 's/\.csv$//')"
+    jrc_names="$(cd "$dir/columnar" && ls | grep '\.jrc$' | sed 's/\.jrc$//')"
+    if [ "$csv_names" != "$jrc_names" ]; then
+        echo "[columnar_test] FAIL ($name): tables differ from the CSV output"
+        FAIL=1
+        return
+    fi
+
+    local table count=0
+    for table in $csv_names; do
+        if ! "$DUMP" "$dir/columnar/$table.jrc" | cmp -s - "$dir/csv/$table.csv"; then
+            echo "[columnar_test] FAIL ($name): $table.jrc does not dump to $table.csv"
+            FAIL=1
+        fi
+        count=$((count + 1))
+    done
+    echo "[columnar_test] PASS ($name): $count tables"
+}
+
+check_columnar sample "$INPUT_FILE"
+check_columnar sample-stream "$INPUT_FILE" --stream
+check_columnar large "$TMPDIR_OUT/large.json" --emit-schema
+check_columnar large-stream "$TMPDIR_OUT/large.json" --stream
+check_columnar large-threads "$TMPDIR_OUT/large.json" --threads 4
+check_columnar large-ndjson "$TMPDIR_OUT/large.jsonl" --ndjson --threads 4
+check_columnar large-schema "$TMPDIR_OUT/large.json" --schema "$TMPDIR_OUT/large/csv/schema.json"
+check_columnar edge "$TMPDIR_OUT/edge.json"
+
+echo "[columnar_test] Checking that the columnar output is smaller..."
+CSV_BYTES=$(cat "$TMPDIR_OUT"/large/csv/*.csv | wc -c)
+JRC_BYTES=$(cat "$TMPDIR_OUT"/large/columnar/*.jrc | wc -c)
+if [ "$JRC_BYTES" -lt "$CSV_BYTES" ]; then
+    echo "[columnar_test] PASS: $JRC_BYTES bytes of .jrc, $CSV_BYTES bytes of CSV"
+else
+    echo "[columnar_test] FAIL: $JRC_BYTES bytes of .jrc is not smaller than $CSV_BYTES bytes of CSV"
+    FAIL=1
+fi
+
+if ! cmp -s "$TMPDIR_OUT/large/csv/schema.json" "$TMPDIR_OUT/large/columnar/schema.json"; then
+    echo "[columnar_test] FAIL: schema.json differs between formats"
+    FAIL=1
+fi
+
+echo "[columnar_test] Sanity check: the dumper rejects a truncated file..."
+head -c 100 "$TMPDIR_OUT/edge/columnar/root.jrc" > "$TMPDIR_OUT/truncated.jrc"
+if "$DUMP" "$TMPDIR_OUT/truncated.jrc" >/dev/null 2>&1; then
+    echo "[columnar_test] FAIL: a truncated file was accepted"
+    FAIL=1
+else
+    echo "[columnar_test] PASS: rejected"
+fi
+
+echo "[columnar_test] Sanity check: bad --format combinations are rejected..."
+for args in "--format=bogus" "--format columnar --append"; do
+    # shellcheck disable=SC2086
+    if "$BINARY" $args --out-dir "$TMPDIR_OUT/rejected" < "$INPUT_FILE" >/dev/null 2>&1; then
+        echo "[columnar_test] FAIL: '$args' was accepted"
+        FAIL=1
+    fi
+done
+echo "[columnar_test] PASS: rejected"
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[columnar_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[columnar_test] RESULT: ALL PASSED"
+exit 0
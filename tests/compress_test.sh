@@ -0,0 +1,113 @@
+#!/usr/bin/env bash
+# Compression test: converts inputs with --compress and without in each mode, and verifies
+# that every output comes out as "<name>.gz" or "<name>.zst" holding exactly the bytes of
+# the uncompressed file. Codecs the build (or this machine's decompressors) lack are skipped.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+INPUT_FILE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[compress_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[compress_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[compress_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Large enough that every table spans several compression blocks.
+python3 "$REPO_ROOT/generate_large_json.py" "$TMPDIR_OUT/large.json" "$LARGE_OBJECTS" >/dev/null
+echo '[]' > "$TMPDIR_OUT/empty.json"
+
+# The codecs to test: gzip is decompressed with Python, zstd with the zstd command.
+CODECS=""
+for codec in gzip zstd; do
+    if ! "$BINARY" --compress=$codec --out-dir "$TMPDIR_OUT/probe-$codec" < "$INPUT_FILE" 2>"$TMPDIR_OUT/probe.err"; then
+        echo "[compress_test] SKIP: $codec ($(cat "$TMPDIR_OUT/probe.err"))"
+    elif [ "$codec" = "zstd" ] && ! command -v zstd >/dev/null; then
+        echo "[compress_test] SKIP: zstd (no zstd command to decompress with)"
+    else
+        CODECS="$CODECS $codec"
+    fi
+done
+
+# Converts with and without --compress=$2 into "<dir>/compressed" and "<dir>/plain", then
+# checks that each compressed file decompresses to its plain counterpart. Extra arguments
+# go to both runs.
+check_compress() {
+    local name="$1" compress="$2" input="$3"
+    shift 3
+    local dir="$TMPDIR_OUT/$name-${compress%%:*}"
+
+    echo "[compress_test] Converting ($name, $compress)..."
+    mkdir -p "$dir"
+    "$BINARY" --out-dir "$dir/plain" "$@" < "$input"
+    "$BINARY" --compress="$compress" --out-dir "$dir/compressed" "$@" < "$input"
+
+    python3 - "$dir" "$name" "${compress%%:*}" <<'PY' || FAIL=1
+import gzip, os, subprocess, sys
+
+dir, name, codec = sys.argv[1:]
+extension = {"gzip": ".gz", "zstd": ".zst"}[codec]
+plain = sorted(os.listdir(os.path.join(dir, "plain")))
+compressed = sorted(os.listdir(os.path.join(dir, "compressed")))
+if compressed != [f + extension for f in plain]:
+    print(f"[compress_test] FAIL ({name}, {codec}): wrote {compressed} for {plain}")
+    sys.exit(1)
+
+for f in plain:
+    path = os.path.join(dir, "compressed", f + extension)
+    if codec == "gzip":
+        data = gzip.open(path).read()
+    else:
+        data = subprocess.run(["zstd", "-dcq", path], capture_output=True, check=True).stdout
+    if data != open(os.path.join(dir, "plain", f), "rb").read():
+        print(f"[compress_test] FAIL ({name}, {codec}): {f}{extension} does not decompress to {f}")
+        sys.exit(1)
+print(f"[compress_test] PASS ({name}, {codec}): {len(plain)} files")
+PY
+}
+
+for codec in $CODECS; do
+    check_compress sample "$codec" "$INPUT_FILE" --emit-schema
+    check_compress large "$codec" "$TMPDIR_OUT/large.json" --emit-schema
+    check_compress large-stream "$codec" "$TMPDIR_OUT/large.json" --stream --emit-schema
+    check_compress large-threads "$codec" "$TMPDIR_OUT/large.json" --threads 4
+    check_compress large-pgcopy "$codec" "$TMPDIR_OUT/large.json" --format=pgcopy
+    check_compress large-fastest "$codec:1" "$TMPDIR_OUT/large.json"
+    check_compress empty "$codec" "$TMPDIR_OUT/empty.json" --emit-schema
+done
+case " $CODECS " in
+    *" gzip "*) check_compress large-best gzip:9 "$TMPDIR_OUT/large.json" ;;
+esac
+
+echo "[compress_test] Sanity check: bad --compress values are rejected..."
+ACCEPTED=""
+for value in lz4 gzip: gzip:x gzip:0 gzip:10 zstd:23; do
+    if "$BINARY" --compress=$value --out-dir "$TMPDIR_OUT/bad" < "$INPUT_FILE" >/dev/null 2>&1; then
+        ACCEPTED="$ACCEPTED --compress=$value"
+    fi
+done
+if "$BINARY" --compress=gzip --append --out-dir "$TMPDIR_OUT/bad" < "$INPUT_FILE" >/dev/null 2>&1; then
+    ACCEPTED="$ACCEPTED --compress=gzip --append"
+fi
+if [ -n "$ACCEPTED" ]; then
+    echo "[compress_test] FAIL: accepted$ACCEPTED"
+    FAIL=1
+else
+    echo "[compress_test] PASS: rejected"
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[compress_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[compress_test] RESULT: ALL PASSED"
+exit 0
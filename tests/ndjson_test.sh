@@ -0,0 +1,114 @@
+#!/usr/bin/env bash
+# NDJSON test: verifies --ndjson converts JSON Lines exactly like the same records
+# wrapped in a top-level array, single- and multi-threaded, and with --stream.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+RECORDS="${RECORDS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[ndjson_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[ndjson_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[ndjson_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Compares the output directories $2 (expected) and $3 for test case $1.
+check_same() {
+    local name="$1" expected="$2" actual="$3"
+    if ! diff -r "$expected" "$actual" >/dev/null; then
+        diff -ru "$expected" "$actual" | head -40
+        echo "[ndjson_test] FAIL: $name differs from the wrapped array"
+        FAIL=1
+    else
+        echo "[ndjson_test] PASS: $name matches the wrapped array"
+    fi
+}
+
+# The records of the large benchmark input, one per line, with nested objects and arrays.
+LINES="$TMPDIR_OUT/records.jsonl"
+WRAPPED="$TMPDIR_OUT/records.json"
+python3 "$REPO_ROOT/generate_large_json.py" "$WRAPPED" "$RECORDS" >/dev/null
+python3 - "$WRAPPED" "$LINES" <<'PY'
+import json, sys
+with open(sys.argv[1]) as f:
+    document = json.load(f)
+records = document["records"]
+with open(sys.argv[2], "w") as f:
+    for record in records:
+        f.write(json.dumps(record) + "\n")
+with open(sys.argv[1], "w") as f:
+    json.dump(records, f)
+PY
+
+echo "[ndjson_test] Converting $RECORDS records as a wrapped array..."
+"$BINARY" --emit-schema --out-dir "$TMPDIR_OUT/wrapped" < "$WRAPPED"
+"$BINARY" --stream --emit-schema --out-dir "$TMPDIR_OUT/wrapped-stream" < "$WRAPPED"
+
+for threads in 1 2 5; do
+    "$BINARY" --ndjson --threads "$threads" --emit-schema --out-dir "$TMPDIR_OUT/stdin-$threads" < "$LINES"
+    check_same "--ndjson --threads $threads (stdin)" "$TMPDIR_OUT/wrapped" "$TMPDIR_OUT/stdin-$threads"
+    "$BINARY" --ndjson --threads "$threads" --emit-schema --input "$LINES" --out-dir "$TMPDIR_OUT/mapped-$threads"
+    check_same "--ndjson --threads $threads (--input)" "$TMPDIR_OUT/wrapped" "$TMPDIR_OUT/mapped-$threads"
+done
+
+"$BINARY" --ndjson --stream --emit-schema --out-dir "$TMPDIR_OUT/stream" < "$LINES"
+check_same "--ndjson --stream" "$TMPDIR_OUT/wrapped-stream" "$TMPDIR_OUT/stream"
+
+# Sanity: a syntax error is reported with its line number in the whole input, even
+# when it falls in a later chunk.
+echo "[ndjson_test] Sanity check: error line numbers span chunks..."
+BAD="$TMPDIR_OUT/bad.jsonl"
+{ head -n 999 "$LINES"; echo '{"broken" 1}'; tail -n +1000 "$LINES"; } > "$BAD"
+if "$BINARY" --ndjson --threads 4 --out-dir "$TMPDIR_OUT/bad" < "$BAD" 2>"$TMPDIR_OUT/bad.err"; then
+    echo "[ndjson_test] FAIL: malformed line was accepted"
+    FAIL=1
+elif ! grep -q "line 1000," "$TMPDIR_OUT/bad.err"; then
+    cat "$TMPDIR_OUT/bad.err"
+    echo "[ndjson_test] FAIL: error does not name line 1000"
+    FAIL=1
+else
+    echo "[ndjson_test] PASS: error reported at line 1000"
+fi
+
+# Sanity: a record that goes on past its line is rejected the same way at every thread
+# count, since the input is split at newlines; blank lines and CRLF endings are fine.
+echo "[ndjson_test] Sanity check: records span one line..."
+SPLIT="$TMPDIR_OUT/split.jsonl"
+{ head -n 999 "$LINES"; printf '{"a": 1,\n "b": 2}\n'; tail -n +1000 "$LINES"; } > "$SPLIT"
+for threads in 1 4; do
+    for source in stdin input; do
+        input_args=()
+        [ "$source" = input ] && input_args=(--input "$SPLIT")
+        if "$BINARY" --ndjson --threads "$threads" ${input_args[@]+"${input_args[@]}"} --out-dir "$TMPDIR_OUT/split" \
+            < "$SPLIT" 2>"$TMPDIR_OUT/split.err"; then
+            echo "[ndjson_test] FAIL: multi-line record accepted (--threads $threads, $source)"
+            FAIL=1
+        elif ! grep -q "Newline inside a JSON Lines record at line 1000," "$TMPDIR_OUT/split.err"; then
+            cat "$TMPDIR_OUT/split.err"
+            echo "[ndjson_test] FAIL: wrong error for a multi-line record (--threads $threads, $source)"
+            FAIL=1
+        else
+            echo "[ndjson_test] PASS: multi-line record rejected at line 1000 (--threads $threads, $source)"
+        fi
+    done
+done
+printf '{"a": 1}\r\n\n  [1, 2] \r\n"x"\n' > "$TMPDIR_OUT/blank.jsonl"
+printf '[{"a": 1}, [1, 2], "x"]' > "$TMPDIR_OUT/blank.json"
+"$BINARY" --out-dir "$TMPDIR_OUT/blank-wrapped" < "$TMPDIR_OUT/blank.json"
+"$BINARY" --ndjson --threads 2 --out-dir "$TMPDIR_OUT/blank" < "$TMPDIR_OUT/blank.jsonl"
+check_same "--ndjson with blank lines and CRLF" "$TMPDIR_OUT/blank-wrapped" "$TMPDIR_OUT/blank"
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[ndjson_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[ndjson_test] RESULT: ALL PASSED"
+exit 0
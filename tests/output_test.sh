@@ -0,0 +1,109 @@
+#!/usr/bin/env bash
+# Output test: verifies that an output which cannot be opened or written fails the
+# conversion (exit status and message) in each mode, rather than leaving a short file
+# behind a successful exit, and that a document with more tables than the process may
+# open files still writes all of them.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+SAMPLE="$REPO_ROOT/tests/sample.json"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[output_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[output_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[output_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Converts the sample into a fresh directory where the output $2 is already taken: $3
+# "full" makes it a link to /dev/full (every write fails), "dir" a directory (it cannot
+# be opened). Extra arguments go to the conversion, which must fail naming $4.
+check_failure() {
+    local name="$1" output="$2" kind="$3" expected="$4"
+    shift 4
+    local dir="$TMPDIR_OUT/$name"
+
+    mkdir -p "$dir"
+    if [ "$kind" = full ]; then
+        ln -s /dev/full "$dir/$output"
+    else
+        mkdir "$dir/$output"
+    fi
+    echo "[output_test] Converting ($name)..."
+    if "$BINARY" --out-dir "$dir" "$@" < "$SAMPLE" 2> "$dir.err"; then
+        echo "[output_test] FAIL ($name): the conversion succeeded"
+        FAIL=1
+    elif ! grep -q "Could not write the output $expected" "$dir.err"; then
+        echo "[output_test] FAIL ($name): unexpected error: $(cat "$dir.err")"
+        FAIL=1
+    else
+        echo "[output_test] PASS ($name)"
+    fi
+}
+
+if [ -w /dev/full ]; then
+    check_failure full root.csv full root.csv
+    check_failure full-stream root.csv full root.csv --stream
+    check_failure full-threads users.csv full users.csv --threads 4
+    check_failure full-schema schema.json full schema.json --emit-schema
+    check_failure full-pgcopy root.pgcopy full root.csv --format=pgcopy
+    check_failure full-columnar root.jrc full root.csv --format=columnar
+    if "$BINARY" --compress=gzip --out-dir "$TMPDIR_OUT/probe" < "$SAMPLE" >/dev/null 2>&1; then
+        check_failure full-gzip root.csv.gz full root.csv --compress=gzip
+    fi
+else
+    echo "[output_test] SKIP: /dev/full is not available"
+fi
+check_failure dir root.csv dir root.csv
+check_failure dir-stream root.csv dir root.csv --stream
+check_failure dir-threads users.csv dir users.csv --threads 4
+
+# A fixed schema opens every table's CSV before the parse.
+"$BINARY" --emit-schema --out-dir "$TMPDIR_OUT/schema" < "$SAMPLE"
+check_failure dir-fixed-schema root.csv dir root.csv --schema "$TMPDIR_OUT/schema/schema.json"
+
+# 1500 tables (and root), under the usual limit of 1024 open files.
+python3 -c 'import json; print(json.dumps({"t%04d" % i: [{"a": i}, {"a": -i}] for i in range(1500)}))' \
+    > "$TMPDIR_OUT/tables.json"
+
+# Converts the many-table document with the given flags into $1 and checks that every
+# table was written, the same as without them.
+check_tables() {
+    local name="$1"
+    shift
+    local dir="$TMPDIR_OUT/tables-$name"
+
+    echo "[output_test] Converting 1501 tables ($name)..."
+    if ! (ulimit -n 1024 && "$BINARY" --out-dir "$dir" "$@" < "$TMPDIR_OUT/tables.json"); then
+        echo "[output_test] FAIL ($name): the conversion failed"
+        FAIL=1
+    elif [ "$(ls "$dir" | wc -l)" -ne 1501 ]; then
+        echo "[output_test] FAIL ($name): $(ls "$dir" | wc -l) files written"
+        FAIL=1
+    elif [ "$name" != ast ] && ! diff -r "$TMPDIR_OUT/tables-ast" "$dir" >/dev/null; then
+        echo "[output_test] FAIL ($name): differs from the AST path"
+        FAIL=1
+    else
+        echo "[output_test] PASS ($name)"
+    fi
+}
+
+check_tables ast
+check_tables threads --threads 4
+check_tables stream --stream
+"$BINARY" --emit-schema --out-dir "$TMPDIR_OUT/tables-schema" < "$TMPDIR_OUT/tables.json"
+check_tables fixed-schema --schema "$TMPDIR_OUT/tables-schema/schema.json"
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[output_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[output_test] RESULT: ALL PASSED"
+exit 0
@@ -0,0 +1,228 @@
+#!/usr/bin/env bash
+# PostgreSQL COPY test: converts inputs with --format=pgcopy and with the default CSV in
+# each mode, decodes every .pgcopy with json2relcsv_pgcopy_dump, and verifies that it
+# holds the CSV's values in its column types (text exactly, bigint and numeric by value,
+# numeric with the lexeme's decimal places) and that schema.sql declares those types.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+DUMP="$REPO_ROOT/build/json2relcsv_pgcopy_dump"
+INPUT_FILE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-5000}"
+
+# Build if binaries not present
+if [ ! -f "$BINARY" ] || [ ! -f "$DUMP" ]; then
+    echo "[pgcopy_test] Binaries not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[pgcopy_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[pgcopy_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+python3 "$REPO_ROOT/generate_large_json.py" "$TMPDIR_OUT/large.json" "$LARGE_OBJECTS" >/dev/null
+python3 - "$TMPDIR_OUT/large.json" "$TMPDIR_OUT/large.jsonl" <<'PY'
+import json, sys
+with open(sys.argv[2], "w") as out:
+    for record in json.load(open(sys.argv[1]))["records"]:
+        out.write(json.dumps(record) + "\n")
+PY
+
+# Values each column type has to carry: numbers only numeric holds exactly, integers at
+# the bigint limits, booleans, and strings that need quoting in CSV.
+cat > "$TMPDIR_OUT/edge.json" <<'JSON'
+[
+  {"i": 9223372036854775807, "n": 1.50, "b": true, "s": "with \"quotes\", commas\nand lines", "m": 1},
+  {"i": -9223372036854775808, "n": 1e400, "b": false, "s": "", "m": "1"},
+  {"i": -0, "n": -0.0, "b": null, "s": null, "m": true},
+  {"i": 0, "n": 18446744073709551616, "s": "plain", "m": 2.5},
+  {"n": 1E5, "m": null},
+  {"n": -12.5e-3},
+  {"n": 5e-324},
+  {"n": 0.000123456789012345678901234567890}
+]
+JSON
+
+# The schema pass skips arrays nested in arrays, so it never sees the positions written
+# to "t"'s "seq" from inside them, nor the string in "u"'s "a": each column holds values
+# it did not type, and has to be widened to text.
+cat > "$TMPDIR_OUT/skipped.json" <<'JSON'
+{"t": {"seq": true}, "u": [{"a": 1}], "l": [[{"t": [{"a": 1}]}, {"u": [{"a": "x", "b": 2}]}]]}
+JSON
+
+# Converts with and without --format=pgcopy into "<dir>/pgcopy" and "<dir>/csv", then
+# checks the decoded files against the CSVs. Extra arguments go to both runs.
+check_pgcopy() {
+    local name="$1" input="$2"
+    shift 2
+    local dir="$TMPDIR_OUT/$name"
+
+    echo "[pgcopy_test] Converting ($name)..."
+    mkdir -p "$dir"
+    "$BINARY" --out-dir "$dir/csv" "$@" < "$input"
+    "$BINARY" --format=pgcopy --out-dir "$dir/pgcopy" "$@" < "$input"
+
+    python3 - "$dir" "$name" "$DUMP" <<'PY' || FAIL=1
+import os, re, subprocess, sys
+from decimal import Decimal
+
+dir, name, dump = sys.argv[1:]
+
+def parse(text):
+    """The header and rows of CSV in the writers' dialect, each field as
+    (quoted, text), or None for null."""
+    header, _, body = text.partition("\n")
+    rows, row, i = [], [], 0
+    while i < len(body):
+        if body[i] == '"':
+            i += 1
+            value = []
+            while True:
+                quote = body.index('"', i)
+                value.append(body[i:quote])
+                i = quote + 1
+                if body[i:i + 1] != '"':
+                    break
+                value.append('"')
+                i += 1
+            row.append((True, "".join(value)))
+        else:
+            end = i
+            while end < len(body) and body[end] not in ",\n":
+                end += 1
+            row.append((False, body[i:end]) if end > i else None)
+            i = end
+        if body[i] == "\n":
+            rows.append(row)
+            row = []
+        i += 1
+    return header.split(",") if header else [], rows
+
+def same(column_type, csv, decoded):
+    if csv is None or decoded is None:
+        return csv is None and decoded is None
+    if column_type == "text":
+        return decoded[0] and decoded[1] == csv[1]
+    if column_type == "boolean":
+        return decoded == csv
+    if column_type == "bigint":
+        return not csv[0] and int(decoded[1]) == int(csv[1])
+    value = Decimal(csv[1])
+    places = max(0, -value.as_tuple().exponent)
+    return (not csv[0] and Decimal(decoded[1]) == value
+            and len(decoded[1].partition(".")[2]) == places)
+
+errors = []
+ddl = open(os.path.join(dir, "pgcopy", "schema.sql")).read()
+csv_tables = sorted(f[:-4] for f in os.listdir(os.path.join(dir, "csv")) if f.endswith(".csv"))
+pgcopy_tables = sorted(f[:-7] for f in os.listdir(os.path.join(dir, "pgcopy")) if f.endswith(".pgcopy"))
+if csv_tables != pgcopy_tables:
+    errors.append(f"tables differ: {csv_tables} vs {pgcopy_tables}")
+
+rows = 0
+for table in csv_tables if not errors else []:
+    path = os.path.join(dir, "pgcopy", table + ".pgcopy")
+    info = subprocess.run([dump, "--info", path], capture_output=True, text=True, check=True).stdout
+    types = [line.split()[-1] for line in info.splitlines() if line.startswith("  ")]
+    header, expected = parse(open(os.path.join(dir, "csv", table + ".csv"), newline="").read())
+    decoded_header, decoded = parse(subprocess.run([dump, path], capture_output=True, text=True,
+                                                   check=True).stdout)
+
+    declared = re.search(r'CREATE TABLE "%s" \((.*?)\n\);' % table, ddl, re.S)
+    columns = [re.match(r'\s*"(.*)" (\w+)', line).groups() for line in declared.group(1).strip().split(",\n")] \
+        if declared else []
+    if columns != list(zip(header, types)):
+        errors.append(f"{table}: schema.sql does not declare the file's columns and types")
+    if decoded_header != header or len(decoded) != len(expected):
+        errors.append(f"{table}: {len(decoded)} rows decoded, {len(expected)} in the CSV")
+        continue
+    for csv_row, decoded_row in zip(expected, decoded):
+        if not all(same(t, c, d) for t, c, d in zip(types, csv_row, decoded_row)) or len(decoded_row) != len(types):
+            errors.append(f"{table}: row {csv_row} decoded as {decoded_row}")
+            break
+    rows += len(expected)
+
+for error in errors:
+    print(f"[pgcopy_test] FAIL ({name}): {error}")
+if errors:
+    sys.exit(1)
+print(f"[pgcopy_test] PASS ({name}): {len(csv_tables)} tables, {rows} rows")
+PY
+}
+
+check_pgcopy sample "$INPUT_FILE"
+check_pgcopy sample-stream "$INPUT_FILE" --stream
+check_pgcopy large "$TMPDIR_OUT/large.json" --emit-schema
+check_pgcopy large-stream "$TMPDIR_OUT/large.json" --stream
+check_pgcopy large-threads "$TMPDIR_OUT/large.json" --threads 4
+check_pgcopy large-ndjson "$TMPDIR_OUT/large.jsonl" --ndjson --threads 4
+check_pgcopy large-schema "$TMPDIR_OUT/large.json" --schema "$TMPDIR_OUT/large/csv/schema.json"
+check_pgcopy edge "$TMPDIR_OUT/edge.json"
+check_pgcopy skipped "$TMPDIR_OUT/skipped.json"
+check_pgcopy skipped-stream "$TMPDIR_OUT/skipped.json" --stream
+check_pgcopy skipped-threads "$TMPDIR_OUT/skipped.json" --threads 4
+
+echo "[pgcopy_test] Checking the inferred column types..."
+EXPECTED_TYPES="id bigint
+seq bigint
+i bigint
+n numeric
+b boolean
+s text
+m text"
+ACTUAL_TYPES="$("$DUMP" --info "$TMPDIR_OUT/edge/pgcopy/root.pgcopy" | awk '/^  / { print $1, $2 }')"
+if [ "$ACTUAL_TYPES" = "$EXPECTED_TYPES" ]; then
+    echo "[pgcopy_test] PASS: bigint, numeric, boolean and text columns"
+else
+    echo "[pgcopy_test] FAIL: column types were"
+    echo "$ACTUAL_TYPES"
+    FAIL=1
+fi
+
+for mode in skipped skipped-stream skipped-threads; do
+    ACTUAL_TYPES="$(for table in t u; do
+        "$DUMP" --info "$TMPDIR_OUT/$mode/pgcopy/$table.pgcopy" | awk -v t="$table" '/^  (seq|a) / { print t, $1, $2 }'
+    done)"
+    if [ "$ACTUAL_TYPES" = "t seq text
+u seq bigint
+u a text" ]; then
+        echo "[pgcopy_test] PASS ($mode): values the schema pass skipped widen their columns"
+    else
+        echo "[pgcopy_test] FAIL ($mode): column types were"
+        echo "$ACTUAL_TYPES"
+        FAIL=1
+    fi
+done
+
+echo "[pgcopy_test] Sanity check: with --schema, a value its column's type cannot hold is an error..."
+echo '{"t": [{"a": 1}]}' | "$BINARY" --emit-schema --out-dir "$TMPDIR_OUT/typed" >/dev/null
+if echo '{"t": [{"a": "x"}]}' | "$BINARY" --format=pgcopy --schema "$TMPDIR_OUT/typed/schema.json" \
+        --out-dir "$TMPDIR_OUT/mismatch" 2>"$TMPDIR_OUT/mismatch.err" >/dev/null; then
+    echo "[pgcopy_test] FAIL: the conversion succeeded"
+    FAIL=1
+elif ! grep -q 'Column "a" of table "t"' "$TMPDIR_OUT/mismatch.err"; then
+    echo "[pgcopy_test] FAIL: the error does not name the column"
+    FAIL=1
+else
+    echo "[pgcopy_test] PASS: rejected"
+fi
+
+echo "[pgcopy_test] Sanity check: the dumper rejects a truncated file..."
+head -c 60 "$TMPDIR_OUT/edge/pgcopy/root.pgcopy" > "$TMPDIR_OUT/truncated.pgcopy"
+if "$DUMP" "$TMPDIR_OUT/truncated.pgcopy" >/dev/null 2>&1; then
+    echo "[pgcopy_test] FAIL: a truncated file was accepted"
+    FAIL=1
+else
+    echo "[pgcopy_test] PASS: rejected"
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[pgcopy_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[pgcopy_test] RESULT: ALL PASSED"
+exit 0
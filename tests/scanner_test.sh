@@ -0,0 +1,96 @@
+#!/usr/bin/env bash
+# Scanner test: converts a document whose string and number tokens straddle the
+# scanner's 16 KiB input buffer, or are longer than it, from standard input, a mapped
+# file (--input), --stream and --ndjson, and checks every value against the text it
+# was generated from. Token values point into the scanner's buffer until the next
+# token, so a refill that moves or grows the buffer must not reach a value in use.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[scanner_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[scanner_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[scanner_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Writes the document as a JSON array (doc.json) and as JSON Lines (doc.jsonl), and the
+# root.csv both must convert to (expected.csv). Strings are written with and without
+# escapes; numbers are lexemes, copied to the CSV as written.
+python3 - "$TMPDIR_OUT" <<'PY'
+import os, random, sys
+
+out = sys.argv[1]
+rng = random.Random(9)
+escapes = {'"': '\\"', '\\': '\\\\', '\n': '\\n', '\t': '\\t', '/': '\\/'}
+
+def text(n, escaped):
+    chars = [rng.choice("abcdefgh ") for _ in range(n)]
+    if escaped and n:
+        for i in rng.sample(range(n), min(n, 8)):
+            chars[i] = rng.choice(list(escapes))
+    return "".join(chars)
+
+def encode(s):
+    return '"' + "".join(escapes.get(c, c) for c in s) + '"'
+
+def number(n):
+    return "-" + "7" * max(n, 1) + ".25e-3"
+
+# Lengths around the buffer size and its multiples, then random ones that keep moving
+# token boundaries across refills.
+lengths = [0, 1, 16381, 16382, 16383, 16384, 16385, 32768, 40000, 100000]
+lengths += [rng.randint(0, 20000) for _ in range(60)]
+
+records, rows = [], []
+for i, n in enumerate(lengths):
+    s, e, num = text(n, False), text(n // 2, True), number(rng.choice([1, n % 5000]))
+    records.append('{"s": %s, "e": %s, "n": %s}' % (encode(s), encode(e), num))
+    quote = lambda v: '"' + v.replace('"', '""') + '"'
+    rows.append("%d,%d,%s,%s,%s" % (i + 1, i, quote(s), quote(e), num))
+
+with open(os.path.join(out, "doc.json"), "w") as f:
+    f.write("[\n" + ",\n".join(records) + "\n]\n")
+with open(os.path.join(out, "doc.jsonl"), "w") as f:
+    f.write("\n".join(records) + "\n")
+with open(os.path.join(out, "expected.csv"), "w", newline="") as f:
+    f.write("id,seq,s,e,n\n" + "\n".join(rows) + "\n")
+PY
+
+# Converts with the given flags and compares root.csv with the expected one.
+check_scan() {
+    local name="$1"
+    shift
+    local dir="$TMPDIR_OUT/$name"
+
+    echo "[scanner_test] Converting ($name)..."
+    "$BINARY" --out-dir "$dir" "$@"
+    if cmp -s "$TMPDIR_OUT/expected.csv" "$dir/root.csv"; then
+        echo "[scanner_test] PASS ($name)"
+    else
+        echo "[scanner_test] FAIL ($name): root.csv differs from the document's values"
+        FAIL=1
+    fi
+}
+
+check_scan stdin < "$TMPDIR_OUT/doc.json"
+check_scan mapped --input "$TMPDIR_OUT/doc.json"
+check_scan stream --stream < "$TMPDIR_OUT/doc.json"
+check_scan ndjson --ndjson < "$TMPDIR_OUT/doc.jsonl"
+check_scan ndjson-threads --ndjson --threads 4 < "$TMPDIR_OUT/doc.jsonl"
+check_scan ndjson-mapped --ndjson --threads 4 --input "$TMPDIR_OUT/doc.jsonl"
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[scanner_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[scanner_test] RESULT: ALL PASSED"
+exit 0
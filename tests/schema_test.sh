@@ -0,0 +1,191 @@
+#!/usr/bin/env bash
+# Schema test: verifies that converting with --schema (the schema.json of an earlier
+# --emit-schema run) writes the same CSVs as inferring the schema, and that values the
+# schema has no place for are rejected, or skipped with --drop-unknown. Also checks the
+# column types schema.json records.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+SAMPLE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[schema_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[schema_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[schema_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Converts $1 with an inferred schema, then again with that schema loaded, and
+# compares every output file. Extra arguments go to both runs.
+compare_schema() {
+    local name="$1" input="$2"
+    shift 2
+    local inferred_dir="$TMPDIR_OUT/$name-inferred" loaded_dir="$TMPDIR_OUT/$name-loaded"
+
+    echo "[schema_test] Converting $name with an inferred and a loaded schema..."
+    "$BINARY" --emit-schema --out-dir "$inferred_dir" "$@" < "$input"
+    "$BINARY" --schema "$inferred_dir/schema.json" --emit-schema --out-dir "$loaded_dir" "$@" < "$input"
+
+    if ! diff -r "$inferred_dir" "$loaded_dir" >/dev/null; then
+        diff -ru "$inferred_dir" "$loaded_dir" | head -40
+        echo "[schema_test] FAIL: $name --schema output differs from the inferred schema's"
+        FAIL=1
+    else
+        echo "[schema_test] PASS: $name --schema output matches ($(ls "$loaded_dir" | wc -l | tr -d ' ') files)"
+    fi
+}
+
+compare_schema sample "$SAMPLE"
+
+# Same shape as the large benchmark input, scaled down to keep the test quick.
+LARGE_INPUT="$TMPDIR_OUT/large.json"
+python3 "$REPO_ROOT/generate_large_json.py" "$LARGE_INPUT" "$LARGE_OBJECTS" >/dev/null
+compare_schema large "$LARGE_INPUT"
+
+# The sample as JSON Lines, one record per line.
+NDJSON_INPUT="$TMPDIR_OUT/records.jsonl"
+python3 -c 'import json, sys; [print(json.dumps(r)) for r in json.load(open(sys.argv[1]))["records"]]' \
+    "$LARGE_INPUT" > "$NDJSON_INPUT"
+compare_schema ndjson "$NDJSON_INPUT" --ndjson
+
+# A schema that lacks a column the input has: a sample schema without its last column.
+python3 - "$TMPDIR_OUT/sample-inferred/schema.json" "$TMPDIR_OUT/partial.json" <<'PY'
+import json, sys
+schema = json.load(open(sys.argv[1]))
+table = max(schema["tables"], key=lambda t: len(t["columns"]))
+table["columns"].pop()
+table["columnTypes"].pop()
+json.dump(schema, open(sys.argv[2], "w"))
+print(table["name"], file=open(sys.argv[2] + ".table", "w"))
+PY
+PARTIAL_TABLE="$(cat "$TMPDIR_OUT/partial.json.table")"
+
+echo "[schema_test] Unknown column without --drop-unknown..."
+if "$BINARY" --schema "$TMPDIR_OUT/partial.json" --out-dir "$TMPDIR_OUT/rejected" < "$SAMPLE" \
+        2>"$TMPDIR_OUT/rejected.err"; then
+    echo "[schema_test] FAIL: a value outside the schema was accepted"
+    FAIL=1
+elif ! grep -q "of table \"$PARTIAL_TABLE\" is not in the schema" "$TMPDIR_OUT/rejected.err"; then
+    cat "$TMPDIR_OUT/rejected.err"
+    echo "[schema_test] FAIL: the error does not name the unknown column"
+    FAIL=1
+else
+    echo "[schema_test] PASS: rejected ($(cat "$TMPDIR_OUT/rejected.err"))"
+fi
+
+echo "[schema_test] Unknown column with --drop-unknown..."
+DROP_DIR="$TMPDIR_OUT/dropped"
+"$BINARY" --schema "$TMPDIR_OUT/partial.json" --drop-unknown --out-dir "$DROP_DIR" < "$SAMPLE"
+# Every table but the trimmed one is unchanged; that one lost its last column.
+python3 - "$TMPDIR_OUT/sample-inferred" "$DROP_DIR" "$PARTIAL_TABLE" <<'PY' || FAIL=1
+import csv, os, sys
+inferred, dropped, trimmed = sys.argv[1:]
+for name in sorted(os.listdir(inferred)):
+    if not name.endswith(".csv"):
+        continue
+    expected = list(csv.reader(open(os.path.join(inferred, name), newline="")))
+    if name == trimmed + ".csv":
+        expected = [row[:-1] for row in expected]
+    actual = list(csv.reader(open(os.path.join(dropped, name), newline="")))
+    if actual != expected:
+        print(f"[schema_test] FAIL: {name} differs after --drop-unknown")
+        sys.exit(1)
+print("[schema_test] PASS: --drop-unknown skipped only the unknown column")
+PY
+
+echo "[schema_test] Column types..."
+# A member missing from a row or null in one makes its column nullable; maxLength counts
+# the bytes of the longest string, and a scalar after an object or array with the same
+# key is not a value (the first member wins).
+cat > "$TMPDIR_OUT/types.json" <<'JSON'
+[
+  {"i": 1, "f": 1.5, "b": true, "s": "héllo", "n": null, "m": 1, "d": {}, "d": 2},
+  {"i": -9223372036854775808, "f": 2, "b": false, "s": "", "m": "one"},
+  {"i": 9223372036854775807, "f": 1e400, "b": true, "s": "x", "m": false, "l": [1, "a", null, [2]]}
+]
+JSON
+for mode in tree stream; do
+    flags=""
+    [ "$mode" = "stream" ] && flags="--stream"
+    # shellcheck disable=SC2086
+    "$BINARY" --emit-schema $flags --out-dir "$TMPDIR_OUT/types-$mode" < "$TMPDIR_OUT/types.json"
+    python3 - "$TMPDIR_OUT/types-$mode/schema.json" "$mode" <<'PY' || FAIL=1
+import json, sys
+tables = {t["name"]: t for t in json.load(open(sys.argv[1]))["tables"]}
+actual = {(name, c): e for name, t in tables.items() for c, e in zip(t["columns"], t["columnTypes"])}
+integer = {"types": ["integer"], "nullable": False}
+expected = {
+    ("root", "id"): integer,
+    ("root", "seq"): integer,
+    ("root", "i"): integer,
+    ("root", "f"): {"types": ["integer", "number"], "nullable": False},
+    ("root", "b"): {"types": ["boolean"], "nullable": False},
+    ("root", "s"): {"types": ["string"], "nullable": False, "maxLength": 6},
+    ("root", "n"): {"types": [], "nullable": True},
+    ("root", "m"): {"types": ["boolean", "integer", "string"], "nullable": False, "maxLength": 3},
+    ("root", "d"): {"types": [], "nullable": True},
+    ("d", "id"): integer,
+    ("d", "root_id"): integer,
+    ("l", "id"): integer,
+    ("l", "root_id"): integer,
+    ("l", "index"): integer,
+    ("l", "value"): {"types": ["integer", "string"], "nullable": True, "maxLength": 1},
+}
+if actual != expected:
+    for key in sorted(set(actual) | set(expected)):
+        if actual.get(key) != expected.get(key):
+            print(f"[schema_test] {key}: {actual.get(key)}, expected {expected.get(key)}")
+    print(f"[schema_test] FAIL: column types ({sys.argv[2]})")
+    sys.exit(1)
+print(f"[schema_test] PASS: column types ({sys.argv[2]})")
+PY
+done
+
+echo "[schema_test] Sanity check: a schema without column types still loads..."
+python3 - "$TMPDIR_OUT/sample-inferred/schema.json" "$TMPDIR_OUT/untyped.json" <<'PY'
+import json, sys
+schema = json.load(open(sys.argv[1]))
+for table in schema["tables"]:
+    del table["columnTypes"]
+json.dump(schema, open(sys.argv[2], "w"))
+PY
+"$BINARY" --schema "$TMPDIR_OUT/untyped.json" --emit-schema --out-dir "$TMPDIR_OUT/untyped" < "$SAMPLE"
+if python3 -c 'import json, sys; sys.exit(any(e is not None for t in json.load(open(sys.argv[1]))["tables"]
+                                              for e in t["columnTypes"]))' "$TMPDIR_OUT/untyped/schema.json"; then
+    echo "[schema_test] PASS: its columns' types are unknown (null)"
+else
+    echo "[schema_test] FAIL: types were made up for a schema without them"
+    FAIL=1
+fi
+
+echo "[schema_test] Sanity check: a file that is not a schema is rejected..."
+echo '{"tables": [{"name": "../escape", "kind": "object", "columns": []}]}' > "$TMPDIR_OUT/bad.json"
+if "$BINARY" --schema "$TMPDIR_OUT/bad.json" --out-dir "$TMPDIR_OUT/bad" < "$SAMPLE" >/dev/null 2>&1; then
+    echo "[schema_test] FAIL: a schema with a bad table name was accepted"
+    FAIL=1
+else
+    echo "[schema_test] PASS: bad schema rejected"
+fi
+echo '{"tables": [{"name": "t", "kind": "object", "columns": ["id"], "columnTypes": [{"types": ["date"], "nullable": false}]}]}' \
+    > "$TMPDIR_OUT/bad-types.json"
+if "$BINARY" --schema "$TMPDIR_OUT/bad-types.json" --out-dir "$TMPDIR_OUT/bad" < "$SAMPLE" >/dev/null 2>&1; then
+    echo "[schema_test] FAIL: a schema with an unknown column type was accepted"
+    FAIL=1
+else
+    echo "[schema_test] PASS: unknown column type rejected"
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[schema_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[schema_test] RESULT: ALL PASSED"
+exit 0
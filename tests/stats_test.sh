@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+# Stats test: verifies --stats leaves the output untouched, that --stats=json is valid
+# JSON, and that its per-table rows and bytes describe the CSVs actually written.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+SAMPLE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[stats_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[stats_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[stats_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Converts $2 with and without --stats=json (plus flags $3...) and checks the report.
+check_stats() {
+    local name="$1" input="$2"
+    shift 2
+    local plain_dir="$TMPDIR_OUT/$name-plain" stats_dir="$TMPDIR_OUT/$name-stats"
+
+    "$BINARY" --emit-schema "$@" --out-dir "$plain_dir" < "$input"
+    "$BINARY" --emit-schema "$@" --stats=json --out-dir "$stats_dir" < "$input" 2> "$TMPDIR_OUT/$name-report.json"
+
+    if ! diff -r "$plain_dir" "$stats_dir" >/dev/null; then
+        echo "[stats_test] FAIL: $name output changes with --stats"
+        FAIL=1
+        return
+    fi
+
+    if python3 - "$TMPDIR_OUT/$name-report.json" "$stats_dir" <<'PY'
+import json, os, sys
+stats = json.load(open(sys.argv[1]))
+for phase in ("parse", "schema", "write", "emit_schema"):
+    assert stats["phases"][phase]["wall_s"] >= 0, phase
+assert stats["peak_rss_kb"] > 0
+csvs = sorted(f[:-4] for f in os.listdir(sys.argv[2]) if f.endswith(".csv"))
+assert sorted(t["name"] for t in stats["tables"]) == csvs, "tables differ from the CSVs written"
+if stats["counters_enabled"]:
+    assert stats["tokens"]["total"] > 0
+    for t in stats["tables"]:
+        path = os.path.join(sys.argv[2], t["name"] + ".csv")
+        assert os.path.getsize(path) == t["bytes"], t
+PY
+    then
+        echo "[stats_test] PASS: $name --stats=json describes the output"
+    else
+        echo "[stats_test] FAIL: $name --stats=json report is wrong"
+        FAIL=1
+    fi
+}
+
+check_stats sample "$SAMPLE"
+
+LARGE_INPUT="$TMPDIR_OUT/large.json"
+python3 "$REPO_ROOT/generate_large_json.py" "$LARGE_INPUT" "$LARGE_OBJECTS" >/dev/null
+check_stats large "$LARGE_INPUT"
+check_stats large-threads "$LARGE_INPUT" --threads 3
+check_stats large-stream "$LARGE_INPUT" --stream
+
+# The text report names every phase.
+echo "[stats_test] Checking the text report..."
+"$BINARY" --stats --out-dir "$TMPDIR_OUT/text" < "$SAMPLE" 2> "$TMPDIR_OUT/text.txt"
+if grep -q "parse" "$TMPDIR_OUT/text.txt" && grep -q "emit_schema" "$TMPDIR_OUT/text.txt"; then
+    echo "[stats_test] PASS: text report printed"
+else
+    echo "[stats_test] FAIL: text report missing"
+    FAIL=1
+fi
+
+# Sanity: an unknown format is rejected.
+if "$BINARY" --stats=xml --out-dir "$TMPDIR_OUT/rejected" < "$SAMPLE" >/dev/null 2>&1; then
+    echo "[stats_test] FAIL: --stats=xml was accepted"
+    FAIL=1
+else
+    echo "[stats_test] PASS: --stats=xml rejected"
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[stats_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[stats_test] RESULT: ALL PASSED"
+exit 0
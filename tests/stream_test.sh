@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+# Stream test: verifies --stream writes the same CSVs and schema.json as the
+# AST-based conversion, on the sample input and on a generated large input.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+SAMPLE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[stream_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[stream_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[stream_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Converts $1 both ways and compares every output file.
+compare_modes() {
+    local name="$1" input="$2"
+    local ast_dir="$TMPDIR_OUT/$name-ast" stream_dir="$TMPDIR_OUT/$name-stream"
+
+    echo "[stream_test] Converting $name with and without --stream..."
+    "$BINARY" --emit-schema --out-dir "$ast_dir" < "$input"
+    "$BINARY" --stream --emit-schema --out-dir "$stream_dir" < "$input"
+
+    if ! diff -r "$ast_dir" "$stream_dir" >/dev/null; then
+        diff -ru "$ast_dir" "$stream_dir" | head -40
+        echo "[stream_test] FAIL: $name --stream output differs from the AST path"
+        FAIL=1
+    else
+        echo "[stream_test] PASS: $name --stream output matches ($(ls "$stream_dir" | wc -l | tr -d ' ') files)"
+    fi
+}
+
+compare_modes sample "$SAMPLE"
+
+# Same shape as the large benchmark input, scaled down to keep the test quick.
+LARGE_INPUT="$TMPDIR_OUT/large.json"
+python3 "$REPO_ROOT/generate_large_json.py" "$LARGE_INPUT" "$LARGE_OBJECTS" >/dev/null
+compare_modes large "$LARGE_INPUT"
+
+# Sanity: --print-ast needs the AST, so it must be rejected in stream mode.
+echo "[stream_test] Sanity check: --stream rejects --print-ast..."
+if "$BINARY" --stream --print-ast --out-dir "$TMPDIR_OUT/rejected" < "$SAMPLE" >/dev/null 2>&1; then
+    echo "[stream_test] FAIL: --stream --print-ast was accepted"
+    FAIL=1
+else
+    echo "[stream_test] PASS: --stream --print-ast rejected"
+fi
+
+# Sanity: rows that cannot be spooled fail the conversion. The large input spools past
+# the 8 MiB kept in memory; a 1 MiB file size limit makes the temporary file's writes fail.
+if [ "$LARGE_OBJECTS" -ge 20000 ]; then
+    echo "[stream_test] Sanity check: a failed spool write fails the conversion..."
+    if (trap '' XFSZ; ulimit -f 1024; "$BINARY" --stream --out-dir "$TMPDIR_OUT/spool" < "$LARGE_INPUT") \
+            2> "$TMPDIR_OUT/spool.err"; then
+        echo "[stream_test] FAIL: the conversion succeeded"
+        FAIL=1
+    elif ! grep -q "spooled rows" "$TMPDIR_OUT/spool.err"; then
+        echo "[stream_test] FAIL: unexpected error: $(cat "$TMPDIR_OUT/spool.err")"
+        FAIL=1
+    else
+        echo "[stream_test] PASS: $(cat "$TMPDIR_OUT/spool.err")"
+    fi
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[stream_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[stream_test] RESULT: ALL PASSED"
+exit 0
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+# Threads test: verifies --threads N writes exactly the same CSVs and schema.json
+# as a single-threaded run, for several worker counts.
+set -euo pipefail
+
+REPO_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BINARY="$REPO_ROOT/build/json2relcsv"
+SAMPLE="$REPO_ROOT/tests/sample.json"
+LARGE_OBJECTS="${LARGE_OBJECTS:-20000}"
+
+# Build if binary not present
+if [ ! -f "$BINARY" ]; then
+    echo "[threads_test] Binary not found; building..."
+    cmake -B "$REPO_ROOT/build" -S "$REPO_ROOT" >/dev/null || { echo "[threads_test] cmake configure failed"; exit 1; }
+    cmake --build "$REPO_ROOT/build" >/dev/null || { echo "[threads_test] build failed"; exit 1; }
+fi
+
+TMPDIR_OUT="$(mktemp -d)"
+trap 'rm -rf "$TMPDIR_OUT"' EXIT
+
+FAIL=0
+
+# Converts $2 single-threaded and with several --threads counts and compares the output.
+compare_threads() {
+    local name="$1" input="$2"
+    local serial_dir="$TMPDIR_OUT/$name-1"
+
+    "$BINARY" --emit-schema --out-dir "$serial_dir" < "$input"
+    for threads in 2 3 8 64; do
+        local threads_dir="$TMPDIR_OUT/$name-$threads"
+        "$BINARY" --emit-schema --threads "$threads" --out-dir "$threads_dir" < "$input"
+        if ! diff -r "$serial_dir" "$threads_dir" >/dev/null; then
+            diff -ru "$serial_dir" "$threads_dir" | head -40
+            echo "[threads_test] FAIL: $name with --threads $threads differs from one thread"
+            FAIL=1
+        else
+            echo "[threads_test] PASS: $name with --threads $threads matches one thread"
+        fi
+    done
+}
+
+compare_threads sample "$SAMPLE"
+
+LARGE_INPUT="$TMPDIR_OUT/large.json"
+python3 "$REPO_ROOT/generate_large_json.py" "$LARGE_INPUT" "$LARGE_OBJECTS" >/dev/null
+compare_threads large "$LARGE_INPUT"
+
+# Sanity: a thread count that is not a positive number is rejected.
+echo "[threads_test] Sanity check: --threads 0 is rejected..."
+if "$BINARY" --threads 0 --out-dir "$TMPDIR_OUT/rejected" < "$SAMPLE" >/dev/null 2>&1; then
+    echo "[threads_test] FAIL: --threads 0 was accepted"
+    FAIL=1
+else
+    echo "[threads_test] PASS: --threads 0 rejected"
+fi
+
+if [ "$FAIL" -ne 0 ]; then
+    echo "[threads_test] RESULT: FAILED"
+    exit 1
+fi
+
+echo "[threads_test] RESULT: ALL PASSED"
+exit 0
@@ -0,0 +1,405 @@
+// Reads a columnar table file (--format=columnar, see columnar.h) and prints it.
+//
+//   json2relcsv_dump FILE.jrc           the table as CSV, byte for byte what --format=csv writes
+//   json2relcsv_dump --info FILE.jrc    the table's layout: every chunk's column encodings and sizes
+//
+// The reader checks every length against the file, so it doubles as a validator: a
+// truncated or malformed file is reported and exits with status 1.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "columnar.h"
+#include "input.h"
+
+typedef struct Reader {
+    const unsigned char* p;
+    const unsigned char* end;
+    const char* path;
+} Reader;
+
+// One decoded cell.
+typedef struct Cell {
+    int kind;            // 0 for null, otherwise a ColumnarValueKind
+    const char* text;    // strings and number lexemes
+    size_t len;
+    int has_int;         // COLUMNAR_INT64
+    long long int_value;
+    int has_double;      // COLUMNAR_FLOAT64
+    double double_value;
+} Cell;
+
+static void fail(const Reader* r, const char* what) {
+    fprintf(stderr, "Error: %s: %s\n", r->path, what);
+    exit(EXIT_FAILURE);
+}
+
+static const unsigned char* take(Reader* r, size_t len) {
+    if ((size_t)(r->end - r->p) < len) {
+        fail(r, "truncated");
+    }
+    const unsigned char* bytes = r->p;
+    r->p += len;
+    return bytes;
+}
+
+static unsigned int get_u8(Reader* r) {
+    return *take(r, 1);
+}
+
+static size_t get_u32(Reader* r) {
+    const unsigned char* b = take(r, 4);
+    return (size_t)b[0] | (size_t)b[1] << 8 | (size_t)b[2] << 16 | (size_t)b[3] << 24;
+}
+
+// Reads a 'width'-byte unsigned integer.
+static unsigned long long get_uint(Reader* r, size_t width) {
+    const unsigned char* b = take(r, width);
+    unsigned long long value = 0;
+    for (size_t i = width; i-- > 0;) {
+        value = value << 8 | b[i];
+    }
+    return value;
+}
+
+static unsigned long long get_u64(Reader* r) {
+    return get_uint(r, 8);
+}
+
+static char* get_name(Reader* r) {
+    size_t len = get_u32(r);
+    const unsigned char* bytes = take(r, len);
+    char* name = (char*)malloc(len + 1);
+    if (!name) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(name, bytes, len);
+    name[len] = '\0';
+    return name;
+}
+
+// Reads the "strings" layout of 'count' values into the cells listed in 'targets'.
+static void get_strings(Reader* r, Cell** targets, size_t count) {
+    const unsigned char* offsets = take(r, 4 * (count + 1));
+    Reader offset_reader = { offsets, offsets + 4 * (count + 1), r->path };
+    size_t previous = get_u32(&offset_reader);
+    if (previous != 0) {
+        fail(r, "bad string offsets");
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t next = get_u32(&offset_reader);
+        if (next < previous) {
+            fail(r, "bad string offsets");
+        }
+        previous = next;
+    }
+    const char* bytes = (const char*)take(r, previous);
+
+    offset_reader.p = offsets;
+    size_t start = get_u32(&offset_reader);
+    for (size_t i = 0; i < count; i++) {
+        size_t next = get_u32(&offset_reader);
+        targets[i]->text = bytes + start;
+        targets[i]->len = next - start;
+        start = next;
+    }
+}
+
+static const char* encoding_name(unsigned int encoding) {
+    switch (encoding) {
+        case COLUMNAR_NULL: return "null";
+        case COLUMNAR_BOOL: return "bool";
+        case COLUMNAR_INT64: return "int64";
+        case COLUMNAR_INT64_DELTA: return "int64_delta";
+        case COLUMNAR_FLOAT64: return "float64";
+        case COLUMNAR_NUMBER_TEXT: return "number_text";
+        case COLUMNAR_STRING: return "string";
+        case COLUMNAR_STRING_DICT: return "string_dict";
+        case COLUMNAR_MIXED: return "mixed";
+        default: return NULL;
+    }
+}
+
+// Decodes one column chunk of 'rows' rows into 'cells' (one per row). 'present' is
+// scratch space for 'rows' pointers.
+static void get_column_chunk(Reader* r, Cell* cells, Cell** present, size_t rows, unsigned int* encoding_out,
+                             size_t* size_out) {
+    unsigned int encoding = get_u8(r);
+    unsigned int flags = get_u8(r);
+    size_t size = get_u32(r);
+    Reader column = { take(r, size), NULL, r->path };
+    column.end = column.p + size;
+    if (!encoding_name(encoding)) {
+        fail(r, "unknown column encoding");
+    }
+    *encoding_out = encoding;
+    *size_out = size + 6;
+
+    memset(cells, 0, rows * sizeof(Cell));
+    size_t count = 0;
+    if (encoding == COLUMNAR_NULL) {
+        count = 0;
+    } else if (flags & COLUMNAR_HAS_NULLS) {
+        const unsigned char* bitmap = take(&column, (rows + 7) / 8);
+        for (size_t row = 0; row < rows; row++) {
+            if (bitmap[row / 8] >> (row % 8) & 1) {
+                present[count++] = &cells[row];
+            }
+        }
+    } else {
+        for (size_t row = 0; row < rows; row++) {
+            present[count++] = &cells[row];
+        }
+    }
+
+    switch (encoding) {
+        case COLUMNAR_NULL:
+            break;
+        case COLUMNAR_BOOL: {
+            const unsigned char* bits = take(&column, (count + 7) / 8);
+            for (size_t i = 0; i < count; i++) {
+                present[i]->kind = (bits[i / 8] >> (i % 8) & 1) ? COLUMNAR_VALUE_TRUE : COLUMNAR_VALUE_FALSE;
+            }
+            break;
+        }
+        case COLUMNAR_INT64:
+        case COLUMNAR_INT64_DELTA: {
+            unsigned long long value = encoding == COLUMNAR_INT64_DELTA && count > 0 ? get_u64(&column) : 0;
+            unsigned long long base = get_u64(&column);
+            size_t width = get_u8(&column);
+            if (width != 1 && width != 2 && width != 4 && width != 8) {
+                fail(r, "bad integer width");
+            }
+            for (size_t i = 0; i < count; i++) {
+                if (encoding == COLUMNAR_INT64) {
+                    value = base + get_uint(&column, width);
+                } else if (i > 0) {
+                    value += base + get_uint(&column, width);
+                }
+                present[i]->kind = COLUMNAR_VALUE_NUMBER;
+                present[i]->has_int = 1;
+                present[i]->int_value = (long long)value;
+            }
+            break;
+        }
+        case COLUMNAR_FLOAT64:
+            for (size_t i = 0; i < count; i++) {
+                unsigned long long bits = get_u64(&column);
+                present[i]->kind = COLUMNAR_VALUE_NUMBER;
+                present[i]->has_double = 1;
+                memcpy(&present[i]->double_value, &bits, sizeof(bits));
+            }
+            break;
+        case COLUMNAR_NUMBER_TEXT:
+        case COLUMNAR_STRING:
+            for (size_t i = 0; i < count; i++) {
+                present[i]->kind = encoding == COLUMNAR_STRING ? COLUMNAR_VALUE_STRING : COLUMNAR_VALUE_NUMBER;
+            }
+            get_strings(&column, present, count);
+            break;
+        case COLUMNAR_STRING_DICT: {
+            size_t entry_count = get_u32(&column);
+            size_t width = get_u8(&column);
+            if (width != 1 && width != 2 && width != 4) {
+                fail(r, "bad dictionary index width");
+            }
+            if (entry_count > (size_t)(column.end - column.p) / 4) {
+                fail(r, "truncated");
+            }
+            Cell* entries = (Cell*)calloc(entry_count ? entry_count : 1, sizeof(Cell));
+            Cell** entry_list = (Cell**)malloc((entry_count ? entry_count : 1) * sizeof(Cell*));
+            if (!entries || !entry_list) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            for (size_t i = 0; i < entry_count; i++) {
+                entry_list[i] = &entries[i];
+            }
+            get_strings(&column, entry_list, entry_count);
+            for (size_t i = 0; i < count; i++) {
+                size_t index = (size_t)get_uint(&column, width);
+                if (index >= entry_count) {
+                    fail(r, "dictionary index out of range");
+                }
+                present[i]->kind = COLUMNAR_VALUE_STRING;
+                present[i]->text = entries[index].text;
+                present[i]->len = entries[index].len;
+            }
+            free(entries);
+            free(entry_list);
+            break;
+        }
+        case COLUMNAR_MIXED: {
+            const unsigned char* kinds = take(&column, count);
+            for (size_t i = 0; i < count; i++) {
+                if (kinds[i] < COLUMNAR_VALUE_STRING || kinds[i] > COLUMNAR_VALUE_TRUE) {
+                    fail(r, "bad value kind");
+                }
+                present[i]->kind = kinds[i];
+            }
+            get_strings(&column, present, count);
+            break;
+        }
+    }
+    if (column.p != column.end) {
+        fail(r, "column chunk length does not match its contents");
+    }
+}
+
+static void print_cell(const Cell* cell) {
+    char number[32];
+    switch (cell->kind) {
+        case COLUMNAR_VALUE_STRING:
+            putchar('"');
+            for (size_t i = 0; i < cell->len; i++) {
+                if (cell->text[i] == '"') {
+                    putchar('"');
+                }
+                putchar(cell->text[i]);
+            }
+            putchar('"');
+            break;
+        case COLUMNAR_VALUE_NUMBER:
+            if (cell->has_int) {
+                printf("%lld", cell->int_value);
+            } else if (cell->has_double) {
+                columnar_format_double(cell->double_value, number, sizeof(number));
+                fputs(number, stdout);
+            } else {
+                fwrite(cell->text, 1, cell->len, stdout);
+            }
+            break;
+        case COLUMNAR_VALUE_FALSE:
+            fputs("false", stdout);
+            break;
+        case COLUMNAR_VALUE_TRUE:
+            fputs("true", stdout);
+            break;
+        default:
+            break;  // null: empty field
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int info = 0;
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--info") == 0) {
+            info = 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: json2relcsv_dump [--info] FILE.jrc\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", path);
+        return EXIT_FAILURE;
+    }
+    size_t size = 0;
+    char* data = input_read_stream(file, &size);
+    fclose(file);
+
+    Reader r = { (const unsigned char*)data, (const unsigned char*)data + size, path };
+    if (memcmp(take(&r, 4), COLUMNAR_MAGIC, 4) != 0) {
+        fail(&r, "not a columnar table file");
+    }
+    char* table = get_name(&r);
+    size_t column_count = get_u32(&r);
+    if (column_count > size) {
+        fail(&r, "truncated");
+    }
+    char** names = (char**)malloc((column_count ? column_count : 1) * sizeof(char*));
+    Cell** cells = (Cell**)malloc((column_count ? column_count : 1) * sizeof(Cell*));
+    if (!names || !cells) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t c = 0; c < column_count; c++) {
+        names[c] = get_name(&r);
+        cells[c] = NULL;
+    }
+
+    if (info) {
+        printf("table %s, %zu columns\n", table, column_count);
+    } else {
+        for (size_t c = 0; c < column_count; c++) {
+            printf("%s%s", c ? "," : "", names[c]);
+        }
+        putchar('\n');
+    }
+
+    size_t capacity = 0;
+    Cell** present = NULL;
+    size_t total_rows = 0;
+    size_t chunk_count = 0;
+    size_t rows;
+    while ((rows = get_u32(&r)) > 0) {
+        if (rows > capacity) {
+            capacity = rows;
+            present = (Cell**)realloc(present, capacity * sizeof(Cell*));
+            for (size_t c = 0; c < column_count; c++) {
+                cells[c] = (Cell*)realloc(cells[c], capacity * sizeof(Cell));
+                if (!cells[c]) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (!present) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (info) {
+            printf("chunk %zu: %zu rows\n", chunk_count, rows);
+        }
+        for (size_t c = 0; c < column_count; c++) {
+            unsigned int encoding;
+            size_t chunk_size;
+            get_column_chunk(&r, cells[c], present, rows, &encoding, &chunk_size);
+            if (info) {
+                size_t nulls = 0;
+                for (size_t row = 0; row < rows; row++) {
+                    nulls += cells[c][row].kind == 0;
+                }
+                printf("  %-24s %-12s %8zu nulls %12zu bytes\n", names[c], encoding_name(encoding), nulls, chunk_size);
+            }
+        }
+
+        if (!info) {
+            for (size_t row = 0; row < rows; row++) {
+                for (size_t c = 0; c < column_count; c++) {
+                    if (c) {
+                        putchar(',');
+                    }
+                    print_cell(&cells[c][row]);
+                }
+                putchar('\n');
+            }
+        }
+        total_rows += rows;
+        chunk_count++;
+    }
+    if (r.p != r.end) {
+        fail(&r, "unexpected data after the end of the table");
+    }
+    if (info) {
+        printf("%zu rows in %zu chunks, %zu bytes\n", total_rows, chunk_count, size);
+    }
+
+    for (size_t c = 0; c < column_count; c++) {
+        free(names[c]);
+        free(cells[c]);
+    }
+    free(names);
+    free(cells);
+    free(present);
+    free(table);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+// Reads a PostgreSQL binary COPY file (--format=pgcopy, see pgcopy.h) and prints it.
+//
+//   json2relcsv_pgcopy_dump FILE.pgcopy          the table as CSV: text quoted, bigint and
+//                                                numeric as PostgreSQL prints them, booleans
+//                                                as true/false, null as an empty field
+//   json2relcsv_pgcopy_dump --info FILE.pgcopy   the columns with their types, and the row count
+//
+// The reader checks every length against the file, and when printing, every value against
+// its column's type, so it doubles as a validator: a truncated or malformed file is
+// reported and exits with status 1.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgcopy.h"
+#include "input.h"
+
+typedef struct Reader {
+    const unsigned char* p;
+    const unsigned char* end;
+    const char* path;
+} Reader;
+
+static void fail(const Reader* r, const char* what) {
+    fprintf(stderr, "Error: %s: %s\n", r->path, what);
+    exit(EXIT_FAILURE);
+}
+
+static const unsigned char* take(Reader* r, size_t len) {
+    if ((size_t)(r->end - r->p) < len) {
+        fail(r, "truncated");
+    }
+    const unsigned char* bytes = r->p;
+    r->p += len;
+    return bytes;
+}
+
+static int get_int16(Reader* r) {
+    const unsigned char* b = take(r, 2);
+    return (short)(b[0] << 8 | b[1]);
+}
+
+static long get_int32(Reader* r) {
+    const unsigned char* b = take(r, 4);
+    return (long)(int)((unsigned int)b[0] << 24 | (unsigned int)b[1] << 16 | (unsigned int)b[2] << 8 | b[3]);
+}
+
+static long long get_int64(Reader* r) {
+    const unsigned char* b = take(r, 8);
+    unsigned long long value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = value << 8 | b[i];
+    }
+    return (long long)value;
+}
+
+// Prints a numeric value the way PostgreSQL does: every digit of the integer part, then
+// 'dscale' digits after the point.
+static void print_numeric(Reader* r) {
+    int ndigits = get_int16(r);
+    int weight = get_int16(r);
+    int sign = get_int16(r) & 0xFFFF;
+    int dscale = get_int16(r);
+    if (ndigits < 0 || dscale < 0 || (sign != 0 && sign != 0x4000)) {
+        fail(r, "bad numeric header");
+    }
+    int* digits = (int*)malloc(((size_t)ndigits + 1) * sizeof(int));
+    if (!digits) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < ndigits; i++) {
+        digits[i] = get_int16(r);
+        if (digits[i] < 0 || digits[i] > 9999) {
+            fail(r, "bad numeric digit");
+        }
+    }
+    if (r->p != r->end) {
+        fail(r, "numeric length does not match its digits");
+    }
+
+    if (sign && ndigits > 0) {
+        putchar('-');
+    }
+    // Digit i is worth 10000^(weight - i).
+    if (weight < 0) {
+        putchar('0');
+    }
+    for (int i = 0; i <= weight; i++) {
+        int digit = i < ndigits ? digits[i] : 0;
+        printf(i == 0 ? "%d" : "%04d", digit);
+    }
+    if (dscale > 0) {
+        putchar('.');
+        for (int i = weight + 1, printed = 0; printed < dscale; i++) {
+            char group[5];
+            snprintf(group, sizeof(group), "%04d", i >= 0 && i < ndigits ? digits[i] : 0);
+            for (int k = 0; k < 4 && printed < dscale; k++, printed++) {
+                putchar(group[k]);
+            }
+        }
+    }
+    free(digits);
+}
+
+// Prints the field in 'r' (exactly its bytes) as a CSV cell of a 'type' column.
+static void print_field(Reader* r, long type) {
+    size_t len = (size_t)(r->end - r->p);
+    switch (type) {
+        case PGCOPY_BOOLEAN:
+            if (len != 1 || *r->p > 1) {
+                fail(r, "bad boolean");
+            }
+            fputs(*r->p ? "true" : "false", stdout);
+            break;
+        case PGCOPY_BIGINT:
+            if (len != 8) {
+                fail(r, "bad bigint length");
+            }
+            printf("%lld", get_int64(r));
+            break;
+        case PGCOPY_NUMERIC:
+            print_numeric(r);
+            break;
+        default:
+            putchar('"');
+            for (size_t i = 0; i < len; i++) {
+                if (r->p[i] == '"') {
+                    putchar('"');
+                }
+                putchar(r->p[i]);
+            }
+            putchar('"');
+            break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int info = 0;
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--info") == 0) {
+            info = 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: json2relcsv_pgcopy_dump [--info] FILE.pgcopy\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", path);
+        return EXIT_FAILURE;
+    }
+    size_t size = 0;
+    char* data = input_read_stream(file, &size);
+    fclose(file);
+
+    Reader r = { (const unsigned char*)data, (const unsigned char*)data + size, path };
+    if (memcmp(take(&r, PGCOPY_SIGNATURE_SIZE), PGCOPY_SIGNATURE, PGCOPY_SIGNATURE_SIZE) != 0) {
+        fail(&r, "not a binary COPY file");
+    }
+    if (get_int32(&r) != 0) {
+        fail(&r, "unexpected flags");
+    }
+    long extension_len = get_int32(&r);
+    if (extension_len < 0) {
+        fail(&r, "bad header extension length");
+    }
+    Reader extension = { take(&r, (size_t)extension_len), NULL, path };
+    extension.end = extension.p + extension_len;
+    if (memcmp(take(&extension, PGCOPY_EXTENSION_TAG_SIZE), PGCOPY_EXTENSION_TAG, PGCOPY_EXTENSION_TAG_SIZE) != 0) {
+        fail(&r, "no json2relcsv column list in the header");
+    }
+    long column_count = get_int32(&extension);
+    if (column_count < 0 || column_count > PGCOPY_MAX_COLUMNS) {
+        fail(&r, "bad column count");
+    }
+    long* types = (long*)malloc(((size_t)column_count + 1) * sizeof(long));
+    if (!types) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (info) {
+        printf("%ld columns\n", column_count);
+    }
+    for (long c = 0; c < column_count; c++) {
+        types[c] = get_int32(&extension);
+        long name_len = get_int32(&extension);
+        if (!pgcopy_type_name((int)types[c])) {
+            fail(&r, "unknown column type");
+        }
+        if (name_len < 0) {
+            fail(&r, "bad column name length");
+        }
+        const char* name = (const char*)take(&extension, (size_t)name_len);
+        if (info) {
+            printf("  %-24.*s %s\n", (int)name_len, name, pgcopy_type_name((int)types[c]));
+        } else {
+            printf("%s%.*s", c ? "," : "", (int)name_len, name);
+        }
+    }
+    if (extension.p != extension.end) {
+        fail(&r, "header extension length does not match its contents");
+    }
+    if (!info) {
+        putchar('\n');
+    }
+
+    size_t rows = 0;
+    int field_count;
+    while ((field_count = get_int16(&r)) != -1) {
+        if (field_count != column_count) {
+            fail(&r, "row field count does not match the columns");
+        }
+        for (long c = 0; c < column_count; c++) {
+            long len = get_int32(&r);
+            if (c && !info) {
+                putchar(',');
+            }
+            if (len == -1) {
+                continue;  // null: empty field
+            }
+            if (len < 0) {
+                fail(&r, "bad field length");
+            }
+            Reader field = { take(&r, (size_t)len), NULL, path };
+            field.end = field.p + len;
+            if (!info) {
+                print_field(&field, types[c]);
+            }
+        }
+        if (!info) {
+            putchar('\n');
+        }
+        rows++;
+    }
+    if (r.p != r.end) {
+        fail(&r, "unexpected data after the end of the table");
+    }
+    if (info) {
+        printf("%zu rows, %zu bytes\n", rows, size);
+    }
+
+    free(types);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -74,6 +74,9 @@ mkdir -p "${OUT_DIR}"
 echo ""
 echo "==> Compiling to WASM with emcc..."
 
+# callMain + MEMFS drives the CLI; the exported json2relcsv_* functions convert a buffer
+# straight into memory buffers without touching the file system (see web/test/smoke.mjs).
+
 emcc \
     -O2 \
     -s MODULARIZE=1 \
@@ -82,17 +85,34 @@ emcc \
     -s SINGLE_FILE=1 \
     -s INVOKE_RUN=0 \
     -s EXIT_RUNTIME=1 \
-    -s EXPORTED_RUNTIME_METHODS=callMain,FS \
+    -s EXPORTED_RUNTIME_METHODS=callMain,FS,HEAPU8,setValue,UTF8ToString \
+    -s EXPORTED_FUNCTIONS=_main,_malloc,_free,_json2relcsv_convert_to_memory,_json2relcsv_memory_create,_json2relcsv_memory_count,_json2relcsv_memory_name,_json2relcsv_memory_data,_json2relcsv_memory_size,_json2relcsv_memory_free,_json2relcsv_archive_create,_json2relcsv_archive_sink,_json2relcsv_archive_finish,_json2relcsv_archive_free \
     -s ALLOW_MEMORY_GROWTH=1 \
     -s FORCE_FILESYSTEM=1 \
+    -s USE_ZLIB=1 \
+    -D JSON2RELCSV_WITH_ZLIB \
     -I "${REPO_ROOT}/include" \
     -I "${GEN_INCLUDE_DIR}" \
     -I "${GEN_DIR}" \
     "${GEN_DIR}/parser.tab.c" \
     "${GEN_DIR}/lex.yy.c" \
     "${REPO_ROOT}/src/main.c" \
+    "${REPO_ROOT}/src/json2relcsv.c" \
+    "${REPO_ROOT}/src/arena.c" \
     "${REPO_ROOT}/src/ast.c" \
+    "${REPO_ROOT}/src/symbols.c" \
     "${REPO_ROOT}/src/csv_gen.c" \
+    "${REPO_ROOT}/src/schema.c" \
+    "${REPO_ROOT}/src/row_ids.c" \
+    "${REPO_ROOT}/src/csv_writer.c" \
+    "${REPO_ROOT}/src/columnar.c" \
+    "${REPO_ROOT}/src/pgcopy.c" \
+    "${REPO_ROOT}/src/compress.c" \
+    "${REPO_ROOT}/src/archive.c" \
+    "${REPO_ROOT}/src/stream_gen.c" \
+    "${REPO_ROOT}/src/input.c" \
+    "${REPO_ROOT}/src/json_number.c" \
+    "${REPO_ROOT}/src/ndjson.c" \
     -o "${OUT_DIR}/json2relcsv.mjs"
 
 # ---------------------------------------------------------------------------
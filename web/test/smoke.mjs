@@ -118,6 +118,43 @@ async function convert(json) {
   };
 }
 
+// ---------------------------------------------------------------------------
+// Helper: convert through the library API (include/json2relcsv.h) into memory
+// buffers — no stdin, no MEMFS. Returns { result, outputs, error }.
+// ---------------------------------------------------------------------------
+async function convertInMemory(json) {
+  const module = await createJson2relcsv({ print() {}, printErr() {} });
+  const inputBytes = Buffer.from(json, 'utf8');
+
+  const data = module._malloc(inputBytes.length + 1);
+  module.HEAPU8.set(inputBytes, data);
+  // Json2RelCsvOptions: five ints (emit_schema, stream, ndjson, threads, print_ast),
+  // the stats and schema pointers, then drop_unknown, format, compression and
+  // compression_level.
+  const options = module._malloc(44);
+  module.HEAPU8.fill(0, options, options + 44);
+  module.setValue(options, 1, 'i32');
+  // Json2RelCsvError: line, column, then the message.
+  const error = module._malloc(8 + 160);
+  const memory = module._json2relcsv_memory_create();
+
+  const result = module._json2relcsv_convert_to_memory(data, inputBytes.length, options, memory, error);
+
+  const outputs = {};
+  const count = module._json2relcsv_memory_count(memory);
+  for (let i = 0; i < count; i++) {
+    const name = module.UTF8ToString(module._json2relcsv_memory_name(memory, i));
+    outputs[name] = module.UTF8ToString(module._json2relcsv_memory_data(memory, i));
+  }
+  const message = result === 0 ? null : module.UTF8ToString(error + 8);
+
+  module._json2relcsv_memory_free(memory);
+  module._free(error);
+  module._free(options);
+  module._free(data);
+  return { result, outputs, error: message };
+}
+
 // ---------------------------------------------------------------------------
 // Assertion helpers
 // ---------------------------------------------------------------------------
@@ -178,6 +215,31 @@ if (failures === 0) {
   console.log('  PASS');
 }
 
+// ---------------------------------------------------------------------------
+// Test 3: library API into memory buffers matches the MEMFS run
+// ---------------------------------------------------------------------------
+console.log('--- Test 3: library API, in-memory sink ---');
+const inMemory = await convertInMemory(sampleJson);
+
+assert(inMemory.result === 0, `in-memory conversion should succeed, got ${inMemory.result}`);
+for (const [name, content] of Object.entries(valid.tables)) {
+  assert(inMemory.outputs[name + '.csv'] === content, `in-memory "${name}.csv" should match the MEMFS file`);
+}
+assert(Object.keys(inMemory.outputs).length === csvCount + 1, 'in-memory outputs should be the CSVs plus schema.json');
+assert(
+  JSON.stringify(JSON.parse(inMemory.outputs['schema.json'] ?? 'null')) === JSON.stringify(valid.schema),
+  'in-memory schema.json should match the MEMFS file',
+);
+
+const inMemoryInvalid = await convertInMemory('{ not valid json');
+assert(inMemoryInvalid.result !== 0, 'invalid JSON should fail in memory too');
+assert(/syntax error/.test(inMemoryInvalid.error ?? ''), `error message expected, got ${JSON.stringify(inMemoryInvalid.error)}`);
+
+if (failures === 0) {
+  console.log('  outputs:', Object.keys(inMemory.outputs).join(', '));
+  console.log('  PASS');
+}
+
 // ---------------------------------------------------------------------------
 // Final result
 // ---------------------------------------------------------------------------